@@ -0,0 +1,191 @@
+#include "AnimFile.h"
+#include "MappedFile.h"
+#include "GatherWriter.h"
+#include "Logger.h"
+#include <filesystem>
+#include <cstring>
+
+namespace
+{
+	bool IsAnimChunk(uint32_t ChunkId)
+	{
+		using EAnimChunk = M2Lib::AnimFile::EAnimChunk;
+
+		return ChunkId == (uint32_t)EAnimChunk::AFM2 || ChunkId == (uint32_t)EAnimChunk::AFSA || ChunkId == (uint32_t)EAnimChunk::AFSB;
+	}
+
+	uint32_t ReadChunkId(uint8_t const* Data)
+	{
+		uint32_t ChunkId;
+		memcpy(&ChunkId, Data, sizeof(ChunkId));
+		return REVERSE_CC(ChunkId);
+	}
+}
+
+M2Lib::EError M2Lib::AnimFile::Load(const wchar_t* FileName)
+{
+	if (!FileName)
+		return EError_FailedToLoadAnim_CouldNotOpenFile;
+
+	auto File = std::make_shared<MappedFile>();
+	if (!File->Open(FileName))
+		return EError_FailedToLoadAnim_CouldNotOpenFile;
+
+	if (File->GetSize() > UINT32_MAX)
+		return EError_FailedToLoadAnim_FileCorrupt;
+
+	auto Data = File->GetData();
+	uint32_t FileSize = (uint32_t)File->GetSize();
+
+	// file is chunked if it starts with known chunk and chunks cover it exactly, otherwise whole file is model keys
+	std::vector<Chunk> FileChunks;
+	bool Chunked = FileSize >= 8 && IsAnimChunk(ReadChunkId(Data));
+	for (uint32_t Offset = 0; Chunked && Offset < FileSize;)
+	{
+		uint32_t ChunkSize;
+		if (FileSize - Offset < 8)
+		{
+			Chunked = false;
+			break;
+		}
+		memcpy(&ChunkSize, Data + Offset + 4, sizeof(ChunkSize));
+		if (ChunkSize > FileSize - Offset - 8)
+		{
+			Chunked = false;
+			break;
+		}
+
+		Chunk chunk;
+		chunk.Id = ReadChunkId(Data + Offset);
+		chunk.Offset = Offset + 8;
+		chunk.Size = ChunkSize;
+		FileChunks.push_back(std::move(chunk));
+
+		Offset += 8 + ChunkSize;
+	}
+
+	if (!Chunked)
+	{
+		FileChunks.clear();
+
+		Chunk chunk;
+		chunk.Id = (uint32_t)EAnimChunk::AFM2;
+		chunk.Offset = 0;
+		chunk.Size = FileSize;
+		FileChunks.push_back(std::move(chunk));
+	}
+
+	fileName = FileName;
+	mapping = File;
+	chunks = std::move(FileChunks);
+	chunked = Chunked;
+	modified = false;
+
+	return EError_OK;
+}
+
+M2Lib::EError M2Lib::AnimFile::Save(const wchar_t* FileName, SaveBatch& Batch)
+{
+	if (!FileName)
+		return EError_FailedToSaveM2_NoFileSpecified;
+
+	auto directory = std::filesystem::path(FileName).parent_path();
+	if (!std::filesystem::is_directory(directory) && !std::filesystem::create_directories(directory))
+	{
+		sLogger.LogError(L"Failed to write to directory '%s'", directory.wstring().c_str());
+
+		return EError_FailedToSaveM2;
+	}
+
+	// mapped file can't be replaced while it is mapped by this file or any of its clones
+	std::error_code ec;
+	if (mapping && std::filesystem::equivalent(FileName, fileName, ec))
+		Detach();
+
+	sLogger.LogInfo(L"Saving animation file to %s", FileName);
+
+	auto& Writer = Batch.Add(FileName, EError_FailedToSaveM2);
+	for (auto& chunk : chunks)
+	{
+		if (chunked)
+		{
+			Writer.AppendValue(REVERSE_CC(chunk.Id));
+			Writer.AppendValue(chunk.Size);
+		}
+
+		if (chunk.Size)
+			Writer.Append(GetChunkData(chunk), chunk.Size);
+	}
+
+	return EError_OK;
+}
+
+M2Lib::AnimFile* M2Lib::AnimFile::Clone() const
+{
+	return new AnimFile(*this);
+}
+
+M2Lib::AnimFile::Chunk const* M2Lib::AnimFile::FindChunk(EAnimChunk ChunkId) const
+{
+	for (auto& chunk : chunks)
+		if (chunk.Id == (uint32_t)ChunkId)
+			return &chunk;
+
+	return nullptr;
+}
+
+uint8_t const* M2Lib::AnimFile::GetChunkData(Chunk const& Chunk) const
+{
+	if (Chunk.Copied)
+		return Chunk.Data.data();
+
+	return mapping->GetData() + Chunk.Offset;
+}
+
+void M2Lib::AnimFile::CopyChunk(Chunk& Chunk)
+{
+	if (Chunk.Copied)
+		return;
+
+	auto Source = mapping->GetData() + Chunk.Offset;
+	Chunk.Data = std::vector<uint8_t>(Source, Source + Chunk.Size);
+	Chunk.Copied = true;
+}
+
+uint8_t const* M2Lib::AnimFile::GetData(EAnimChunk ChunkId, uint32_t Offset, uint32_t Size) const
+{
+	auto chunk = FindChunk(ChunkId);
+	if (!chunk || Offset > chunk->Size || Size > chunk->Size - Offset)
+		return nullptr;
+
+	return GetChunkData(*chunk) + Offset;
+}
+
+uint8_t* M2Lib::AnimFile::GetMutableData(EAnimChunk ChunkId, uint32_t Offset, uint32_t Size)
+{
+	auto chunk = const_cast<Chunk*>(FindChunk(ChunkId));
+	if (!chunk || Offset > chunk->Size || Size > chunk->Size - Offset)
+		return nullptr;
+
+	CopyChunk(*chunk);
+	modified = true;
+
+	return chunk->Data.data() + Offset;
+}
+
+void M2Lib::AnimFile::Detach()
+{
+	if (mapping)
+		mapping->CopyToMemory();
+}
+
+uint64_t M2Lib::AnimFile::GetMemoryUsage() const
+{
+	uint64_t Size = sizeof(*this) + chunks.capacity() * sizeof(Chunk);
+	for (auto& chunk : chunks)
+		Size += chunk.Data.GetMemoryUsage();
+	if (mapping)
+		Size += mapping->GetMemoryUsage() / mapping.use_count();
+
+	return Size;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "BaseTypes.h"
+#include "M2Types.h"
+#include "SharedBuffer.h"
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace M2Lib
+{
+	class MappedFile;
+	class SaveBatch;
+
+	// external animation file with keys of sequences that are not stored in model or skeleton file.
+	// offsets in sub arrays of tracks for such sequences are relative to start of chunk data, or to start of file for files without chunks.
+	// file is memory mapped, chunks are read from mapping until they are modified and copied to memory.
+	class AnimFile
+	{
+	public:
+		enum class EAnimChunk : uint32_t
+		{
+			AFM2 = 'AFM2',	// keys of model tracks
+			AFSA = 'AFSA',	// keys of skeleton attachment tracks
+			AFSB = 'AFSB',	// keys of skeleton bone tracks
+		};
+
+		EError Load(const wchar_t* FileName);
+		// adds file to batch. mapped chunks are referenced, so file must not be modified until batch is committed.
+		EError Save(const wchar_t* FileName, SaveBatch& Batch);
+
+		// creates copy of file, mapping and chunk data are shared until modified.
+		AnimFile* Clone() const;
+
+		// returns Size bytes at Offset of chunk data, or nullptr if file has no such chunk or range is out of its bounds.
+		// does not modify file and can be called from several threads at once.
+		uint8_t const* GetData(EAnimChunk ChunkId, uint32_t Offset, uint32_t Size) const;
+		// same as GetData, but chunk is copied from mapping and file is marked modified
+		uint8_t* GetMutableData(EAnimChunk ChunkId, uint32_t Offset, uint32_t Size);
+
+		bool IsChunked() const { return chunked; }
+		bool IsModified() const { return modified; }
+		std::wstring const& GetFileName() const { return fileName; }
+
+		// copies file to memory and releases mapping. mapping is shared with clones, so they are detached too.
+		void Detach();
+
+		// heap memory held by modified and detached chunks, mapped pages are not counted
+		uint64_t GetMemoryUsage() const;
+
+	private:
+		struct Chunk
+		{
+			uint32_t Id;
+			uint32_t Offset;		// offset of data in mapping
+			uint32_t Size;
+			bool Copied = false;
+			SharedBuffer Data;		// contents of chunk after it was copied
+		};
+
+		std::wstring fileName;
+		std::shared_ptr<MappedFile> mapping;
+		std::vector<Chunk> chunks;
+		bool chunked = false;		// files before legion contain only model keys without chunk header
+		bool modified = false;
+
+		Chunk const* FindChunk(EAnimChunk ChunkId) const;
+		uint8_t const* GetChunkData(Chunk const& Chunk) const;
+		void CopyChunk(Chunk& Chunk);
+	};
+}
@@ -0,0 +1,481 @@
+#include "AnimationSampler.h"
+#include "DataElement.h"
+#include "AnimFile.h"
+#include "M2.h"
+#include "Skeleton.h"
+#include "SkeletonChunk.h"
+#include "ThreadPool.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+# include <xmmintrin.h>
+# define M2LIB_ANIMATION_SSE 1
+#else
+# define M2LIB_ANIMATION_SSE 0
+#endif
+
+using namespace M2Lib::M2Element;
+using namespace M2Lib::SkeletonChunk;
+using M2Lib::Geometry::Matrix;
+using M2Lib::Geometry::Quaternion;
+
+namespace
+{
+	bool IsSpline(EInterpolationType Interpolation)
+	{
+		return Interpolation == EInterpolationType_Bezier || Interpolation == EInterpolationType_Hermite;
+	}
+
+	// spline keys are value followed by in and out tangents
+	template <class T>
+	T ReadKey(uint8_t const* Values, uint32_t Index, uint32_t Part, bool Spline)
+	{
+		T Result;
+		memcpy(&Result, Values + ((Spline ? Index * 3 : Index) + Part) * sizeof(T), sizeof(T));
+		return Result;
+	}
+}
+
+M2Lib::AnimationSampler::AnimationSampler(M2& Model)
+{
+	auto AnimationElement = Model.GetAnimationsForRead();
+	if (AnimationElement)
+	{
+		auto Source = AnimationElement->as<CElement_Animation>();
+		for (uint32_t i = 0; i < AnimationElement->Count; ++i)
+			animations.push_back({ Source[i].Length, Source[i].IsInplace(), NULL });
+
+		// external files are mapped here, sampling only reads them
+		for (uint32_t i = 0; i < animations.size(); ++i)
+			if (!animations[i].Inplace)
+				animations[i].File = Model.GetAnimFile(i);
+	}
+
+	// bones of model, or of its skeleton if model has none
+	DataElement const* BoneElement = &Model.Elements[EElement_Bone];
+	DataElement const* KeyElements = Model.Elements;
+	uint32_t KeyElementCount = EElement__CountM2__;
+	DataElement const* GlobalSequenceElement = &Model.Elements[EElement_GlobalSequence];
+
+	if (auto Skeleton = Model.GetSkeleton())
+	{
+		if (auto SequenceChunk = (SKS1Chunk*)Skeleton->GetChunk(ESkeletonChunk::SKS1))
+		{
+			if (SequenceChunk->Elements[SKS1Chunk::EElement_GlobalSequence].Count)
+				GlobalSequenceElement = &SequenceChunk->Elements[SKS1Chunk::EElement_GlobalSequence];
+		}
+
+		auto BoneChunk = (SKB1Chunk*)Skeleton->GetChunk(ESkeletonChunk::SKB1);
+		if (BoneChunk && !BoneElement->Count)
+		{
+			BoneElement = &BoneChunk->Elements[SKB1Chunk::EElement_Bone];
+			KeyElements = BoneChunk->Elements;
+			KeyElementCount = SKB1Chunk::EElement_Count;
+			animChunk = AnimFile::EAnimChunk::AFSB;
+		}
+	}
+
+	auto GlobalSequences = GlobalSequenceElement->as<CElement_GlobalSequence>();
+	for (uint32_t i = 0; i < GlobalSequenceElement->Count; ++i)
+		globalSequences.push_back(GlobalSequences[i].Value);
+
+	auto SourceBones = BoneElement->as<CElement_Bone>();
+	bones.resize(BoneElement->Count);
+	for (uint32_t i = 0; i < bones.size(); ++i)
+	{
+		auto& Bone = bones[i];
+		Bone.ParentBone = SourceBones[i].ParentBone;
+		Bone.Pivot = SourceBones[i].Position;
+		ResolveTrack(SourceBones[i].AnimationBlock_Position, Bone.Position, KeyElements, KeyElementCount, sizeof(M2Track::SKey_Float32x3));
+		ResolveTrack(SourceBones[i].AnimationBlock_Rotation, Bone.Rotation, KeyElements, KeyElementCount, sizeof(M2Track::SKey_SInt16x4));
+		ResolveTrack(SourceBones[i].AnimationBlock_Scale, Bone.Scale, KeyElements, KeyElementCount, sizeof(M2Track::SKey_Float32x3));
+	}
+	SortBones();
+
+	uint32_t SplineRotations = 0;
+	for (auto& Bone : bones)
+	{
+		if (IsSpline(Bone.Rotation.Interpolation) && !Bone.Rotation.Sequences.empty())
+			++SplineRotations;
+	}
+	if (SplineRotations)
+		sLogger.LogWarning(L"Warning: %u bone rotation tracks use spline interpolation, their tangents are ignored and keys are interpolated spherically", SplineRotations);
+
+	// weights are normalized, vertices without weights or with invalid bones are bound to identity matrix after bones
+	auto& VertexElement = static_cast<DataElement const&>(Model.Elements[EElement_Vertex]);
+	auto Vertices = VertexElement.as<CVertex>();
+	uint32_t VertexCount = VertexElement.Count;
+	uint32_t PaddedCount = (VertexCount + 3) & ~3;
+	uint16_t StaticBone = (uint16_t)bones.size();
+
+	vertices.X.resize(PaddedCount);
+	vertices.Y.resize(PaddedCount);
+	vertices.Z.resize(PaddedCount);
+	for (uint32_t j = 0; j < BONES_PER_VERTEX; ++j)
+	{
+		vertices.Bones[j].resize(PaddedCount, StaticBone);
+		vertices.Weights[j].resize(PaddedCount, 0.0f);
+	}
+
+	for (uint32_t i = 0; i < PaddedCount; ++i)
+	{
+		if (!VertexCount)
+			break;
+
+		auto& Vertex = Vertices[std::min(i, VertexCount - 1)];
+		vertices.X[i] = Vertex.Position.X;
+		vertices.Y[i] = Vertex.Position.Y;
+		vertices.Z[i] = Vertex.Position.Z;
+
+		uint32_t WeightSum = 0;
+		for (uint32_t j = 0; j < BONES_PER_VERTEX; ++j)
+		{
+			if (Vertex.BoneIndices[j] < bones.size())
+				WeightSum += Vertex.BoneWeights[j];
+		}
+
+		if (!WeightSum)
+		{
+			vertices.Weights[0][i] = 1.0f;
+			continue;
+		}
+
+		for (uint32_t j = 0; j < BONES_PER_VERTEX; ++j)
+		{
+			if (Vertex.BoneIndices[j] >= bones.size() || !Vertex.BoneWeights[j])
+				continue;
+
+			vertices.Bones[j][i] = Vertex.BoneIndices[j];
+			vertices.Weights[j][i] = Vertex.BoneWeights[j] / (float)WeightSum;
+		}
+	}
+}
+
+void M2Lib::AnimationSampler::ResolveTrack(M2Track const& Source, Track& Result, DataElement const* Elements, uint32_t ElementCount, uint32_t KeySize)
+{
+	Result.Interpolation = Source.InterpolationType;
+	Result.GlobalSequenceID = Source.GlobalSequenceID;
+
+	if (!Source.TimeStamps.Count || Source.TimeStamps.Count != Source.Values.Count)
+		return;
+
+	auto SubTimes = (M2Array const*)DataElement::FindLocalPointer(Elements, ElementCount, Source.TimeStamps.Offset, Source.TimeStamps.Count * sizeof(M2Array));
+	auto SubValues = (M2Array const*)DataElement::FindLocalPointer(Elements, ElementCount, Source.Values.Offset, Source.Values.Count * sizeof(M2Array));
+	if (!SubTimes || !SubValues)
+		return;
+
+	uint32_t Stride = IsSpline(Source.InterpolationType) ? KeySize * 3 : KeySize;
+
+	// keys of sequences stored in .anim files are read from mapped file, spans of sequences without loaded file stay empty
+	Result.Sequences.resize(Source.TimeStamps.Count);
+	for (uint32_t i = 0; i < Result.Sequences.size(); ++i)
+	{
+		auto& Times = SubTimes[i];
+		auto& Values = SubValues[i];
+		if (Times.Count <= 0 || Times.Count != Values.Count)
+			continue;
+
+		auto& Span = Result.Sequences[i];
+		if (Source.GlobalSequenceID == -1 && i < animations.size() && !animations[i].Inplace)
+		{
+			auto File = animations[i].File;
+			if (!File)
+				continue;
+
+			Span.Times = (uint32_t const*)File->GetData(animChunk, Times.Offset, Times.Count * sizeof(uint32_t));
+			Span.Values = File->GetData(animChunk, Values.Offset, Values.Count * Stride);
+		}
+		else
+		{
+			Span.Times = (uint32_t const*)DataElement::FindLocalPointer(Elements, ElementCount, Times.Offset, Times.Count * sizeof(uint32_t));
+			Span.Values = DataElement::FindLocalPointer(Elements, ElementCount, Values.Offset, Values.Count * Stride);
+		}
+		Span.Count = Span.Times && Span.Values ? Times.Count : 0;
+	}
+}
+
+void M2Lib::AnimationSampler::SortBones()
+{
+	// bones normally follow their parents, order is still verified. bones with invalid parents or in cycles become roots.
+	enum { Unvisited, Visiting, Done };
+	std::vector<uint8_t> State(bones.size(), Unvisited);
+	std::vector<uint32_t> Stack;
+
+	boneOrder.clear();
+	for (uint32_t i = 0; i < bones.size(); ++i)
+	{
+		for (uint32_t Current = i; State[Current] == Unvisited;)
+		{
+			State[Current] = Visiting;
+			Stack.push_back(Current);
+
+			auto Parent = bones[Current].ParentBone;
+			if (Parent < 0 || (uint32_t)Parent >= bones.size())
+				break;
+			if (State[Parent] == Visiting)
+			{
+				bones[Current].ParentBone = -1;
+				break;
+			}
+			Current = Parent;
+		}
+
+		for (; !Stack.empty(); Stack.pop_back())
+		{
+			State[Stack.back()] = Done;
+			boneOrder.push_back(Stack.back());
+		}
+	}
+
+	for (auto& Bone : bones)
+	{
+		if (Bone.ParentBone >= (int32_t)bones.size())
+			Bone.ParentBone = -1;
+	}
+}
+
+bool M2Lib::AnimationSampler::IsSampleable(uint32_t AnimationIndex) const
+{
+	return AnimationIndex < animations.size() && (animations[AnimationIndex].Inplace || animations[AnimationIndex].File);
+}
+
+bool M2Lib::AnimationSampler::FindKeys(Track const& Track, uint32_t AnimationIndex, uint32_t Time, KeyPosition& Position) const
+{
+	uint32_t SequenceIndex = AnimationIndex;
+	if (Track.GlobalSequenceID >= 0)
+	{
+		SequenceIndex = 0;
+		if ((uint32_t)Track.GlobalSequenceID < globalSequences.size() && globalSequences[Track.GlobalSequenceID])
+			Time %= globalSequences[Track.GlobalSequenceID];
+	}
+
+	if (SequenceIndex >= Track.Sequences.size() || !Track.Sequences[SequenceIndex].Count)
+		return false;
+
+	auto& Span = Track.Sequences[SequenceIndex];
+	Position.Span = &Span;
+	Position.Factor = 0.0f;
+
+	if (Time <= Span.Times[0])
+		Position.Index = Position.Next = 0;
+	else if (Time >= Span.Times[Span.Count - 1])
+		Position.Index = Position.Next = Span.Count - 1;
+	else
+	{
+		Position.Next = std::upper_bound(Span.Times, Span.Times + Span.Count, Time) - Span.Times;
+		Position.Index = Position.Next - 1;
+
+		// step interpolation holds value of previous key
+		if (Track.Interpolation != EInterpolationType_None)
+			Position.Factor = (float)(Time - Span.Times[Position.Index]) / (float)(Span.Times[Position.Next] - Span.Times[Position.Index]);
+	}
+
+	return true;
+}
+
+M2Lib::C3Vector M2Lib::AnimationSampler::EvaluateVector(Track const& Track, uint32_t AnimationIndex, uint32_t Time, C3Vector const& Default) const
+{
+	KeyPosition Position;
+	if (!FindKeys(Track, AnimationIndex, Time, Position))
+		return Default;
+
+	bool Spline = IsSpline(Track.Interpolation);
+	auto Values = Position.Span->Values;
+	auto A = ReadKey<C3Vector>(Values, Position.Index, 0, Spline);
+	if (Position.Factor <= 0.0f)
+		return A;
+
+	auto B = ReadKey<C3Vector>(Values, Position.Next, 0, Spline);
+	float t = Position.Factor;
+
+	switch (Track.Interpolation)
+	{
+		case EInterpolationType_Hermite:
+		{
+			// tangents are out tangent of first key and in tangent of second
+			float t2 = t * t;
+			float t3 = t2 * t;
+			auto OutTangent = ReadKey<C3Vector>(Values, Position.Index, 2, Spline);
+			auto InTangent = ReadKey<C3Vector>(Values, Position.Next, 1, Spline);
+
+			return A * (2.0f * t3 - 3.0f * t2 + 1.0f) + B * (-2.0f * t3 + 3.0f * t2) + OutTangent * (t3 - 2.0f * t2 + t) + InTangent * (t3 - t2);
+		}
+		case EInterpolationType_Bezier:
+		{
+			// control points are out tangent of first key and in tangent of second
+			float s = 1.0f - t;
+			auto OutTangent = ReadKey<C3Vector>(Values, Position.Index, 2, Spline);
+			auto InTangent = ReadKey<C3Vector>(Values, Position.Next, 1, Spline);
+
+			return A * (s * s * s) + OutTangent * (3.0f * s * s * t) + InTangent * (3.0f * s * t * t) + B * (t * t * t);
+		}
+		default:
+			return A + (B - A) * t;
+	}
+}
+
+M2Lib::Geometry::Quaternion M2Lib::AnimationSampler::EvaluateRotation(Track const& Track, uint32_t AnimationIndex, uint32_t Time) const
+{
+	KeyPosition Position;
+	if (!FindKeys(Track, AnimationIndex, Time, Position))
+		return Quaternion();
+
+	// rotation tangents of spline tracks are ignored, keys are interpolated spherically
+	bool Spline = IsSpline(Track.Interpolation);
+	auto A = ReadKey<M2Track::SKey_SInt16x4>(Position.Span->Values, Position.Index, 0, Spline);
+	if (Position.Factor <= 0.0f)
+		return Quaternion::FromPacked(A.Values);
+
+	auto B = ReadKey<M2Track::SKey_SInt16x4>(Position.Span->Values, Position.Next, 0, Spline);
+	return Quaternion::Slerp(Quaternion::FromPacked(A.Values), Quaternion::FromPacked(B.Values), Position.Factor);
+}
+
+void M2Lib::AnimationSampler::GetBoneMatrices(uint32_t AnimationIndex, uint32_t Time, std::vector<Matrix>& Matrices) const
+{
+	Matrices.resize(bones.size() + 1);
+
+	for (auto i : boneOrder)
+	{
+		auto& Bone = bones[i];
+
+		auto Translation = EvaluateVector(Bone.Position, AnimationIndex, Time, C3Vector(0.0f, 0.0f, 0.0f));
+		auto Rotation = EvaluateRotation(Bone.Rotation, AnimationIndex, Time);
+		auto Scale = EvaluateVector(Bone.Scale, AnimationIndex, Time, C3Vector(1.0f, 1.0f, 1.0f));
+
+		// animation is applied around bone pivot
+		auto Local = Matrix::Translation(Bone.Pivot) * Matrix::Transform(Translation, Rotation, Scale) * Matrix::Translation(Bone.Pivot * -1.0f);
+		Matrices[i] = Bone.ParentBone >= 0 ? Matrices[Bone.ParentBone] * Local : Local;
+	}
+
+	Matrices.back() = Matrix::Identity();
+}
+
+void M2Lib::AnimationSampler::SkinBlock(uint32_t First, Matrix const* Matrices, float* X, float* Y, float* Z) const
+{
+#if M2LIB_ANIMATION_SSE
+	// 4 vertices are processed at once, matrix elements of their bones are gathered into lanes
+	__m128 PositionX = _mm_loadu_ps(&vertices.X[First]);
+	__m128 PositionY = _mm_loadu_ps(&vertices.Y[First]);
+	__m128 PositionZ = _mm_loadu_ps(&vertices.Z[First]);
+	__m128 Result[3] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+
+	for (uint32_t j = 0; j < BONES_PER_VERTEX; ++j)
+	{
+		__m128 Weight = _mm_loadu_ps(&vertices.Weights[j][First]);
+		if (_mm_movemask_ps(_mm_cmpneq_ps(Weight, _mm_setzero_ps())) == 0)
+			continue;
+
+		auto Bones = &vertices.Bones[j][First];
+		auto& Bone0 = Matrices[Bones[0]].M;
+		auto& Bone1 = Matrices[Bones[1]].M;
+		auto& Bone2 = Matrices[Bones[2]].M;
+		auto& Bone3 = Matrices[Bones[3]].M;
+
+		for (uint32_t Row = 0; Row < 3; ++Row)
+		{
+			__m128 Value = _mm_set_ps(Bone3[Row][3], Bone2[Row][3], Bone1[Row][3], Bone0[Row][3]);
+			Value = _mm_add_ps(Value, _mm_mul_ps(_mm_set_ps(Bone3[Row][0], Bone2[Row][0], Bone1[Row][0], Bone0[Row][0]), PositionX));
+			Value = _mm_add_ps(Value, _mm_mul_ps(_mm_set_ps(Bone3[Row][1], Bone2[Row][1], Bone1[Row][1], Bone0[Row][1]), PositionY));
+			Value = _mm_add_ps(Value, _mm_mul_ps(_mm_set_ps(Bone3[Row][2], Bone2[Row][2], Bone1[Row][2], Bone0[Row][2]), PositionZ));
+			Result[Row] = _mm_add_ps(Result[Row], _mm_mul_ps(Value, Weight));
+		}
+	}
+
+	_mm_storeu_ps(X, Result[0]);
+	_mm_storeu_ps(Y, Result[1]);
+	_mm_storeu_ps(Z, Result[2]);
+#else
+	for (uint32_t Lane = 0; Lane < 4; ++Lane)
+	{
+		uint32_t i = First + Lane;
+		X[Lane] = Y[Lane] = Z[Lane] = 0.0f;
+
+		for (uint32_t j = 0; j < BONES_PER_VERTEX; ++j)
+		{
+			float Weight = vertices.Weights[j][i];
+			if (Weight == 0.0f)
+				continue;
+
+			auto& M = Matrices[vertices.Bones[j][i]].M;
+			X[Lane] += Weight * (M[0][0] * vertices.X[i] + M[0][1] * vertices.Y[i] + M[0][2] * vertices.Z[i] + M[0][3]);
+			Y[Lane] += Weight * (M[1][0] * vertices.X[i] + M[1][1] * vertices.Y[i] + M[1][2] * vertices.Z[i] + M[1][3]);
+			Z[Lane] += Weight * (M[2][0] * vertices.X[i] + M[2][1] * vertices.Y[i] + M[2][2] * vertices.Z[i] + M[2][3]);
+		}
+	}
+#endif
+}
+
+void M2Lib::AnimationSampler::CalculateBoundingVolumes(uint32_t SampleInterval, std::vector<SVolume>& Volumes, std::vector<bool>& Valid) const
+{
+	Volumes.assign(animations.size(), SVolume());
+	Valid.assign(animations.size(), false);
+	if (vertices.X.empty())
+		return;
+
+	SampleInterval = std::max<uint32_t>(SampleInterval, 1);
+	std::vector<uint8_t> Sampled(animations.size(), 0);
+
+	ThreadPool::GetInstance()->ParallelFor(animations.size(), [&](uint32_t AnimationIndex)
+	{
+		if (!IsSampleable(AnimationIndex))
+			return;
+
+		uint32_t Length = animations[AnimationIndex].Length;
+		std::vector<Matrix> Matrices;
+
+		// visits skinned vertices of every sample, last sample is taken at end of sequence
+		auto ForEachSample = [&](auto&& Visit)
+		{
+			for (uint64_t Time = 0;; Time += SampleInterval)
+			{
+				GetBoneMatrices(AnimationIndex, (uint32_t)std::min<uint64_t>(Time, Length), Matrices);
+
+				float X[4], Y[4], Z[4];
+				for (uint32_t First = 0; First < vertices.X.size(); First += 4)
+				{
+					SkinBlock(First, Matrices.data(), X, Y, Z);
+					for (uint32_t Lane = 0; Lane < 4; ++Lane)
+						Visit(X[Lane], Y[Lane], Z[Lane]);
+				}
+
+				if (Time >= Length)
+					break;
+			}
+		};
+
+		auto& Volume = Volumes[AnimationIndex];
+		Volume.Min = C3Vector(FLT_MAX, FLT_MAX, FLT_MAX);
+		Volume.Max = C3Vector(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		ForEachSample([&Volume](float X, float Y, float Z)
+		{
+			Volume.Min.X = std::min(Volume.Min.X, X);
+			Volume.Min.Y = std::min(Volume.Min.Y, Y);
+			Volume.Min.Z = std::min(Volume.Min.Z, Z);
+			Volume.Max.X = std::max(Volume.Max.X, X);
+			Volume.Max.Y = std::max(Volume.Max.Y, Y);
+			Volume.Max.Z = std::max(Volume.Max.Z, Z);
+		});
+
+		// radius around box center, same as model bounds
+		auto Center = (Volume.Min + Volume.Max) / 2.0f;
+		float RadiusSquared = 0.0f;
+		ForEachSample([&Center, &RadiusSquared](float X, float Y, float Z)
+		{
+			float DeltaX = X - Center.X;
+			float DeltaY = Y - Center.Y;
+			float DeltaZ = Z - Center.Z;
+			RadiusSquared = std::max(RadiusSquared, DeltaX * DeltaX + DeltaY * DeltaY + DeltaZ * DeltaZ);
+		});
+		Volume.Radius = std::sqrt(RadiusSquared);
+
+		// nan or infinite keys make volume unusable
+		Sampled[AnimationIndex] = std::isfinite(Volume.Min.X + Volume.Min.Y + Volume.Min.Z + Volume.Max.X + Volume.Max.Y + Volume.Max.Z + Volume.Radius);
+	});
+
+	for (uint32_t i = 0; i < Sampled.size(); ++i)
+		Valid[i] = Sampled[i] != 0;
+}
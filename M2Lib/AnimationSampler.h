@@ -0,0 +1,103 @@
+#pragma once
+
+#include "BaseTypes.h"
+#include "M2Types.h"
+#include "M2Element.h"
+#include "VectorMath.h"
+#include "AnimFile.h"
+#include <vector>
+
+namespace M2Lib
+{
+	class M2;
+	class DataElement;
+
+	// evaluates bone animation of model and skins its vertices.
+	// key arrays are resolved on construction, sampling only reads them and can run on several threads at once.
+	// model must not be modified while sampler is used.
+	class AnimationSampler
+	{
+	public:
+		AnimationSampler(M2& Model);
+
+		uint32_t GetBoneCount() const { return bones.size(); }
+		uint32_t GetAnimationCount() const { return animations.size(); }
+		// true if keys of sequence are stored in model or skeleton file or its .anim file was loaded
+		bool IsSampleable(uint32_t AnimationIndex) const;
+
+		// evaluates model space transforms of all bones at Time milliseconds of sequence, parents are evaluated before children.
+		// tracks of global sequences are evaluated at Time modulo global sequence length.
+		// one more identity matrix is appended for vertices without bone weights.
+		void GetBoneMatrices(uint32_t AnimationIndex, uint32_t Time, std::vector<Geometry::Matrix>& Matrices) const;
+
+		// samples every sequence each SampleInterval milliseconds and at its end on thread pool.
+		// volume is box around skinned vertices and radius around its center. Valid is false for sequences that were not sampled.
+		void CalculateBoundingVolumes(uint32_t SampleInterval, std::vector<SVolume>& Volumes, std::vector<bool>& Valid) const;
+
+	private:
+		struct KeySpan
+		{
+			uint32_t const* Times = nullptr;
+			uint8_t const* Values = nullptr;
+			uint32_t Count = 0;
+		};
+
+		struct Track
+		{
+			M2Element::EInterpolationType Interpolation = M2Element::EInterpolationType_None;
+			int16_t GlobalSequenceID = -1;
+			std::vector<KeySpan> Sequences;		// indexed by animation, single span for global sequence
+		};
+
+		struct Bone
+		{
+			int16_t ParentBone;
+			C3Vector Pivot;
+			Track Position;
+			Track Rotation;
+			Track Scale;
+		};
+
+		struct Animation
+		{
+			uint32_t Length;
+			bool Inplace;
+			AnimFile const* File;	// external keys of sequence that is not in-place
+		};
+
+		// key position of track at time
+		struct KeyPosition
+		{
+			KeySpan const* Span;
+			uint32_t Index;
+			uint32_t Next;
+			float Factor;
+		};
+
+		std::vector<Bone> bones;
+		std::vector<uint32_t> boneOrder;	// parents before children
+		std::vector<Animation> animations;
+		std::vector<uint32_t> globalSequences;
+		AnimFile::EAnimChunk animChunk = AnimFile::EAnimChunk::AFM2;	// chunk of external files with keys of bones
+
+		// vertex positions and influences as structure of arrays, padded to multiple of 4 with copies of last vertex
+		struct
+		{
+			std::vector<float> X;
+			std::vector<float> Y;
+			std::vector<float> Z;
+			std::vector<uint16_t> Bones[BONES_PER_VERTEX];
+			std::vector<float> Weights[BONES_PER_VERTEX];
+		} vertices;
+
+		void ResolveTrack(M2Element::M2Track const& Source, Track& Result, DataElement const* Elements, uint32_t ElementCount, uint32_t KeySize);
+		void SortBones();
+
+		bool FindKeys(Track const& Track, uint32_t AnimationIndex, uint32_t Time, KeyPosition& Position) const;
+		C3Vector EvaluateVector(Track const& Track, uint32_t AnimationIndex, uint32_t Time, C3Vector const& Default) const;
+		Geometry::Quaternion EvaluateRotation(Track const& Track, uint32_t AnimationIndex, uint32_t Time) const;
+
+		// skins 4 vertices starting at First
+		void SkinBlock(uint32_t First, Geometry::Matrix const* Matrices, float* X, float* Y, float* Z) const;
+	};
+}
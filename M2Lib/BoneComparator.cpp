@@ -30,7 +30,7 @@ M2Lib::BoneComparator::DiffResult M2Lib::BoneComparator::Diff(M2 const* oldM2, M
 
 	std::set<uint16_t> matchedIndices;
 
-	auto maxZSearcher = [](CElement_SubMesh* submeshes, uint32_t submeshCount, uint16_t* Indices, CVertex* vertices) -> float
+	auto maxZSearcher = [](CElement_SubMesh* submeshes, uint32_t submeshCount, uint16_t* Indices, CVertex const* vertices) -> float
 	{
 		float maxZ = 0.0f;
 		for (uint32_t i = 0; i < submeshCount; ++i)
@@ -280,6 +280,10 @@ M2LIB_HANDLE M2Lib::BoneComparator::Wrapper_Create(M2LIB_HANDLE oldM2, M2LIB_HAN
 {
 	try
 	{
+		// comparator reads skin 0 of both models, make sure it is loaded if models are lazy
+		static_cast<M2*>(oldM2)->GetSkin(0);
+		static_cast<M2*>(newM2)->GetSkin(0);
+
 		return new ComparatorWrapper(static_cast<M2 const*>(oldM2), static_cast<M2 const*>(newM2), weightThreshold, compareTextures, predictScale, sourceScale);
 	}
 	catch (std::exception & e)
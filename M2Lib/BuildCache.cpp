@@ -0,0 +1,308 @@
+#include "BuildCache.h"
+#include "ContentHash.h"
+#include "GatherWriter.h"
+#include "Logger.h"
+#include "StringHelpers.h"
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+
+namespace
+{
+	wchar_t const* ManifestFileName = L"entry.bin";
+
+	void WriteString(std::fstream& FileStream, std::wstring const& String)
+	{
+		uint32_t Length = String.length();
+		FileStream.write((char const*)&Length, sizeof(Length));
+		FileStream.write((char const*)String.data(), Length * sizeof(wchar_t));
+	}
+
+	bool ReadString(std::fstream& FileStream, std::wstring& String)
+	{
+		uint32_t Length = 0;
+		FileStream.read((char*)&Length, sizeof(Length));
+		if (FileStream.fail() || Length > 32 * 1024)
+			return false;
+
+		String.resize(Length);
+		FileStream.read((char*)&String[0], Length * sizeof(wchar_t));
+
+		return !FileStream.fail();
+	}
+
+	bool IsSamePath(std::wstring const& A, std::wstring const& B)
+	{
+		std::error_code ec;
+		return std::filesystem::weakly_canonical(A, ec) == std::filesystem::weakly_canonical(B, ec);
+	}
+}
+
+void M2Lib::BuildCache::SetDirectory(std::wstring const& Directory, uint64_t MaxSize)
+{
+	this->Directory = Directory;
+	this->MaxSize = MaxSize;
+
+	if (Directory.empty())
+		return;
+
+	std::error_code ec;
+	std::filesystem::create_directories(Directory, ec);
+	if (ec)
+	{
+		sLogger.LogError(L"Failed to create build cache directory '%s', cache disabled", Directory.c_str());
+		this->Directory.clear();
+	}
+}
+
+std::wstring M2Lib::BuildCache::GetEntryDirectory(uint64_t Key) const
+{
+	return (std::filesystem::path(Directory) / ContentHash::ToString(Key)).wstring();
+}
+
+bool M2Lib::BuildCache::Contains(uint64_t Key)
+{
+	if (!IsEnabled())
+		return false;
+
+	if (std::filesystem::exists(std::filesystem::path(GetEntryDirectory(Key)) / ManifestFileName))
+		return true;
+
+	++Stats.Misses;
+	return false;
+}
+
+bool M2Lib::BuildCache::Restore(uint64_t Key, std::wstring const& M2FileName)
+{
+	if (!IsEnabled())
+		return false;
+
+	auto EntryDirectory = std::filesystem::path(GetEntryDirectory(Key));
+	auto ManifestPath = EntryDirectory / ManifestFileName;
+
+	std::fstream FileStream;
+	FileStream.open(ManifestPath, std::ios::in | std::ios::binary);
+	if (FileStream.fail())
+	{
+		++Stats.Misses;
+		return false;
+	}
+
+	std::wstring StoredM2FileName;
+	uint32_t FileCount = 0;
+	if (!ReadString(FileStream, StoredM2FileName) || !FileStream.read((char*)&FileCount, sizeof(FileCount)))
+	{
+		++Stats.Misses;
+		return false;
+	}
+
+	if (!IsSamePath(StoredM2FileName, M2FileName))
+	{
+		sLogger.LogInfo(L"Build cache entry %s was produced for '%s', not used", ContentHash::ToString(Key).c_str(), StoredM2FileName.c_str());
+		++Stats.Misses;
+		return false;
+	}
+
+	// all cached files are read before any output is touched, then they are saved as model would save them:
+	// through temporary files and skipping outputs that already have same contents
+	SaveBatch Batch;
+	uint64_t BytesRestored = 0;
+	for (uint32_t i = 0; i < FileCount; ++i)
+	{
+		std::wstring FileName;
+		if (!ReadString(FileStream, FileName))
+		{
+			++Stats.Misses;
+			return false;
+		}
+
+		std::fstream CachedStream;
+		CachedStream.open(EntryDirectory / (std::to_wstring(i) + L".dat"), std::ios::in | std::ios::binary);
+		if (CachedStream.fail())
+		{
+			sLogger.LogError(L"Failed to read cached copy of '%s'", FileName.c_str());
+			++Stats.Misses;
+			return false;
+		}
+		std::vector<uint8_t> Data((std::istreambuf_iterator<char>(CachedStream)), std::istreambuf_iterator<char>());
+
+		std::error_code ec;
+		std::filesystem::create_directories(std::filesystem::path(FileName).parent_path(), ec);
+
+		BytesRestored += Data.size();
+		Batch.Add(FileName, EError_FailedToSaveM2).AppendBuffer(std::move(Data));
+	}
+
+	FileStream.close();
+
+	if (Batch.Commit() != EError_OK)
+	{
+		sLogger.LogError(L"Failed to restore build cache entry %s", ContentHash::ToString(Key).c_str());
+		++Stats.Misses;
+		return false;
+	}
+
+	// manifest time is used as last access time for eviction
+	std::error_code ec;
+	std::filesystem::last_write_time(ManifestPath, std::filesystem::file_time_type::clock::now(), ec);
+
+	++Stats.Hits;
+	Stats.BytesRestored += BytesRestored;
+
+	return true;
+}
+
+void M2Lib::BuildCache::Store(uint64_t Key, std::wstring const& M2FileName, std::vector<std::wstring> const& FileNames)
+{
+	if (!IsEnabled())
+		return;
+
+	auto EntryDirectory = std::filesystem::path(GetEntryDirectory(Key));
+
+	std::error_code ec;
+	std::filesystem::remove_all(EntryDirectory, ec);
+	std::filesystem::create_directories(EntryDirectory, ec);
+	if (ec)
+	{
+		sLogger.LogError(L"Failed to create build cache entry '%s'", EntryDirectory.wstring().c_str());
+		return;
+	}
+
+	uint64_t BytesStored = 0;
+	for (uint32_t i = 0; i < FileNames.size(); ++i)
+	{
+		std::filesystem::copy_file(FileNames[i], EntryDirectory / (std::to_wstring(i) + L".dat"), ec);
+		if (ec)
+		{
+			sLogger.LogError(L"Failed to store '%s' in build cache", FileNames[i].c_str());
+			std::filesystem::remove_all(EntryDirectory, ec);
+			return;
+		}
+
+		auto Size = std::filesystem::file_size(FileNames[i], ec);
+		if (!ec)
+			BytesStored += Size;
+	}
+
+	// manifest is written last, entry without it is incomplete and is never used
+	std::fstream FileStream;
+	FileStream.open(EntryDirectory / ManifestFileName, std::ios::out | std::ios::trunc | std::ios::binary);
+	if (FileStream.fail())
+	{
+		std::filesystem::remove_all(EntryDirectory, ec);
+		return;
+	}
+
+	WriteString(FileStream, M2FileName);
+	uint32_t FileCount = FileNames.size();
+	FileStream.write((char const*)&FileCount, sizeof(FileCount));
+	for (auto& FileName : FileNames)
+		WriteString(FileStream, FileName);
+	FileStream.close();
+
+	sLogger.LogInfo(L"Stored %u files, %llu bytes in build cache entry %s", FileCount, (unsigned long long)BytesStored, ContentHash::ToString(Key).c_str());
+
+	++Stats.Stores;
+	Stats.BytesStored += BytesStored;
+
+	Evict();
+}
+
+void M2Lib::BuildCache::Evict()
+{
+	if (!MaxSize)
+		return;
+
+	struct Entry
+	{
+		std::filesystem::path Path;
+		std::filesystem::file_time_type LastAccess;
+		uint64_t Size;
+	};
+
+	std::vector<Entry> Entries;
+	uint64_t TotalSize = 0;
+
+	std::error_code ec;
+	for (auto& itr : std::filesystem::directory_iterator(Directory, ec))
+	{
+		if (!itr.is_directory())
+			continue;
+
+		Entry entry;
+		entry.Path = itr.path();
+		entry.LastAccess = std::filesystem::last_write_time(itr.path() / ManifestFileName, ec);
+		if (ec)
+			entry.LastAccess = std::filesystem::file_time_type::min();
+		entry.Size = 0;
+		// files may be removed by another process while directory is scanned
+		for (auto& file : std::filesystem::directory_iterator(itr.path(), ec))
+		{
+			std::error_code FileError;
+			auto Size = file.is_regular_file(FileError) ? file.file_size(FileError) : 0;
+			if (!FileError)
+				entry.Size += Size;
+		}
+
+		TotalSize += entry.Size;
+		Entries.push_back(entry);
+	}
+
+	std::sort(Entries.begin(), Entries.end(), [](Entry const& a, Entry const& b) { return a.LastAccess < b.LastAccess; });
+
+	// newest entry is never evicted, even if it alone exceeds limit
+	for (uint32_t i = 0; i + 1 < Entries.size() && TotalSize > MaxSize; ++i)
+	{
+		sLogger.LogInfo(L"Evicting build cache entry %s, %llu bytes", Entries[i].Path.filename().wstring().c_str(), (unsigned long long)Entries[i].Size);
+		std::filesystem::remove_all(Entries[i].Path, ec);
+		TotalSize -= Entries[i].Size;
+		++Stats.Evictions;
+	}
+}
+
+void M2Lib::BuildCache::Clear()
+{
+	if (!IsEnabled())
+		return;
+
+	std::error_code ec;
+	for (auto& itr : std::filesystem::directory_iterator(Directory, ec))
+		if (itr.is_directory())
+			std::filesystem::remove_all(itr.path(), ec);
+}
+
+void M2Lib::BuildCache::PrintStatistics()
+{
+	sLogger.LogInfo(L"Build cache: %u hits, %u misses, %u bypassed, %u stores, %u evictions", Stats.Hits, Stats.Misses, Stats.Bypassed, Stats.Stores, Stats.Evictions);
+	sLogger.LogInfo(L"Build cache: %llu bytes restored, %llu bytes stored", (unsigned long long)Stats.BytesRestored, (unsigned long long)Stats.BytesStored);
+}
+
+void M2Lib::BuildCache_SetDirectory(const wchar_t* Directory, uint64_t MaxSize)
+{
+	try
+	{
+		BuildCache::GetInstance()->SetDirectory(Directory ? Directory : L"", MaxSize);
+	}
+	catch (std::exception& e)
+	{
+		sLogger.LogError(L"Exception: %s", StringHelpers::StringToWString(e.what()).c_str());
+	}
+}
+
+void M2Lib::BuildCache_Clear()
+{
+	try
+	{
+		BuildCache::GetInstance()->Clear();
+	}
+	catch (std::exception& e)
+	{
+		sLogger.LogError(L"Exception: %s", StringHelpers::StringToWString(e.what()).c_str());
+	}
+}
+
+void M2Lib::BuildCache_PrintStatistics()
+{
+	BuildCache::GetInstance()->PrintStatistics();
+}
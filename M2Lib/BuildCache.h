@@ -0,0 +1,71 @@
+#pragma once
+
+#include "BaseTypes.h"
+#include <string>
+#include <vector>
+
+namespace M2Lib
+{
+	// bump when import or save changes produced files, so that entries from older builds are not used
+	uint32_t const BuildCacheLibraryVersion = 1;
+
+	// local cache of M2I import results keyed by hash of all pipeline inputs.
+	// each entry is a directory with copies of produced model, skin and skeleton files.
+	// entries are evicted in least recently used order when total size exceeds limit.
+	class BuildCache
+	{
+	public:
+		struct Statistics
+		{
+			uint32_t Hits = 0;
+			uint32_t Misses = 0;
+			uint32_t Bypassed = 0;		// cached entry existed, but save options did not allow to use it
+			uint32_t Stores = 0;
+			uint32_t Evictions = 0;
+			uint64_t BytesRestored = 0;
+			uint64_t BytesStored = 0;
+		};
+
+	private:
+		BuildCache() = default;
+
+		std::wstring Directory;
+		uint64_t MaxSize = 0;
+
+		Statistics Stats;
+
+		std::wstring GetEntryDirectory(uint64_t Key) const;
+		void Evict();
+
+	public:
+		static BuildCache* GetInstance()
+		{
+			static BuildCache instance;
+
+			return &instance;
+		}
+
+		// enables cache in given directory, empty directory disables it. MaxSize of 0 means no limit.
+		void SetDirectory(std::wstring const& Directory, uint64_t MaxSize);
+		bool IsEnabled() const { return !Directory.empty(); }
+
+		// checks if there is an entry for key, counts miss if there is not
+		bool Contains(uint64_t Key);
+		// writes cached files back to locations they were produced at, through temporary files like model save does.
+		// fails if entry was stored for another output model file.
+		bool Restore(uint64_t Key, std::wstring const& M2FileName);
+		// stores produced files, M2FileName is output model file
+		void Store(uint64_t Key, std::wstring const& M2FileName, std::vector<std::wstring> const& FileNames);
+		void CountBypass() { ++Stats.Bypassed; }
+
+		// removes all entries
+		void Clear();
+
+		Statistics const& GetStatistics() const { return Stats; }
+		void PrintStatistics();
+	};
+
+	M2LIB_API void __cdecl BuildCache_SetDirectory(const wchar_t* Directory, uint64_t MaxSize);
+	M2LIB_API void __cdecl BuildCache_Clear();
+	M2LIB_API void __cdecl BuildCache_PrintStatistics();
+}
@@ -1,16 +1,19 @@
 #include "ChunkBase.h"
 #include <fstream>
 #include "StringHelpers.h"
+#include "MemoryStream.h"
+#include "GatherWriter.h"
 
-void M2Lib::RawChunk::Load(std::fstream& FileStream, uint32_t Size)
+void M2Lib::RawChunk::Load(std::istream& FileStream, uint32_t Size)
 {
 	RawData.resize(Size);
 	FileStream.read((char*)RawData.data(), Size);
 }
 
-void M2Lib::RawChunk::Save(std::fstream& FileStream)
+void M2Lib::RawChunk::Save(std::ostream& FileStream)
 {
-	FileStream.write((char*)RawData.data(), RawData.size());
+	auto const& Data = RawData;
+	FileStream.write((char const*)Data.data(), Data.size());
 }
 
 std::wstring M2Lib::ChunkIdToStr(uint32_t ChunkId, bool Reverse)
@@ -21,3 +24,182 @@ std::wstring M2Lib::ChunkIdToStr(uint32_t ChunkId, bool Reverse)
 
 	return StringHelpers::StringToWString(s);
 }
+
+M2Lib::ChunkBase* M2Lib::ChunkTable::Create(uint32_t Id) const
+{
+	for (auto& entry : entries)
+		if (entry.Id == Id)
+			return entry.Create();
+
+	return new RawChunk();
+}
+
+M2Lib::ChunkList::ChunkList(ChunkList const& Other)
+	: table(Other.table)
+{
+	*this = Other;
+}
+
+M2Lib::ChunkList& M2Lib::ChunkList::operator=(ChunkList const& Other)
+{
+	if (this == &Other)
+		return *this;
+
+	Clear();
+	table = Other.table;
+	items = Other.items;
+	for (auto& itr : items)
+		if (itr.second.Parsed)
+			itr.second.Parsed = itr.second.Parsed->Clone();
+
+	return *this;
+}
+
+M2Lib::ChunkList::~ChunkList()
+{
+	Clear();
+}
+
+void M2Lib::ChunkList::AddView(uint32_t Id, std::shared_ptr<void const> Source, uint8_t const* Data, uint32_t Size)
+{
+	Remove(Id);
+
+	auto& item = items[Id];
+	item.Source = std::move(Source);
+	item.Data = Data;
+	item.Size = Size;
+}
+
+void M2Lib::ChunkList::Set(uint32_t Id, ChunkBase* Chunk)
+{
+	Remove(Id);
+
+	if (Chunk)
+		items[Id].Parsed = Chunk;
+}
+
+M2Lib::ChunkBase* M2Lib::ChunkList::Release(uint32_t Id)
+{
+	auto Chunk = Get(Id);
+	items.erase(Id);
+
+	return Chunk;
+}
+
+void M2Lib::ChunkList::Remove(uint32_t Id)
+{
+	auto itr = items.find(Id);
+	if (itr == items.end())
+		return;
+
+	delete itr->second.Parsed;
+	items.erase(itr);
+}
+
+void M2Lib::ChunkList::Clear()
+{
+	for (auto& itr : items)
+		delete itr.second.Parsed;
+	items.clear();
+}
+
+bool M2Lib::ChunkList::IsParsed(uint32_t Id) const
+{
+	auto itr = items.find(Id);
+	return itr != items.end() && itr->second.Parsed;
+}
+
+M2Lib::ChunkBase const* M2Lib::ChunkList::GetParsed(uint32_t Id) const
+{
+	auto itr = items.find(Id);
+	return itr != items.end() ? itr->second.Parsed : NULL;
+}
+
+std::vector<uint32_t> M2Lib::ChunkList::GetIds() const
+{
+	std::vector<uint32_t> Ids;
+	Ids.reserve(items.size());
+	for (auto& itr : items)
+		Ids.push_back(itr.first);
+
+	return Ids;
+}
+
+M2Lib::ChunkBase* M2Lib::ChunkList::Parse(uint32_t Id, ChunkBase* Target)
+{
+	auto itr = items.find(Id);
+	if (itr == items.end() || itr->second.Parsed)
+	{
+		delete Target;
+		return itr != items.end() ? itr->second.Parsed : NULL;
+	}
+
+	auto& item = itr->second;
+	if (!Target)
+		Target = table->Create(Id);
+
+	try
+	{
+		MemoryStream Stream(item.Data, item.Size);
+		Target->Load(Stream, item.Size);
+	}
+	catch (...)
+	{
+		// chunk stays unparsed, so failed parse does not lose its data
+		delete Target;
+		throw;
+	}
+
+	item.Parsed = Target;
+	item.Source.reset();
+	item.Data = nullptr;
+	item.Size = 0;
+
+	return Target;
+}
+
+void M2Lib::ChunkList::ParseAll()
+{
+	for (auto& itr : items)
+		if (!itr.second.Parsed)
+			Get(itr.first);
+}
+
+bool M2Lib::ChunkList::GetView(uint32_t Id, uint8_t const*& Data, uint32_t& Size) const
+{
+	auto itr = items.find(Id);
+	if (itr == items.end() || itr->second.Parsed)
+		return false;
+
+	Data = itr->second.Data;
+	Size = itr->second.Size;
+	return true;
+}
+
+void M2Lib::ChunkList::Write(uint32_t Id, GatherWriter& Writer) const
+{
+	auto itr = items.find(Id);
+	if (itr == items.end())
+		return;
+
+	auto& item = itr->second;
+	if (item.Parsed)
+	{
+		Writer.AppendChunk(REVERSE_CC(Id), item.Parsed);
+		return;
+	}
+
+	Writer.AppendValue(REVERSE_CC(Id));
+	Writer.AppendValue(item.Size);
+	if (item.Size)
+		Writer.Append(item.Data, item.Size);
+}
+
+uint64_t M2Lib::ChunkList::GetMemoryUsage(uint32_t Id) const
+{
+	auto itr = items.find(Id);
+	if (itr == items.end())
+		return 0;
+
+	return itr->second.Parsed ? itr->second.Parsed->GetMemoryUsage() : itr->second.Size;
+}
@@ -2,9 +2,16 @@
 
 #include "BaseTypes.h"
 #include "M2Types.h"
+#include "SharedBuffer.h"
+#include <initializer_list>
+#include <memory>
+#include <vector>
+#include <map>
 
 namespace M2Lib
 {
+	class GatherWriter;
+
 	std::wstring ChunkIdToStr(uint32_t ChunkId, bool Reverse);
 
 	class ChunkBase
@@ -12,16 +19,99 @@ namespace M2Lib
 	public:
 		virtual ~ChunkBase() {}
 
-		virtual void Load(std::fstream& FileStream, uint32_t Size) = 0;
-		virtual void Save(std::fstream& FileStream) = 0;
+		virtual void Load(std::istream& FileStream, uint32_t Size) = 0;
+		virtual void Save(std::ostream& FileStream) = 0;
+		// creates deep copy of chunk
+		virtual ChunkBase* Clone() const = 0;
+		// heap memory held by chunk data
+		virtual uint64_t GetMemoryUsage() const { return 0; }
 	};
 
 	class RawChunk : public ChunkBase
 	{
 	public:
-		void Load(std::fstream& FileStream, uint32_t Size) override;
-		void Save(std::fstream& FileStream) override;
+		void Load(std::istream& FileStream, uint32_t Size) override;
+		void Save(std::ostream& FileStream) override;
+		ChunkBase* Clone() const override { return new RawChunk(*this); }
+		uint64_t GetMemoryUsage() const override { return RawData.GetMemoryUsage(); }
+
+		SharedBuffer RawData;
+	};
+
+	// maps chunk ids to chunk classes, so file formats declare their chunks in one table instead of switch in loader.
+	class ChunkTable
+	{
+	public:
+		typedef ChunkBase* (*Factory)();
+
+		struct Entry
+		{
+			uint32_t Id;
+			Factory Create;
+		};
+
+		ChunkTable(std::initializer_list<Entry> Entries) : entries(Entries) {}
+
+		template <class T, class TId>
+		static Entry Register(TId Id) { return { (uint32_t)Id, []() -> ChunkBase* { return new T(); } }; }
+
+		// creates empty chunk of class registered for id, chunks with unknown ids are kept as raw data
+		ChunkBase* Create(uint32_t Id) const;
+
+	private:
+		std::vector<Entry> entries;
+	};
+
+	// chunks of file ordered by id. chunk stays unparsed view of file bytes until it is accessed for the first time,
+	// then it is parsed with class from table. chunks that were never accessed are saved as original bytes without decode and encode.
+	class ChunkList
+	{
+		struct Item
+		{
+			std::shared_ptr<void const> Source;		// owner of viewed bytes
+			uint8_t const* Data = nullptr;
+			uint32_t Size = 0;
+			ChunkBase* Parsed = nullptr;
+		};
+
+		ChunkTable const* table;
+		std::map<uint32_t, Item> items;
+
+	public:
+		explicit ChunkList(ChunkTable const& Table) : table(&Table) {}
+		// parsed chunks are cloned, views share source bytes
+		ChunkList(ChunkList const& Other);
+		ChunkList& operator=(ChunkList const& Other);
+		~ChunkList();
+
+		// adds unparsed chunk. Source must own Data, it is released when chunk is parsed or removed.
+		void AddView(uint32_t Id, std::shared_ptr<void const> Source, uint8_t const* Data, uint32_t Size);
+		// adds parsed chunk and takes ownership of it, chunk with same id is deleted
+		void Set(uint32_t Id, ChunkBase* Chunk);
+		// removes chunk from list without deleting it. returns NULL if there is no such chunk.
+		ChunkBase* Release(uint32_t Id);
+		void Remove(uint32_t Id);
+		void Clear();
+
+		bool Contains(uint32_t Id) const { return items.count(Id) != 0; }
+		bool IsParsed(uint32_t Id) const;
+		// returns parsed chunk without parsing it. returns NULL if there is no such chunk or it was not accessed yet.
+		ChunkBase const* GetParsed(uint32_t Id) const;
+		std::vector<uint32_t> GetIds() const;
+
+		// returns chunk, parsing it on first access. returns NULL if there is no such chunk.
+		ChunkBase* Get(uint32_t Id) { return Parse(Id, NULL); }
+		// parses chunk into Target, for chunks that can't be created by table. Target is deleted if chunk is already parsed or missing.
+		ChunkBase* Parse(uint32_t Id, ChunkBase* Target);
+		// parses all chunks that were not accessed yet
+		void ParseAll();
+		// returns bytes of unparsed chunk
+		bool GetView(uint32_t Id, uint8_t const*& Data, uint32_t& Size) const;
+
+		// appends chunk with header, unparsed chunk references its original bytes
+		void Write(uint32_t Id, GatherWriter& Writer) const;
 
-		std::vector<uint8_t> RawData;
+		// heap memory held by chunk, unparsed chunk reports size of its view
+		uint64_t GetMemoryUsage(uint32_t Id) const;
 	};
-}
\ No newline at end of file
+}
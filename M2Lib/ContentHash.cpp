@@ -0,0 +1,96 @@
+#include "ContentHash.h"
+#include "lookup.h"
+#include <fstream>
+#include <cstring>
+#include <cwchar>
+#include <algorithm>
+
+namespace
+{
+	size_t const BlockSize = 64 * 1024;
+}
+
+M2Lib::ContentHash::ContentHash()
+{
+	Block.reserve(BlockSize);
+}
+
+void M2Lib::ContentHash::HashBlock(uint8_t const* Data, size_t Size)
+{
+	hashlittle2(Data, Size, &HashHigh, &HashLow);
+}
+
+void M2Lib::ContentHash::Add(void const* Data, size_t Size)
+{
+	auto Bytes = (uint8_t const*)Data;
+	Length += Size;
+
+	// complete pending block first
+	if (!Block.empty())
+	{
+		size_t Count = std::min(Size, BlockSize - Block.size());
+		Block.insert(Block.end(), Bytes, Bytes + Count);
+		Bytes += Count;
+		Size -= Count;
+
+		if (Block.size() < BlockSize)
+			return;
+
+		HashBlock(Block.data(), Block.size());
+		Block.clear();
+	}
+
+	// full blocks are hashed in place
+	while (Size >= BlockSize)
+	{
+		HashBlock(Bytes, BlockSize);
+		Bytes += BlockSize;
+		Size -= BlockSize;
+	}
+
+	Block.insert(Block.end(), Bytes, Bytes + Size);
+}
+
+void M2Lib::ContentHash::AddString(std::wstring const& String)
+{
+	uint32_t Size = String.size();
+	AddValue(Size);
+	Add(String.data(), String.size() * sizeof(wchar_t));
+}
+
+bool M2Lib::ContentHash::AddFile(std::wstring const& FileName)
+{
+	std::fstream FileStream;
+	FileStream.open(FileName, std::ios::in | std::ios::binary);
+	if (FileStream.fail())
+		return false;
+
+	std::vector<uint8_t> Buffer(BlockSize);
+	while (FileStream)
+	{
+		FileStream.read((char*)Buffer.data(), Buffer.size());
+		Add(Buffer.data(), (size_t)FileStream.gcount());
+	}
+
+	return FileStream.eof();
+}
+
+uint64_t M2Lib::ContentHash::GetValue() const
+{
+	uint32_t High = HashHigh;
+	uint32_t Low = HashLow;
+
+	// tail and total length are mixed in without changing state, more data can be added after this call
+	hashlittle2(Block.data(), Block.size(), &High, &Low);
+	hashlittle2(&Length, sizeof(Length), &High, &Low);
+
+	return (uint64_t)High << 32 | Low;
+}
+
+std::wstring M2Lib::ContentHash::ToString(uint64_t Hash)
+{
+	wchar_t Buffer[17];
+	swprintf(Buffer, 17, L"%016llX", (unsigned long long)Hash);
+
+	return Buffer;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "BaseTypes.h"
+#include <string>
+#include <vector>
+
+namespace M2Lib
+{
+	// fast 64 bit content hash built on lookup3.
+	// data is hashed in fixed size blocks, so result does not depend on how input is split between Add() calls.
+	class ContentHash
+	{
+		uint32_t HashHigh = 0;
+		uint32_t HashLow = 0;
+		uint64_t Length = 0;
+		std::vector<uint8_t> Block;
+
+		void HashBlock(uint8_t const* Data, size_t Size);
+
+	public:
+		ContentHash();
+
+		void Add(void const* Data, size_t Size);
+		void AddString(std::wstring const& String);
+		template <class T>
+		void AddValue(T const& Value) { Add(&Value, sizeof(T)); }
+		// hashes whole file contents, returns false if file can not be read
+		bool AddFile(std::wstring const& FileName);
+
+		uint64_t GetLength() const { return Length; }
+		uint64_t GetValue() const;
+
+		static std::wstring ToString(uint64_t Hash);
+	};
+}
@@ -11,6 +11,7 @@ void M2Lib::DataBinary::_SwitchEndianness(char* Data, uint32_t Size)
 
 void M2Lib::DataBinary::_Read(char* Data, uint32_t Size)
 {
+	m2lib_assert(_Stream && "Reading is not supported for buffer binaries");
 	_Stream->read(Data, Size);
 	if (_Endianness != _EndiannessNative)
 		_SwitchEndianness(Data, Size);
@@ -20,8 +21,11 @@ void M2Lib::DataBinary::_Write(char* Data, uint32_t Size)
 {
 	if (_Endianness != _EndiannessNative)
 		_SwitchEndianness(Data, Size);
-	
-	_Stream->write(Data, Size);
+
+	if (_Buffer)
+		_Buffer->insert(_Buffer->end(), Data, Data + Size);
+	else
+		_Stream->write(Data, Size);
 }
 
 M2Lib::DataBinary::DataBinary(std::fstream* Stream, EEndianness Endianness)
@@ -31,6 +35,18 @@ M2Lib::DataBinary::DataBinary(std::fstream* Stream, EEndianness Endianness)
 
 	m2lib_assert(Stream);
 	_Stream = Stream;
+	_Buffer = NULL;
+	_Endianness = Endianness;
+}
+
+M2Lib::DataBinary::DataBinary(std::vector<uint8_t>* Buffer, EEndianness Endianness)
+{
+	uint8_t EndianTest[2] = { 1, 0 };
+	_EndiannessNative = ((*(int16_t*)EndianTest == 1) ? EEndianness_Little : EEndianness_Big);
+
+	m2lib_assert(Buffer);
+	_Stream = NULL;
+	_Buffer = Buffer;
 	_Endianness = Endianness;
 }
 
@@ -49,6 +65,14 @@ void M2Lib::DataBinary::SetStream(std::fstream* Stream)
 {
 	m2lib_assert(Stream);
 	_Stream = Stream;
+	_Buffer = NULL;
+}
+
+void M2Lib::DataBinary::SetBuffer(std::vector<uint8_t>* Buffer)
+{
+	m2lib_assert(Buffer);
+	_Stream = NULL;
+	_Buffer = Buffer;
 }
 
 M2Lib::EEndianness M2Lib::DataBinary::GetEndianness() const
@@ -2,6 +2,7 @@
 
 #include "M2Types.h"
 #include <fstream>
+#include <vector>
 
 namespace M2Lib
 {
@@ -16,6 +17,7 @@ namespace M2Lib
 	{
 	private:
 		std::fstream* _Stream;
+		std::vector<uint8_t>* _Buffer;
 		EEndianness _Endianness;
 		EEndianness _EndiannessNative;
 
@@ -25,12 +27,15 @@ namespace M2Lib
 
 	public:
 		DataBinary(std::fstream* Stream, EEndianness Endianness);
+		// write-only binary that appends to memory buffer instead of stream
+		DataBinary(std::vector<uint8_t>* Buffer, EEndianness Endianness);
 		~DataBinary() = default;
 
 		void SwitchEndiannessIfNeeded(char* Data, uint32_t Size) const;
 
 		std::fstream* GetStream() const;
 		void SetStream(std::fstream* Stream);
+		void SetBuffer(std::vector<uint8_t>* Buffer);
 
 		EEndianness GetEndianness() const;
 		void SetEndianness(EEndianness Endianness);
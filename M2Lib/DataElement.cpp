@@ -18,13 +18,46 @@ void* M2Lib::DataElement::GetLocalPointer(uint32_t GlobalOffset)
 	return &Data[GlobalOffset];
 }
 
-bool M2Lib::DataElement::Load(std::fstream& FileStream, int32_t FileOffset)
+void const* M2Lib::DataElement::GetLocalPointer(uint32_t GlobalOffset) const
+{
+	m2lib_assert(GlobalOffset >= Offset);
+	GlobalOffset -= Offset;
+	m2lib_assert(GlobalOffset < (uint32_t)Data.size());
+	return Data.data() + GlobalOffset;
+}
+
+uint8_t* M2Lib::DataElement::FindLocalPointer(DataElement* Elements, uint32_t ElementCount, uint32_t GlobalOffset, uint32_t Size)
+{
+	for (uint32_t i = 0; i < ElementCount; ++i)
+	{
+		auto& Element = Elements[i];
+		if (!Element.Data.empty() && GlobalOffset >= Element.Offset && (uint64_t)(GlobalOffset - Element.Offset) + Size <= Element.Data.size())
+			return (uint8_t*)Element.GetLocalPointer(GlobalOffset);
+	}
+
+	return NULL;
+}
+
+uint8_t const* M2Lib::DataElement::FindLocalPointer(DataElement const* Elements, uint32_t ElementCount, uint32_t GlobalOffset, uint32_t Size)
+{
+	for (uint32_t i = 0; i < ElementCount; ++i)
+	{
+		auto& Element = Elements[i];
+		if (!Element.Data.empty() && GlobalOffset >= Element.Offset && (uint64_t)(GlobalOffset - Element.Offset) + Size <= Element.Data.size())
+			return Element.Data.data() + (GlobalOffset - Element.Offset);
+	}
+
+	return NULL;
+}
+
+bool M2Lib::DataElement::Load(std::istream& FileStream, int32_t FileOffset)
 {
 	if (Data.empty())
 		return true;
 
 	FileStream.seekg(Offset + FileOffset, std::ios::beg);
 	FileStream.read((char*)Data.data(), Data.size());
+	Data.MarkReplaced();
 
 	return true;
 }
@@ -35,16 +68,18 @@ bool M2Lib::DataElement::Load(uint8_t const* RawData, int32_t FileOffset)
 		return true;
 
 	memcpy(Data.data(), RawData + Offset + FileOffset, Data.size());
+	Data.MarkReplaced();
 	return true;
 }
 
-bool M2Lib::DataElement::Save(std::fstream& FileStream, int32_t FileOffset)
+bool M2Lib::DataElement::Save(std::ostream& FileStream, int32_t FileOffset)
 {
 	if (Data.empty())
 		return true;
 
+	auto const& ConstData = Data;
 	FileStream.seekp(Offset + FileOffset);
-	FileStream.write((char*)Data.data(), Data.size());
+	FileStream.write((char const*)ConstData.data(), ConstData.size());
 
 	return true;
 }
@@ -63,16 +98,17 @@ void M2Lib::DataElement::SetDataSize(uint32_t NewCount, uint32_t NewDataSize, bo
 			NewDataSize += Align - Mod;
 	}
 
+	auto const& OldData = Data;
 	std::vector<uint8_t> NewData(NewDataSize, 0);
-	if (CopyOldData && !Data.empty())
-		memcpy(NewData.data(), Data.data(), Data.size() > NewDataSize ? NewDataSize : Data.size());
+	if (CopyOldData && !OldData.empty())
+		memcpy(NewData.data(), OldData.data(), OldData.size() > NewDataSize ? NewDataSize : OldData.size());
 
-	Data = NewData;
+	Data = std::move(NewData);
 	Count = NewCount;
 }
 
 void M2Lib::DataElement::Clone(DataElement* Source, DataElement* Destination)
 {
-	Destination->SetDataSize(Source->Count, Source->Data.size(), false);
-	memcpy(Destination->Data.data(), Source->Data.data(), Source->Data.size());
+	Destination->Data = Source->Data;
+	Destination->Count = Source->Count;
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "BaseTypes.h"
+#include "SharedBuffer.h"
 #include <fstream>
 #include <vector>
 #include <assert.h>
@@ -16,7 +17,7 @@ namespace M2Lib
 		uint32_t OffsetOriginal;		// offset of this element as loaded from the original file.
 		uint32_t SizeOriginal;		// size of this element as loaded from the original file.
 
-		std::vector<uint8_t> Data;	// our local copy of data. note that DataSize might be greater than sizeof( DataType ) * Count if there is animation data references or padding at the end.
+		SharedBuffer Data;			// our local copy of data, shared with clones until modified. note that DataSize might be greater than sizeof( DataType ) * Count if there is animation data references or padding at the end.
 		int32_t Align;				// byte alignment boundary. M2s pad the ends of elements with zeros data so they align on 16 byte boundaries.
 
 	public:
@@ -26,22 +27,35 @@ namespace M2Lib
 		// given a global offset, returns a pointer to the data contained in this Element.
 		// asserts if GlobalOffset lies outside of this element.
 		void* GetLocalPointer(uint32_t GlobalOffset);
+		void const* GetLocalPointer(uint32_t GlobalOffset) const;
+		// returns pointer to Size bytes at GlobalOffset if they lie within one of Elements, NULL otherwise.
+		static uint8_t* FindLocalPointer(DataElement* Elements, uint32_t ElementCount, uint32_t GlobalOffset, uint32_t Size);
+		// same without detaching shared data, so it can be called from several threads at once.
+		static uint8_t const* FindLocalPointer(DataElement const* Elements, uint32_t ElementCount, uint32_t GlobalOffset, uint32_t Size);
 
 		// loads this element's data from a file stream. assumes that Offset and DataSize have already been set.
-		bool Load(std::fstream& FileStream, int32_t FileOffset);
+		bool Load(std::istream& FileStream, int32_t FileOffset);
 		// loads this element's data from memory. assumes that Offset and DataSize have already been set.
 		bool Load(uint8_t const* RawData, int32_t FileOffset);
 		// saves this element's data to a file stream. assumes that Offset and DataSize have already been set.
-		bool Save(std::fstream& FileStream, int32_t FileOffset);
+		bool Save(std::ostream& FileStream, int32_t FileOffset);
 
 		// reallocates Data, either erasing existing data or preserving it.
 		// adds padding to NewDataSize if necessary so that new size aligns with Align.
 		void SetDataSize(uint32_t NewCount, uint32_t NewDataSize, bool CopyOldData);
 		// clears element
 		void Clear();
+		// heap memory held by element data
+		size_t GetMemoryUsage() const { return Data.GetMemoryUsage(); }
+		// changes on every resize, reassignment or load of Data, see SharedBuffer::GetGeneration()
+		uint64_t GetGeneration() const { return Data.GetGeneration(); }
 
+		// non-const accessors detach data shared with clones, use const ones to read.
+		// pointers they return are valid until next non-const access or resize of this element.
 		template <class T>
-		T* as() const { return (T*)Data.data(); }
+		T* as() { return (T*)Data.data(); }
+		template <class T>
+		T const* as() const { return (T const*)Data.data(); }
 
 		template <class T>
 		std::vector<T> asVector() const
@@ -56,14 +70,32 @@ namespace M2Lib
 		}
 
 		template <class T>
-		T* at(uint32_t Index) const
+		T* at(uint32_t Index)
 		{
 			m2lib_assert(__FUNCTION__ " Index too large" && Index < Count);
 
 			return &as<T>()[Index];
 		}
 
-		// clones this element from Source to Destination.
+		template <class T>
+		T const* at(uint32_t Index) const
+		{
+			m2lib_assert(__FUNCTION__ " Index too large" && Index < Count);
+
+			return &as<T>()[Index];
+		}
+
+		// clones this element from Source to Destination. data is shared until one of elements is modified.
 		static void Clone(DataElement* Source, DataElement* Destination);
 	};
+
+	// heap memory held by array of elements
+	inline uint64_t GetElementsMemoryUsage(DataElement const* Elements, uint32_t Count)
+	{
+		uint64_t Size = 0;
+		for (uint32_t i = 0; i < Count; ++i)
+			Size += Elements[i].GetMemoryUsage();
+
+		return Size;
+	}
 }
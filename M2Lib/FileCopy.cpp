@@ -0,0 +1,218 @@
+#include "FileCopy.h"
+#include "ThreadPool.h"
+#include "Logger.h"
+#include <filesystem>
+#include <chrono>
+
+#ifdef __linux__
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/ioctl.h>
+# include <sys/stat.h>
+# include <linux/fs.h>
+#endif
+
+namespace
+{
+	bool IsUpToDate(std::filesystem::path const& Source, std::filesystem::path const& Destination, uint64_t Size)
+	{
+		std::error_code ec;
+		if (!std::filesystem::exists(Destination, ec) || std::filesystem::file_size(Destination, ec) != Size || ec)
+			return false;
+
+		auto DestinationTime = std::filesystem::last_write_time(Destination, ec);
+		if (ec)
+			return false;
+
+		return DestinationTime >= std::filesystem::last_write_time(Source, ec) && !ec;
+	}
+
+#ifdef __linux__
+	std::error_code LastError()
+	{
+		return std::error_code(errno, std::generic_category());
+	}
+
+	M2Lib::FileCopy::EResult CopyFileContents(std::filesystem::path const& Source, std::filesystem::path const& Destination, std::error_code& ec)
+	{
+		using EResult = M2Lib::FileCopy::EResult;
+
+		int In = open(Source.c_str(), O_RDONLY | O_CLOEXEC);
+		if (In < 0)
+		{
+			ec = LastError();
+			return EResult::Failed;
+		}
+
+		struct stat Stat;
+		if (fstat(In, &Stat) != 0)
+		{
+			ec = LastError();
+			close(In);
+			return EResult::Failed;
+		}
+
+		int Out = open(Destination.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, Stat.st_mode & 0777);
+		if (Out < 0)
+		{
+			ec = LastError();
+			close(In);
+			return EResult::Failed;
+		}
+
+		auto Result = EResult::Failed;
+#ifdef FICLONE
+		if (ioctl(Out, FICLONE, In) == 0)
+			Result = EResult::Cloned;
+#endif
+
+		if (Result == EResult::Failed)
+		{
+			// copy_file_range moves both file offsets, buffered copy continues where it stopped
+			off_t Remaining = Stat.st_size;
+			while (Remaining > 0)
+			{
+				auto Count = copy_file_range(In, nullptr, Out, nullptr, Remaining, 0);
+				if (Count <= 0)
+					break;
+				Remaining -= Count;
+			}
+
+			std::vector<char> Buffer(Remaining > 0 ? 1024 * 1024 : 0);
+			while (Remaining > 0)
+			{
+				auto Count = read(In, Buffer.data(), Buffer.size());
+				if (Count < 0 && errno == EINTR)
+					continue;
+				if (Count <= 0)
+					break;
+
+				for (ssize_t Written = 0; Written < Count;)
+				{
+					auto Part = write(Out, Buffer.data() + Written, Count - Written);
+					if (Part < 0 && errno == EINTR)
+						continue;
+					if (Part <= 0)
+					{
+						ec = LastError();
+						close(In);
+						close(Out);
+						return EResult::Failed;
+					}
+					Written += Part;
+				}
+				Remaining -= Count;
+			}
+
+			if (Remaining == 0)
+				Result = EResult::Copied;
+			else
+				ec = std::make_error_code(std::errc::io_error);
+		}
+
+		close(In);
+		if (close(Out) != 0 && Result != EResult::Failed)
+		{
+			ec = LastError();
+			Result = EResult::Failed;
+		}
+
+		return Result;
+	}
+#else
+	M2Lib::FileCopy::EResult CopyFileContents(std::filesystem::path const& Source, std::filesystem::path const& Destination, std::error_code& ec)
+	{
+		if (!std::filesystem::copy_file(Source, Destination, std::filesystem::copy_options::overwrite_existing, ec))
+			return M2Lib::FileCopy::EResult::Failed;
+
+		return M2Lib::FileCopy::EResult::Copied;
+	}
+#endif
+}
+
+M2Lib::FileCopy::EResult M2Lib::FileCopy::Copy(std::wstring const& Source, std::wstring const& Destination, bool HardLink, uint64_t& Bytes, std::error_code& ec)
+{
+	Bytes = std::filesystem::file_size(Source, ec);
+	if (ec)
+		return EResult::Failed;
+
+	if (std::filesystem::equivalent(Source, Destination, ec))
+		return EResult::Skipped;
+	ec.clear();
+	if (!HardLink && IsUpToDate(Source, Destination, Bytes))
+		return EResult::Skipped;
+
+	// destination may be hard link left by previous run, writing into it would change source as well
+	std::filesystem::remove(Destination, ec);
+	if (ec)
+		return EResult::Failed;
+
+	if (HardLink)
+	{
+		std::filesystem::create_hard_link(Source, Destination, ec);
+		if (!ec)
+			return EResult::Linked;
+		ec.clear();
+	}
+
+	return CopyFileContents(Source, Destination, ec);
+}
+
+M2Lib::FileCopy::Summary M2Lib::FileCopy::CopyAll(std::vector<Job>& Jobs, bool HardLink)
+{
+	auto Start = std::chrono::high_resolution_clock::now();
+
+	ThreadPool::GetInstance()->ParallelFor(Jobs.size(), [&Jobs, HardLink](uint32_t i)
+	{
+		auto& job = Jobs[i];
+		try
+		{
+			// concurrent creation of same directory is not an error, copy reports if it is really missing
+			std::error_code ec;
+			std::filesystem::create_directories(std::filesystem::path(job.Destination).parent_path(), ec);
+
+			job.Result = Copy(job.Source, job.Destination, HardLink, job.Bytes, job.Error);
+		}
+		catch (std::exception&)
+		{
+			job.Result = EResult::Failed;
+			if (!job.Error)
+				job.Error = std::make_error_code(std::errc::io_error);
+		}
+	});
+
+	Summary summary;
+	for (auto& job : Jobs)
+	{
+		switch (job.Result)
+		{
+			case EResult::Failed: ++summary.Failed; continue;
+			case EResult::Skipped: ++summary.Skipped; continue;
+			case EResult::Copied: ++summary.Copied; break;
+			case EResult::Cloned: ++summary.Cloned; break;
+			case EResult::Linked: ++summary.Linked; break;
+		}
+		summary.Bytes += job.Bytes;
+	}
+	summary.Ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - Start).count();
+
+	return summary;
+}
+
+void M2Lib::FileCopy::Summary::Print() const
+{
+	sLogger.LogInfo(L"Files: %u copied, %u cloned, %u linked, %u skipped, %u failed, %.1f MB in %.1f ms", Copied, Cloned, Linked, Skipped, Failed,
+		Bytes / (1024.0 * 1024.0), Ms);
+}
+
+wchar_t const* M2Lib::FileCopy::GetResultName(EResult Result)
+{
+	switch (Result)
+	{
+		case EResult::Skipped: return L"up to date";
+		case EResult::Copied: return L"copied";
+		case EResult::Cloned: return L"cloned";
+		case EResult::Linked: return L"linked";
+		default: return L"failed";
+	}
+}
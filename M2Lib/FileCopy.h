@@ -0,0 +1,56 @@
+#pragma once
+
+#include "BaseTypes.h"
+#include <string>
+#include <vector>
+#include <system_error>
+
+namespace M2Lib
+{
+	// copies files on thread pool using cheapest method file system supports.
+	// on linux reflink is tried first, then in-kernel copy_file_range, then buffered copy.
+	class FileCopy
+	{
+	public:
+		enum class EResult
+		{
+			Failed,
+			Skipped,	// destination is up to date
+			Copied,
+			Cloned,		// destination shares blocks with source
+			Linked,		// destination is hard link to source
+		};
+
+		struct Job
+		{
+			std::wstring Source;
+			std::wstring Destination;
+
+			EResult Result = EResult::Failed;
+			uint64_t Bytes = 0;
+			std::error_code Error;
+		};
+
+		struct Summary
+		{
+			uint32_t Copied = 0;
+			uint32_t Cloned = 0;
+			uint32_t Linked = 0;
+			uint32_t Skipped = 0;
+			uint32_t Failed = 0;
+			uint64_t Bytes = 0;		// size of copied, cloned and linked files
+			double Ms = 0.0;
+
+			void Print() const;
+		};
+
+		// with HardLink destination is made hard link to source, files are copied if link can't be created
+		static EResult Copy(std::wstring const& Source, std::wstring const& Destination, bool HardLink, uint64_t& Bytes, std::error_code& ec);
+
+		// runs copies on thread pool, no more than pool thread count at once. parent directories of destinations are created.
+		// results are stored in jobs, nothing is logged from workers.
+		static Summary CopyAll(std::vector<Job>& Jobs, bool HardLink);
+
+		static wchar_t const* GetResultName(EResult Result);
+	};
+}
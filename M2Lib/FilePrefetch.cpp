@@ -0,0 +1,69 @@
+#include "FilePrefetch.h"
+#include "ThreadPool.h"
+#include <fstream>
+
+M2Lib::FilePrefetch::~FilePrefetch()
+{
+	// reads that were never taken still reference file names, let them finish
+	for (auto& itr : Pending)
+		itr.second.wait();
+}
+
+M2Lib::FilePrefetch::FileData M2Lib::FilePrefetch::ReadFile(std::wstring const& FileName)
+{
+	std::fstream FileStream;
+	FileStream.open(FileName, std::ios::in | std::ios::binary);
+	if (FileStream.fail())
+		return nullptr;
+
+	FileStream.seekg(0, std::ios::end);
+	auto FileSize = (size_t)FileStream.tellg();
+	FileStream.seekg(0, std::ios::beg);
+
+	auto Result = std::make_shared<std::vector<uint8_t>>(FileSize);
+	FileStream.read((char*)Result->data(), FileSize);
+	if (FileStream.fail())
+		return nullptr;
+
+	return Result;
+}
+
+void M2Lib::FilePrefetch::Request(std::wstring const& FileName)
+{
+	if (FileName.empty() || Pending.count(FileName) || Completed.count(FileName))
+		return;
+
+	// worker can't wait for tasks queued behind it, file will be read by caller on demand
+	if (ThreadPool::IsWorkerThread())
+		return;
+
+	auto itr = Pending.emplace(FileName, std::future<FileData>()).first;
+	auto const& Name = itr->first;
+	itr->second = ThreadPool::GetInstance()->Enqueue([&Name]() { return ReadFile(Name); });
+}
+
+M2Lib::FilePrefetch::FileData M2Lib::FilePrefetch::Get(std::wstring const& FileName)
+{
+	auto completedItr = Completed.find(FileName);
+	if (completedItr != Completed.end())
+		return completedItr->second;
+
+	auto pendingItr = Pending.find(FileName);
+	if (pendingItr == Pending.end())
+		return nullptr;
+
+	FileData Data;
+	try
+	{
+		Data = pendingItr->second.get();
+	}
+	catch (std::exception&)
+	{
+		// fall back to synchronous read by caller which reports error properly
+	}
+	Pending.erase(pendingItr);
+
+	Completed[FileName] = Data;
+
+	return Data;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "BaseTypes.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <future>
+
+namespace M2Lib
+{
+	// reads whole files to memory in background on thread pool.
+	// files are requested up front and taken when parser gets to them.
+	class FilePrefetch
+	{
+	public:
+		typedef std::shared_ptr<std::vector<uint8_t> const> FileData;
+
+	private:
+		std::map<std::wstring, std::future<FileData>> Pending;
+		std::map<std::wstring, FileData> Completed;
+
+		static FileData ReadFile(std::wstring const& FileName);
+
+	public:
+		~FilePrefetch();
+
+		// starts reading file. does nothing if file is already requested.
+		void Request(std::wstring const& FileName);
+		// waits until requested file is read and returns its contents.
+		// returns nullptr if file was not requested or could not be read, caller should fall back to reading file itself.
+		// contents are shared, so parser may keep referencing them after prefetch is destroyed.
+		FileData Get(std::wstring const& FileName);
+
+		uint32_t GetRequestedCount() const { return Pending.size() + Completed.size(); }
+	};
+}
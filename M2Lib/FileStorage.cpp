@@ -2,10 +2,12 @@
 #include "Logger.h"
 #include "StringHelpers.h"
 #include "StringHash.h"
+#include "ContentHash.h"
 #include <fstream>
 #include <algorithm>
 #include <filesystem>
 #include <locale>
+#include <cstring>
 
 const std::wstring M2Lib::FileStorage::DefaultMappingsPath = std::filesystem::current_path() / L"mappings";
 
@@ -15,14 +17,117 @@ M2Lib::FileInfo::FileInfo(uint32_t FileDataId, const wchar_t* Path)
 	this->Path = NormalizePath<wchar_t>(Path);
 }
 
+namespace
+{
+	// utf-16 surrogate pairs are joined, so pool is valid utf-8 whatever size wchar_t has
+	void AppendUtf8(std::string& Destination, std::wstring const& Source)
+	{
+		for (size_t i = 0; i < Source.length(); ++i)
+		{
+			uint32_t c = (uint32_t)Source[i];
+			if (c < 0x80)
+			{
+				Destination += (char)c;
+				continue;
+			}
+
+			if (sizeof(wchar_t) == 2 && c >= 0xD800 && c < 0xDC00 && i + 1 < Source.length() && (uint32_t)Source[i + 1] >= 0xDC00 && (uint32_t)Source[i + 1] < 0xE000)
+				c = 0x10000 + ((c - 0xD800) << 10) + ((uint32_t)Source[++i] - 0xDC00);
+
+			if (c < 0x800)
+				Destination += (char)(0xC0 | (c >> 6));
+			else
+			{
+				if (c < 0x10000)
+					Destination += (char)(0xE0 | (c >> 12));
+				else
+				{
+					Destination += (char)(0xF0 | (c >> 18));
+					Destination += (char)(0x80 | ((c >> 12) & 0x3F));
+				}
+				Destination += (char)(0x80 | ((c >> 6) & 0x3F));
+			}
+			Destination += (char)(0x80 | (c & 0x3F));
+		}
+	}
+
+	std::wstring DecodeUtf8(std::string_view Source)
+	{
+		std::wstring Result;
+		Result.reserve(Source.length());
+
+		for (size_t i = 0; i < Source.length();)
+		{
+			uint32_t c = (uint8_t)Source[i++];
+			uint32_t Extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+			if (Extra)
+				c &= 0x3F >> Extra;
+			for (; Extra && i < Source.length(); --Extra)
+				c = (c << 6) | ((uint8_t)Source[i++] & 0x3F);
+
+			if (sizeof(wchar_t) == 2 && c >= 0x10000)
+			{
+				Result += (wchar_t)(0xD800 + ((c - 0x10000) >> 10));
+				c = 0xDC00 + ((c - 0x10000) & 0x3FF);
+			}
+			Result += (wchar_t)c;
+		}
+
+		return Result;
+	}
+
+	// accepts decimal number that fits 32 bits and nothing else, unlike stoul that throws or stops at first bad character
+	bool ParseFileDataId(wchar_t const* Text, uint32_t& FileDataId)
+	{
+		if (!*Text)
+			return false;
+
+		uint64_t Value = 0;
+		for (; *Text; ++Text)
+		{
+			if (*Text < L'0' || *Text > L'9')
+				return false;
+
+			Value = Value * 10 + (*Text - L'0');
+			if (Value > UINT32_MAX)
+				return false;
+		}
+
+		FileDataId = (uint32_t)Value;
+		return true;
+	}
+
+	template <class T>
+	void ReleaseVector(std::vector<T>& Vector)
+	{
+		std::vector<T>().swap(Vector);
+	}
+}
+
 void M2Lib::FileStorage::ClearStorage()
 {
 	loadFailed = false;
-	for (auto& info : fileInfosByFileDataId)
-		delete info.second;
-	fileInfosByFileDataId.clear();
-	fileInfosByNameHash.clear();
+	ClearEntries();
+
+	for (auto info : fileInfos)
+		delete info;
+	fileInfos.clear();
+}
+
+void M2Lib::FileStorage::ClearEntries()
+{
+	ReleaseVector(entries);
+	ReleaseVector(entriesByNameHash);
+	sortedEntryCount = 0;
+	sortedHashCount = 0;
+	std::string().swap(pathPool);
 	MaxFileDataId = 0;
+	mappingFiles.clear();
+	loaded = false;
+
+	// infos stay alive, pointers to them might be still held by models
+	std::lock_guard<std::mutex> lock(fileInfosLock);
+	fileInfosByFileDataId.clear();
 }
 
 uint32_t M2Lib::FileInfo_GetFileDataId(M2LIB_HANDLE handle)
@@ -35,17 +140,33 @@ wchar_t const* M2Lib::FileInfo_GetPath(M2LIB_HANDLE handle)
 	return static_cast<FileInfo*>(handle)->Path.c_str();
 }
 
-bool M2Lib::FileStorage::ParseCsv(std::wstring const& Path)
+uint32_t M2Lib::FileStorage::AddPath(std::wstring const& Path)
 {
-	std::wifstream in;
-	in.open(Path, std::ios::in);
-	if (in.fail())
-		return false;
+	uint32_t Offset = pathPool.size();
+	AppendUtf8(pathPool, NormalizePath(Path));
+
+	return Offset;
+}
+
+void M2Lib::FileStorage::ParseCsv(char const* Data, size_t Size, PendingEntries& Pending)
+{
+	const auto logDuplicate = [&](wchar_t const* Format, uint32_t FileDataId, wchar_t const* fileName, Entry const* used)
+	{
+		sLogger.LogWarning(Format, FileDataId, fileName, used ? used->FileDataId : 0, used ? DecodeUtf8(GetEntryPath(*used)).c_str() : L"<replaced>");
+	};
 
-	uint32_t dwLocaleFlags = 0;
 	std::wstring line;
-	while (std::getline(in, line))
+	for (size_t Position = 0; Position < Size;)
 	{
+		auto LineEnd = (char const*)memchr(Data + Position, '\n', Size - Position);
+		size_t Length = LineEnd ? LineEnd - (Data + Position) : Size - Position;
+
+		// bytes are widened one by one, as wifstream with default locale did
+		line.resize(Length);
+		for (size_t i = 0; i < Length; ++i)
+			line[i] = (wchar_t)(uint8_t)Data[Position + i];
+		Position += Length + 1;
+
 		StringHelpers::trim(line, { ' ', '\r','\n' });
 
 		if (line.empty())
@@ -59,38 +180,162 @@ bool M2Lib::FileStorage::ParseCsv(std::wstring const& Path)
 		wchar_t const* strId = &line[0];
 		wchar_t const* fileName = &line[colonPos] + 1;
 
-		uint32_t FileDataId = std::stoul(strId);
-
-		auto itr1 = fileInfosByFileDataId.find(FileDataId);
-		if (itr1 != fileInfosByFileDataId.end())
+		uint32_t FileDataId;
+		if (!ParseFileDataId(strId, FileDataId))
 		{
-			sLogger.LogWarning(L"Duplicate file storage entry '%u':'%s' (already used: '%u':'%s'), skipping", FileDataId, fileName, itr1->second->FileDataId, itr1->second->Path.c_str());
+			sLogger.LogWarning(L"Invalid file data id in mapping line '%s;%s', skipping", strId, fileName);
 			continue;
 		}
 
 		auto nameHash = CalcStringHash<wchar_t>(fileName);
-		auto itr2 = fileInfosByNameHash.find(nameHash);
-		if (itr2 != fileInfosByNameHash.end())
+
+		auto used = FindEntry(FileDataId);
+		if (!used)
 		{
-			sLogger.LogWarning(L"Duplicate file storage entry '%u':'%s' (already used: '%u':'%s')", FileDataId, fileName, itr2->second->FileDataId, itr2->second->Path.c_str());
+			auto itr1 = Pending.IndexByFileDataId.find(FileDataId);
+			if (itr1 != Pending.IndexByFileDataId.end())
+				used = &entries[itr1->second];
+		}
+		if (used)
+		{
+			// saved custom mappings are added to storage right away and are met again in appended lines
+			auto hashEntry = FindHashEntry(nameHash);
+			if (!hashEntry || hashEntry->FileDataId != FileDataId)
+				logDuplicate(L"Duplicate file storage entry '%u':'%s' (already used: '%u':'%s'), skipping", FileDataId, fileName, used);
 			continue;
 		}
 
-		auto info = new FileInfo(FileDataId, fileName);
+		auto hashEntry = FindHashEntry(nameHash);
+		if (hashEntry)
+			used = FindEntry(hashEntry->FileDataId);
+		else
+		{
+			auto itr2 = Pending.IndexByNameHash.find(nameHash);
+			if (itr2 != Pending.IndexByNameHash.end())
+				used = &entries[itr2->second];
+		}
+		if (hashEntry || used)
+		{
+			logDuplicate(L"Duplicate file storage entry '%u':'%s' (already used: '%u':'%s')", FileDataId, fileName, used);
+			continue;
+		}
+
+		auto Offset = AddPath(line.substr(colonPos + 1));
 		if (MaxFileDataId < FileDataId)
 			MaxFileDataId = FileDataId;
 
-		fileInfosByFileDataId[FileDataId] = info;
-		fileInfosByNameHash[nameHash] = info;
+		Pending.IndexByFileDataId[FileDataId] = entries.size();
+		Pending.IndexByNameHash[nameHash] = entries.size();
+		entries.push_back({ FileDataId, Offset, uint32_t(pathPool.size() - Offset) });
+		entriesByNameHash.push_back({ nameHash, FileDataId });
+	}
+}
+
+bool M2Lib::FileStorage::UpdateMappingFile(std::wstring const& FileName, PendingEntries& Pending)
+{
+	auto Size = std::filesystem::file_size(FileName);
+	auto WriteTime = (int64_t)std::filesystem::last_write_time(FileName).time_since_epoch().count();
+
+	auto& state = mappingFiles[FileName];
+	if (Size == state.FileSize && WriteTime == state.WriteTime)
+		return true;
+	if (Size < state.Size)
+		return false;
+
+	std::string Data(Size, '\0');
+	{
+		std::ifstream in;
+		in.open(FileName, std::ios::in | std::ios::binary);
+		if (in.fail())
+			throw std::runtime_error("Failed to open file");
+
+		in.read(&Data[0], Size);
+		Data.resize(in.gcount());
 	}
-	in.close();
+
+	ContentHash Hash;
+	Hash.Add(Data.data(), std::min<uint64_t>(state.Size, Data.size()));
+	if (Data.size() < state.Size || (state.Size && Hash.GetValue() != state.PrefixHash))
+		return false;
+
+	// line that is not terminated may still be written, it is parsed now and checked again on next reload.
+	// if it was continued since, entry parsed from it is outdated and file is reloaded.
+	auto Parsed = state.Size;
+	if (state.FileSize > state.Size)
+	{
+		ContentHash TailHash;
+		TailHash.Add(Data.data() + state.Size, std::min<uint64_t>(state.FileSize, Data.size()) - state.Size);
+		if (Data.size() < state.FileSize || TailHash.GetValue() != state.TailHash ||
+			(Data.size() > state.FileSize && Data[state.FileSize] != '\n' && Data[state.FileSize] != '\r'))
+			return false;
+
+		Parsed = state.FileSize;
+	}
+
+	auto LastLineEnd = Data.rfind('\n');
+	auto Complete = LastLineEnd != std::string::npos && LastLineEnd >= state.Size ? LastLineEnd + 1 : state.Size;
+	Hash.Add(Data.data() + state.Size, Complete - state.Size);
+
+	// copy of file already parsed by base is skipped, only lines appended to it later are parsed into overlay
+	if (!Parsed && base && base->HasMappingFile(FileName, Complete, Hash.GetValue()))
+	{
+		sLogger.LogInfo(L"Mapping '%s' is shared with base storage", std::filesystem::path(FileName).filename().wstring().c_str());
+		Parsed = Complete;
+	}
+
+	ParseCsv(Data.data() + Parsed, Data.size() - Parsed, Pending);
+
+	state.Size = Complete;
+	state.FileSize = Data.size();
+	state.WriteTime = WriteTime;
+	state.PrefixHash = Hash.GetValue();
+
+	ContentHash TailHash;
+	TailHash.Add(Data.data() + Complete, Data.size() - Complete);
+	state.TailHash = TailHash.GetValue();
 
 	return true;
 }
 
+void M2Lib::FileStorage::SortEntries(bool Compact)
+{
+	auto sortedEntries = entries.begin() + sortedEntryCount;
+	std::sort(sortedEntries, entries.end(), [](Entry const& a, Entry const& b) { return a.FileDataId < b.FileDataId; });
+	std::inplace_merge(entries.begin(), sortedEntries, entries.end(), [](Entry const& a, Entry const& b) { return a.FileDataId < b.FileDataId; });
+
+	auto sortedHashes = entriesByNameHash.begin() + sortedHashCount;
+	std::sort(sortedHashes, entriesByNameHash.end(), [](HashEntry const& a, HashEntry const& b) { return a.Hash < b.Hash; });
+	std::inplace_merge(entriesByNameHash.begin(), sortedHashes, entriesByNameHash.end(), [](HashEntry const& a, HashEntry const& b) { return a.Hash < b.Hash; });
+
+	sortedEntryCount = entries.size();
+	sortedHashCount = entriesByNameHash.size();
+
+	if (Compact)
+	{
+		entries.shrink_to_fit();
+		entriesByNameHash.shrink_to_fit();
+		pathPool.shrink_to_fit();
+	}
+}
+
+bool M2Lib::FileStorage::HasMappingFile(std::wstring const& FileName, uint64_t Size, uint64_t Hash) const
+{
+	auto Name = std::filesystem::path(FileName).filename().wstring();
+	for (auto& itr : mappingFiles)
+	{
+		if (itr.second.Size == Size && itr.second.PrefixHash == Hash && ToLower(std::filesystem::path(itr.first).filename().wstring()) == ToLower(Name))
+			return true;
+	}
+
+	return false;
+}
+
 bool M2Lib::FileStorage::LoadStorage()
 {
-	if (!fileInfosByFileDataId.empty())
+	if (base)
+		base->LoadStorage();
+
+	if (loaded)
 		return true;
 
 	if (!LoadMappings()) {
@@ -99,7 +344,8 @@ bool M2Lib::FileStorage::LoadStorage()
 		return false;
 	}
 
-	sLogger.LogInfo(L"Loaded %u mapping entries", fileInfosByFileDataId.size());
+	loaded = true;
+	sLogger.LogInfo(L"Loaded %u mapping entries", entries.size());
 	
 	return true;
 }
@@ -120,10 +366,62 @@ void M2Lib::FileStorage::SetMappingsDirectory(std::wstring const& mappingsDirect
 	ClearStorage();
 }
 
+void M2Lib::FileStorage::SetBase(FileStorage* base)
+{
+	m2lib_assert(base != this);
+	if (this->base == base)
+		return;
+
+	this->base = base;
+	loadFailed = false;
+	ClearEntries();
+}
+
 void M2Lib::FileStorage::AddRecord(FileInfo const* record)
 {
-	fileInfosByFileDataId[record->FileDataId] = record;
-	fileInfosByNameHash[CalcStringHash(record->Path)] = record;
+	auto Offset = AddPath(record->Path);
+	Entry entry = { record->FileDataId, Offset, uint32_t(pathPool.size() - Offset) };
+
+	auto hash = CalcStringHash(record->Path);
+
+	// path of replaced entry stays in pool until storage is cleared
+	auto itr = std::lower_bound(entries.begin(), entries.end(), record->FileDataId, [](Entry const& a, uint32_t FileDataId) { return a.FileDataId < FileDataId; });
+	if (itr != entries.end() && itr->FileDataId == record->FileDataId)
+	{
+		// old path must not resolve to this file data id anymore
+		auto oldHash = CalcStringHash(DecodeUtf8(GetEntryPath(*itr)));
+		if (oldHash != hash)
+		{
+			auto oldHashItr = std::lower_bound(entriesByNameHash.begin(), entriesByNameHash.end(), oldHash, [](HashEntry const& a, uint64_t Hash) { return a.Hash < Hash; });
+			if (oldHashItr != entriesByNameHash.end() && oldHashItr->Hash == oldHash && oldHashItr->FileDataId == record->FileDataId)
+			{
+				entriesByNameHash.erase(oldHashItr);
+				--sortedHashCount;
+			}
+		}
+
+		*itr = entry;
+	}
+	else
+	{
+		entries.insert(itr, entry);
+		++sortedEntryCount;
+	}
+
+	auto hashItr = std::lower_bound(entriesByNameHash.begin(), entriesByNameHash.end(), hash, [](HashEntry const& a, uint64_t Hash) { return a.Hash < Hash; });
+	if (hashItr != entriesByNameHash.end() && hashItr->Hash == hash)
+		hashItr->FileDataId = record->FileDataId;
+	else
+	{
+		entriesByNameHash.insert(hashItr, { hash, record->FileDataId });
+		++sortedHashCount;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(fileInfosLock);
+		fileInfos.push_back(record);
+		fileInfosByFileDataId[record->FileDataId] = record;
+	}
 
 	if (record->FileDataId > MaxFileDataId)
 		MaxFileDataId = record->FileDataId;
@@ -134,21 +432,18 @@ M2Lib::FileStorage::~FileStorage()
 	ClearStorage();
 }
 
-bool M2Lib::FileStorage::LoadMappings()
+std::wstring M2Lib::FileStorage::GetMappingsDirectory() const
 {
-	if (loadFailed)
-		return false;
+	return mappingsDirectory.length() > 0 ? mappingsDirectory : DefaultMappingsPath;
+}
 
-	auto directory = mappingsDirectory.length() > 0 ? mappingsDirectory : DefaultMappingsPath;
-	if (!std::filesystem::is_directory(directory)) {
-		sLogger.LogWarning(L"Mappings directory '%s' does not exist", directory.c_str());
+bool M2Lib::FileStorage::ListMappingFiles(std::wstring const& Directory, std::vector<std::wstring>& FileNames) const
+{
+	if (!std::filesystem::is_directory(Directory)) {
+		sLogger.LogWarning(L"Mappings directory '%s' does not exist", Directory.c_str());
 		return false;
 	}
 
-	sLogger.LogInfo(L"Loading mappings at '%s'", directory.c_str());
-
-	std::filesystem::directory_iterator itr;
-
 	const auto isSupportedExtension = [](std::wstring const& extension)
 	{
 		auto copy = extension;
@@ -156,64 +451,249 @@ bool M2Lib::FileStorage::LoadMappings()
 		return copy == L".csv" || copy == L".txt";
 	};
 
-	auto now = time(NULL);
-	for (auto& p : std::filesystem::directory_iterator(directory))
+	for (auto& p : std::filesystem::directory_iterator(Directory))
 	{
-		if (!isSupportedExtension(p.path().extension()))
-			continue;
+		if (isSupportedExtension(p.path().extension()))
+			FileNames.push_back(p.path().wstring());
+	}
+
+	return true;
+}
+
+bool M2Lib::FileStorage::LoadMappings()
+{
+	if (loadFailed)
+		return false;
+
+	auto directory = GetMappingsDirectory();
+	std::vector<std::wstring> FileNames;
+	if (!ListMappingFiles(directory, FileNames))
+		return false;
+
+	sLogger.LogInfo(L"Loading mappings at '%s'", directory.c_str());
 
-		sLogger.LogInfo(L"Loading mapping '%s'", p.path().filename().wstring().c_str());
+	// duplicates are checked against all files, indexes are dropped once entries are sorted
+	PendingEntries Pending;
+	for (auto& FileName : FileNames)
+	{
+		auto fileName = std::filesystem::path(FileName).filename().wstring();
+		sLogger.LogInfo(L"Loading mapping '%s'", fileName.c_str());
 
 		try
 		{
-			if (!ParseCsv(p.path().wstring()))
-				sLogger.LogError(L"Failed to parse mapping file '%s'", p.path().filename().wstring().c_str());
+			UpdateMappingFile(FileName, Pending);
 		}
 		catch (std::exception& e)
 		{
-			sLogger.LogError(L"Failed to parse mapping file '%s': %s", p.path().filename().wstring().c_str(), StringHelpers::StringToWString(e.what()).c_str());
+			sLogger.LogError(L"Failed to parse mapping file '%s': %s", fileName.c_str(), StringHelpers::StringToWString(e.what()).c_str());
 		}
 	}
 
+	SortEntries(true);
+
 	return true;
 }
 
+bool M2Lib::FileStorage::ReloadStorage()
+{
+	if (base)
+		base->ReloadStorage();
+
+	loadFailed = false;
+	if (!loaded)
+		return LoadStorage();
+
+	auto directory = GetMappingsDirectory();
+	std::vector<std::wstring> FileNames;
+	if (!ListMappingFiles(directory, FileNames))
+		return false;
+
+	bool FullReload = FileNames.size() < mappingFiles.size();
+	for (auto& itr : mappingFiles)
+	{
+		if (std::find(FileNames.begin(), FileNames.end(), itr.first) == FileNames.end())
+			FullReload = true;
+	}
+
+	PendingEntries Pending;
+	auto EntryCount = entries.size();
+	for (uint32_t i = 0; i < FileNames.size() && !FullReload; ++i)
+	{
+		try
+		{
+			if (!UpdateMappingFile(FileNames[i], Pending))
+			{
+				sLogger.LogInfo(L"Mapping '%s' was changed", std::filesystem::path(FileNames[i]).filename().wstring().c_str());
+				FullReload = true;
+			}
+		}
+		catch (std::exception& e)
+		{
+			sLogger.LogError(L"Failed to parse mapping file '%s': %s", std::filesystem::path(FileNames[i]).filename().wstring().c_str(), StringHelpers::StringToWString(e.what()).c_str());
+		}
+	}
+
+	if (FullReload)
+	{
+		ClearEntries();
+		return LoadStorage();
+	}
+
+	SortEntries(false);
+	sLogger.LogInfo(L"Reloaded mappings, %u new entries", uint32_t(entries.size() - EntryCount));
+
+	return true;
+}
+
+M2Lib::FileStorage::Entry const* M2Lib::FileStorage::FindEntry(uint32_t FileDataId) const
+{
+	auto end = entries.begin() + sortedEntryCount;
+	auto itr = std::lower_bound(entries.begin(), end, FileDataId, [](Entry const& a, uint32_t FileDataId) { return a.FileDataId < FileDataId; });
+	if (itr == end || itr->FileDataId != FileDataId)
+		return nullptr;
+
+	return &*itr;
+}
+
+M2Lib::FileStorage::HashEntry const* M2Lib::FileStorage::FindHashEntry(uint64_t Hash) const
+{
+	auto end = entriesByNameHash.begin() + sortedHashCount;
+	auto itr = std::lower_bound(entriesByNameHash.begin(), end, Hash, [](HashEntry const& a, uint64_t Hash) { return a.Hash < Hash; });
+	if (itr == end || itr->Hash != Hash)
+		return nullptr;
+
+	return &*itr;
+}
+
+M2Lib::FileInfo const* M2Lib::FileStorage::GetOrCreateFileInfo(Entry const& entry)
+{
+	std::lock_guard<std::mutex> lock(fileInfosLock);
+
+	auto itr = fileInfosByFileDataId.find(entry.FileDataId);
+	if (itr != fileInfosByFileDataId.end())
+		return itr->second;
+
+	auto info = new FileInfo(entry.FileDataId, DecodeUtf8(GetEntryPath(entry)).c_str());
+	fileInfos.push_back(info);
+	fileInfosByFileDataId[entry.FileDataId] = info;
+
+	return info;
+}
+
+bool M2Lib::FileStorage::IsOverridden(uint32_t FileDataId, uint64_t Hash) const
+{
+	// path of base entry was given to other file data id, or file data id got other path
+	auto hashEntry = FindHashEntry(Hash);
+	if (hashEntry)
+		return hashEntry->FileDataId != FileDataId;
+
+	return FindEntry(FileDataId) != nullptr;
+}
+
+uint64_t M2Lib::FileStorage::GetMemoryUsage() const
+{
+	uint64_t Size = entries.capacity() * sizeof(Entry) + entriesByNameHash.capacity() * sizeof(HashEntry) + pathPool.capacity();
+
+	// node based map, approximated as node with two pointers per element and pointer per bucket
+	Size += fileInfos.capacity() * sizeof(FileInfo const*) + fileInfosByFileDataId.bucket_count() * sizeof(void*) +
+		fileInfosByFileDataId.size() * (sizeof(std::pair<uint32_t, FileInfo const*>) + 2 * sizeof(void*));
+	for (auto info : fileInfos)
+		Size += sizeof(FileInfo) + info->Path.capacity() * sizeof(wchar_t);
+
+	return Size;
+}
+
+uint64_t M2Lib::FileStorage::GetStateHash() const
+{
+	ContentHash Hash;
+	Hash.AddValue(MaxFileDataId);
+	Hash.AddValue((uint64_t)entries.size());
+	// records added at runtime always append their paths to pool
+	Hash.AddValue((uint64_t)pathPool.size());
+
+	// map order is not stable, states are hashed in order of file names
+	std::vector<std::pair<std::wstring, MappingFileState const*>> States;
+	for (auto& itr : mappingFiles)
+		States.emplace_back(itr.first, &itr.second);
+	std::sort(States.begin(), States.end(), [](auto const& a, auto const& b) { return a.first < b.first; });
+
+	for (auto& itr : States)
+	{
+		Hash.AddString(itr.first);
+		Hash.AddValue(itr.second->Size);
+		Hash.AddValue(itr.second->FileSize);
+		Hash.AddValue(itr.second->WriteTime);
+		Hash.AddValue(itr.second->PrefixHash);
+	}
+
+	Hash.AddValue(base ? base->GetStateHash() : 0);
+
+	return Hash.GetValue();
+}
+
 M2Lib::FileInfo const* M2Lib::FileStorage::GetFileInfoByPartialPath(std::wstring const & Name)
 {
 	LoadStorage();
 
-	const auto NameCopy = NormalizePath(Name);
+	std::string NameCopy;
+	AppendUtf8(NameCopy, NormalizePath(Name));
 
-	for (auto& itr : fileInfosByFileDataId)
+	for (auto& entry : entries)
 	{
-		if (NormalizePath(itr.second->Path).find(NameCopy) != std::string::npos)
-			return itr.second;
+		if (GetEntryPath(entry).find(NameCopy) != std::string_view::npos)
+			return GetOrCreateFileInfo(entry);
 	}
 
-	return nullptr;
+	if (!base)
+		return nullptr;
+
+	auto info = base->GetFileInfoByPartialPath(Name);
+	if (info && IsOverridden(info->FileDataId, CalcStringHash(info->Path)))
+		return nullptr;
+
+	return info;
 }
 
 M2Lib::FileInfo const* M2Lib::FileStorage::GetFileInfoByFileDataId(uint32_t FileDataId)
 {
 	LoadStorage();
 
-	auto itr = fileInfosByFileDataId.find(FileDataId);
-	if (itr == fileInfosByFileDataId.end())
-		return nullptr;
+	auto entry = FindEntry(FileDataId);
+	if (!entry)
+	{
+		if (!base)
+			return nullptr;
+
+		// path of base entry may be given to other file data id by overlay
+		auto info = base->GetFileInfoByFileDataId(FileDataId);
+		if (info && IsOverridden(FileDataId, CalcStringHash(info->Path)))
+			return nullptr;
+
+		return info;
+	}
 
-	return itr->second;
+	return GetOrCreateFileInfo(*entry);
 }
 
 M2Lib::FileInfo const* M2Lib::FileStorage::GetFileInfoByPath(std::wstring const& Path)
 {
 	LoadStorage();
 
-	uint64_t hash = CalcStringHash(Path);
-	auto itr = fileInfosByNameHash.find(hash);
-	if (itr != fileInfosByNameHash.end())
-		return itr->second;
+	auto hash = CalcStringHash(Path);
+	auto hashEntry = FindHashEntry(hash);
+	if (!hashEntry)
+	{
+		if (!base)
+			return nullptr;
+
+		auto info = base->GetFileInfoByPath(Path);
+		if (info && IsOverridden(info->FileDataId, hash))
+			return nullptr;
 
-	return nullptr;
+		return info;
+	}
+
+	return GetFileInfoByFileDataId(hashEntry->FileDataId);
 }
 
 wchar_t const* M2Lib::FileStorage::PathInfo(uint32_t FileDataId)
@@ -228,6 +708,47 @@ wchar_t const* M2Lib::FileStorage::PathInfo(uint32_t FileDataId)
 	return info->Path.c_str();
 }
 
+std::string_view M2Lib::FileStorage::GetPathView(uint32_t FileDataId)
+{
+	LoadStorage();
+
+	auto entry = FindEntry(FileDataId);
+	if (!entry)
+	{
+		if (!base)
+			return std::string_view();
+
+		auto Path = base->GetPathView(FileDataId);
+		if (!Path.empty() && IsOverridden(FileDataId, CalcStringHash(DecodeUtf8(Path))))
+			return std::string_view();
+
+		return Path;
+	}
+
+	return GetEntryPath(*entry);
+}
+
+uint32_t M2Lib::FileStorage::GetFileDataIdByPath(std::wstring const& Path)
+{
+	LoadStorage();
+
+	auto hash = CalcStringHash(Path);
+	auto hashEntry = FindHashEntry(hash);
+	if (!hashEntry)
+	{
+		if (!base)
+			return 0;
+
+		auto FileDataId = base->GetFileDataIdByPath(Path);
+		if (FileDataId && IsOverridden(FileDataId, hash))
+			return 0;
+
+		return FileDataId;
+	}
+
+	return hashEntry->FileDataId;
+}
+
 std::filesystem::path M2Lib::FileStorage::DetectWorkingDirectory(std::filesystem::path fullPath, std::filesystem::path relativePath)
 {
 	for (;;)
@@ -258,11 +779,38 @@ M2Lib::FileStorage* M2Lib::StorageManager::GetStorage(std::wstring const& mappin
 	auto storage = new FileStorage(mappingDirectory);
 	storages[hash] = storage;
 
+	if (!baseDirectory.empty() && hash != CalcStringHash(baseDirectory))
+		storage->SetBase(GetStorage(baseDirectory));
+
 	return storage;
 }
 
+void M2Lib::StorageManager::SetBaseDirectory(std::wstring const& baseDirectory)
+{
+	this->baseDirectory = baseDirectory;
+
+	auto base = GetBaseStorage();
+	if (base)
+		base->SetBase(nullptr);
+
+	for (auto& itr : storages)
+	{
+		if (itr.second != base)
+			itr.second->SetBase(base);
+	}
+}
+
+M2Lib::FileStorage* M2Lib::StorageManager::GetBaseStorage()
+{
+	if (baseDirectory.empty())
+		return nullptr;
+
+	return GetStorage(baseDirectory);
+}
+
 void M2Lib::StorageManager::Clear()
 {
+	// base directory is kept, its storage is created again on request
 	for (auto storage : storages)
 		delete storage.second;
 
@@ -284,11 +832,30 @@ void M2Lib::FileStorage_Clear()
 	StorageManager::GetInstance()->Clear();
 };
 
+void M2Lib::FileStorage_SetBaseDirectory(const wchar_t* baseDirectory)
+{
+	StorageManager::GetInstance()->SetBaseDirectory(baseDirectory ? baseDirectory : L"");
+}
+
 void M2Lib::FileStorage_SetMappingsDirectory(M2LIB_HANDLE handle, const wchar_t* mappingsDirectory)
 {
 	static_cast<FileStorage*>(handle)->SetMappingsDirectory(mappingsDirectory);
 }
 
+bool M2Lib::FileStorage_Reload(M2LIB_HANDLE handle)
+{
+	try
+	{
+		return static_cast<FileStorage*>(handle)->ReloadStorage();
+	}
+	catch (std::exception& e)
+	{
+		sLogger.LogError(L"Exception: %s", StringHelpers::StringToWString(e.what()).c_str());
+
+		return false;
+	}
+}
+
 M2LIB_HANDLE M2Lib::FileStorage_GetFileInfoByFileDataId(M2LIB_HANDLE handle, uint32_t FileDataId)
 {
 	return (M2LIB_HANDLE)static_cast<FileStorage*>(handle)->GetFileInfoByFileDataId(FileDataId);
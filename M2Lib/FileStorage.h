@@ -2,7 +2,10 @@
 
 #include "BaseTypes.h"
 #include <string>
-#include <map>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <algorithm>
 #include <unordered_map>
 
 namespace std {
@@ -21,39 +24,118 @@ namespace M2Lib
 		std::wstring Path;
 	};
 
+	// listfile entries are kept in flat arrays sorted by file data id and by path hash, normalized paths are stored once in utf-8 pool.
+	// FileInfo objects are created on first request and stay valid until storage is cleared.
+	// storage can be overlay of base storage, then it holds only its own entries and lookups fall through to base.
 	class FileStorage
 	{
+		struct Entry
+		{
+			uint32_t FileDataId;
+			uint32_t PathOffset;
+			uint32_t PathLength;
+		};
+
+		struct HashEntry
+		{
+			uint64_t Hash;
+			uint32_t FileDataId;
+		};
+
+		// state of mapping file after it was parsed, used to parse only appended lines on reload
+		struct MappingFileState
+		{
+			uint64_t Size = 0;			// parsed bytes up to end of last complete line
+			uint64_t FileSize = 0;		// file size at last parse, includes unterminated last line
+			int64_t WriteTime = 0;
+			uint64_t PrefixHash = 0;	// hash of parsed bytes, changes if file was rewritten
+			uint64_t TailHash = 0;		// hash of unterminated last line
+		};
+
+		// entries appended since last sort, duplicates among them are found by indexes until they are merged into sorted arrays
+		struct PendingEntries
+		{
+			std::unordered_map<uint32_t, uint32_t> IndexByFileDataId;
+			std::unordered_map<uint64_t, uint32_t> IndexByNameHash;
+		};
+
 		bool loadFailed = false;
+		bool loaded = false;
 		uint32_t MaxFileDataId = 0;
+		FileStorage* base = nullptr;
 		void ClearStorage();
+		void ClearEntries();
 		bool LoadMappings();
 
-		std::map<uint32_t, FileInfo const*> fileInfosByFileDataId;
-		std::map<uint64_t, FileInfo const*> fileInfosByNameHash;
-		std::wstring mappingsDirectory;
+		std::vector<Entry> entries;				// sorted by file data id
+		std::vector<HashEntry> entriesByNameHash;	// sorted by hash
+		uint32_t sortedEntryCount = 0;			// entries past sorted counts are being parsed
+		uint32_t sortedHashCount = 0;
+		std::string pathPool;
+
+		std::mutex fileInfosLock;
+		std::unordered_map<uint32_t, FileInfo const*> fileInfosByFileDataId;
+		std::vector<FileInfo const*> fileInfos;	// all created or added infos, also replaced ones
 
-		bool ParseCsv(std::wstring const& Path);
+		std::wstring mappingsDirectory;
+		std::unordered_map<std::wstring, MappingFileState> mappingFiles;
+
+		std::wstring GetMappingsDirectory() const;
+		bool ListMappingFiles(std::wstring const& Directory, std::vector<std::wstring>& FileNames) const;
+		// parses lines appended since file was parsed last time, returns false if file was truncated or rewritten
+		bool UpdateMappingFile(std::wstring const& FileName, PendingEntries& Pending);
+		void ParseCsv(char const* Data, size_t Size, PendingEntries& Pending);
+		void SortEntries(bool Compact);
+		// base storage has parsed mapping file with same name and contents
+		bool HasMappingFile(std::wstring const& FileName, uint64_t Size, uint64_t Hash) const;
+
+		uint32_t AddPath(std::wstring const& Path);
+		Entry const* FindEntry(uint32_t FileDataId) const;
+		HashEntry const* FindHashEntry(uint64_t Hash) const;
+		std::string_view GetEntryPath(Entry const& entry) const { return std::string_view(pathPool.data() + entry.PathOffset, entry.PathLength); }
+		FileInfo const* GetOrCreateFileInfo(Entry const& entry);
+		// entry of base is hidden if overlay has other path for the same file data id
+		bool IsOverridden(uint32_t FileDataId, uint64_t Hash) const;
 
 	public:
 		FileStorage(std::wstring const& mappingsDirectory);
 		void SetMappingsDirectory(std::wstring const& mappingsDirectory);
+		// storage takes ownership of record
 		void AddRecord(FileInfo const* record);
 		static std::filesystem::path DetectWorkingDirectory(std::filesystem::path fullPath, std::filesystem::path relativePath);
 
 		~FileStorage();
 
 		bool LoadStorage();
+		// parses only new mapping files and lines appended to known ones, falls back to full reload if any file was truncated, rewritten or removed.
+		// FileInfo objects returned before stay valid, but may be outdated after full reload.
+		bool ReloadStorage();
 		void ResetLoadFailed();
 
+		// base is not owned, overlay is cleared and loads only entries missing in base
+		void SetBase(FileStorage* base);
+		FileStorage* GetBase() const { return base; }
+
 		bool Loaded() const { return GetStorageSize() > 0; }
-		uint32_t GetStorageSize() const { return fileInfosByFileDataId.size(); }
-		uint32_t GetMaxFileDataId() const { return MaxFileDataId; }
+		// entries overridden by overlay are counted in both layers
+		uint32_t GetStorageSize() const { return entries.size() + (base ? base->GetStorageSize() : 0); }
+		uint32_t GetLayerSize() const { return entries.size(); }
+		uint32_t GetMaxFileDataId() const { return base ? std::max(MaxFileDataId, base->GetMaxFileDataId()) : MaxFileDataId; }
+		// memory of this layer only
+		uint64_t GetMemoryUsage() const;
+		// hash of parsed mapping files and entry counts of all layers, changes whenever lookups may give other results
+		uint64_t GetStateHash() const;
 
 		FileInfo const* GetFileInfoByPartialPath(std::wstring const& Name);
 		FileInfo const* GetFileInfoByFileDataId(uint32_t FileDataId);
 		FileInfo const* GetFileInfoByPath(std::wstring const& Path);
 		wchar_t const* PathInfo(uint32_t FileDataId);
 
+		// lookups that don't create FileInfo, returned view is normalized utf-8 path and is valid until storage is changed
+		std::string_view GetPathView(uint32_t FileDataId);
+		// returns 0 if path is not found
+		uint32_t GetFileDataIdByPath(std::wstring const& Path);
+
 		static const std::wstring DefaultMappingsPath;
 	};
 
@@ -61,6 +143,7 @@ namespace M2Lib
 	{
 	private:
 		std::unordered_map<uint64_t, FileStorage*> storages;
+		std::wstring baseDirectory;
 
 	public:
 
@@ -74,12 +157,18 @@ namespace M2Lib
 		~StorageManager();
 
 		FileStorage* GetStorage(std::wstring const& mappingDirectory);
+		// storages of other directories become overlays of storage of base directory, so base listfile is loaded once.
+		// empty directory makes storages independent again.
+		void SetBaseDirectory(std::wstring const& baseDirectory);
+		FileStorage* GetBaseStorage();
 		void Clear();
 	};
 
 	M2LIB_API M2LIB_HANDLE __cdecl FileStorage_Get(const wchar_t* mappingsDirectory);
 	M2LIB_API void __cdecl FileStorage_Clear();
+	M2LIB_API void __cdecl FileStorage_SetBaseDirectory(const wchar_t* baseDirectory);
 	M2LIB_API void __cdecl FileStorage_SetMappingsDirectory(M2LIB_HANDLE handle, const wchar_t* mappingsDirectory);
+	M2LIB_API bool __cdecl FileStorage_Reload(M2LIB_HANDLE handle);
 	M2LIB_API M2LIB_HANDLE __cdecl FileStorage_GetFileInfoByFileDataId(M2LIB_HANDLE handle, uint32_t FileDataId);
 	M2LIB_API M2LIB_HANDLE __cdecl FileStorage_GetFileInfoByPartialPath(M2LIB_HANDLE handle, wchar_t const* Path);
 
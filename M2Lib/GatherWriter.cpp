@@ -0,0 +1,247 @@
+#include "GatherWriter.h"
+#include "ChunkBase.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include "ContentHash.h"
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+	// segments smaller than this are copied to staging buffer and written together
+	size_t const SmallSegmentSize = 64 * 1024;
+	size_t const StagingBufferSize = 1024 * 1024;
+}
+
+double M2Lib::GatherWriter::Statistics::GetMegabytesPerSecond() const
+{
+	if (Milliseconds <= 0.0)
+		return 0.0;
+
+	return (double)Bytes / (1024.0 * 1024.0) / (Milliseconds / 1000.0);
+}
+
+void M2Lib::GatherWriter::Append(void const* Data, size_t Size)
+{
+	if (!Size)
+		return;
+
+	Segments.push_back({ (uint8_t const*)Data, Size });
+	TotalSize += Size;
+}
+
+void M2Lib::GatherWriter::AppendAt(size_t Offset, void const* Data, size_t Size)
+{
+	m2lib_assert("Segments must be appended in file order" && Offset >= TotalSize);
+
+	if (Offset > TotalSize)
+		AppendBuffer(std::vector<uint8_t>(Offset - TotalSize, 0));
+
+	Append(Data, Size);
+}
+
+void M2Lib::GatherWriter::AppendCopy(void const* Data, size_t Size)
+{
+	std::vector<uint8_t> Buffer(Size);
+	if (Size)
+		memcpy(Buffer.data(), Data, Size);
+
+	AppendBuffer(std::move(Buffer));
+}
+
+void M2Lib::GatherWriter::AppendBuffer(std::vector<uint8_t>&& Buffer)
+{
+	OwnedBuffers.push_back(std::move(Buffer));
+	Append(OwnedBuffers.back().data(), OwnedBuffers.back().size());
+}
+
+void M2Lib::GatherWriter::AppendChunk(uint32_t ChunkId, ChunkBase* Chunk)
+{
+	std::ostringstream ChunkStream(std::ios::out | std::ios::binary);
+	Chunk->Save(ChunkStream);
+
+	auto const& Data = ChunkStream.str();
+	uint32_t ChunkSize = Data.size();
+
+	AppendValue(ChunkId);
+	AppendValue(ChunkSize);
+	AppendCopy(Data.data(), Data.size());
+}
+
+bool M2Lib::GatherWriter::IsUnchanged(std::wstring const& FileName) const
+{
+	// size is compared first, existing file is read only if it may match
+	std::error_code ec;
+	auto ExistingSize = std::filesystem::file_size(FileName, ec);
+	if (ec || ExistingSize != TotalSize)
+		return false;
+
+	ContentHash ExistingHash;
+	if (!ExistingHash.AddFile(FileName))
+		return false;
+
+	ContentHash NewHash;
+	for (auto& segment : Segments)
+		NewHash.Add(segment.Data, segment.Size);
+
+	return ExistingHash.GetValue() == NewHash.GetValue();
+}
+
+bool M2Lib::GatherWriter::Commit(std::wstring const& FileName)
+{
+	M2LIB_PROFILE_SCOPE("GatherWriter::Commit");
+
+	auto StartTime = std::chrono::high_resolution_clock::now();
+
+	Stats = Statistics();
+	Stats.Segments = Segments.size();
+
+	// rewriting identical file would only change its timestamp and invalidate downstream caches
+	if (IsUnchanged(FileName))
+	{
+		Stats.Bytes = TotalSize;
+		Stats.Skipped = true;
+		Stats.Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - StartTime).count();
+
+		return true;
+	}
+
+	std::filesystem::path TempPath = FileName + L".tmp";
+
+	{
+		// stream is unbuffered, every write() below goes straight to file
+		std::fstream FileStream;
+		FileStream.rdbuf()->pubsetbuf(nullptr, 0);
+		FileStream.open(TempPath, std::ios::out | std::ios::trunc | std::ios::binary);
+		if (FileStream.fail())
+			return false;
+
+		std::vector<uint8_t> Staging;
+		Staging.reserve(StagingBufferSize);
+
+		auto FlushStaging = [&]()
+		{
+			if (Staging.empty())
+				return;
+
+			FileStream.write((char const*)Staging.data(), Staging.size());
+			++Stats.WriteCalls;
+			Staging.clear();
+		};
+
+		for (auto& segment : Segments)
+		{
+			if (segment.Size < SmallSegmentSize)
+			{
+				if (Staging.size() + segment.Size > StagingBufferSize)
+					FlushStaging();
+				Staging.insert(Staging.end(), segment.Data, segment.Data + segment.Size);
+				continue;
+			}
+
+			FlushStaging();
+			FileStream.write((char const*)segment.Data, segment.Size);
+			++Stats.WriteCalls;
+		}
+		FlushStaging();
+
+		FileStream.close();
+		if (FileStream.fail())
+		{
+			std::error_code ec;
+			std::filesystem::remove(TempPath, ec);
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(TempPath, FileName, ec);
+	if (ec)
+	{
+		std::filesystem::remove(TempPath, ec);
+		return false;
+	}
+
+	Stats.Bytes = TotalSize;
+	Stats.Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - StartTime).count();
+
+	return true;
+}
+
+void M2Lib::GatherWriter::LogStatistics(std::wstring const& FileName) const
+{
+	if (Stats.Skipped)
+	{
+		sLogger.LogInfo(L"Unchanged %s: %llu bytes, write skipped", FileName.c_str(), (unsigned long long)Stats.Bytes);
+		return;
+	}
+
+	sLogger.LogInfo(L"Saved %s: %llu bytes, %u segments in %u writes, %.2f ms, %.1f MB/s", FileName.c_str(),
+		(unsigned long long)Stats.Bytes, Stats.Segments, Stats.WriteCalls, Stats.Milliseconds, Stats.GetMegabytesPerSecond());
+}
+
+M2Lib::GatherWriter& M2Lib::SaveBatch::Add(std::wstring const& FileName, EError FailError)
+{
+	Files.emplace_back();
+	Files.back().FileName = FileName;
+	Files.back().FailError = FailError;
+
+	return Files.back().Writer;
+}
+
+std::vector<std::wstring> M2Lib::SaveBatch::GetFileNames() const
+{
+	std::vector<std::wstring> Result;
+	for (auto& file : Files)
+		Result.push_back(file.FileName);
+
+	return Result;
+}
+
+M2Lib::EError M2Lib::SaveBatch::Commit()
+{
+	M2LIB_PROFILE_SCOPE("SaveBatch::Commit");
+
+	std::vector<File*> FileList;
+	for (auto& file : Files)
+		FileList.push_back(&file);
+
+	// workers only write, results are logged below on calling thread
+	ThreadPool::GetInstance()->ParallelFor(FileList.size(), [&FileList](uint32_t Index)
+	{
+		auto file = FileList[Index];
+		file->Succeeded = file->Writer.Commit(file->FileName);
+	});
+
+	EError Result = EError_OK;
+	uint32_t SkippedCount = 0;
+	uint64_t SkippedBytes = 0;
+	for (auto file : FileList)
+	{
+		if (file->Succeeded)
+		{
+			file->Writer.LogStatistics(file->FileName);
+
+			auto const& Stats = file->Writer.GetStatistics();
+			if (Stats.Skipped)
+			{
+				++SkippedCount;
+				SkippedBytes += Stats.Bytes;
+			}
+			continue;
+		}
+
+		sLogger.LogError(L"Error: failed to write '%s'", file->FileName.c_str());
+		if (Result == EError_OK)
+			Result = file->FailError;
+	}
+
+	if (SkippedCount)
+		sLogger.LogInfo(L"Skipped writing %u of %u files with unchanged contents, %llu bytes", SkippedCount, (uint32_t)FileList.size(), (unsigned long long)SkippedBytes);
+
+	return Result;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "BaseTypes.h"
+#include "M2Types.h"
+#include <string>
+#include <vector>
+#include <list>
+
+namespace M2Lib
+{
+	class ChunkBase;
+
+	// assembles file from list of memory segments and writes it in one sequential pass to temporary file,
+	// which then replaces target file. target is never left truncated if save fails halfway.
+	// referenced memory is not copied and must stay unchanged until Commit().
+	class GatherWriter
+	{
+	public:
+		struct Statistics
+		{
+			uint64_t Bytes = 0;
+			uint32_t Segments = 0;
+			uint32_t WriteCalls = 0;
+			double Milliseconds = 0.0;
+			bool Skipped = false;		// existing file had same contents and was not rewritten
+
+			double GetMegabytesPerSecond() const;
+		};
+
+	private:
+		struct Segment
+		{
+			uint8_t const* Data;
+			size_t Size;
+		};
+
+		std::vector<Segment> Segments;
+		std::list<std::vector<uint8_t>> OwnedBuffers;
+		size_t TotalSize = 0;
+
+		Statistics Stats;
+
+		bool IsUnchanged(std::wstring const& FileName) const;
+
+	public:
+		// appends referenced memory
+		void Append(void const* Data, size_t Size);
+		// appends referenced memory at absolute file offset, gap before it is filled with zeros
+		void AppendAt(size_t Offset, void const* Data, size_t Size);
+		// appends copy of memory
+		void AppendCopy(void const* Data, size_t Size);
+		// takes ownership of buffer and appends it
+		void AppendBuffer(std::vector<uint8_t>&& Buffer);
+
+		template <class T>
+		void AppendValue(T const& Value) { AppendCopy(&Value, sizeof(T)); }
+
+		// serializes chunk and appends it with chunk id and size header
+		void AppendChunk(uint32_t ChunkId, ChunkBase* Chunk);
+
+		size_t GetSize() const { return TotalSize; }
+
+		// writes all segments to temporary file next to FileName and renames it over FileName.
+		// if FileName already has same contents, nothing is written.
+		bool Commit(std::wstring const& FileName);
+
+		Statistics const& GetStatistics() const { return Stats; }
+		// logs size, write count and throughput of last Commit()
+		void LogStatistics(std::wstring const& FileName) const;
+	};
+
+	// group of independent output files that are written concurrently once all of them are assembled.
+	// total save time is bounded by the largest file rather than the sum of all of them.
+	class SaveBatch
+	{
+		struct File
+		{
+			std::wstring FileName;
+			EError FailError;
+			GatherWriter Writer;
+			bool Succeeded = false;
+		};
+
+		std::list<File> Files;
+
+	public:
+		// adds file to batch, returned writer stays valid until batch is destroyed
+		GatherWriter& Add(std::wstring const& FileName, EError FailError);
+
+		uint32_t GetFileCount() const { return Files.size(); }
+		std::vector<std::wstring> GetFileNames() const;
+
+		// commits all files on thread pool. result of every file is logged, first failure is returned.
+		EError Commit();
+	};
+}
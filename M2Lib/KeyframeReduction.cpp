@@ -0,0 +1,442 @@
+#include "KeyframeReduction.h"
+#include "DataElement.h"
+#include "M2.h"
+#include "Skeleton.h"
+#include "SkeletonChunk.h"
+#include "VectorMath.h"
+#include "Logger.h"
+#include <functional>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+using namespace M2Lib::M2Element;
+using namespace M2Lib::SkeletonChunk;
+using M2Lib::Geometry::Quaternion;
+
+namespace
+{
+	// keys between two kept keys are checked against all keys of the span, longer spans are split to bound the cost
+	uint32_t const MaxSpanKeys = 512;
+}
+
+M2Lib::KeyframeReduction::Stats M2Lib::KeyframeReduction::Report::GetTotal() const
+{
+	Stats Total;
+	for (auto& Type : Types)
+	{
+		Total.Tracks += Type.Tracks;
+		Total.KeysBefore += Type.KeysBefore;
+		Total.KeysAfter += Type.KeysAfter;
+		Total.UnusedKeyBytes += Type.UnusedKeyBytes;
+	}
+
+	return Total;
+}
+
+void M2Lib::KeyframeReduction::Report::Print() const
+{
+	for (uint32_t i = 0; i < ETrackType__Count__; ++i)
+	{
+		auto& Type = Types[i];
+		if (!Type.Tracks)
+			continue;
+
+		sLogger.LogInfo(L"\t%s: %u tracks, %u -> %u keys, %u key bytes left unused", GetTrackTypeName((ETrackType)i),
+			Type.Tracks, Type.KeysBefore, Type.KeysAfter, Type.UnusedKeyBytes);
+	}
+
+	auto Total = GetTotal();
+	sLogger.LogInfo(L"\tTotal: %u tracks, %u -> %u keys, %u key bytes left unused", Total.Tracks, Total.KeysBefore, Total.KeysAfter, Total.UnusedKeyBytes);
+}
+
+M2Lib::KeyframeReduction::KeyframeReduction(float PositionTolerance, float AngleTolerance)
+	: positionTolerance(PositionTolerance), angleTolerance(AngleTolerance)
+{
+}
+
+void M2Lib::KeyframeReduction::AddTrack(M2Track& Track, ETrackType Type, EValueType ValueType, uint32_t Components, uint32_t Stride,
+	DataElement* Elements, uint32_t ElementCount, DataElement* Animations, AnimFile::EAnimChunk FileChunk)
+{
+	// bezier and hermite keys carry tangents, removing them changes curve shape
+	if (Track.InterpolationType != EInterpolationType_None && Track.InterpolationType != EInterpolationType_Linear)
+		return;
+	if (!Track.TimeStamps.Count || Track.TimeStamps.Count != Track.Values.Count)
+		return;
+
+	auto SubTimes = (M2Array*)DataElement::FindLocalPointer(Elements, ElementCount, Track.TimeStamps.Offset, Track.TimeStamps.Count * sizeof(M2Array));
+	auto SubValues = (M2Array*)DataElement::FindLocalPointer(Elements, ElementCount, Track.Values.Offset, Track.Values.Count * sizeof(M2Array));
+	if (!SubTimes || !SubValues)
+		return;
+
+	for (int32_t i = 0; i < Track.TimeStamps.Count; ++i)
+	{
+		auto& Times = SubTimes[i];
+		auto& Values = SubValues[i];
+		if (Times.Count <= 0 || Times.Count != Values.Count)
+			continue;
+
+		uint32_t* TimeData;
+		uint8_t* ValueData;
+
+		// keys of sequences that are not in-place are stored in .anim files
+		if (Track.GlobalSequenceID == -1 && (!Animations || (uint32_t)i >= Animations->Count || !Animations->at<CElement_Animation>(i)->IsInplace()))
+		{
+			auto File = (uint32_t)i < animFiles.size() ? animFiles[i] : NULL;
+			if (!File)
+				continue;
+
+			TimeData = (uint32_t*)File->GetMutableData(FileChunk, Times.Offset, Times.Count * sizeof(uint32_t));
+			ValueData = File->GetMutableData(FileChunk, Values.Offset, Values.Count * Stride);
+		}
+		else
+		{
+			TimeData = (uint32_t*)DataElement::FindLocalPointer(Elements, ElementCount, Times.Offset, Times.Count * sizeof(uint32_t));
+			ValueData = DataElement::FindLocalPointer(Elements, ElementCount, Values.Offset, Values.Count * Stride);
+		}
+		if (!TimeData || !ValueData)
+			continue;
+
+		KeyArray Array;
+		Array.Times = &Times;
+		Array.Values = &Values;
+		Array.TimeData = TimeData;
+		Array.ValueData = ValueData;
+		Array.Count = Times.Count;
+		Array.Type = Type;
+		Array.ValueType = ValueType;
+		Array.Components = Components;
+		Array.Stride = Stride;
+		Array.Linear = Track.InterpolationType == EInterpolationType_Linear;
+		keyArrays.push_back(Array);
+	}
+}
+
+void M2Lib::KeyframeReduction::AddModel(M2& Model)
+{
+	auto Elements = Model.Elements;
+	auto Animations = Model.GetAnimations();
+
+	animFiles.assign(Animations->Count, NULL);
+	for (uint32_t i = 0; i < Animations->Count; ++i)
+		animFiles[i] = Model.GetAnimFile(i);
+	auto Add = [&](M2Track& Track, ETrackType Type, EValueType ValueType, uint32_t Components, uint32_t Stride)
+	{
+		AddTrack(Track, Type, ValueType, Components, Stride, Elements, EElement__CountM2__, Animations);
+	};
+
+	auto Bones = Elements[EElement_Bone].as<CElement_Bone>();
+	for (uint32_t i = 0; i < Elements[EElement_Bone].Count; ++i)
+	{
+		Add(Bones[i].AnimationBlock_Position, ETrackType_BonePosition, EValueType_Float, 3, sizeof(M2Track::SKey_Float32x3));
+		Add(Bones[i].AnimationBlock_Rotation, ETrackType_BoneRotation, EValueType_Quaternion, 4, sizeof(M2Track::SKey_SInt16x4));
+		Add(Bones[i].AnimationBlock_Scale, ETrackType_BoneScale, EValueType_Float, 3, sizeof(M2Track::SKey_Float32x3));
+	}
+
+	auto Attachments = Elements[EElement_Attachment].as<CElement_Attachment>();
+	for (uint32_t i = 0; i < Elements[EElement_Attachment].Count; ++i)
+		Add(Attachments[i].AnimationBlock_Visibility, ETrackType_Attachment, EValueType_Flag, 1, 1);
+
+	auto Lights = Elements[EElement_Light].as<CElement_Light>();
+	for (uint32_t i = 0; i < Elements[EElement_Light].Count; ++i)
+	{
+		auto& Light = Lights[i];
+		Add(Light.AnimationBlock_AmbientColor, ETrackType_Light, EValueType_Float, 3, sizeof(M2Track::SKey_Float32x3));
+		Add(Light.AnimationBlock_AmbientIntensity, ETrackType_Light, EValueType_Float, 1, sizeof(M2Track::SKey_Float32));
+		Add(Light.AnimationBlock_DiffuseColor, ETrackType_Light, EValueType_Float, 3, sizeof(M2Track::SKey_Float32x3));
+		Add(Light.AnimationBlock_DiffuseIntensity, ETrackType_Light, EValueType_Float, 1, sizeof(M2Track::SKey_Float32));
+		Add(Light.AnimationBlock_AttenuationStart, ETrackType_Light, EValueType_Float, 1, sizeof(M2Track::SKey_Float32));
+		Add(Light.AnimationBlock_AttenuationEnd, ETrackType_Light, EValueType_Float, 1, sizeof(M2Track::SKey_Float32));
+		Add(Light.AnimationBlock_Visibility, ETrackType_Light, EValueType_Flag, 1, 1);
+	}
+
+	// camera keys are spline keys: value followed by in and out tangents
+	auto AddCamera = [&](M2Track& Position, M2Track& Target, M2Track& Roll, M2Track* FieldOfView)
+	{
+		Add(Position, ETrackType_Camera, EValueType_Float, 3, 3 * sizeof(M2Track::SKey_Float32x3));
+		Add(Target, ETrackType_Camera, EValueType_Float, 3, 3 * sizeof(M2Track::SKey_Float32x3));
+		Add(Roll, ETrackType_Camera, EValueType_Angle, 1, 3 * sizeof(M2Track::SKey_Float32));
+		if (FieldOfView)
+			Add(*FieldOfView, ETrackType_Camera, EValueType_Angle, 1, 3 * sizeof(M2Track::SKey_Float32));
+	};
+
+	for (uint32_t i = 0; i < Elements[EElement_Camera].Count; ++i)
+	{
+		if (Model.GetExpansion() < Expansion::Cataclysm)
+		{
+			auto Camera = Elements[EElement_Camera].at<CElement_Camera_PreCata>(i);
+			AddCamera(Camera->AnimationBlock_Position, Camera->AnimationBlock_Target, Camera->AnimationBlock_Roll, nullptr);
+		}
+		else
+		{
+			auto Camera = Elements[EElement_Camera].at<CElement_Camera>(i);
+			AddCamera(Camera->AnimationBlock_Position, Camera->AnimationBlock_Target, Camera->AnimationBlock_Roll, &Camera->AnimationBlock_FieldOfView);
+		}
+	}
+
+	auto ParticleEmitters = Elements[EElement_ParticleEmitter].as<CElement_ParticleEmitter>();
+	for (uint32_t i = 0; i < Elements[EElement_ParticleEmitter].Count; ++i)
+	{
+		auto& Emitter = ParticleEmitters[i];
+		for (auto Track : { &Emitter.AnimationBlock_EmitSpeed, &Emitter.AnimationBlock_SpeedVariance, &Emitter.AnimationBlock_VerticalRange,
+			&Emitter.AnimationBlock_HorizontalRange, &Emitter.AnimationBlock_Gravity, &Emitter.AnimationBlock_Lifespan, &Emitter.AnimationBlock_EmissionRate,
+			&Emitter.AnimationBlock_EmissionAreaLength, &Emitter.AnimationBlock_EmissionAreaWidth, &Emitter.AnimationBlock_zSource })
+			Add(*Track, ETrackType_ParticleEmitter, EValueType_Float, 1, sizeof(M2Track::SKey_Float32));
+		Add(Emitter.AnimationBlock_EnabledIn, ETrackType_ParticleEmitter, EValueType_Flag, 1, 1);
+	}
+
+	if (auto Skeleton = Model.GetSkeleton())
+		AddSkeleton(*Skeleton, Animations);
+}
+
+void M2Lib::KeyframeReduction::AddSkeleton(Skeleton& Source, DataElement* Animations)
+{
+	if (auto Chunk = (SKB1Chunk*)Source.GetChunk(ESkeletonChunk::SKB1))
+	{
+		auto& Element = Chunk->Elements[SKB1Chunk::EElement_Bone];
+		auto Bones = Element.as<CElement_Bone>();
+		for (uint32_t i = 0; i < Element.Count; ++i)
+		{
+			AddTrack(Bones[i].AnimationBlock_Position, ETrackType_BonePosition, EValueType_Float, 3, sizeof(M2Track::SKey_Float32x3), Chunk->Elements, SKB1Chunk::EElement_Count, Animations, AnimFile::EAnimChunk::AFSB);
+			AddTrack(Bones[i].AnimationBlock_Rotation, ETrackType_BoneRotation, EValueType_Quaternion, 4, sizeof(M2Track::SKey_SInt16x4), Chunk->Elements, SKB1Chunk::EElement_Count, Animations, AnimFile::EAnimChunk::AFSB);
+			AddTrack(Bones[i].AnimationBlock_Scale, ETrackType_BoneScale, EValueType_Float, 3, sizeof(M2Track::SKey_Float32x3), Chunk->Elements, SKB1Chunk::EElement_Count, Animations, AnimFile::EAnimChunk::AFSB);
+		}
+	}
+
+	if (auto Chunk = (SKA1Chunk*)Source.GetChunk(ESkeletonChunk::SKA1))
+	{
+		auto& Element = Chunk->Elements[SKA1Chunk::EElement_Attachment];
+		auto Attachments = Element.as<CElement_Attachment>();
+		for (uint32_t i = 0; i < Element.Count; ++i)
+			AddTrack(Attachments[i].AnimationBlock_Visibility, ETrackType_Attachment, EValueType_Flag, 1, 1, Chunk->Elements, SKA1Chunk::EElement_Count, Animations, AnimFile::EAnimChunk::AFSA);
+	}
+}
+
+bool M2Lib::KeyframeReduction::IsRedundant(KeyArray const& Array, uint32_t From, uint32_t To, uint32_t Index) const
+{
+	// equal timestamps make a jump, keys around it are kept
+	auto TimeFrom = Array.TimeData[From];
+	auto TimeTo = Array.TimeData[To];
+	auto Time = Array.TimeData[Index];
+	if (Time <= TimeFrom || Time >= TimeTo)
+		return false;
+
+	auto KeyFrom = Array.ValueData + From * Array.Stride;
+	auto KeyTo = Array.ValueData + To * Array.Stride;
+	auto Key = Array.ValueData + Index * Array.Stride;
+	float Factor = (float)(Time - TimeFrom) / (float)(TimeTo - TimeFrom);
+
+	switch (Array.ValueType)
+	{
+		case EValueType_Float:
+		case EValueType_Angle:
+		{
+			float Tolerance = Array.ValueType == EValueType_Angle ? angleTolerance : positionTolerance;
+			for (uint32_t i = 0; i < Array.Components; ++i)
+			{
+				float ValueFrom, ValueTo, Value;
+				memcpy(&ValueFrom, KeyFrom + i * sizeof(float), sizeof(float));
+				memcpy(&ValueTo, KeyTo + i * sizeof(float), sizeof(float));
+				memcpy(&Value, Key + i * sizeof(float), sizeof(float));
+
+				// written so that nan is never within tolerance
+				if (!(std::fabs(ValueFrom + (ValueTo - ValueFrom) * Factor - Value) <= Tolerance))
+					return false;
+			}
+
+			return true;
+		}
+		case EValueType_Quaternion:
+		{
+			uint16_t Values[3][4];
+			memcpy(Values[0], KeyFrom, sizeof(Values[0]));
+			memcpy(Values[1], KeyTo, sizeof(Values[1]));
+			memcpy(Values[2], Key, sizeof(Values[2]));
+
+			auto QuaternionFrom = Quaternion::FromPacked(Values[0]);
+			auto QuaternionTo = Quaternion::FromPacked(Values[1]);
+			auto Original = Quaternion::FromPacked(Values[2]);
+
+			// keys on opposite hemispheres may be interpolated either way
+			float Cos = QuaternionFrom.Dot(QuaternionTo);
+			if (Cos < 0.0f)
+				return false;
+
+			// client may use nlerp or slerp, key is removed only if both reproduce it
+			auto Nlerp = Quaternion::Nlerp(QuaternionFrom, QuaternionTo, Factor);
+			auto Slerp = Quaternion::Slerp(QuaternionFrom, QuaternionTo, Factor);
+			return Quaternion::GetAngle(Nlerp, Original) <= angleTolerance && Quaternion::GetAngle(Slerp, Original) <= angleTolerance;
+		}
+		default:
+			return false;
+	}
+}
+
+uint32_t M2Lib::KeyframeReduction::Reduce(KeyArray& Array)
+{
+	if (Array.Count < 3)
+		return Array.Count;
+
+	auto IsEqual = [&Array](uint32_t A, uint32_t B)
+	{
+		return memcmp(Array.ValueData + A * Array.Stride, Array.ValueData + B * Array.Stride, Array.Stride) == 0;
+	};
+
+	std::vector<uint32_t> Kept;
+	Kept.push_back(0);
+
+	if (!Array.Linear || Array.ValueType == EValueType_Flag)
+	{
+		// key equal to both neighbours is reproduced by any interpolation
+		for (uint32_t i = 1; i + 1 < Array.Count; ++i)
+		{
+			if (!IsEqual(i - 1, i) || !IsEqual(i, i + 1))
+				Kept.push_back(i);
+		}
+	}
+	else
+	{
+		// span from last kept key grows while interpolation between its ends reproduces every original key inside.
+		// difference of two polylines is largest at their vertices, so error between keys is bounded as well.
+		uint32_t From = 0;
+		for (uint32_t To = 2; To < Array.Count; ++To)
+		{
+			bool Fits = To - From <= MaxSpanKeys;
+			for (uint32_t i = From + 1; i < To && Fits; ++i)
+				Fits = IsRedundant(Array, From, To, i);
+
+			if (!Fits)
+			{
+				From = To - 1;
+				Kept.push_back(From);
+			}
+		}
+	}
+
+	Kept.push_back(Array.Count - 1);
+	if (Kept.size() == Array.Count)
+		return Array.Count;
+
+	// kept keys only move towards start, so they are copied in place
+	for (uint32_t i = 0; i < Kept.size(); ++i)
+	{
+		Array.TimeData[i] = Array.TimeData[Kept[i]];
+		memmove(Array.ValueData + i * Array.Stride, Array.ValueData + Kept[i] * Array.Stride, Array.Stride);
+	}
+
+	memset(Array.TimeData + Kept.size(), 0, (Array.Count - Kept.size()) * sizeof(uint32_t));
+	memset(Array.ValueData + Kept.size() * Array.Stride, 0, (Array.Count - Kept.size()) * Array.Stride);
+
+	Array.Times->Count = Kept.size();
+	Array.Values->Count = Kept.size();
+
+	return Kept.size();
+}
+
+M2Lib::KeyframeReduction::Report M2Lib::KeyframeReduction::Reduce()
+{
+	// key data referenced from several tracks is reduced once, arrays with same data get same count.
+	// arrays whose time or value bytes overlap any other array in different way are left as is.
+	struct Range
+	{
+		uint8_t const* Begin;
+		uint8_t const* End;
+		uint32_t Array;
+	};
+
+	std::vector<Range> Ranges;
+	Ranges.reserve(keyArrays.size() * 2);
+	for (uint32_t i = 0; i < keyArrays.size(); ++i)
+	{
+		auto& Array = keyArrays[i];
+		auto Times = (uint8_t const*)Array.TimeData;
+		Ranges.push_back({ Times, Times + Array.Count * sizeof(uint32_t), i });
+		Ranges.push_back({ Array.ValueData, Array.ValueData + Array.Count * Array.Stride, i });
+	}
+
+	std::sort(Ranges.begin(), Ranges.end(), [](Range const& a, Range const& b) { return std::less<uint8_t const*>()(a.Begin, b.Begin); });
+
+	auto IsSameData = [this](uint32_t A, uint32_t B)
+	{
+		auto& First = keyArrays[A];
+		auto& Second = keyArrays[B];
+		return First.TimeData == Second.TimeData && First.ValueData == Second.ValueData && First.Count == Second.Count && First.Stride == Second.Stride;
+	};
+
+	// ranges are grouped into clusters of transitively overlapping ones. cluster of equal ranges of arrays with same data is alias group.
+	for (size_t ClusterBegin = 0; ClusterBegin < Ranges.size();)
+	{
+		auto ClusterEnd = ClusterBegin + 1;
+		auto End = Ranges[ClusterBegin].End;
+		while (ClusterEnd < Ranges.size() && std::less<uint8_t const*>()(Ranges[ClusterEnd].Begin, End))
+		{
+			End = std::max(End, Ranges[ClusterEnd].End, std::less<uint8_t const*>());
+			++ClusterEnd;
+		}
+
+		auto& First = Ranges[ClusterBegin];
+		bool Aliases = true;
+		for (auto i = ClusterBegin + 1; i < ClusterEnd && Aliases; ++i)
+			Aliases = Ranges[i].Begin == First.Begin && Ranges[i].End == First.End && IsSameData(First.Array, Ranges[i].Array);
+
+		if (ClusterEnd - ClusterBegin > 1)
+		{
+			uint32_t Owner = First.Array;
+			for (auto i = ClusterBegin; i < ClusterEnd; ++i)
+				Owner = std::min(Owner, Ranges[i].Array);
+
+			for (auto i = ClusterBegin; i < ClusterEnd; ++i)
+			{
+				auto& Array = keyArrays[Ranges[i].Array];
+				if (!Aliases)
+					Array.Shared = true;
+				else if (Ranges[i].Array != Owner)
+					Array.Alias = Owner;
+			}
+		}
+
+		ClusterBegin = ClusterEnd;
+	}
+
+	Report Result;
+	for (auto& Array : keyArrays)
+	{
+		auto& Type = Result.Types[Array.Type];
+		++Type.Tracks;
+		Type.KeysBefore += Array.Count;
+
+		uint32_t Count = Array.Count;
+		if (Array.Alias >= 0 && !Array.Shared)
+		{
+			Count = keyArrays[Array.Alias].Times->Count;
+			Array.Times->Count = Count;
+			Array.Values->Count = Count;
+		}
+		else if (!Array.Shared)
+		{
+			Count = Reduce(Array);
+			Type.UnusedKeyBytes += (Array.Count - Count) * (sizeof(uint32_t) + Array.Stride);
+		}
+
+		Type.KeysAfter += Count;
+	}
+
+	keyArrays.clear();
+
+	return Result;
+}
+
+wchar_t const* M2Lib::KeyframeReduction::GetTrackTypeName(ETrackType Type)
+{
+	switch (Type)
+	{
+		case ETrackType_BonePosition: return L"Bone position";
+		case ETrackType_BoneRotation: return L"Bone rotation";
+		case ETrackType_BoneScale: return L"Bone scale";
+		case ETrackType_Attachment: return L"Attachment";
+		case ETrackType_Light: return L"Light";
+		case ETrackType_Camera: return L"Camera";
+		case ETrackType_ParticleEmitter: return L"Particle emitter";
+		default: return L"Unknown";
+	}
+}
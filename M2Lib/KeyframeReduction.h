@@ -0,0 +1,101 @@
+#pragma once
+
+#include "BaseTypes.h"
+#include "M2Element.h"
+#include "AnimFile.h"
+#include <vector>
+
+namespace M2Lib
+{
+	class DataElement;
+	class M2;
+	class Skeleton;
+
+	// removes animation keys that interpolation between neighbouring keys reproduces within tolerance.
+	// key arrays are compacted in place, counts of their M2Arrays are lowered and freed bytes are zeroed, so element layout is unchanged.
+	// keys of sequences in .anim files are processed if model has loaded their files, modified files are written when model is saved.
+	class KeyframeReduction
+	{
+	public:
+		enum ETrackType
+		{
+			ETrackType_BonePosition,
+			ETrackType_BoneRotation,
+			ETrackType_BoneScale,
+			ETrackType_Attachment,
+			ETrackType_Light,
+			ETrackType_Camera,
+			ETrackType_ParticleEmitter,
+			ETrackType__Count__
+		};
+
+		enum EValueType
+		{
+			EValueType_Float,		// PositionTolerance applies to each component
+			EValueType_Angle,		// float angle in radians, AngleTolerance applies
+			EValueType_Quaternion,	// SKey_SInt16x4, AngleTolerance applies to rotation between original and interpolated key
+			EValueType_Flag,		// visibility and enable keys, one byte each. only keys equal to both neighbours are removed
+		};
+
+		struct Stats
+		{
+			uint32_t Tracks = 0;		// key arrays that were examined
+			uint32_t KeysBefore = 0;
+			uint32_t KeysAfter = 0;
+			uint32_t UnusedKeyBytes = 0;	// time and value bytes of removed keys. they stay in file as zeros, file size is not changed
+		};
+
+		struct Report
+		{
+			Stats Types[ETrackType__Count__];
+
+			Stats GetTotal() const;
+			void Print() const;
+		};
+
+		// PositionTolerance is in model units, AngleTolerance is in radians
+		KeyframeReduction(float PositionTolerance, float AngleTolerance);
+
+		// adds track whose sub arrays and keys are stored in Elements. Stride is size of one key in bytes.
+		// Animations tells which sequences are not in-place, their keys are taken from FileChunk of animation files added by AddModel().
+		void AddTrack(M2Element::M2Track& Track, ETrackType Type, EValueType ValueType, uint32_t Components, uint32_t Stride,
+			DataElement* Elements, uint32_t ElementCount, DataElement* Animations, AnimFile::EAnimChunk FileChunk = AnimFile::EAnimChunk::AFM2);
+
+		// adds bone, attachment, light, camera and particle emitter tracks of model and bone and attachment tracks of its skeleton
+		void AddModel(M2& Model);
+		// adds SKB1 bone and SKA1 attachment tracks, their keys are stored in chunks
+		void AddSkeleton(Skeleton& Source, DataElement* Animations);
+
+		// reduces keys of all added tracks
+		Report Reduce();
+
+		static wchar_t const* GetTrackTypeName(ETrackType Type);
+
+	private:
+		struct KeyArray
+		{
+			M2Array* Times;
+			M2Array* Values;
+			uint32_t* TimeData;
+			uint8_t* ValueData;
+			uint32_t Count;
+
+			ETrackType Type;
+			EValueType ValueType;
+			uint32_t Components;
+			uint32_t Stride;
+			bool Linear;
+
+			bool Shared = false;	// key data overlaps data of another array that is not its alias
+			int32_t Alias = -1;		// index of array with same key data, its result is copied
+		};
+
+		float positionTolerance;
+		float angleTolerance;
+		std::vector<KeyArray> keyArrays;
+		std::vector<AnimFile*> animFiles;	// indexed by sequence, NULL for in-place sequences and missing files
+
+		bool IsRedundant(KeyArray const& Array, uint32_t From, uint32_t To, uint32_t Index) const;
+		uint32_t Reduce(KeyArray& Array);
+	};
+}
@@ -1,69 +1,284 @@
 #include "Logger.h"
 #include <Windows.h>
+#include <cstdarg>
+
+namespace
+{
+	uint32_t const MaxBatchSize = 1024;
+}
+
+M2Lib::Logger::Logger() : Queue(new Slot[QueueSize])
+{
+	CurrentSinks = std::make_shared<Sinks const>();
+	SinkLevels = LOG_NONE;
+	EnabledLevels = LOG_ALL;
+	EnqueuePos = 0;
+	Accepting = false;
+	Producers = 0;
+	Enqueued = 0;
+
+	for (size_t i = 0; i < QueueSize; ++i)
+		Queue[i].Sequence.store(i, std::memory_order_relaxed);
+}
+
+M2Lib::Logger::~Logger()
+{
+	// joining here would deadlock under loader lock, worker is expected to be stopped by Shutdown().
+	// at process exit it is already terminated, so only its handle is released.
+	if (Worker.joinable())
+		Worker.detach();
+}
+
+void M2Lib::Logger::UpdateSinks(Sinks* NewSinks)
+{
+	uint8_t Levels = LOG_NONE;
+	for (auto& itr : NewSinks->Callbacks)
+		if (!itr.second.empty())
+			Levels |= itr.first;
+	for (auto& itr : NewSinks->BatchCallbacks)
+		Levels |= itr.first;
+
+	bool NeedWorker = !NewSinks->BatchCallbacks.empty();
+
+	// messages queued so far are delivered to batch sinks that are being removed
+	if (NewSinks->BatchCallbacks.size() < std::atomic_load(&CurrentSinks)->BatchCallbacks.size())
+		Flush();
+
+	// worker must accept messages before first thread sees new batch sink
+	if (NeedWorker && !Worker.joinable())
+	{
+		Worker = std::thread(&Logger::WorkerLoop, this);
+		Accepting = true;
+	}
+
+	std::atomic_store(&CurrentSinks, std::shared_ptr<Sinks const>(NewSinks));
+	SinkLevels = Levels;
+
+	// threads may still log through old snapshot, StopWorker waits for them
+	if (!NeedWorker && Worker.joinable())
+		StopWorker();
+}
 
 void M2Lib::Logger::AttachCallback(uint8_t logLevel, LoggerCallback callback)
 {
+	std::lock_guard<std::mutex> lock(SinksLock);
+
+	auto NewSinks = new Sinks(*std::atomic_load(&CurrentSinks));
 	for (auto level : { LOG_INFO, LOG_ERROR, LOG_WARNING, LOG_CUSTOM })
 		if (logLevel & level)
-			AttachedCallbacks[level].push_back(callback);
+			NewSinks->Callbacks[level].push_back(callback);
+
+	UpdateSinks(NewSinks);
 }
 
 void M2Lib::Logger::DetachCallback(uint8_t logLevel, LoggerCallback callback)
 {
+	std::lock_guard<std::mutex> lock(SinksLock);
+
+	auto NewSinks = new Sinks(*std::atomic_load(&CurrentSinks));
 	for (auto level : { LOG_INFO, LOG_ERROR, LOG_WARNING, LOG_CUSTOM })
 	{
-		auto itr = AttachedCallbacks.find(level);
-		if (itr == AttachedCallbacks.end())
+		auto itr = NewSinks->Callbacks.find(level);
+		if (itr == NewSinks->Callbacks.end())
 			continue;
 
 		itr->second.remove(callback);
 	}
+
+	UpdateSinks(NewSinks);
 }
 
-void M2Lib::Logger::LogInfo(wchar_t const* format, ...)
+void M2Lib::Logger::AttachBatchCallback(uint8_t logLevel, LoggerBatchCallback callback)
 {
-	va_list args;
-	va_start(args, format);
-	Log(LOG_INFO, format, args);
-	va_end(args);
+	std::lock_guard<std::mutex> lock(SinksLock);
+
+	auto NewSinks = new Sinks(*std::atomic_load(&CurrentSinks));
+	NewSinks->BatchCallbacks.emplace_back(logLevel & LOG_ALL, callback);
+
+	UpdateSinks(NewSinks);
 }
 
-void M2Lib::Logger::LogError(wchar_t const* format, ...)
+void M2Lib::Logger::DetachBatchCallback(LoggerBatchCallback callback)
 {
-	va_list args;
-	va_start(args, format);
-	Log(LOG_ERROR, format, args);
-	va_end(args);
+	std::lock_guard<std::mutex> lock(SinksLock);
+
+	auto NewSinks = new Sinks(*std::atomic_load(&CurrentSinks));
+	NewSinks->BatchCallbacks.remove_if([callback](std::pair<uint8_t, LoggerBatchCallback> const& sink) { return sink.second == callback; });
+
+	UpdateSinks(NewSinks);
 }
 
-void M2Lib::Logger::LogWarning(wchar_t const* format, ...)
+void M2Lib::Logger::Log(int LogLevel, wchar_t const* format, ...)
 {
+	auto CurrentSinks = std::atomic_load(&this->CurrentSinks);
+
+	wchar_t text[4096];
+
 	va_list args;
 	va_start(args, format);
-	Log(LOG_WARNING, format, args);
+	vswprintf_s(text, sizeof(text) / sizeof(text[0]), format, args);
 	va_end(args);
+
+	auto itr = CurrentSinks->Callbacks.find(LogLevel);
+	if (itr != CurrentSinks->Callbacks.end() && !itr->second.empty())
+	{
+		std::lock_guard<std::mutex> lock(CallbackLock);
+		for (auto callback : itr->second)
+			callback(LogLevel, text);
+	}
+
+	for (auto& sink : CurrentSinks->BatchCallbacks)
+	{
+		if (sink.first & LogLevel)
+		{
+			// snapshot may be older than detach that is stopping worker, message must not be queued after worker has drained queue
+			++Producers;
+			if (Accepting)
+				Enqueue(LogLevel, text);
+			--Producers;
+			break;
+		}
+	}
 }
 
-void M2Lib::Logger::LogCustom(wchar_t const* format, ...)
+void M2Lib::Logger::Enqueue(uint8_t Level, wchar_t const* Text)
 {
-	va_list args;
-	va_start(args, format);
-	Log(LOG_CUSTOM, format, args);
-	va_end(args);
+	// bounded multi-producer queue, each slot sequence tells whether slot is free for given position
+	size_t Position = EnqueuePos.load(std::memory_order_relaxed);
+	Slot* slot;
+	for (;;)
+	{
+		slot = &Queue[Position & (QueueSize - 1)];
+		size_t Sequence = slot->Sequence.load(std::memory_order_acquire);
+		intptr_t Diff = (intptr_t)Sequence - (intptr_t)Position;
+		if (Diff == 0)
+		{
+			if (EnqueuePos.compare_exchange_weak(Position, Position + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (Diff < 0)
+		{
+			// queue is full, let logger thread catch up
+			WorkerCondition.notify_one();
+			std::this_thread::yield();
+			Position = EnqueuePos.load(std::memory_order_relaxed);
+		}
+		else
+			Position = EnqueuePos.load(std::memory_order_relaxed);
+	}
+
+	slot->Level = Level;
+	slot->Text = Text;
+	slot->Sequence.store(Position + 1, std::memory_order_release);
+
+	++Enqueued;
+	WorkerCondition.notify_one();
+}
+
+void M2Lib::Logger::WorkerLoop()
+{
+	std::vector<uint8_t> Levels;
+	std::vector<std::wstring> Texts;
+	std::vector<uint8_t> BatchLevels;
+	std::vector<wchar_t const*> BatchTexts;
+
+	for (;;)
+	{
+		Levels.clear();
+		Texts.clear();
+
+		while (Levels.size() < MaxBatchSize)
+		{
+			auto& slot = Queue[DequeuePos & (QueueSize - 1)];
+			if (slot.Sequence.load(std::memory_order_acquire) != DequeuePos + 1)
+				break;
+
+			Levels.push_back(slot.Level);
+			Texts.push_back(std::move(slot.Text));
+			slot.Sequence.store(DequeuePos + QueueSize, std::memory_order_release);
+			++DequeuePos;
+		}
+
+		if (Levels.empty())
+		{
+			std::unique_lock<std::mutex> lock(WorkerLock);
+			if (Stopping)
+				return;
+
+			// producers notify without lock, timeout covers missed wakeups
+			WorkerCondition.wait_for(lock, std::chrono::milliseconds(10));
+			continue;
+		}
+
+		auto CurrentSinks = std::atomic_load(&this->CurrentSinks);
+		for (auto& sink : CurrentSinks->BatchCallbacks)
+		{
+			BatchLevels.clear();
+			BatchTexts.clear();
+			for (uint32_t i = 0; i < Levels.size(); ++i)
+			{
+				if (!(sink.first & Levels[i]))
+					continue;
+
+				BatchLevels.push_back(Levels[i]);
+				BatchTexts.push_back(Texts[i].c_str());
+			}
+
+			if (!BatchLevels.empty())
+				sink.second(BatchLevels.size(), BatchLevels.data(), BatchTexts.data());
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(WorkerLock);
+			Delivered += Levels.size();
+		}
+		FlushCondition.notify_all();
+	}
 }
 
-void M2Lib::Logger::Log(int LogLevel, wchar_t const* format, va_list args)
+void M2Lib::Logger::StopWorker()
 {
-	auto itr = AttachedCallbacks.find(LogLevel);
-	if (itr == AttachedCallbacks.end())
+	if (!Worker.joinable())
 		return;
 
-	wchar_t text[4096];
+	// after this no message is queued, producers that checked it earlier are still served by running worker
+	Accepting = false;
+	while (Producers)
+		std::this_thread::yield();
 
-	vswprintf_s(text, sizeof(text) / sizeof(text[0]), format, args);
+	{
+		std::lock_guard<std::mutex> lock(WorkerLock);
+		Stopping = true;
+	}
+	WorkerCondition.notify_one();
+
+	// worker drains queue before it exits
+	Worker.join();
+	Stopping = false;
+}
 
-	for (auto callback : itr->second)
-		callback(LogLevel, text);
+void M2Lib::Logger::Flush()
+{
+	uint64_t Target = Enqueued;
+
+	std::unique_lock<std::mutex> lock(WorkerLock);
+	// batch callback that logs or changes sinks can't wait for itself
+	if (!Worker.joinable() || Worker.get_id() == std::this_thread::get_id())
+		return;
+
+	WorkerCondition.notify_one();
+	FlushCondition.wait(lock, [this, Target] { return Delivered >= Target; });
+}
+
+void M2Lib::Logger::Shutdown()
+{
+	std::lock_guard<std::mutex> lock(SinksLock);
+
+	// without worker nothing would free queue slots, so batch sinks can't stay attached
+	auto NewSinks = new Sinks(*std::atomic_load(&CurrentSinks));
+	NewSinks->BatchCallbacks.clear();
+
+	UpdateSinks(NewSinks);
 }
 
 void M2Lib::AttachLoggerCallback(uint8_t logLevel, LoggerCallback callback)
@@ -75,3 +290,28 @@ void M2Lib::DetachLoggerCallback(uint8_t logLevel, LoggerCallback callback)
 {
 	sLogger.DetachCallback(logLevel, callback);
 }
+
+void M2Lib::AttachLoggerBatchCallback(uint8_t logLevel, LoggerBatchCallback callback)
+{
+	sLogger.AttachBatchCallback(logLevel, callback);
+}
+
+void M2Lib::DetachLoggerBatchCallback(LoggerBatchCallback callback)
+{
+	sLogger.DetachBatchCallback(callback);
+}
+
+void M2Lib::SetLoggerEnabledLevels(uint8_t logLevel)
+{
+	sLogger.SetEnabledLevels(logLevel);
+}
+
+void M2Lib::FlushLogger()
+{
+	sLogger.Flush();
+}
+
+void M2Lib::ShutdownLogger()
+{
+	sLogger.Shutdown();
+}
@@ -3,6 +3,18 @@
 #include "BaseTypes.h"
 #include <list>
 #include <map>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <memory>
+
+// levels that are compiled in, messages of other levels are removed at compile time
+#ifndef M2LIB_LOG_LEVELS
+# define M2LIB_LOG_LEVELS M2Lib::LOG_ALL
+#endif
 
 namespace M2Lib
 {
@@ -19,14 +31,58 @@ namespace M2Lib
 	};
 
 	typedef void(__stdcall* LoggerCallback)(uint8_t LogLevel, wchar_t const*);
+	// receives Count messages at once, called from logger thread
+	typedef void(__stdcall* LoggerBatchCallback)(uint32_t Count, uint8_t const* LogLevels, wchar_t const* const* Messages);
 
+	// messages are formatted only if level is compiled in, enabled and has attached sink.
+	// plain callbacks are called synchronously, since GUI relies on it to show message boxes.
+	// batch callbacks are fed from lock-free multi-producer ring buffer by background thread.
+	// background thread must be stopped with Shutdown() before library is unloaded, it can't be joined from static destructor under loader lock.
 	class Logger
 	{
-		Logger() = default;
+		Logger();
+
+		struct Sinks
+		{
+			std::map<uint8_t, std::list<LoggerCallback>> Callbacks;
+			std::list<std::pair<uint8_t, LoggerBatchCallback>> BatchCallbacks;
+		};
+
+		// sink lists are replaced as a whole, logging threads only take a snapshot
+		std::shared_ptr<Sinks const> CurrentSinks;
+		std::mutex SinksLock;
+		std::mutex CallbackLock;		// serializes synchronous callbacks
+
+		std::atomic<uint8_t> SinkLevels;		// levels that have at least one sink
+		std::atomic<uint8_t> EnabledLevels;	// runtime filter
+
+		struct Slot
+		{
+			std::atomic<size_t> Sequence;
+			uint8_t Level;
+			std::wstring Text;
+		};
 
-		std::map<uint8_t, std::list<LoggerCallback>> AttachedCallbacks;
+		static size_t const QueueSize = 4096;	// power of 2
+		std::unique_ptr<Slot[]> Queue;
+		std::atomic<size_t> EnqueuePos;
+		size_t DequeuePos = 0;
 
-		void Log(int LogLevel, wchar_t const* format, va_list args);
+		std::thread Worker;
+		std::mutex WorkerLock;
+		std::condition_variable WorkerCondition;
+		std::condition_variable FlushCondition;
+		bool Stopping = false;
+		std::atomic<bool> Accepting;			// false once worker is being stopped, late messages are dropped instead of stranded in queue
+		std::atomic<uint32_t> Producers;		// threads that are enqueueing right now, worker is stopped only after they finish
+		std::atomic<uint64_t> Enqueued;
+		uint64_t Delivered = 0;
+
+		void Log(int LogLevel, wchar_t const* format, ...);
+		void Enqueue(uint8_t Level, wchar_t const* Text);
+		void WorkerLoop();
+		void UpdateSinks(Sinks* NewSinks);
+		void StopWorker();
 
 	public:
 		static Logger& getInstance()
@@ -35,17 +91,44 @@ namespace M2Lib
 			return l;
 		}
 
+		~Logger();
+
 		void AttachCallback(uint8_t logLevel, LoggerCallback callback);
 		void DetachCallback(uint8_t logLevel, LoggerCallback callback);
+		void AttachBatchCallback(uint8_t logLevel, LoggerBatchCallback callback);
+		void DetachBatchCallback(LoggerBatchCallback callback);
+
+		// runtime filter of levels, all levels are enabled by default
+		void SetEnabledLevels(uint8_t logLevel) { EnabledLevels = logLevel; }
+
+		// true if message of level would reach any sink. use it to skip building expensive diagnostic output.
+		bool IsEnabled(uint8_t logLevel) const
+		{
+			return (M2LIB_LOG_LEVELS & logLevel) && (SinkLevels & EnabledLevels & logLevel);
+		}
+
+		// waits until all queued messages are delivered to batch callbacks
+		void Flush();
+		// delivers queued messages, detaches batch callbacks and stops background thread. thread is started again by next batch attach.
+		void Shutdown();
 
-		void LogInfo(wchar_t const* format, ...);
-		void LogError(wchar_t const* format, ...);
-		void LogWarning(wchar_t const* format, ...);
-		void LogCustom(wchar_t const* format, ...);
+		template <class... Args>
+		void LogInfo(wchar_t const* format, Args... args) { if (IsEnabled(LOG_INFO)) Log(LOG_INFO, format, args...); }
+		template <class... Args>
+		void LogError(wchar_t const* format, Args... args) { if (IsEnabled(LOG_ERROR)) Log(LOG_ERROR, format, args...); }
+		template <class... Args>
+		void LogWarning(wchar_t const* format, Args... args) { if (IsEnabled(LOG_WARNING)) Log(LOG_WARNING, format, args...); }
+		template <class... Args>
+		void LogCustom(wchar_t const* format, Args... args) { if (IsEnabled(LOG_CUSTOM)) Log(LOG_CUSTOM, format, args...); }
 	};
 
 	M2LIB_API void __cdecl AttachLoggerCallback(uint8_t logLevel, LoggerCallback callback);
 	M2LIB_API void __cdecl DetachLoggerCallback(uint8_t logLevel, LoggerCallback callback);
+	M2LIB_API void __cdecl AttachLoggerBatchCallback(uint8_t logLevel, LoggerBatchCallback callback);
+	M2LIB_API void __cdecl DetachLoggerBatchCallback(LoggerBatchCallback callback);
+	M2LIB_API void __cdecl SetLoggerEnabledLevels(uint8_t logLevel);
+	M2LIB_API void __cdecl FlushLogger();
+	M2LIB_API void __cdecl ShutdownLogger();
 }
 
 #define sLogger M2Lib::Logger::getInstance()
@@ -3,13 +3,27 @@
 #include "M2SkinBuilder.h"
 #include "Settings.h"
 #include "Skeleton.h"
+#include "AnimFile.h"
 #include "FileStorage.h"
+#include "FileCopy.h"
+#include "KeyframeReduction.h"
+#include "AnimationSampler.h"
 #include "Logger.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
 #include <sstream>
 #include <set>
 #include "StringHelpers.h"
 #include "StringHash.h"
+#include "ThreadPool.h"
+#include "FilePrefetch.h"
+#include "SkeletonCache.h"
+#include "GatherWriter.h"
+#include "BuildCache.h"
+#include "ContentHash.h"
+#include <algorithm>
 #include <filesystem>
+#include <chrono>
 
 using namespace M2Lib::M2Element;
 using namespace M2Lib::M2Chunk;
@@ -75,11 +89,10 @@ M2Lib::M2::M2(M2Lib::Settings* Settings)
 M2Lib::M2::~M2()
 {
 	delete pInM2I;
-	for (auto& Chunk : Chunks)
-		delete Chunk.second;
-	Chunks.clear();
 	delete Skeleton;
 	delete ParentSkeleton;
+	for (auto& itr : animFiles)
+		delete itr.second.File;
 
 	for (uint32_t i = 0; i < SKIN_COUNT; ++i)
 		delete Skins[i];
@@ -92,6 +105,67 @@ M2Lib::M2::~M2()
 	customFileInfosByNameHash.clear();
 }
 
+M2Lib::M2* M2Lib::M2::Clone() const
+{
+	m2lib_assert(!pInM2I && "Cloning of model with imported M2I is not supported");
+
+	auto SettingsCopy = Settings;
+	auto Result = new M2(&SettingsCopy);
+
+	Result->_FileName = _FileName;
+	Result->Header = Header;
+	// element copies share data buffers
+	for (uint32_t i = 0; i < EElement__CountM2__; ++i)
+		Result->Elements[i] = Elements[i];
+
+	Result->Chunks = Chunks;
+
+	for (uint32_t i = 0; i < SKIN_COUNT; ++i)
+		if (Skins[i])
+			Result->Skins[i] = Skins[i]->Clone(Result);
+	Result->OriginalSkinCount = OriginalSkinCount;
+	Result->hasLodSkins = hasLodSkins;
+	Result->lazy = lazy;
+	Result->buildCache = buildCache;
+
+	if (Skeleton)
+		Result->Skeleton = Skeleton->Clone();
+	if (ParentSkeleton)
+		Result->ParentSkeleton = ParentSkeleton->Clone();
+	for (auto& itr : animFiles)
+	{
+		auto& Entry = Result->animFiles[itr.first];
+		Entry.FileDataId = itr.second.FileDataId;
+		if (itr.second.File)
+			Entry.File = itr.second.File->Clone();
+	}
+	if (replaceM2)
+		Result->replaceM2 = replaceM2->Clone();
+
+	Result->needRemapReferences = needRemapReferences;
+	Result->remapPath = remapPath;
+	Result->remapCopyFiles = remapCopyFiles;
+	Result->remapHardLinks = remapHardLinks;
+	Result->needRemoveTXIDChunk = needRemoveTXIDChunk;
+	Result->normalizationRules = normalizationRules;
+	Result->m_OriginalModelChunkSize = m_OriginalModelChunkSize;
+	Result->saveMappingsCallback = saveMappingsCallback;
+
+	// custom mappings are owned by model, copy them
+	Result->currentCustomFileDataId = currentCustomFileDataId;
+	std::map<FileInfo const*, FileInfo const*> CustomInfoRemap;
+	for (auto& itr : customFileInfosByFileDataId)
+	{
+		auto info = new FileInfo(itr.second->FileDataId, itr.second->Path.c_str());
+		CustomInfoRemap[itr.second] = info;
+		Result->customFileInfosByFileDataId[itr.first] = info;
+	}
+	for (auto& itr : customFileInfosByNameHash)
+		Result->customFileInfosByNameHash[itr.first] = CustomInfoRemap[itr.second];
+
+	return Result;
+}
+
 uint32_t M2Lib::M2::GetHeaderSize() const
 {
 	return Header.IsLongHeader() && GetExpansion() >= Expansion::Cataclysm ? sizeof(Header) : sizeof(Header) - 8;
@@ -99,6 +173,8 @@ uint32_t M2Lib::M2::GetHeaderSize() const
 
 M2Lib::EError M2Lib::M2::Load(const wchar_t* FileName)
 {
+	M2LIB_PROFILE_SCOPE("M2::Load");
+
 	// check path
 	if (!FileName)
 	{
@@ -107,6 +183,8 @@ M2Lib::EError M2Lib::M2::Load(const wchar_t* FileName)
 	}
 
 	_FileName = FileName;
+	// import deferred for previous model must not be applied to this one
+	buildCache = BuildCacheState();
 
 	// open file stream
 	std::fstream FileStream;
@@ -126,84 +204,62 @@ M2Lib::EError M2Lib::M2::Load(const wchar_t* FileName)
 
 	sLogger.LogInfo(L"File size: %u", FileSize);
 
-	struct PostChunkInfo
+	// file is read at once and chunks stay views into it until they are accessed
+	auto FileData = std::make_shared<std::vector<uint8_t>>(FileSize);
+	FileStream.read((char*)FileData->data(), FileSize);
+	if (FileStream.fail())
 	{
-		PostChunkInfo() { }
-		PostChunkInfo(uint32_t Offs, uint32_t Size)
-		{
-			this->Offs = Offs;
-			this->Size = Size;
-		}
-
-		uint32_t Offs;
-		uint32_t Size;
-	};
-
-	std::map<EM2Chunk, PostChunkInfo> PostProcessChunks;
+		sLogger.LogError(L"Error: Failed to read file %s", FileName);
+		return EError_FailedToLoadM2_CouldNotOpenFile;
+	}
+	FileStream.close();
 
-	while (FileStream.tellg() < FileSize)
+	auto Data = FileData->data();
+	for (uint32_t Offset = 0; FileSize - Offset >= 8;)
 	{
 		uint32_t ChunkId;
 		uint32_t ChunkSize;
 
-		FileStream.read((char*)&ChunkId, sizeof(ChunkId));
-		FileStream.read((char*)&ChunkSize, sizeof(ChunkSize));
+		memcpy(&ChunkId, Data + Offset, sizeof(ChunkId));
+		memcpy(&ChunkSize, Data + Offset + 4, sizeof(ChunkSize));
 
 		// support pre-legion M2
 		if (REVERSE_CC(ChunkId) == 'MD20')
 		{
 			sLogger.LogInfo(L"Detected pre-Legion mode (unchunked)");
-			auto Chunk = new MD21Chunk();
-			FileStream.seekg(0, std::ios::beg);
-			Chunk->Load(FileStream, FileSize);
-			Chunks[EM2Chunk::Model] = Chunk;
+			Chunks.AddView((uint32_t)EM2Chunk::Model, FileData, Data, FileSize);
 			break;
 		}
-		else
-		{
-			ChunkBase* Chunk = NULL;
-			auto eChunk = (EM2Chunk)REVERSE_CC(ChunkId);
 
-			sLogger.LogInfo(L"Loaded '%s' M2 chunk, size %u", ChunkIdToStr(ChunkId, false).c_str(), ChunkSize);
-			switch (eChunk)
-			{
-				case EM2Chunk::Model: Chunk = new MD21Chunk(); break;
-				case EM2Chunk::Physic: Chunk = new PFIDChunk(); break;
-				case EM2Chunk::Animation: Chunk = new AFIDChunk(); break;
-				case EM2Chunk::Bone: Chunk = new BFIDChunk(); break;
-				case EM2Chunk::Skeleton: Chunk = new SKIDChunk(); break;
-				case EM2Chunk::Skin: Chunk = new SFIDChunk(); break;
-				case EM2Chunk::Texture: Chunk = new TXIDChunk(); break;
-				case EM2Chunk::ParticleGeometryModels: Chunk = new GPIDChunk(); break;
-				case EM2Chunk::ParticleRecursiveModel: Chunk = new RPIDChunk(); break;
-				case EM2Chunk::TXAC:
-					PostProcessChunks[eChunk] = { (uint32_t)FileStream.tellg(), ChunkSize };
-					FileStream.seekg(ChunkSize, std::ios::cur);
-					continue;
-				default:
-					Chunk = new RawChunk();
-					break;
-			}
+		Offset += 8;
+		if (ChunkSize > FileSize - Offset)
+		{
+			sLogger.LogWarning(L"Warning: '%s' M2 chunk size %u exceeds file size, chunk is truncated", ChunkIdToStr(ChunkId, false).c_str(), ChunkSize);
+			ChunkSize = FileSize - Offset;
+		}
 
-			uint32_t savePos = (uint32_t)FileStream.tellg();
-			Chunk->Load(FileStream, ChunkSize);
-			FileStream.seekg(savePos + ChunkSize, std::ios::beg);
+		sLogger.LogInfo(L"Found '%s' M2 chunk, size %u", ChunkIdToStr(ChunkId, false).c_str(), ChunkSize);
 
-			Chunks[eChunk] = Chunk;
-		}
+		Chunks.AddView(REVERSE_CC(ChunkId), FileData, Data + Offset, ChunkSize);
+		Offset += ChunkSize;
 	}
 
-	auto ModelChunk = (MD21Chunk*)GetChunk(EM2Chunk::Model);
-	if (!ModelChunk)
+	// model chunk is never parsed, header and elements are read from its view
+	uint8_t const* ModelData;
+	if (!Chunks.GetView((uint32_t)EM2Chunk::Model, ModelData, m_OriginalModelChunkSize))
 	{
 		sLogger.LogError(L"Error: '%s' chunk not found in model", ChunkIdToStr((uint32_t)EM2Chunk::Model, true).c_str());
 		return EError_FailedToLoadM2_FileCorrupt;
 	}
 
-	m_OriginalModelChunkSize = ModelChunk->RawData.size();
+	if (m_OriginalModelChunkSize < sizeof(Header))
+	{
+		sLogger.LogError(L"Error: '%s' chunk is too small", ChunkIdToStr((uint32_t)EM2Chunk::Model, true).c_str());
+		return EError_FailedToLoadM2_FileCorrupt;
+	}
 
 	// load header
-	memcpy(&Header, ModelChunk->RawData.data(), sizeof(Header));
+	memcpy(&Header, ModelData, sizeof(Header));
 	if (!Header.IsLongHeader() || GetExpansion() < Expansion::Cataclysm)
 	{
 		sLogger.LogInfo(L"Short header detected");
@@ -217,6 +273,38 @@ M2Lib::EError M2Lib::M2::Load(const wchar_t* FileName)
 		return EError_FailedToLoadM2_VersionNotSupported;
 	}
 
+	if ((Header.Elements.nSkin == 0) || (Header.Elements.nSkin > SKIN_COUNT - LOD_SKIN_MAX_COUNT))
+	{
+		sLogger.LogError(L"Error: Unsupported number of skins in model: %u", Header.Elements.nSkin);
+		return EError_FailedToLoadM2_FileCorrupt;
+	}
+
+	// resolve all companion files up front and read them in background while model elements are being parsed
+	FilePrefetch Prefetch;
+	std::wstring SkinFileNames[SKIN_COUNT];
+	std::wstring FileNameSkeleton;
+
+	if (!lazy.Enabled)
+	{
+		for (uint32_t i = 0; i < Header.Elements.nSkin; ++i)
+			if (GetFileSkin(SkinFileNames[i], _FileName, i, false))
+				Prefetch.Request(SkinFileNames[i]);
+
+		hasLodSkins = false;
+		auto skinChunk = (M2Chunk::SFIDChunk*)GetChunk(EM2Chunk::Skin);
+		if (skinChunk && skinChunk->SkinsFileDataIds.size() > Header.Elements.nSkin)
+			hasLodSkins = true;
+		else
+		{
+			for (uint32_t i = SKIN_COUNT - LOD_SKIN_MAX_COUNT; i < SKIN_COUNT; ++i)
+				if (GetFileSkin(SkinFileNames[i], _FileName, i, false))
+					Prefetch.Request(SkinFileNames[i]);
+		}
+
+		if (GetFileSkeleton(FileNameSkeleton, _FileName, false))
+			Prefetch.Request(FileNameSkeleton);
+	}
+
 	// fill elements header data
 	m_LoadElements_CopyHeaderToElements();
 	m_LoadElements_FindSizes(m_OriginalModelChunkSize);
@@ -227,75 +315,36 @@ M2Lib::EError M2Lib::M2::Load(const wchar_t* FileName)
 	for (uint32_t i = 0; i < EElement__CountM2__; ++i)
 	{
 		Elements[i].Align = 16;
-		if (!Elements[i].Load(ModelChunk->RawData.data(), 0))
+		if (!Elements[i].Load(ModelData, 0))
 		{
 			sLogger.LogError(L"Error: Failed to load M2 element #%u", i);
 			return EError_FailedToLoadM2_FileCorrupt;
 		}
 	}
 
-	// load skins
-	if ((Header.Elements.nSkin == 0) || (Header.Elements.nSkin > SKIN_COUNT - LOD_SKIN_MAX_COUNT))
-	{
-		sLogger.LogError(L"Error: Unsupported number of skins in model: %u", Header.Elements.nSkin);
-		return EError_FailedToLoadM2_FileCorrupt;
-	}
+	// TXAC entry counts are taken from header, so it can't be created by chunk table
+	if (Chunks.Contains((uint32_t)EM2Chunk::TXAC))
+		Chunks.Parse((uint32_t)EM2Chunk::TXAC, new TXACChunk(Header.Elements.nTextureFlags, Header.Elements.nParticleEmitter));
 
-	if (auto chunk = (SFIDChunk*)GetChunk(EM2Chunk::Skin))
+	if (lazy.Enabled)
 	{
-		sLogger.LogInfo(L"Used skin files:");
-		for (auto fileDataId : chunk->SkinsFileDataIds)
-			sLogger.LogInfo(L"\t[%u] %s", fileDataId, PathInfo(fileDataId));
-	}
+		for (uint32_t i = 0; i < Header.Elements.nSkin; ++i)
+			lazy.SkinPending[i] = true;
+		lazy.LodSkinsPending = true;
+		lazy.SkeletonPending = true;
 
-	auto Error = LoadSkins();
-	if (Error != EError::EError_OK)
-		return Error;
-
-	hasLodSkins = false;
-	auto skinChunk = (M2Chunk::SFIDChunk*)GetChunk(EM2Chunk::Skin);
-	if (skinChunk && skinChunk->SkinsFileDataIds.size() > Header.Elements.nSkin)
-		hasLodSkins = true;
-	else
-	{
-		for (int i = 0; i < LOD_SKIN_MAX_COUNT; ++i)
-		{
-			std::wstring FileNameSkin;
-			if (!GetFileSkin(FileNameSkin, _FileName, SKIN_COUNT - LOD_SKIN_MAX_COUNT + i, false))
-				continue;
+		sLogger.LogInfo(L"Lazy loading enabled, skins and skeleton will be loaded on first access");
+		sLogger.LogInfo(L"Finished loading M2");
 
-			sLogger.LogInfo(L"Loading skin '%s'...", FileNameSkin);
-			M2Skin LoDSkin(this);
-			if (EError Error = LoDSkin.Load(FileNameSkin.c_str()))
-			{
-				if (Error == EError_FailedToLoadSKIN_CouldNotOpenFile)
-					continue;
-
-				sLogger.LogError(L"Error: Failed to load #%u lod skin %s", i, FileNameSkin);
-				return Error;
-			}
-			else
-			{
-				hasLodSkins = true;
-				break;
-			}
-		}
+		return EError_OK;
 	}
 
-	for (auto& PostChunk : PostProcessChunks)
+	// load skins
+	if (auto chunk = sLogger.IsEnabled(LOG_INFO) ? (SFIDChunk*)GetChunk(EM2Chunk::Skin) : NULL)
 	{
-		FileStream.seekg(PostChunk.second.Offs, std::ios::beg);
-		ChunkBase* Chunk = NULL;
-		switch (PostChunk.first)
-		{
-			case EM2Chunk::TXAC:
-				Chunk = new TXACChunk(Header.Elements.nTextureFlags, Header.Elements.nParticleEmitter);
-				break;
-			default: Chunk = new RawChunk(); break;
-		}
-
-		Chunk->Load(FileStream, PostChunk.second.Size);
-		Chunks[PostChunk.first] = Chunk;
+		sLogger.LogInfo(L"Used skin files:");
+		for (auto fileDataId : chunk->SkinsFileDataIds)
+			sLogger.LogInfo(L"\t[%u] %s", fileDataId, PathInfo(fileDataId));
 	}
 
 	if (auto chunk = (SKIDChunk*)GetChunk(EM2Chunk::Skeleton))
@@ -304,7 +353,20 @@ M2Lib::EError M2Lib::M2::Load(const wchar_t* FileName)
 		sLogger.LogInfo(L"\t[%u] %s", chunk->SkeletonFileDataId, PathInfo(chunk->SkeletonFileDataId));
 	}
 
-	Error = LoadSkeleton();
+	// skeleton goes first, so parent skeleton is read in background while skins are parsed
+	auto Error = LoadSkeleton(FileNameSkeleton, Prefetch);
+	if (Error != EError_OK)
+		return Error;
+
+	Error = LoadSkins(SkinFileNames, Prefetch);
+	if (Error != EError::EError_OK)
+		return Error;
+
+	Error = LoadLodSkins(SkinFileNames, Prefetch);
+	if (Error != EError::EError_OK)
+		return Error;
+
+	Error = LoadParentSkeleton(Prefetch);
 	if (Error != EError_OK)
 		return Error;
 
@@ -320,29 +382,36 @@ M2Lib::EError M2Lib::M2::Load(const wchar_t* FileName)
 
 M2Lib::EError M2Lib::M2::SetReplaceM2(const wchar_t* FileName)
 {
+	// replace model applies to import that comes after it
+	if (EError Error = LoadPendingImport())
+		return Error;
+
 	auto replaceM2 = new M2();
 	auto Error = replaceM2->Load(FileName);
 	if (Error != EError_OK)
 		return Error;
 
 	this->replaceM2 = replaceM2;
+	InvalidateBuildCache();
 	return EError_OK;
 }
 
-M2Lib::EError M2Lib::M2::LoadSkeleton()
+M2Lib::EError M2Lib::M2::LoadSkeleton(std::wstring const& FileNameSkeleton, FilePrefetch& Prefetch)
 {
-	std::wstring FileNameSkeleton;
-	if (!GetFileSkeleton(FileNameSkeleton, _FileName, false))
+	M2LIB_PROFILE_SCOPE("M2::LoadSkeleton");
+
+	if (FileNameSkeleton.empty())
 		return EError_OK;
 
-	if (!std::filesystem::exists(FileNameSkeleton))
+	auto FileData = Prefetch.Get(FileNameSkeleton);
+	if (!FileData && !std::filesystem::exists(FileNameSkeleton))
 	{
 		sLogger.LogError(L"Error: Skeleton file %s not found!", FileNameSkeleton);
 		return EError_FailedToLoadSkeleton_CouldNotOpenFile;
 	}
 
 	auto sk = new M2Lib::Skeleton();
-	auto loadResult = sk->Load(FileNameSkeleton.c_str());
+	auto loadResult = sk->Load(FileNameSkeleton.c_str(), FileData);
 	if (loadResult != EError_OK)
 	{
 		if (GetChunk(EM2Chunk::Skeleton))
@@ -354,42 +423,73 @@ M2Lib::EError M2Lib::M2::LoadSkeleton()
 
 	sLogger.LogInfo(L"Sekeleton file detected and loaded");
 	Skeleton = sk;
+	CountLazyRead(L"skeleton", FileNameSkeleton);
+
+	// start reading parent skeleton, it is taken by LoadParentSkeleton once other parts are parsed
+	uint32_t ParentFileDataId;
+	std::wstring ParentFileName;
+	if (GetParentSkeletonSource(ParentFileDataId, ParentFileName) && !SkeletonCache::GetInstance()->IsCached(ParentFileDataId, ParentFileName))
+		Prefetch.Request(ParentFileName);
+
+	return EError_OK;
+}
+
+bool M2Lib::M2::GetParentSkeletonSource(uint32_t& FileDataId, std::wstring& FileName)
+{
+	auto chunk = Skeleton ? (SkeletonChunk::SKPDChunk*)Skeleton->GetChunk(SkeletonChunk::ESkeletonChunk::SKPD) : NULL;
+	if (!chunk)
+		return false;
+
+	auto info = GetFileInfoByFileDataId(chunk->Data.ParentSkeletonFileId);
+	if (!info)
+		return false;
+
+	std::filesystem::path ParentSkeletonPath;
+	if (wcslen(Settings.WorkingDirectory))
+		ParentSkeletonPath = std::filesystem::path(Settings.WorkingDirectory) / info->Path;
+	else
+		ParentSkeletonPath = std::filesystem::path(_FileName).parent_path() / std::filesystem::path(info->Path).filename();
+
+	FileDataId = chunk->Data.ParentSkeletonFileId;
+	FileName = ParentSkeletonPath.wstring();
 
-	if (auto chunk = (SkeletonChunk::SKPDChunk*)Skeleton->GetChunk(SkeletonChunk::ESkeletonChunk::SKPD))
+	return true;
+}
+
+M2Lib::EError M2Lib::M2::LoadParentSkeleton(FilePrefetch& Prefetch)
+{
+	M2LIB_PROFILE_SCOPE("M2::LoadParentSkeleton");
+
+	if (!Skeleton || !Skeleton->GetChunk(SkeletonChunk::ESkeletonChunk::SKPD))
+		return EError_OK;
+
+	uint32_t ParentFileDataId;
+	std::wstring ParentFileName;
+	if (!GetParentSkeletonSource(ParentFileDataId, ParentFileName))
 	{
-		if (auto info = GetFileInfoByFileDataId(chunk->Data.ParentSkeletonFileId))
-		{
-			std::filesystem::path ParentSkeletonPath;
-			if (wcslen(Settings.WorkingDirectory))
-				ParentSkeletonPath = std::filesystem::path(Settings.WorkingDirectory) / info->Path;
-			else
-				ParentSkeletonPath = std::filesystem::path(_FileName).parent_path() / std::filesystem::path(info->Path).filename();
+		sLogger.LogError(L"Error: skeleton has parent skeleton chunk, but parent file not loaded!");
+		return EError_FailedToLoadSkeleton_CouldNotOpenFile;
+	}
 
-			auto parentSkeleton = new M2Lib::Skeleton();
-			auto Error = parentSkeleton->Load(ParentSkeletonPath.c_str());
-			if (Error == EError_OK)
-			{
-				sLogger.LogInfo(L"Parent skeleton file [%u] %s loaded", chunk->Data.ParentSkeletonFileId, ParentSkeletonPath.wstring().c_str());
-				ParentSkeleton = parentSkeleton;
-			}
-			else
-			{
-				sLogger.LogError(L"Error: Failed to load parent skeleton file [%u] %s", chunk->Data.ParentSkeletonFileId, ParentSkeletonPath.wstring().c_str());
-				delete parentSkeleton;
-				return EError_FailedToLoadSkeleton_CouldNotOpenFile;
-			}
-		}
-		else
-		{
-			sLogger.LogError(L"Error: skeleton has parent skeleton chunk, but parent file not loaded!");
-			return EError_FailedToLoadSkeleton_CouldNotOpenFile;
-		}
+	// parent skeletons are shared by many models and are loaded through process-wide cache, model copies its chunks only when it modifies them
+	EError Error;
+	bool Hit;
+	auto sharedSkeleton = SkeletonCache::GetInstance()->Load(ParentFileDataId, ParentFileName, Error, Prefetch.Get(ParentFileName), &Hit);
+	if (Error != EError_OK)
+	{
+		sLogger.LogError(L"Error: Failed to load parent skeleton file [%u] %s", ParentFileDataId, ParentFileName.c_str());
+		return EError_FailedToLoadSkeleton_CouldNotOpenFile;
 	}
 
+	sLogger.LogInfo(L"Parent skeleton file [%u] %s loaded", ParentFileDataId, ParentFileName.c_str());
+	ParentSkeleton = new M2Lib::Skeleton(sharedSkeleton);
+	if (!Hit)
+		CountLazyRead(L"parent skeleton", ParentFileName);
+
 	return EError_OK;
 }
 
-M2Lib::EError M2Lib::M2::SaveSkeleton(std::wstring const& M2FileName)
+M2Lib::EError M2Lib::M2::SaveSkeleton(std::wstring const& M2FileName, SaveBatch& Batch)
 {
 	if (!Skeleton)
 		return EError_OK;
@@ -398,7 +498,7 @@ M2Lib::EError M2Lib::M2::SaveSkeleton(std::wstring const& M2FileName)
 	if (!GetFileSkeleton(SkeletonFileName, M2FileName, true))
 		return EError_OK;
 
-	auto Error = Skeleton->Save(SkeletonFileName.c_str());
+	auto Error = Skeleton->Save(SkeletonFileName.c_str(), Batch);
 	if (Error != EError_OK)
 		return Error;
 
@@ -412,13 +512,108 @@ M2Lib::EError M2Lib::M2::SaveSkeleton(std::wstring const& M2FileName)
 		return EError_FailedToSaveM2_NoFileSpecified;
 	}
 
-	Error = ParentSkeleton->Save(ParentSkeletonFileName.c_str());
+	Error = ParentSkeleton->Save(ParentSkeletonFileName.c_str(), Batch);
 	if (Error != EError_OK)
 		return Error;
 
 	return EError_OK;
 }
 
+M2Lib::AnimFile* M2Lib::M2::GetAnimFile(uint32_t AnimationIndex)
+{
+	// sequences of older models are always stored in model
+	if (GetExpansion() < Expansion::WrathOfTheLichKing)
+		return NULL;
+
+	auto AnimationElement = GetAnimationsForRead();
+	if (!AnimationElement || AnimationIndex >= AnimationElement->Count)
+		return NULL;
+
+	auto Animation = AnimationElement->as<CElement_Animation>() + AnimationIndex;
+	if (Animation->IsInplace() || Animation->IsAlias())
+		return NULL;
+
+	uint16_t AnimationID = Animation->AnimationID;
+	uint16_t AnimationSubID = Animation->AnimationSubID;
+	uint32_t Key = (uint32_t)AnimationID << 16 | AnimationSubID;
+
+	auto itr = animFiles.find(Key);
+	if (itr != animFiles.end())
+		return itr->second.File;
+
+	// failed files are remembered too, so they are not looked up again
+	auto& Entry = animFiles[Key];
+
+	std::wstring AnimFileName;
+	if (!GetFileAnim(AnimFileName, _FileName, AnimationID, AnimationSubID, Entry.FileDataId, false))
+		return NULL;
+
+	auto File = new AnimFile();
+	if (auto Error = File->Load(AnimFileName.c_str()))
+	{
+		sLogger.LogError(L"Error: failed to load animation file of sequence %u-%u at %s: %s", AnimationID, AnimationSubID, AnimFileName.c_str(), GetErrorText(Error));
+		delete File;
+		return NULL;
+	}
+
+	sLogger.LogInfo(L"Animation file of sequence %u-%u mapped from %s", AnimationID, AnimationSubID, AnimFileName.c_str());
+	Entry.File = File;
+
+	return File;
+}
+
+uint32_t M2Lib::M2::GetAnimFileDataId(uint16_t AnimationID, uint16_t AnimationSubID)
+{
+	if (auto afidChunk = (AFIDChunk*)GetChunk(EM2Chunk::Animation))
+	{
+		for (auto& anim : afidChunk->AnimInfos)
+			if (anim.AnimId == AnimationID && anim.SubAnimId == AnimationSubID && anim.FileId)
+				return anim.FileId;
+	}
+
+	if (auto afidChunk = GetSkeletonAFIDChunk())
+	{
+		for (auto& anim : afidChunk->AnimInfos)
+			if (anim.AnimId == AnimationID && anim.SubAnimId == AnimationSubID && anim.FileId)
+				return anim.FileId;
+	}
+
+	return 0;
+}
+
+bool M2Lib::M2::IsAnimFileModified(uint32_t FileDataId) const
+{
+	for (auto& itr : animFiles)
+		if (itr.second.FileDataId == FileDataId && itr.second.File && itr.second.File->IsModified())
+			return true;
+
+	return false;
+}
+
+M2Lib::EError M2Lib::M2::SaveAnimFiles(std::wstring const& M2FileName, SaveBatch& Batch)
+{
+	for (auto& itr : animFiles)
+	{
+		auto File = itr.second.File;
+		if (!File || !File->IsModified())
+			continue;
+
+		// file data id may be changed by remapping
+		std::wstring AnimFileName;
+		uint32_t FileDataId;
+		if (!GetFileAnim(AnimFileName, M2FileName, itr.first >> 16, itr.first & 0xFFFF, FileDataId, true))
+		{
+			sLogger.LogError(L"Error: Failed to save animation file %s - cannot determine output file", File->GetFileName().c_str());
+			return EError_FailedToSaveM2_NoFileSpecified;
+		}
+
+		if (auto Error = File->Save(AnimFileName.c_str(), Batch))
+			return Error;
+	}
+
+	return EError_OK;
+}
+
 M2Lib::EError M2Lib::M2::SaveCustomMappings(wchar_t const* fileName)
 {
 	if (customFileInfosByFileDataId.empty())
@@ -463,16 +658,18 @@ M2Lib::EError M2Lib::M2::SaveCustomMappings(wchar_t const* fileName)
 	return EError_OK;
 }
 
-M2Lib::EError M2Lib::M2::LoadSkins()
+M2Lib::EError M2Lib::M2::LoadSkins(std::wstring const* SkinFileNames, FilePrefetch& Prefetch)
 {
+	M2LIB_PROFILE_SCOPE("M2::LoadSkins");
+
 	for (uint32_t i = 0; i < Header.Elements.nSkin; ++i)
 	{
-		std::wstring FileNameSkin;
-		if (!GetFileSkin(FileNameSkin, _FileName, i, false))
+		std::wstring const& FileNameSkin = SkinFileNames[i];
+		if (FileNameSkin.empty())
 			continue;
 
 		Skins[i] = new M2Skin(this);
-		if (EError Error = Skins[i]->Load(FileNameSkin.c_str()))
+		if (EError Error = Skins[i]->Load(FileNameSkin.c_str(), Prefetch.Get(FileNameSkin).get()))
 		{
 			delete Skins[i];
 			Skins[i] = NULL;
@@ -483,17 +680,51 @@ M2Lib::EError M2Lib::M2::LoadSkins()
 	return EError::EError_OK;
 }
 
-M2Lib::EError M2Lib::M2::SaveSkins(wchar_t const* M2FileName)
+M2Lib::EError M2Lib::M2::LoadLodSkins(std::wstring const* SkinFileNames, FilePrefetch& Prefetch)
+{
+	if (hasLodSkins)
+		return EError_OK;
+
+	for (int i = 0; i < LOD_SKIN_MAX_COUNT; ++i)
+	{
+		std::wstring const& FileNameSkin = SkinFileNames[SKIN_COUNT - LOD_SKIN_MAX_COUNT + i];
+		if (FileNameSkin.empty())
+			continue;
+
+		sLogger.LogInfo(L"Loading skin '%s'...", FileNameSkin);
+		M2Skin LoDSkin(this);
+		if (EError Error = LoDSkin.Load(FileNameSkin.c_str(), Prefetch.Get(FileNameSkin).get()))
+		{
+			if (Error == EError_FailedToLoadSKIN_CouldNotOpenFile)
+				continue;
+
+			sLogger.LogError(L"Error: Failed to load #%u lod skin %s", i, FileNameSkin);
+			return Error;
+		}
+		else
+		{
+			CountLazyRead(L"lod skin", FileNameSkin);
+			hasLodSkins = true;
+			break;
+		}
+	}
+
+	return EError_OK;
+}
+
+M2Lib::EError M2Lib::M2::SaveSkins(wchar_t const* M2FileName, SaveBatch& Batch)
 {
 	if (Header.Elements.nSkin == 0 || Header.Elements.nSkin > SKIN_COUNT - LOD_SKIN_MAX_COUNT)
 		return EError_FailedToSaveM2;
 
-	// delete existing skin files
+	// existing skin files that are not written again are deleted below.
+	// rewritten ones are kept, so that unchanged files are not touched at all
+	std::set<std::wstring> StaleSkinFiles;
 	for (uint32_t i = 0; i < SKIN_COUNT; ++i)
 	{
 		std::wstring FileNameSkin;
 		if (GetFileSkin(FileNameSkin, M2FileName, i, true))
-			_wremove(FileNameSkin.c_str());
+			StaleSkinFiles.insert(FileNameSkin);
 	}
 
 	for (uint32_t i = 0; i < Header.Elements.nSkin; ++i)
@@ -502,7 +733,7 @@ M2Lib::EError M2Lib::M2::SaveSkins(wchar_t const* M2FileName)
 		if (!GetFileSkin(FileNameSkin, M2FileName, i, true))
 			continue;
 
-		if (EError Error = Skins[i]->Save(FileNameSkin.c_str()))
+		if (EError Error = Skins[i]->Save(FileNameSkin.c_str(), Batch))
 			return Error;
 	}
 
@@ -517,15 +748,22 @@ M2Lib::EError M2Lib::M2::SaveSkins(wchar_t const* M2FileName)
 		if (!GetFileSkin(FileNameSkin, M2FileName, i + 4, true))
 			continue;
 
-		if (EError Error = (Skins[1] ? Skins[1] : Skins[0])->Save(FileNameSkin.c_str()))
+		if (EError Error = (Skins[1] ? Skins[1] : Skins[0])->Save(FileNameSkin.c_str(), Batch))
 			return Error;
 	}
 
+	for (auto& FileName : Batch.GetFileNames())
+		StaleSkinFiles.erase(FileName);
+	for (auto& FileName : StaleSkinFiles)
+		_wremove(FileName.c_str());
+
 	return EError_OK;
 }
 
 void M2Lib::M2::DoExtraWork()
 {
+	M2LIB_PROFILE_SCOPE("M2::DoExtraWork");
+
 	//auto RenderFlags = Elements[EElement_TextureFlags].as<CElement_TextureFlag>();
 	//sLogger.LogInfo("Existing render flags:");
 	//for (uint32_t i = 0; i < Elements[EElement_TextureFlags].Count; ++i)
@@ -561,13 +799,8 @@ void M2Lib::M2::DoExtraWork()
 				if (renderFlagsByStyle.find(key) == renderFlagsByStyle.end())
 					renderFlagsByStyle[key] = AddTextureFlags((CElement_TextureFlag::EFlags)ExtraData->RenderFlags, (CElement_TextureFlag::EBlend)ExtraData->BlendMode);
 
-				for (uint32_t j = 0; j < Skin->Header.nMaterial; ++j)
-				{
-					if (Materials[j].iSubMesh != MeshIndex)
-						continue;
-
+				for (auto j : Skin->Index.GetSubMeshMaterials(Skin->Elements, MeshIndex))
 					Materials[j].iRenderFlags = renderFlagsByStyle[key];
-				}
 			}
 
 			if (ShaderId == -1)
@@ -584,6 +817,12 @@ void M2Lib::M2::DoExtraWork()
 		if (!Skin)
 			continue;
 
+		// first mesh of current skin for each mesh of zero skin, to translate indices.
+		// zero skin needs it too once its sub meshes were sorted by earlier save.
+		std::unordered_map<uint32_t, uint32_t> LocalMeshByFirstLODMesh;
+		for (uint32_t LocalMeshIndex = 0; LocalMeshIndex < Skin->ExtraDataBySubmeshIndex.size(); ++LocalMeshIndex)
+			LocalMeshByFirstLODMesh.emplace(Skin->ExtraDataBySubmeshIndex[LocalMeshIndex]->FirstLODMeshIndex, LocalMeshIndex);
+
 		// copy materials
 		for (uint32_t MeshIndex = 0; MeshIndex < Skin->ExtraDataBySubmeshIndex.size(); ++MeshIndex)
 		{
@@ -591,21 +830,10 @@ void M2Lib::M2::DoExtraWork()
 			if (ExtraData->MaterialOverride < 0)
 				continue;
 
-			if (i == 0)
-				Skin->CopyMaterial(ExtraData->MaterialOverride, MeshIndex);
-			else
-			{
-				// translate index from zero skin to current skin
-				for (uint32_t LocalMeshIndex = 0; LocalMeshIndex < Skin->ExtraDataBySubmeshIndex.size(); ++LocalMeshIndex)
-				{
-					auto LocalExtraData = Skin->ExtraDataBySubmeshIndex[LocalMeshIndex];
-					if (LocalExtraData->FirstLODMeshIndex == ExtraData->MaterialOverride)
-					{
-						Skin->CopyMaterial(LocalMeshIndex, MeshIndex);
-						break;
-					}
-				}
-			}
+			// translate index from zero skin to current skin
+			auto itr = LocalMeshByFirstLODMesh.find((uint32_t)ExtraData->MaterialOverride);
+			if (itr != LocalMeshByFirstLODMesh.end())
+				Skin->CopyMaterial(itr->second, MeshIndex);
 		}
 	}
 
@@ -615,18 +843,326 @@ void M2Lib::M2::DoExtraWork()
 
 M2Lib::ChunkBase* M2Lib::M2::GetChunk(EM2Chunk ChunkId)
 {
-	auto chunkItr = Chunks.find(ChunkId);
-	if (chunkItr == Chunks.end())
-		return NULL;
+	if (lazy.Enabled && Chunks.Contains((uint32_t)ChunkId) && !Chunks.IsParsed((uint32_t)ChunkId))
+	{
+		auto ChunkName = ChunkIdToStr(REVERSE_CC((uint32_t)ChunkId), false);
+		sLogger.LogInfo(L"Parsing deferred '%s' M2 chunk", ChunkName.c_str());
+		lazy.Touched.push_back(L"chunk '" + ChunkName + L"'");
+	}
 
-	return chunkItr->second;
+	return Chunks.Get((uint32_t)ChunkId);
 }
 
 void M2Lib::M2::RemoveChunk(EM2Chunk ChunkId)
 {
-	auto chunkItr = Chunks.find(ChunkId);
-	if (chunkItr != Chunks.end())
-		Chunks.erase(chunkItr);
+	Chunks.Remove((uint32_t)ChunkId);
+}
+
+void M2Lib::M2::SetLazyLoad(bool Lazy)
+{
+	lazy.Enabled = Lazy;
+}
+
+void M2Lib::M2::SetRemapHardLinks(bool HardLinks)
+{
+	remapHardLinks = HardLinks;
+}
+
+M2Lib::EError M2Lib::M2::ReduceKeyframes(float PositionTolerance, float AngleTolerance)
+{
+	M2LIB_PROFILE_SCOPE("M2::ReduceKeyframes");
+
+	// tracks of older models store all sequences in one key array
+	if (GetExpansion() < Expansion::WrathOfTheLichKing)
+	{
+		sLogger.LogError(L"Keyframe reduction is not supported for models before Wrath of the Lich King");
+		return EError_FAIL;
+	}
+
+	if (EError Error = LoadPendingImport())
+		return Error;
+
+	KeyframeReduction Reduction(PositionTolerance, AngleTolerance);
+	Reduction.AddModel(*this);
+	auto Report = Reduction.Reduce();
+	InvalidateBuildCache();
+
+	sLogger.LogInfo(L"Keyframe reduction (position tolerance %f, angle tolerance %f), file size is not changed:", PositionTolerance, AngleTolerance);
+	Report.Print();
+
+	return EError_OK;
+}
+
+M2Lib::EError M2Lib::M2::CalculateAnimationBounds(uint32_t SampleInterval)
+{
+	M2LIB_PROFILE_SCOPE("M2::CalculateAnimationBounds");
+
+	if (GetExpansion() < Expansion::WrathOfTheLichKing)
+	{
+		sLogger.LogError(L"Animation bounds can not be calculated for models before Wrath of the Lich King");
+		return EError_FAIL;
+	}
+
+	if (EError Error = LoadPendingImport())
+		return Error;
+
+	auto Start = std::chrono::high_resolution_clock::now();
+
+	AnimationSampler Sampler(*this);
+	std::vector<SVolume> Volumes;
+	std::vector<bool> Valid;
+	Sampler.CalculateBoundingVolumes(SampleInterval, Volumes, Valid);
+
+	InvalidateBuildCache();
+
+	auto AnimationElement = GetAnimations();
+	uint32_t Updated = 0;
+	for (uint32_t i = 0; i < Volumes.size(); ++i)
+	{
+		if (!Valid[i])
+			continue;
+
+		AnimationElement->at<CElement_Animation>(i)->BoundingVolume = Volumes[i];
+		++Updated;
+	}
+
+	sLogger.LogInfo(L"Bounding volumes of %u of %u sequences updated from %u bones in %.1f ms", Updated, Sampler.GetAnimationCount(), Sampler.GetBoneCount(),
+		std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - Start).count());
+
+	return EError_OK;
+}
+
+void M2Lib::M2::CountLazyRead(std::wstring const& Part, std::wstring const& FileName)
+{
+	if (!lazy.Enabled)
+		return;
+
+	std::error_code ec;
+	auto Size = std::filesystem::file_size(FileName, ec);
+	if (!ec)
+		lazy.BytesRead += Size;
+	lazy.Touched.push_back(Part + L" " + FileName);
+}
+
+M2Lib::EError M2Lib::M2::LoadLazySkin(uint32_t Index)
+{
+	if (!lazy.SkinPending[Index])
+		return EError_OK;
+
+	lazy.SkinPending[Index] = false;
+
+	std::wstring FileNameSkin;
+	if (!GetFileSkin(FileNameSkin, _FileName, Index, false))
+		return EError_OK;
+
+	sLogger.LogInfo(L"Loading skin '%s' on demand...", FileNameSkin.c_str());
+	auto Skin = new M2Skin(this);
+	if (EError Error = Skin->Load(FileNameSkin.c_str()))
+	{
+		sLogger.LogError(L"Error: Failed to load #%u skin %s", Index, FileNameSkin.c_str());
+		delete Skin;
+		return Error;
+	}
+
+	Skins[Index] = Skin;
+	CountLazyRead(L"skin", FileNameSkin);
+
+	return EError_OK;
+}
+
+M2Lib::EError M2Lib::M2::LoadLazySkeleton()
+{
+	if (!lazy.SkeletonPending)
+		return EError_OK;
+
+	lazy.SkeletonPending = false;
+
+	std::wstring FileNameSkeleton;
+	if (!GetFileSkeleton(FileNameSkeleton, _FileName, false))
+		return EError_OK;
+
+	FilePrefetch Prefetch;
+	if (EError Error = LoadSkeleton(FileNameSkeleton, Prefetch))
+		return Error;
+
+	return LoadParentSkeleton(Prefetch);
+}
+
+M2Lib::M2Skin* M2Lib::M2::GetSkin(uint32_t Index)
+{
+	if (Index >= SKIN_COUNT)
+		return NULL;
+
+	LoadPendingImport();
+	LoadLazySkin(Index);
+
+	return Skins[Index];
+}
+
+M2Lib::Skeleton* M2Lib::M2::GetSkeleton()
+{
+	LoadPendingImport();
+	LoadLazySkeleton();
+
+	return Skeleton;
+}
+
+M2Lib::Skeleton* M2Lib::M2::GetParentSkeleton()
+{
+	// parent skeleton is referenced from skeleton, they are loaded together
+	LoadPendingImport();
+	LoadLazySkeleton();
+
+	return ParentSkeleton;
+}
+
+M2Lib::EError M2Lib::M2::LoadLazyParts()
+{
+	if (EError Error = LoadPendingImport())
+		return Error;
+
+	if (!lazy.Enabled)
+		return EError_OK;
+
+	for (uint32_t i = 0; i < SKIN_COUNT; ++i)
+		if (EError Error = LoadLazySkin(i))
+			return Error;
+
+	if (lazy.LodSkinsPending)
+	{
+		lazy.LodSkinsPending = false;
+
+		auto skinChunk = (SFIDChunk*)GetChunk(EM2Chunk::Skin);
+		if (skinChunk && skinChunk->SkinsFileDataIds.size() > Header.Elements.nSkin)
+			hasLodSkins = true;
+		else
+		{
+			FilePrefetch Prefetch;
+			std::wstring SkinFileNames[SKIN_COUNT];
+			for (uint32_t i = SKIN_COUNT - LOD_SKIN_MAX_COUNT; i < SKIN_COUNT; ++i)
+				GetFileSkin(SkinFileNames[i], _FileName, i, false);
+
+			if (EError Error = LoadLodSkins(SkinFileNames, Prefetch))
+				return Error;
+		}
+	}
+
+	return LoadLazySkeleton();
+}
+
+void M2Lib::M2::PrintLazyLoadInfo()
+{
+	if (!sLogger.IsEnabled(LOG_INFO))
+		return;
+
+	if (!lazy.Enabled)
+	{
+		sLogger.LogInfo(L"Lazy loading is disabled, model was loaded completely");
+		return;
+	}
+
+	// resolving file names below may parse pending chunks, take snapshot first
+	auto Touched = lazy.Touched;
+	auto BytesRead = lazy.BytesRead;
+	std::vector<uint32_t> UnparsedChunks;
+	for (auto ChunkId : Chunks.GetIds())
+		if (ChunkId != (uint32_t)EM2Chunk::Model && !Chunks.IsParsed(ChunkId))
+			UnparsedChunks.push_back(ChunkId);
+
+	sLogger.LogInfo(L"Parts loaded on demand:");
+	for (auto& part : Touched)
+		sLogger.LogInfo(L"	%s", part.c_str());
+
+	// chunks are read with model file, but are not parsed until accessed
+	sLogger.LogInfo(L"Chunks not parsed:");
+	for (auto ChunkId : UnparsedChunks)
+		sLogger.LogInfo(L"	chunk '%s', size %llu", ChunkIdToStr(REVERSE_CC(ChunkId), false).c_str(), (unsigned long long)Chunks.GetMemoryUsage(ChunkId));
+
+	uint64_t BytesSkipped = 0;
+	sLogger.LogInfo(L"Parts not loaded:");
+
+	std::error_code ec;
+	for (uint32_t i = 0; i < SKIN_COUNT; ++i)
+	{
+		std::wstring FileName;
+		if (!lazy.SkinPending[i] || !GetFileSkin(FileName, _FileName, i, false))
+			continue;
+
+		auto Size = std::filesystem::file_size(FileName, ec);
+		sLogger.LogInfo(L"	skin %s, size %llu", FileName.c_str(), ec ? 0ull : (unsigned long long)Size);
+		if (!ec)
+			BytesSkipped += Size;
+	}
+
+	if (lazy.SkeletonPending)
+	{
+		std::wstring FileName;
+		if (GetFileSkeleton(FileName, _FileName, false))
+		{
+			auto Size = std::filesystem::file_size(FileName, ec);
+			sLogger.LogInfo(L"	skeleton %s, size %llu", FileName.c_str(), ec ? 0ull : (unsigned long long)Size);
+			if (!ec)
+				BytesSkipped += Size;
+			sLogger.LogInfo(L"	parent skeleton, if any, can not be resolved until skeleton is loaded");
+		}
+	}
+
+	sLogger.LogInfo(L"Read on demand: %llu bytes, not read: %llu bytes", (unsigned long long)BytesRead, (unsigned long long)BytesSkipped);
+}
+
+void M2Lib::M2::GetMemoryUsage(MemoryReport& Report) const
+{
+	static char const* ElementNames[EElement__CountM2__] =
+	{
+		"Name", "GlobalSequence", "Animation", "AnimationLookup", "Bone", "KeyBoneLookup", "Vertex", "Color", "Texture", "Transparency",
+		"TextureAnimation", "TextureReplace", "TextureFlags", "SkinnedBoneLookup", "TextureLookup", "TextureUnitLookup", "TransparencyLookup",
+		"TextureAnimationLookup", "BoundingTriangle", "BoundingVertex", "BoundingNormal", "Attachment", "AttachmentLookup", "Event", "Light",
+		"Camera", "CameraLookup", "RibbonEmitter", "ParticleEmitter", "TextureCombinerCombo",
+	};
+
+	Report.Add("M2 object", sizeof(*this));
+
+	for (uint32_t i = 0; i < EElement__CountM2__; ++i)
+		Report.Add(std::string("Element ") + ElementNames[i], Elements[i].GetMemoryUsage());
+
+	for (uint32_t i = 0; i < SKIN_COUNT; ++i)
+	{
+		if (Skins[i])
+			Report.Add("Skin " + std::to_string(i), Skins[i]->GetMemoryUsage());
+	}
+
+	for (auto ChunkId : Chunks.GetIds())
+		Report.Add("Chunk " + StringHelpers::WStringToString(ChunkIdToStr(REVERSE_CC(ChunkId), false)), Chunks.GetMemoryUsage(ChunkId));
+
+	if (Skeleton)
+		Report.Add("Skeleton", Skeleton->GetMemoryUsage());
+	if (ParentSkeleton)
+		Report.Add("Parent skeleton", ParentSkeleton->GetMemoryUsage());
+
+	uint64_t AnimFilesSize = 0;
+	for (auto& itr : animFiles)
+		if (itr.second.File)
+			AnimFilesSize += itr.second.File->GetMemoryUsage();
+	Report.Add("Animation files", AnimFilesSize);
+
+	if (pInM2I)
+		Report.Add("Imported M2I", pInM2I->GetMemoryUsage());
+
+	// replace model is reported as a whole, its own breakdown can be printed separately
+	if (replaceM2)
+	{
+		MemoryReport ReplaceReport;
+		replaceM2->GetMemoryUsage(ReplaceReport);
+		Report.Add("Replace M2", ReplaceReport.GetTotal());
+	}
+}
+
+void M2Lib::M2::PrintMemoryUsage() const
+{
+	MemoryReport Report;
+	GetMemoryUsage(Report);
+
+	Report.Print((L"Memory used by " + (_FileName.empty() ? std::wstring(L"model") : _FileName)).c_str());
 }
 
 void M2Lib::M2::CopyReplaceChunks()
@@ -644,17 +1180,13 @@ void M2Lib::M2::CopyReplaceChunks()
 		{
 			sLogger.LogInfo(L"Model to replace does not have SKIN chunk, removing source one...");
 			RemoveChunk(EM2Chunk::Skin);
-			delete skinChunk;
 		}
 	}
 	else
 	{
 		sLogger.LogInfo(L"Copying skin chunk to source model...");
-		if (skinChunk)
-			delete skinChunk;
-		Chunks[EM2Chunk::Skin] = otherSkinChunk;
+		Chunks.Set((uint32_t)EM2Chunk::Skin, replaceM2->Chunks.Release((uint32_t)EM2Chunk::Skin));
 		Header.Elements.nSkin = replaceM2->Header.Elements.nSkin;
-		replaceM2->RemoveChunk(EM2Chunk::Skin);
 	}
 
 	auto otherSkeletonChunk = replaceM2->GetChunk(EM2Chunk::Skeleton);
@@ -668,11 +1200,7 @@ void M2Lib::M2::CopyReplaceChunks()
 	else
 	{
 		sLogger.LogInfo(L"Copying skeleton chunk to source model...");
-		if (skeletonChunk)
-			delete skeletonChunk;
-
-		Chunks[EM2Chunk::Skeleton] = otherSkeletonChunk;
-		replaceM2->RemoveChunk(EM2Chunk::Skeleton);
+		Chunks.Set((uint32_t)EM2Chunk::Skeleton, replaceM2->Chunks.Release((uint32_t)EM2Chunk::Skeleton));
 	}
 }
 
@@ -698,6 +1226,8 @@ void M2Lib::M2::FixSkinChunk()
 
 M2Lib::EError M2Lib::M2::Save(const wchar_t* FileName, uint8_t saveMask = SAVE_ALL)
 {
+	M2LIB_PROFILE_SCOPE("M2::Save");
+
 	if (!saveMask)
 		saveMask = SAVE_ALL;
 
@@ -705,6 +1235,29 @@ M2Lib::EError M2Lib::M2::Save(const wchar_t* FileName, uint8_t saveMask = SAVE_A
 	if (!FileName)
 		return EError_FailedToSaveM2_NoFileSpecified;
 
+	if (buildCache.Hit)
+	{
+		buildCache.Hit = false;
+
+		bool Cacheable = IsBuildCacheable(saveMask);
+		// model stays not imported, import is run if it is accessed or saved again
+		if (Cacheable && BuildCache::GetInstance()->Restore(buildCache.Key, FileName))
+		{
+			sLogger.LogInfo(L"Model restored from build cache");
+			buildCache.Active = false;
+			return EError_OK;
+		}
+
+		// model is imported by LoadLazyParts() below and written as usual
+		if (!Cacheable)
+			BuildCache::GetInstance()->CountBypass();
+	}
+
+	// everything is written back, so everything skipped by lazy loading is needed
+	auto LazyError = LoadLazyParts();
+	if (LazyError != EError_OK)
+		return LazyError;
+
 	auto directory = std::filesystem::path(FileName).parent_path();
 	if (!is_directory(directory) && !std::filesystem::create_directories(directory))
 	{
@@ -715,6 +1268,13 @@ M2Lib::EError M2Lib::M2::Save(const wchar_t* FileName, uint8_t saveMask = SAVE_A
 
 	DoExtraWork();
 
+	// skins built from M2I follow order of its meshes, materials are final now so they can be ordered by render state
+	for (uint32_t i = 0; i < SKIN_COUNT; ++i)
+	{
+		if (Skins[i] && !Skins[i]->ExtraDataBySubmeshIndex.empty())
+			Skins[i]->SortSubMeshes();
+	}
+
 	if (needRemapReferences)
 		if (!RemapReferences(FileName))
 			return EError_FAIL;
@@ -729,79 +1289,89 @@ M2Lib::EError M2Lib::M2::Save(const wchar_t* FileName, uint8_t saveMask = SAVE_A
 
 	FixSkinChunk();
 
+	SaveBatch Batch;
+
 	if (saveMask & SAVE_M2)
 	{
 		// Reserve model chunk header
 		uint32_t const ChunkReserveOffset = 8;
 
-		// open file stream
-		std::fstream FileStream;
-		FileStream.open(FileName, std::ios::out | std::ios::trunc | std::ios::binary);
-		if (FileStream.fail())
-			return EError_FailedToSaveM2;
-		uint32_t ChunkId = REVERSE_CC((uint32_t)EM2Chunk::Model);
-		FileStream.write((char*)&ChunkId, 4);
-		FileStream.seekp(4, std::ios::cur);		// reserve bytes for chunk size
-
 		//Header.Description.Version = 0x0110;
 		//Header.Description.Flags &= ~0x80;
 
-		// save header
+		// element offsets are final, so model chunk size is known before anything is written
 		uint32_t HeaderSize = GetHeaderSize();
-		FileStream.write((char*)&Header, HeaderSize);
-
-		// save elements
 		uint32_t ElementCount = Header.IsLongHeader() ? EElement__CountM2__ : EElement__CountM2__ - 1;
+
+		uint32_t MD20Size = HeaderSize;
 		for (uint32_t i = 0; i < ElementCount; ++i)
 		{
-			if (!Elements[i].Save(FileStream, ChunkReserveOffset))
-				return EError_FailedToSaveM2;
+			auto const& Data = Elements[i].Data;
+			if (!Data.empty())
+				MD20Size = std::max<uint32_t>(MD20Size, Elements[i].Offset + Data.size());
 		}
 
-		uint32_t MD20Size = (uint32_t)FileStream.tellp();
-		MD20Size -= ChunkReserveOffset;
+		auto& Writer = Batch.Add(FileName, EError_FailedToSaveM2);
+		Writer.AppendValue(REVERSE_CC((uint32_t)EM2Chunk::Model));
+		Writer.AppendValue(MD20Size);
 
-		FileStream.seekp(4, std::ios::beg);
-		FileStream.write((char*)(&MD20Size), 4);
+		// save header
+		Writer.Append(&Header, HeaderSize);
 
-		FileStream.seekp(0, std::ios::end);
+		// save elements, their buffers are referenced and not copied
+		for (uint32_t i = 0; i < ElementCount; ++i)
+		{
+			auto const& Data = Elements[i].Data;
+			if (!Data.empty())
+				Writer.AppendAt(ChunkReserveOffset + Elements[i].Offset, Data.data(), Data.size());
+		}
 
-		for (auto chunk : Chunks)
+		// chunks that were not accessed are written as loaded
+		for (auto ChunkId : Chunks.GetIds())
 		{
-			if (chunk.first == EM2Chunk::Model)
+			if (ChunkId == (uint32_t)EM2Chunk::Model)
 				continue;
 
-			//if (chunk.first == 'SFID')
+			//if (ChunkId == 'SFID')
 			//	continue;
 
-			uint32_t ChunkId = REVERSE_CC((uint32_t)chunk.first);
-
-			FileStream.write((char*)&ChunkId, 4);
-			FileStream.seekp(4, std::ios::cur);		// reserve space for chunk size
-			uint32_t savePos = (uint32_t)FileStream.tellp();
-			chunk.second->Save(FileStream);
-			uint32_t ChunkSize = (uint32_t)FileStream.tellp() - savePos;
-			FileStream.seekp(savePos - 4, std::ios::beg);
-			FileStream.write((char*)&ChunkSize, 4);
-			FileStream.seekp(0, std::ios::end);
+			Chunks.Write(ChunkId, Writer);
 		}
 	}
 
 	if (saveMask & SAVE_SKIN)
 	{
 		// save skins
-		auto Error = SaveSkins(FileName);
+		auto Error = SaveSkins(FileName, Batch);
 		if (Error != EError_OK)
 			return Error;
 	}
 
 	if (saveMask & SAVE_SKELETON)
 	{
-		auto Error = SaveSkeleton(FileName);
+		auto Error = SaveSkeleton(FileName, Batch);
 		if (Error != EError_OK)
 			return Error;
 	}
 
+	if (saveMask & SAVE_OTHER)
+	{
+		auto Error = SaveAnimFiles(FileName, Batch);
+		if (Error != EError_OK)
+			return Error;
+	}
+
+	// all outputs are assembled and independent now, write them concurrently
+	auto Error = Batch.Commit();
+	if (Error != EError_OK)
+		return Error;
+
+	if (IsBuildCacheable(saveMask))
+	{
+		BuildCache::GetInstance()->Store(buildCache.Key, FileName, Batch.GetFileNames());
+		buildCache.Active = false;
+	}
+
 	if (auto chunk = (SFIDChunk*)GetChunk(EM2Chunk::Skin))
 	{
 		sLogger.LogInfo(L"INFO: Put your skins to:");
@@ -830,14 +1400,20 @@ M2Lib::EError M2Lib::M2::Save(const wchar_t* FileName, uint8_t saveMask = SAVE_A
 
 M2Lib::EError M2Lib::M2::ExportM2Intermediate(wchar_t const* FileName)
 {
+	// only skin 0 is needed for export, skeleton is loaded on demand by bone accessors
+	M2Skin* pSkin = GetSkin(0);
+	if (!pSkin)
+		return EError_FailedToExportM2I_M2NotLoaded;
+
 	// open file stream
 	std::fstream FileStream;
 	FileStream.open(FileName, std::ios::out | std::ios::trunc | std::ios::binary);
 	if (FileStream.fail())
 		return EError_FailedToExportM2I_CouldNotOpenFile;
 
-	// open binary stream
-	DataBinary DataBinary(&FileStream, EEndianness_Little);
+	// file is serialized to memory in parts, subsets in parallel, and parts are written in order
+	std::vector<uint8_t> HeaderBuffer;
+	DataBinary DataBinary(&HeaderBuffer, EEndianness_Little);
 
 	// save signature
 	DataBinary.WriteFourCC(M2I::Signature_M2I0);
@@ -846,24 +1422,31 @@ M2Lib::EError M2Lib::M2::ExportM2Intermediate(wchar_t const* FileName)
 	DataBinary.Write<uint16_t>(8);
 	DataBinary.Write<uint16_t>(1);
 
-	// get data to save
-	M2Skin* pSkin = Skins[0];
+	// get data to save, export only reads so const access keeps data shared with clones
+	auto const* SkinElements = pSkin->Elements;
+	auto const* ModelElements = Elements;
 
-	uint32_t SubsetCount = pSkin->Elements[M2SkinElement::EElement_SubMesh].Count;
-	M2SkinElement::CElement_SubMesh* Subsets = pSkin->Elements[M2SkinElement::EElement_SubMesh].as<M2SkinElement::CElement_SubMesh>();
+	uint32_t SubsetCount = SkinElements[M2SkinElement::EElement_SubMesh].Count;
+	M2SkinElement::CElement_SubMesh const* Subsets = SkinElements[M2SkinElement::EElement_SubMesh].as<M2SkinElement::CElement_SubMesh>();
 
-	CVertex* Vertices = Elements[EElement_Vertex].as<CVertex>();
-	auto verticesCount = Elements[EElement_Vertex].Count;
-	uint16_t* Triangles = pSkin->Elements[M2SkinElement::EElement_TriangleIndex].as<uint16_t>();
-	auto trianglesCount = pSkin->Elements[M2SkinElement::EElement_TriangleIndex];
-	uint16_t* Indices = pSkin->Elements[M2SkinElement::EElement_VertexLookup].as<uint16_t>();
-	auto indicesCount = pSkin->Elements[M2SkinElement::EElement_VertexLookup].Count;
+	CVertex const* Vertices = ModelElements[EElement_Vertex].as<CVertex>();
+	auto verticesCount = ModelElements[EElement_Vertex].Count;
+	uint16_t const* Triangles = SkinElements[M2SkinElement::EElement_TriangleIndex].as<uint16_t>();
+	uint16_t const* Indices = SkinElements[M2SkinElement::EElement_VertexLookup].as<uint16_t>();
+	auto indicesCount = SkinElements[M2SkinElement::EElement_VertexLookup].Count;
 
 	// save subsets
 	DataBinary.Write<uint32_t>(SubsetCount);
-	for (uint32_t i = 0; i < SubsetCount; ++i)
+
+	// subsets are independent of each other, serialize each one to own buffer in parallel
+	std::vector<std::vector<uint8_t>> SubsetBuffers(SubsetCount);
+	ThreadPool::GetInstance()->ParallelFor(SubsetCount, [&](uint32_t i)
 	{
-		M2SkinElement::CElement_SubMesh* pSubsetOut = &Subsets[i];
+		M2SkinElement::CElement_SubMesh const* pSubsetOut = &Subsets[i];
+
+		std::vector<uint8_t>& SubsetBuffer = SubsetBuffers[i];
+		SubsetBuffer.reserve(64 + pSubsetOut->VertexCount * 48 + pSubsetOut->TriangleIndexCount * sizeof(uint16_t));
+		M2Lib::DataBinary DataBinary(&SubsetBuffer, EEndianness_Little);
 
 		DataBinary.Write<uint16_t>(pSubsetOut->ID);	// mesh id
 		DataBinary.WriteASCIIString("");		// description
@@ -919,15 +1502,18 @@ M2Lib::EError M2Lib::M2::ExportM2Intermediate(wchar_t const* FileName)
 			m2lib_assert(TriangleIndexOut < pSubsetOut->VertexCount);
 			DataBinary.Write<uint16_t>(TriangleIndexOut);
 		}
-	}
+	});
+
+	std::vector<uint8_t> TailBuffer;
+	DataBinary.SetBuffer(&TailBuffer);
 
-	auto boneElement = GetBones();
+	DataElement const* boneElement = GetBones();
 
 	// write bones
 	DataBinary.Write<uint32_t>(boneElement->Count);
 	for (uint16_t i = 0; i < boneElement->Count; i++)
 	{
-		CElement_Bone& Bone = *boneElement->at<CElement_Bone>(i);
+		CElement_Bone const& Bone = *boneElement->at<CElement_Bone>(i);
 
 		DataBinary.Write<uint16_t>(i);
 		DataBinary.Write<int16_t>(Bone.ParentBone);
@@ -939,12 +1525,12 @@ M2Lib::EError M2Lib::M2::ExportM2Intermediate(wchar_t const* FileName)
 		DataBinary.Write<uint16_t>(Bone.Unknown[1]);
 	}
 
-	auto attachmentElement = GetAttachments();
+	DataElement const* attachmentElement = GetAttachments();
 	// write attachments
 	DataBinary.Write<uint32_t>(attachmentElement->Count);
 	for (uint16_t i = 0; i < attachmentElement->Count; i++)
 	{
-		CElement_Attachment& Attachment = *attachmentElement->at<CElement_Attachment>(i);
+		CElement_Attachment const& Attachment = *attachmentElement->at<CElement_Attachment>(i);
 
 		DataBinary.Write<uint32_t>(Attachment.ID);
 		DataBinary.Write<int16_t>(Attachment.ParentBone);
@@ -952,7 +1538,8 @@ M2Lib::EError M2Lib::M2::ExportM2Intermediate(wchar_t const* FileName)
 		DataBinary.Write<float>(1.0f);
 	}
 
-	uint32_t CamerasCount = Elements[EElement_Camera].Count;
+	auto const& CameraElement = ModelElements[EElement_Camera];
+	uint32_t CamerasCount = CameraElement.Count;
 	// write cameras
 	DataBinary.Write<uint32_t>(CamerasCount);
 	for (uint16_t i = 0; i < CamerasCount; i++)
@@ -963,7 +1550,7 @@ M2Lib::EError M2Lib::M2::ExportM2Intermediate(wchar_t const* FileName)
 
 		if (GetExpansion() < Expansion::Cataclysm)
 		{
-			auto Camera = Elements[EElement_Camera].at<CElement_Camera_PreCata>(i);
+			auto Camera = CameraElement.at<CElement_Camera_PreCata>(i);
 			CameraType = Camera->Type;
 			ClipFar = Camera->ClipFar;
 			ClipNear = Camera->ClipNear;
@@ -973,7 +1560,7 @@ M2Lib::EError M2Lib::M2::ExportM2Intermediate(wchar_t const* FileName)
 		}
 		else
 		{
-			auto Camera = Elements[EElement_Camera].at<CElement_Camera>(i);
+			auto Camera = CameraElement.at<CElement_Camera>(i);
 			CameraType = Camera->Type;
 			ClipFar = Camera->ClipFar;
 			ClipNear = Camera->ClipNear;
@@ -983,13 +1570,13 @@ M2Lib::EError M2Lib::M2::ExportM2Intermediate(wchar_t const* FileName)
 			// extract field of view of camera from animation block
 			if (Camera->AnimationBlock_FieldOfView.Values.Count > 0)
 			{
-				auto ExternalAnimations = (M2Array*)Elements[EElement_Camera].GetLocalPointer(Camera->AnimationBlock_FieldOfView.Values.Offset);
+				auto ExternalAnimations = (M2Array const*)CameraElement.GetLocalPointer(Camera->AnimationBlock_FieldOfView.Values.Offset);
 				auto LastElementIndex = GetLastElementIndex();
 				m2lib_assert(LastElementIndex != M2Element::EElement__CountM2__);
-				auto& LastElement = Elements[LastElementIndex];
+				auto const& LastElement = ModelElements[LastElementIndex];
 				m2lib_assert(ExternalAnimations[0].Offset >= LastElement.Offset && ExternalAnimations[0].Offset < LastElement.Offset + LastElement.Data.size());
 
-				float* FieldOfView_Keys = (float*)LastElement.GetLocalPointer(ExternalAnimations[0].Offset);
+				float const* FieldOfView_Keys = (float const*)LastElement.GetLocalPointer(ExternalAnimations[0].Offset);
 				FoV = FieldOfView_Keys[0];
 			}
 			else
@@ -999,21 +1586,105 @@ M2Lib::EError M2Lib::M2::ExportM2Intermediate(wchar_t const* FileName)
 		DataBinary.Write<uint8_t>(1);	// has data
 		DataBinary.Write<int32_t>(CameraType);
 
-		DataBinary.Write<float>(FoV);
+		DataBinary.Write<float>(FoV);
+
+		DataBinary.Write<float>(ClipFar);
+		DataBinary.Write<float>(ClipNear);
+		DataBinary.WriteC3Vector(Position);
+		DataBinary.WriteC3Vector(Target);
+	}
+
+	// buffers are written in sequence instead of being joined, so output is not held in memory twice.
+	// each subset buffer is released once written.
+	FileStream.write((char const*)HeaderBuffer.data(), HeaderBuffer.size());
+	for (auto& SubsetBuffer : SubsetBuffers)
+	{
+		FileStream.write((char const*)SubsetBuffer.data(), SubsetBuffer.size());
+		std::vector<uint8_t>().swap(SubsetBuffer);
+	}
+	FileStream.write((char const*)TailBuffer.data(), TailBuffer.size());
+	FileStream.close();
+
+	return EError_OK;
+}
+
+bool M2Lib::M2::CalcBuildCacheKey(wchar_t const* M2IFileName, uint64_t& Key)
+{
+	ContentHash Hash;
+	Hash.AddValue(BuildCacheLibraryVersion);
+
+	if (!Hash.AddFile(_FileName) || !Hash.AddFile(M2IFileName))
+		return false;
+	if (replaceM2 && !Hash.AddFile(replaceM2->_FileName))
+		return false;
+	Hash.AddValue(replaceM2 != NULL);
+
+	// original companion files are read back on save, lod skins and skeletons are optional
+	for (uint32_t i = 0; i < SKIN_COUNT; ++i)
+	{
+		std::wstring SkinFileName;
+		if (!GetFileSkin(SkinFileName, _FileName, i, false))
+			continue;
+
+		Hash.AddString(SkinFileName);
+		if (!Hash.AddFile(SkinFileName) && i < Header.Elements.nSkin)
+			return false;
+	}
+
+	std::wstring SkeletonFileName;
+	if (GetFileSkeleton(SkeletonFileName, _FileName, false))
+	{
+		Hash.AddString(SkeletonFileName);
+		Hash.AddFile(SkeletonFileName);
+	}
+
+	uint32_t ParentFileDataId;
+	std::wstring ParentFileName;
+	if (GetParentSkeletonSource(ParentFileDataId, ParentFileName))
+	{
+		Hash.AddValue(ParentFileDataId);
+		Hash.AddString(ParentFileName);
+		Hash.AddFile(ParentFileName);
+	}
 
-		DataBinary.Write<float>(ClipFar);
-		DataBinary.Write<float>(ClipNear);
-		DataBinary.WriteC3Vector(Position);
-		DataBinary.WriteC3Vector(Target);
+	// file names and new file data ids are resolved through listfile
+	Hash.AddValue(storageRef ? storageRef->GetStateHash() : 0);
+
+	Hash.AddString(Settings.OutputDirectory);
+	Hash.AddString(Settings.WorkingDirectory);
+	Hash.AddString(Settings.MappingsDirectory);
+	Hash.AddValue(Settings.ForceLoadExpansion);
+	Hash.AddValue(Settings.CustomFilesStartIndex);
+	Hash.AddValue(Settings.MergeBones);
+	Hash.AddValue(Settings.MergeAttachments);
+	Hash.AddValue(Settings.MergeCameras);
+	Hash.AddValue(Settings.FixSeams);
+	Hash.AddValue(Settings.FixEdgeNormals);
+	Hash.AddValue(Settings.IgnoreOriginalMeshIndexes);
+	Hash.AddValue(Settings.FixAnimationsTest);
+
+	for (auto& rule : normalizationRules.GetRules())
+	{
+		std::wstringstream ss;
+		rule.Write(ss);
+		Hash.AddString(ss.str());
 	}
 
-	FileStream.close();
+	Key = Hash.GetValue();
+	return true;
+}
 
-	return EError_OK;
+bool M2Lib::M2::IsBuildCacheable(uint8_t saveMask) const
+{
+	// remapping registers custom mappings and copies referenced files, those side effects can't be replayed from cache.
+	// import may register custom mappings as well, they are saved only by full save.
+	return buildCache.Active && saveMask == SAVE_ALL && !needRemapReferences && !needRemoveTXIDChunk && customFileInfosByFileDataId.empty();
 }
 
 M2Lib::EError M2Lib::M2::ImportM2Intermediate(wchar_t const* FileName)
 {
+	M2LIB_PROFILE_SCOPE("M2::ImportM2Intermediate");
+
 	if (!FileName)
 		return EError_FailedToImportM2I_NoFileSpecified;
 
@@ -1021,6 +1692,58 @@ M2Lib::EError M2Lib::M2::ImportM2Intermediate(wchar_t const* FileName)
 	if (!Header.Elements.nSkin)
 		return EError_FailedToExportM2I_M2NotLoaded;
 
+	// companion files are part of cache key
+	auto LazyError = LoadLazyParts();
+	if (LazyError != EError_OK)
+		return LazyError;
+
+	buildCache = BuildCacheState();
+	if (BuildCache::GetInstance()->IsEnabled() && CalcBuildCacheKey(FileName, buildCache.Key))
+	{
+		buildCache.Active = true;
+		buildCache.Hit = BuildCache::GetInstance()->Contains(buildCache.Key);
+	}
+
+	// import is skipped until model is accessed, save restores cached files without it
+	if (buildCache.Hit)
+	{
+		sLogger.LogInfo(L"Build cache entry %s found, import is deferred", ContentHash::ToString(buildCache.Key).c_str());
+		buildCache.PendingImport = FileName;
+		return EError_OK;
+	}
+
+	auto Error = m_ImportM2Intermediate(FileName);
+	if (Error != EError_OK)
+		buildCache = BuildCacheState();
+
+	return Error;
+}
+
+M2Lib::EError M2Lib::M2::LoadPendingImport()
+{
+	if (buildCache.PendingImport.empty())
+		return EError_OK;
+
+	// imported model is same as cached one, so entry can still be restored if model is not changed
+	auto FileName = std::move(buildCache.PendingImport);
+	buildCache.PendingImport.clear();
+	sLogger.LogInfo(L"Running import deferred by build cache");
+
+	auto Error = m_ImportM2Intermediate(FileName.c_str());
+	if (Error != EError_OK)
+		buildCache = BuildCacheState();
+
+	return Error;
+}
+
+M2Lib::EError M2Lib::M2::m_ImportM2Intermediate(wchar_t const* FileName)
+{
+	M2LIB_PROFILE_SCOPE("M2::BuildM2Intermediate");
+
+	auto LazyError = LoadLazyParts();
+	if (LazyError != EError_OK)
+		return LazyError;
+
 	if (pInM2I)
 		delete pInM2I;
 	pInM2I = new M2I();
@@ -1147,7 +1870,6 @@ M2Lib::EError M2Lib::M2::ImportM2Intermediate(wchar_t const* FileName)
 		if (NewSkinList[i])
 		{
 			NewSkinList[i]->CopyMaterials(pOriginalSkin0);
-			//NewSkinList[i]->SortSubMeshes();
 		}
 	}
 	delete pOriginalSkin0;
@@ -1459,6 +2181,10 @@ void M2Lib::M2::PrintInfo()
 
 void M2Lib::M2::PrintReferencedFileInfo()
 {
+	// resolving every referenced path is expensive, skip it when nobody listens
+	if (!sLogger.IsEnabled(LOG_INFO))
+		return;
+
 	sLogger.LogInfo(L"=====START REFERENCED FILE INFO=======");
 	auto skinChunk = (SFIDChunk*)GetChunk(EM2Chunk::Skin);
 	if (!skinChunk)
@@ -1707,7 +2433,8 @@ bool M2Lib::M2::RemapReferences(const wchar_t* m2FileName)
 		sLogger.LogCustom(L"Remapping file: [%u] %s to [%u] %s", info->FileDataId, info->Path.c_str(), newInfo->FileDataId, newInfo->Path.c_str());
 
 		const auto extension = ToLower<wchar_t>(newPath.extension().wstring().c_str());
-		if (extension != L".m2" && extension != L".skin" && extension != L".skel")
+		// modified animation files are saved to new path instead of being copied
+		if (extension != L".m2" && extension != L".skin" && extension != L".skel" && !IsAnimFileModified(info->FileDataId))
 			remapCopyFiles[info->FileDataId] = newInfo->FileDataId;
 
 		return true;
@@ -1830,6 +2557,8 @@ void M2Lib::M2::CopyRemappedFiles(const wchar_t* m2FileName)
 
 	std::filesystem::create_directories(outputDirectory);
 
+	// storage lookups and logging stay on this thread, only copies run on pool
+	std::vector<FileCopy::Job> Jobs;
 	for (auto itr : remapCopyFiles)
 	{
 		const auto oldInfo = GetFileInfoByFileDataId(itr.first);
@@ -1842,12 +2571,23 @@ void M2Lib::M2::CopyRemappedFiles(const wchar_t* m2FileName)
 			continue;
 		}
 
-		auto newPath = outputDirectory / newInfo->Path;
+		FileCopy::Job job;
+		job.Source = oldPath.wstring();
+		job.Destination = (outputDirectory / newInfo->Path).wstring();
+		Jobs.push_back(job);
+	}
+
+	auto Summary = FileCopy::CopyAll(Jobs, remapHardLinks);
 
-		sLogger.LogInfo(L"Copying '%s' to '%s'", oldPath.c_str(), newPath.c_str());
-		if (!std::filesystem::copy_file(oldPath, newPath, std::filesystem::copy_options::overwrite_existing))
-			sLogger.LogError(L"Failed to copy '%s' to '%s'", oldPath.c_str(), newPath.c_str());
+	for (auto& job : Jobs)
+	{
+		if (job.Result == FileCopy::EResult::Failed)
+			sLogger.LogError(L"Failed to copy '%s' to '%s': %s", job.Source.c_str(), job.Destination.c_str(), StringHelpers::StringToWString(job.Error.message()).c_str());
+		else
+			sLogger.LogInfo(L"Copying '%s' to '%s': %s", job.Source.c_str(), job.Destination.c_str(), FileCopy::GetResultName(job.Result));
 	}
+
+	Summary.Print();
 }
 
 // Gets the .skin file names.
@@ -1958,6 +2698,40 @@ bool M2Lib::M2::GetFileSkeleton(std::wstring& SkeletonFileNameResultBuffer, std:
 	return true;
 }
 
+bool M2Lib::M2::GetFileAnim(std::wstring& AnimFileNameResultBuffer, std::wstring const& M2FileName, uint16_t AnimationID, uint16_t AnimationSubID, uint32_t& FileDataId, bool Save)
+{
+	FileDataId = GetAnimFileDataId(AnimationID, AnimationSubID);
+	if (FileDataId)
+	{
+		auto info = GetFileInfoByFileDataId(FileDataId);
+		if (!info)
+		{
+			sLogger.LogError(L"Can't determine animation [%u] file name of sequence %u-%u", FileDataId, AnimationID, AnimationSubID);
+			return false;
+		}
+
+		if (!Save && wcslen(Settings.WorkingDirectory))
+			AnimFileNameResultBuffer = std::filesystem::path(Settings.WorkingDirectory) / info->Path;
+		else if (Save && wcslen(Settings.OutputDirectory))
+			AnimFileNameResultBuffer = std::filesystem::path(Settings.OutputDirectory) / info->Path;
+		else
+			AnimFileNameResultBuffer = std::filesystem::path(M2FileName).parent_path() / std::filesystem::path(info->Path).filename();
+
+		return true;
+	}
+
+	// AFID chunk lists all animation files of model
+	if (GetChunk(EM2Chunk::Animation) || GetSkeletonAFIDChunk())
+		return false;
+
+	// files of models without chunks are named after model
+	wchar_t Suffix[32];
+	std::swprintf(Suffix, 32, L"%04u-%02u.anim", AnimationID, AnimationSubID);
+	AnimFileNameResultBuffer = std::filesystem::path(M2FileName).parent_path() / (std::filesystem::path(M2FileName).stem().wstring() + Suffix);
+
+	return true;
+}
+
 bool M2Lib::M2::GetFileParentSkeleton(std::wstring& SkeletonFileNameResultBuffer, std::wstring const& M2FileName, bool Save) const
 {
 	if (!Skeleton)
@@ -2126,21 +2900,33 @@ M2Lib::DataElement* M2Lib::M2::GetAnimations()
 {
 	using namespace SkeletonChunk;
 
-	if (auto animationChunk = Skeleton ? (SKS1Chunk*)Skeleton->GetChunk(ESkeletonChunk::SKS1) : NULL)
+	if (auto animationChunk = GetSkeleton() ? (SKS1Chunk*)Skeleton->GetChunk(ESkeletonChunk::SKS1) : NULL)
 		return &animationChunk->Elements[SKS1Chunk::EElement_Animation];
-	if (auto animationChunk = ParentSkeleton ? (SKS1Chunk*)ParentSkeleton->GetChunk(ESkeletonChunk::SKS1) : NULL)
+	if (auto animationChunk = GetParentSkeleton() ? (SKS1Chunk*)ParentSkeleton->GetChunk(ESkeletonChunk::SKS1) : NULL)
 		return &animationChunk->Elements[SKS1Chunk::EElement_Animation];
 		
 	return &Elements[EElement_Animation];
 }
 
+M2Lib::DataElement const* M2Lib::M2::GetAnimationsForRead()
+{
+	using namespace SkeletonChunk;
+
+	if (auto animationChunk = GetSkeleton() ? (SKS1Chunk*)Skeleton->GetChunk(ESkeletonChunk::SKS1) : NULL)
+		return &animationChunk->Elements[SKS1Chunk::EElement_Animation];
+	if (auto animationChunk = GetParentSkeleton() ? (SKS1Chunk const*)ParentSkeleton->FindChunk(ESkeletonChunk::SKS1) : NULL)
+		return &animationChunk->Elements[SKS1Chunk::EElement_Animation];
+
+	return &Elements[EElement_Animation];
+}
+
 M2Lib::DataElement* M2Lib::M2::GetAnimationsLookup()
 {
 	using namespace SkeletonChunk;
 
-	if (auto animationChunk = Skeleton ? (SKS1Chunk*)Skeleton->GetChunk(ESkeletonChunk::SKS1) : NULL)
+	if (auto animationChunk = GetSkeleton() ? (SKS1Chunk*)Skeleton->GetChunk(ESkeletonChunk::SKS1) : NULL)
 		return &animationChunk->Elements[SKS1Chunk::EElement_AnimationLookup];
-	if (auto animationChunk = ParentSkeleton ? (SKS1Chunk*)ParentSkeleton->GetChunk(ESkeletonChunk::SKS1) : NULL)
+	if (auto animationChunk = GetParentSkeleton() ? (SKS1Chunk*)ParentSkeleton->GetChunk(ESkeletonChunk::SKS1) : NULL)
 		return &animationChunk->Elements[SKS1Chunk::EElement_AnimationLookup];
 
 	return &Elements[EElement_Animation];
@@ -2150,9 +2936,9 @@ M2Lib::DataElement* M2Lib::M2::GetBones()
 {
 	using namespace SkeletonChunk;
 
-	if (auto boneChunk = Skeleton ? (SKB1Chunk*)Skeleton->GetChunk(ESkeletonChunk::SKB1) : NULL)
+	if (auto boneChunk = GetSkeleton() ? (SKB1Chunk*)Skeleton->GetChunk(ESkeletonChunk::SKB1) : NULL)
 		return &boneChunk->Elements[SKB1Chunk::EElement_Bone];
-	if (auto boneChunk = ParentSkeleton ? (SKB1Chunk*)ParentSkeleton->GetChunk(ESkeletonChunk::SKB1) : NULL)
+	if (auto boneChunk = GetParentSkeleton() ? (SKB1Chunk*)ParentSkeleton->GetChunk(ESkeletonChunk::SKB1) : NULL)
 		return &boneChunk->Elements[SKB1Chunk::EElement_Bone];
 
 	return &Elements[EElement_Bone];
@@ -2162,9 +2948,9 @@ M2Lib::DataElement* M2Lib::M2::GetBoneLookups()
 {
 	using namespace SkeletonChunk;
 
-	if (auto boneChunk = Skeleton ? (SKB1Chunk*)Skeleton->GetChunk(ESkeletonChunk::SKB1) : NULL)
+	if (auto boneChunk = GetSkeleton() ? (SKB1Chunk*)Skeleton->GetChunk(ESkeletonChunk::SKB1) : NULL)
 		return &boneChunk->Elements[SKB1Chunk::EElement_KeyBoneLookup];
-	if (auto boneChunk = ParentSkeleton ? (SKB1Chunk*)ParentSkeleton->GetChunk(ESkeletonChunk::SKB1) : NULL)
+	if (auto boneChunk = GetParentSkeleton() ? (SKB1Chunk*)ParentSkeleton->GetChunk(ESkeletonChunk::SKB1) : NULL)
 		return &boneChunk->Elements[SKB1Chunk::EElement_KeyBoneLookup];
 		
 	return &Elements[EElement_KeyBoneLookup];
@@ -2174,22 +2960,22 @@ M2Lib::DataElement* M2Lib::M2::GetAttachments()
 {
 	using namespace SkeletonChunk;
 
-	if (auto attachmentChunk = Skeleton ? (SKA1Chunk*)Skeleton->GetChunk(ESkeletonChunk::SKA1) : NULL)
+	if (auto attachmentChunk = GetSkeleton() ? (SKA1Chunk*)Skeleton->GetChunk(ESkeletonChunk::SKA1) : NULL)
 		return &attachmentChunk->Elements[SKA1Chunk::EElement_Attachment];
-	if (auto attachmentChunk = ParentSkeleton ? (SKA1Chunk*)ParentSkeleton->GetChunk(ESkeletonChunk::SKA1) : NULL)
+	if (auto attachmentChunk = GetParentSkeleton() ? (SKA1Chunk*)ParentSkeleton->GetChunk(ESkeletonChunk::SKA1) : NULL)
 		return &attachmentChunk->Elements[SKA1Chunk::EElement_Attachment];
 		
 	return &Elements[EElement_Attachment];
 }
 
-M2Lib::SkeletonChunk::AFIDChunk* M2Lib::M2::GetSkeletonAFIDChunk()
+M2Lib::SkeletonChunk::AFIDChunk const* M2Lib::M2::GetSkeletonAFIDChunk()
 {
 	using namespace SkeletonChunk;
 
-	if (auto chunk = Skeleton ? Skeleton->GetChunk(ESkeletonChunk::AFID) : NULL)
-		return (SkeletonChunk::AFIDChunk*)chunk;
-	if (auto chunk = ParentSkeleton ? ParentSkeleton->GetChunk(ESkeletonChunk::AFID) : NULL)
-		return (SkeletonChunk::AFIDChunk*)chunk;
+	if (auto chunk = GetSkeleton() ? Skeleton->GetChunk(ESkeletonChunk::AFID) : NULL)
+		return (SkeletonChunk::AFIDChunk const*)chunk;
+	if (auto chunk = GetParentSkeleton() ? ParentSkeleton->FindChunk(ESkeletonChunk::AFID) : NULL)
+		return (SkeletonChunk::AFIDChunk const*)chunk;
 	
 
 	return NULL;
@@ -2222,210 +3008,215 @@ void M2Lib::M2::m_SaveElements_FindOffsets()
 		// if the current element's current offset doesn't match the calculated offset, some data has resized and we need to fix...
 		OffsetDelta = CurrentOffset - Elements[iElement].Offset;
 
-		switch (iElement)
+		// when nothing moved, offsets stored in element data are still valid and data stays shared with clones.
+		// particle emitters are always visited because offsets of their empty arrays are reset.
+		if (OffsetDelta != 0 || totalDiff != 0 || iElement == EElement_ParticleEmitter)
 		{
-			case EElement_Name:
-			case EElement_GlobalSequence:
-			case EElement_Animation:
-			case EElement_AnimationLookup:
-				break;
-
-			case EElement_Bone:
+			switch (iElement)
 			{
-				CElement_Bone* Bones = Elements[iElement].as<CElement_Bone>();
-				for (uint32_t j = 0; j < Elements[iElement].Count; ++j)
+				case EElement_Name:
+				case EElement_GlobalSequence:
+				case EElement_Animation:
+				case EElement_AnimationLookup:
+					break;
+
+				case EElement_Bone:
 				{
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, Bones[j].AnimationBlock_Position, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, Bones[j].AnimationBlock_Rotation, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, Bones[j].AnimationBlock_Scale, iElement);
+					CElement_Bone* Bones = Elements[iElement].as<CElement_Bone>();
+					for (uint32_t j = 0; j < Elements[iElement].Count; ++j)
+					{
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, Bones[j].AnimationBlock_Position, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, Bones[j].AnimationBlock_Rotation, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, Bones[j].AnimationBlock_Scale, iElement);
+					}
+					break;
 				}
-				break;
-			}
-			case EElement_KeyBoneLookup:
-			case EElement_Vertex:
-				break;
+				case EElement_KeyBoneLookup:
+				case EElement_Vertex:
+					break;
 
-			case EElement_Color:
-			{
-				CElement_Color* Colors = Elements[iElement].as<CElement_Color>();
-				for (uint32_t j = 0; j < Elements[iElement].Count; ++j)
+				case EElement_Color:
 				{
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, Colors[j].AnimationBlock_Color, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, Colors[j].AnimationBlock_Opacity, iElement);
+					CElement_Color* Colors = Elements[iElement].as<CElement_Color>();
+					for (uint32_t j = 0; j < Elements[iElement].Count; ++j)
+					{
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, Colors[j].AnimationBlock_Color, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, Colors[j].AnimationBlock_Opacity, iElement);
+					}
+					break;
 				}
-				break;
-			}
 
-			case EElement_Texture:
-			{
-				CElement_Texture* Textures = Elements[iElement].as<CElement_Texture>();
-				for (uint32_t j = 0; j < Elements[iElement].Count; ++j)
+				case EElement_Texture:
 				{
-					if (Textures[j].TexturePath.Offset)
+					CElement_Texture* Textures = Elements[iElement].as<CElement_Texture>();
+					for (uint32_t j = 0; j < Elements[iElement].Count; ++j)
 					{
-						VERIFY_OFFSET_LOCAL(Textures[j].TexturePath.Offset);
-						Textures[j].TexturePath.Offset += OffsetDelta;
+						if (Textures[j].TexturePath.Offset)
+						{
+							VERIFY_OFFSET_LOCAL(Textures[j].TexturePath.Offset);
+							Textures[j].TexturePath.Offset += OffsetDelta;
+						}
 					}
+					break;
 				}
-				break;
-			}
 
-			case EElement_Transparency:
-			{
-				CElement_Transparency* Transparencies = Elements[iElement].as<CElement_Transparency>();
-				for (uint32_t j = 0; j < Elements[iElement].Count; ++j)
+				case EElement_Transparency:
 				{
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, Transparencies[j].AnimationBlock_Transparency, iElement);
+					CElement_Transparency* Transparencies = Elements[iElement].as<CElement_Transparency>();
+					for (uint32_t j = 0; j < Elements[iElement].Count; ++j)
+					{
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, Transparencies[j].AnimationBlock_Transparency, iElement);
+					}
+					break;
 				}
-				break;
-			}
-			case EElement_TextureAnimation:
-			{
-				CElement_UVAnimation* Animations = Elements[iElement].as<CElement_UVAnimation>();
-				for (uint32_t j = 0; j < Elements[iElement].Count; ++j)
+				case EElement_TextureAnimation:
 				{
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, Animations[j].AnimationBlock_Position, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, Animations[j].AnimationBlock_Rotation, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, Animations[j].AnimationBlock_Scale, iElement);
+					CElement_UVAnimation* Animations = Elements[iElement].as<CElement_UVAnimation>();
+					for (uint32_t j = 0; j < Elements[iElement].Count; ++j)
+					{
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, Animations[j].AnimationBlock_Position, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, Animations[j].AnimationBlock_Rotation, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, Animations[j].AnimationBlock_Scale, iElement);
+					}
+					break;
 				}
-				break;
-			}
 
-			case EElement_TextureReplace:
-			case EElement_TextureFlags:
-			case EElement_SkinnedBoneLookup:
-			case EElement_TextureLookup:
-			case EElement_TextureUnitLookup:
-			case EElement_TransparencyLookup:
-			case EElement_TextureAnimationLookup:
-			case EElement_BoundingTriangle:
-			case EElement_BoundingVertex:
-			case EElement_BoundingNormal:
-				break;
+				case EElement_TextureReplace:
+				case EElement_TextureFlags:
+				case EElement_SkinnedBoneLookup:
+				case EElement_TextureLookup:
+				case EElement_TextureUnitLookup:
+				case EElement_TransparencyLookup:
+				case EElement_TextureAnimationLookup:
+				case EElement_BoundingTriangle:
+				case EElement_BoundingVertex:
+				case EElement_BoundingNormal:
+					break;
 
-			case EElement_Attachment:
-			{
-				CElement_Attachment* Attachments = Elements[iElement].as<CElement_Attachment>();
-				for (uint32_t j = 0; j < Elements[iElement].Count; ++j)
+				case EElement_Attachment:
 				{
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, Attachments[j].AnimationBlock_Visibility, iElement);
+					CElement_Attachment* Attachments = Elements[iElement].as<CElement_Attachment>();
+					for (uint32_t j = 0; j < Elements[iElement].Count; ++j)
+					{
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, Attachments[j].AnimationBlock_Visibility, iElement);
+					}
+					break;
 				}
-				break;
-			}
-
-			case EElement_AttachmentLookup:
-				break;
-
-			case EElement_Event:
-			{
-				CElement_Event* Events = Elements[iElement].as<CElement_Event>();
-				for (uint32_t j = 0; j < Elements[iElement].Count; ++j)
-					m_FixAnimationM2Array(OffsetDelta, totalDiff, Events[j].GlobalSequenceID, Events[j].TimeLines, iElement);
 
-				break;
-			}
+				case EElement_AttachmentLookup:
+					break;
 
-			case EElement_Light:
-			{
-				CElement_Light* Lights = Elements[iElement].as<CElement_Light>();
-				for (uint32_t j = 0; j < Elements[iElement].Count; ++j)
+				case EElement_Event:
 				{
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, Lights[j].AnimationBlock_AmbientColor, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, Lights[j].AnimationBlock_AmbientIntensity, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, Lights[j].AnimationBlock_DiffuseColor, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, Lights[j].AnimationBlock_DiffuseIntensity, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, Lights[j].AnimationBlock_AttenuationStart, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, Lights[j].AnimationBlock_AttenuationEnd, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, Lights[j].AnimationBlock_Visibility, iElement);
-				}
-				break;
-			}
+					CElement_Event* Events = Elements[iElement].as<CElement_Event>();
+					for (uint32_t j = 0; j < Elements[iElement].Count; ++j)
+						m_FixAnimationM2Array(OffsetDelta, totalDiff, Events[j].GlobalSequenceID, Events[j].TimeLines, iElement);
 
-			case EElement_Camera:
-			{
-				CElement_Camera* Cameras = Elements[iElement].as<CElement_Camera>();
-				for (uint32_t j = 0; j < Elements[iElement].Count; ++j)
-				{
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, Cameras[j].AnimationBlock_Position, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, Cameras[j].AnimationBlock_Target, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, Cameras[j].AnimationBlock_Roll, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, Cameras[j].AnimationBlock_FieldOfView, iElement);
+					break;
 				}
-				break;
-			}
-
-			case EElement_CameraLookup:
-				break;
 
-			case EElement_RibbonEmitter:
-			{
-				// untested!
-				CElement_RibbonEmitter* RibbonEmitters = Elements[iElement].as<CElement_RibbonEmitter>();
-				for (uint32_t j = 0; j < Elements[iElement].Count; ++j)
+				case EElement_Light:
 				{
-					VERIFY_OFFSET_LOCAL(RibbonEmitters[j].TextureIndices.Offset);
-					RibbonEmitters[j].TextureIndices.Offset += OffsetDelta;
-					VERIFY_OFFSET_LOCAL(RibbonEmitters[j].MaterialIndices.Offset);
-					RibbonEmitters[j].MaterialIndices.Offset += OffsetDelta;
-
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, RibbonEmitters[j].AnimationBlock_Color, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, RibbonEmitters[j].AnimationBlock_Opacity, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, RibbonEmitters[j].AnimationBlock_HeightAbove, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, RibbonEmitters[j].AnimationBlock_HeightBelow, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, RibbonEmitters[j].AnimationBlock_TexSlotTrack, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, RibbonEmitters[j].AnimationBlock_Visibility, iElement);
+					CElement_Light* Lights = Elements[iElement].as<CElement_Light>();
+					for (uint32_t j = 0; j < Elements[iElement].Count; ++j)
+					{
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, Lights[j].AnimationBlock_AmbientColor, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, Lights[j].AnimationBlock_AmbientIntensity, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, Lights[j].AnimationBlock_DiffuseColor, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, Lights[j].AnimationBlock_DiffuseIntensity, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, Lights[j].AnimationBlock_AttenuationStart, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, Lights[j].AnimationBlock_AttenuationEnd, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, Lights[j].AnimationBlock_Visibility, iElement);
+					}
+					break;
 				}
-				break;
-			}
 
-			case EElement_ParticleEmitter:
-			{
-				CElement_ParticleEmitter* ParticleEmitters = Elements[iElement].as<CElement_ParticleEmitter>();
-				for (uint32_t j = 0; j < Elements[iElement].Count; ++j)
+				case EElement_Camera:
 				{
-					if (ParticleEmitters[j].GeometryFileNameModel.Count)
+					CElement_Camera* Cameras = Elements[iElement].as<CElement_Camera>();
+					for (uint32_t j = 0; j < Elements[iElement].Count; ++j)
 					{
-						VERIFY_OFFSET_LOCAL(ParticleEmitters[j].GeometryFileNameModel.Offset);
-						ParticleEmitters[j].GeometryFileNameModel.Offset += OffsetDelta;
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, Cameras[j].AnimationBlock_Position, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, Cameras[j].AnimationBlock_Target, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, Cameras[j].AnimationBlock_Roll, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, Cameras[j].AnimationBlock_FieldOfView, iElement);
 					}
-					else
-						ParticleEmitters[j].GeometryFileNameModel.Offset = 0;
+					break;
+				}
+
+				case EElement_CameraLookup:
+					break;
 
-					if (ParticleEmitters[j].RecursionFileNameModel.Count)
+				case EElement_RibbonEmitter:
+				{
+					// untested!
+					CElement_RibbonEmitter* RibbonEmitters = Elements[iElement].as<CElement_RibbonEmitter>();
+					for (uint32_t j = 0; j < Elements[iElement].Count; ++j)
 					{
-						VERIFY_OFFSET_LOCAL(ParticleEmitters[j].RecursionFileNameModel.Offset);
-						ParticleEmitters[j].RecursionFileNameModel.Offset += OffsetDelta;
+						VERIFY_OFFSET_LOCAL(RibbonEmitters[j].TextureIndices.Offset);
+						RibbonEmitters[j].TextureIndices.Offset += OffsetDelta;
+						VERIFY_OFFSET_LOCAL(RibbonEmitters[j].MaterialIndices.Offset);
+						RibbonEmitters[j].MaterialIndices.Offset += OffsetDelta;
+
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, RibbonEmitters[j].AnimationBlock_Color, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, RibbonEmitters[j].AnimationBlock_Opacity, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, RibbonEmitters[j].AnimationBlock_HeightAbove, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, RibbonEmitters[j].AnimationBlock_HeightBelow, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, RibbonEmitters[j].AnimationBlock_TexSlotTrack, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, RibbonEmitters[j].AnimationBlock_Visibility, iElement);
 					}
-					else
-						ParticleEmitters[j].RecursionFileNameModel.Offset = 0;
+					break;
+				}
 
-					if (ParticleEmitters[j].SplinePoints.Count)
+				case EElement_ParticleEmitter:
+				{
+					CElement_ParticleEmitter* ParticleEmitters = Elements[iElement].as<CElement_ParticleEmitter>();
+					for (uint32_t j = 0; j < Elements[iElement].Count; ++j)
 					{
-						VERIFY_OFFSET_LOCAL(ParticleEmitters[j].SplinePoints.Offset);
-						ParticleEmitters[j].SplinePoints.Offset += OffsetDelta;
+						if (ParticleEmitters[j].GeometryFileNameModel.Count)
+						{
+							VERIFY_OFFSET_LOCAL(ParticleEmitters[j].GeometryFileNameModel.Offset);
+							ParticleEmitters[j].GeometryFileNameModel.Offset += OffsetDelta;
+						}
+						else
+							ParticleEmitters[j].GeometryFileNameModel.Offset = 0;
+
+						if (ParticleEmitters[j].RecursionFileNameModel.Count)
+						{
+							VERIFY_OFFSET_LOCAL(ParticleEmitters[j].RecursionFileNameModel.Offset);
+							ParticleEmitters[j].RecursionFileNameModel.Offset += OffsetDelta;
+						}
+						else
+							ParticleEmitters[j].RecursionFileNameModel.Offset = 0;
+
+						if (ParticleEmitters[j].SplinePoints.Count)
+						{
+							VERIFY_OFFSET_LOCAL(ParticleEmitters[j].SplinePoints.Offset);
+							ParticleEmitters[j].SplinePoints.Offset += OffsetDelta;
+						}
+						else
+							ParticleEmitters[j].SplinePoints.Offset = 0;
+
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, ParticleEmitters[j].AnimationBlock_EmitSpeed, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, ParticleEmitters[j].AnimationBlock_SpeedVariance, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, ParticleEmitters[j].AnimationBlock_VerticalRange, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, ParticleEmitters[j].AnimationBlock_HorizontalRange, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, ParticleEmitters[j].AnimationBlock_Gravity, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, ParticleEmitters[j].AnimationBlock_Lifespan, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, ParticleEmitters[j].AnimationBlock_EmissionRate, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, ParticleEmitters[j].AnimationBlock_EmissionAreaLength, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, ParticleEmitters[j].AnimationBlock_EmissionAreaWidth, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, ParticleEmitters[j].AnimationBlock_zSource, iElement);
+						m_FixAnimationOffsets(OffsetDelta, totalDiff, ParticleEmitters[j].AnimationBlock_EnabledIn, iElement);
+
+						m_FixFakeAnimationBlockOffsets_Old(OffsetDelta, totalDiff, ParticleEmitters[j].ColorTrack, iElement);
+						m_FixFakeAnimationBlockOffsets_Old(OffsetDelta, totalDiff, ParticleEmitters[j].AlphaTrack, iElement);
+						m_FixFakeAnimationBlockOffsets_Old(OffsetDelta, totalDiff, ParticleEmitters[j].ScaleTrack, iElement);
+						m_FixFakeAnimationBlockOffsets_Old(OffsetDelta, totalDiff, ParticleEmitters[j].HeadCellTrack, iElement);
+						m_FixFakeAnimationBlockOffsets_Old(OffsetDelta, totalDiff, ParticleEmitters[j].TailCellTrack, iElement);
 					}
-					else
-						ParticleEmitters[j].SplinePoints.Offset = 0;
-
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, ParticleEmitters[j].AnimationBlock_EmitSpeed, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, ParticleEmitters[j].AnimationBlock_SpeedVariance, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, ParticleEmitters[j].AnimationBlock_VerticalRange, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, ParticleEmitters[j].AnimationBlock_HorizontalRange, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, ParticleEmitters[j].AnimationBlock_Gravity, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, ParticleEmitters[j].AnimationBlock_Lifespan, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, ParticleEmitters[j].AnimationBlock_EmissionRate, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, ParticleEmitters[j].AnimationBlock_EmissionAreaLength, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, ParticleEmitters[j].AnimationBlock_EmissionAreaWidth, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, ParticleEmitters[j].AnimationBlock_zSource, iElement);
-					m_FixAnimationOffsets(OffsetDelta, totalDiff, ParticleEmitters[j].AnimationBlock_EnabledIn, iElement);
-
-					m_FixFakeAnimationBlockOffsets_Old(OffsetDelta, totalDiff, ParticleEmitters[j].ColorTrack, iElement);
-					m_FixFakeAnimationBlockOffsets_Old(OffsetDelta, totalDiff, ParticleEmitters[j].AlphaTrack, iElement);
-					m_FixFakeAnimationBlockOffsets_Old(OffsetDelta, totalDiff, ParticleEmitters[j].ScaleTrack, iElement);
-					m_FixFakeAnimationBlockOffsets_Old(OffsetDelta, totalDiff, ParticleEmitters[j].HeadCellTrack, iElement);
-					m_FixFakeAnimationBlockOffsets_Old(OffsetDelta, totalDiff, ParticleEmitters[j].TailCellTrack, iElement);
+					break;
 				}
-				break;
 			}
 		}
 
@@ -2890,15 +3681,13 @@ std::wstring M2Lib::M2::GetTexturePath(uint32_t Index)
 
 M2Lib::EError M2Lib::M2::SetNeedRemoveTXIDChunk()
 {
-	auto chunkItr = Chunks.find(EM2Chunk::Texture);
-	if (chunkItr == Chunks.end())
+	auto chunk = (M2Chunk::TXIDChunk*)GetChunk(EM2Chunk::Texture);
+	if (!chunk)
 	{
 		sLogger.LogCustom(L"TXID chunk not present, skipping");
 		return EError_FAIL;
 	}
 
-	auto chunk = (M2Chunk::TXIDChunk*)chunkItr->second;
-
 	auto& Element = Elements[EElement_Texture];
 	for (uint32_t i = 0; i < chunk->TextureFileDataIds.size(); ++i)
 	{
@@ -2933,6 +3722,10 @@ M2Lib::EError M2Lib::M2::SetNeedRemapReferences(const wchar_t* remapPath)
 
 M2Lib::EError M2Lib::M2::AddNormalizationRule(int sourceType, uint32_t* sourceData, uint32_t sourceLen, int targetType, uint32_t* targetData, uint32_t targetLen, bool preferSource)
 {
+	// rule applies to import that comes after it
+	if (EError Error = LoadPendingImport())
+		return Error;
+
 	normalizationRules.Add(sourceType, sourceData, sourceLen, targetType, targetData, targetLen, preferSource);
 
 	return EError_OK;
@@ -2949,15 +3742,13 @@ void M2Lib::M2::RemoveTXIDChunk()
 {
 	sLogger.LogInfo(L"Erasing TXID chunk from model");
 
-	auto chunkItr = Chunks.find(EM2Chunk::Texture);
-	if (chunkItr == Chunks.end())
+	auto chunk = (M2Chunk::TXIDChunk*)GetChunk(EM2Chunk::Texture);
+	if (!chunk)
 	{
 		sLogger.LogInfo(L"TXID chunk not present, skipping");
 		return;
 	}
 
-	auto chunk = (M2Chunk::TXIDChunk*)chunkItr->second;
-
 	uint32_t newDataLen = 0;
 	std::map<uint32_t, std::string> PathsByTextureId;
 
@@ -2985,7 +3776,7 @@ void M2Lib::M2::RemoveTXIDChunk()
 
 	if (!newDataLen)
 	{
-		Chunks.erase(chunkItr);
+		RemoveChunk(EM2Chunk::Texture);
 		return;
 	}
 
@@ -3004,7 +3795,7 @@ void M2Lib::M2::RemoveTXIDChunk()
 
 	sLogger.LogInfo(L"Moved %u textures from chunk", PathsByTextureId.size());
 
-	Chunks.erase(chunkItr);
+	RemoveChunk(EM2Chunk::Texture);
 }
 
 uint32_t M2Lib::M2::AddTextureLookup(uint16_t TextureId, bool ForceNewIndex /*= false*/)
@@ -3109,6 +3900,87 @@ M2Lib::EError M2Lib::M2_SetReplaceM2(M2LIB_HANDLE handle, const wchar_t* FileNam
 	}
 }
 
+M2LIB_HANDLE M2Lib::M2_Clone(M2LIB_HANDLE handle)
+{
+	try
+	{
+		return static_cast<M2*>(handle)->Clone();
+	}
+	catch (std::exception& e)
+	{
+		sLogger.LogError(L"Exception: %s", StringHelpers::StringToWString(e.what()).c_str());
+
+		return nullptr;
+	}
+}
+
+void M2Lib::M2_SetLazyLoad(M2LIB_HANDLE handle, bool Lazy)
+{
+	try
+	{
+		static_cast<M2*>(handle)->SetLazyLoad(Lazy);
+	}
+	catch (std::exception& e)
+	{
+		sLogger.LogError(L"Exception: %s", StringHelpers::StringToWString(e.what()).c_str());
+	}
+}
+
+M2Lib::EError M2Lib::M2_LoadLazyParts(M2LIB_HANDLE handle)
+{
+	try
+	{
+		return static_cast<M2*>(handle)->LoadLazyParts();
+	}
+	catch (std::exception& e)
+	{
+		sLogger.LogError(L"Exception: %s", StringHelpers::StringToWString(e.what()).c_str());
+
+		return EError_FAIL;
+	}
+}
+
+void M2Lib::M2_PrintLazyLoadInfo(M2LIB_HANDLE handle)
+{
+	try
+	{
+		static_cast<M2*>(handle)->PrintLazyLoadInfo();
+	}
+	catch (std::exception& e)
+	{
+		sLogger.LogError(L"Exception: %s", StringHelpers::StringToWString(e.what()).c_str());
+	}
+}
+
+uint64_t M2Lib::M2_GetMemoryUsage(M2LIB_HANDLE handle)
+{
+	try
+	{
+		MemoryReport Report;
+		static_cast<M2*>(handle)->GetMemoryUsage(Report);
+
+		return Report.GetTotal();
+	}
+	catch (std::exception& e)
+	{
+		sLogger.LogError(L"Exception: %s", StringHelpers::StringToWString(e.what()).c_str());
+
+		return 0;
+	}
+}
+
+void M2Lib::M2_PrintMemoryUsage(M2LIB_HANDLE handle)
+{
+	try
+	{
+		static_cast<M2*>(handle)->PrintMemoryUsage();
+	}
+	catch (std::exception& e)
+	{
+		sLogger.LogError(L"Exception: %s", StringHelpers::StringToWString(e.what()).c_str());
+	}
+}
+
 M2Lib::EError M2Lib::M2_ExportM2Intermediate(M2LIB_HANDLE handle, const wchar_t* FileName)
 {
 	try
@@ -3151,6 +4023,46 @@ M2Lib::EError M2Lib::M2_SetNeedRemapReferences(M2LIB_HANDLE handle, const wchar_
 	}
 }
 
+void M2Lib::M2_SetRemapHardLinks(M2LIB_HANDLE handle, bool HardLinks)
+{
+	try
+	{
+		static_cast<M2*>(handle)->SetRemapHardLinks(HardLinks);
+	}
+	catch (std::exception& e)
+	{
+		sLogger.LogError(L"Exception: %s", StringHelpers::StringToWString(e.what()).c_str());
+	}
+}
+
+M2Lib::EError M2Lib::M2_ReduceKeyframes(M2LIB_HANDLE handle, float PositionTolerance, float AngleTolerance)
+{
+	try
+	{
+		return static_cast<M2*>(handle)->ReduceKeyframes(PositionTolerance, AngleTolerance);
+	}
+	catch (std::exception& e)
+	{
+		sLogger.LogError(L"Exception: %s", StringHelpers::StringToWString(e.what()).c_str());
+
+		return EError_FAIL;
+	}
+}
+
+M2Lib::EError M2Lib::M2_CalculateAnimationBounds(M2LIB_HANDLE handle, uint32_t SampleInterval)
+{
+	try
+	{
+		return static_cast<M2*>(handle)->CalculateAnimationBounds(SampleInterval);
+	}
+	catch (std::exception& e)
+	{
+		sLogger.LogError(L"Exception: %s", StringHelpers::StringToWString(e.what()).c_str());
+
+		return EError_FAIL;
+	}
+}
+
 M2Lib::EError M2Lib::M2_SetNeedRemoveTXIDChunk(M2LIB_HANDLE handle)
 {
 	try
@@ -19,9 +19,14 @@
 namespace M2Lib
 {
 	class FileStorage;
+	class FilePrefetch;
+	class SaveBatch;
 	struct FileInfo;
 	struct Settings;
 	class Skeleton;
+	class AnimFile;
+	class BenchmarkSuite;
+	class MemoryReport;
 
 	namespace SkeletonChunk
 	{
@@ -86,6 +91,8 @@ namespace M2Lib
 	// load, export, import merge, save: M2 file.
 	class M2
 	{
+		friend class BenchmarkSuite;
+
 	public:
 
 #pragma pack(push,1)
@@ -239,15 +246,25 @@ namespace M2Lib
 	private:
 		std::wstring _FileName;	// needed to create skin file names so we can load/save skins.
 
-		std::map<M2Chunk::EM2Chunk, ChunkBase*> Chunks;
+		ChunkList Chunks { M2Chunk::GetChunkTable() };
 
 		M2Lib::Skeleton* Skeleton;
 		M2Lib::Skeleton* ParentSkeleton;
 		bool hasLodSkins;
 
+		struct ExternalAnimation
+		{
+			uint32_t FileDataId = 0;	// 0 for files named after model
+			AnimFile* File = NULL;		// NULL if file could not be loaded
+		};
+
+		// external animation files by animation id in high and sub animation id in low word
+		std::map<uint32_t, ExternalAnimation> animFiles;
+
 		bool needRemapReferences;
 		std::wstring remapPath;
 		std::map<uint32_t, uint32_t> remapCopyFiles;
+		bool remapHardLinks = false;
 
 		bool needRemoveTXIDChunk; // TXID chunk will be removed when model has textures that are not indexed in CASC storage
 
@@ -289,14 +306,44 @@ namespace M2Lib
 		// loads an M2 from a file.
 		EError Load(const wchar_t* FileName);
 
+		// enables lazy loading, must be called before Load().
+		// only model chunk is parsed by Load(), skins, skeletons and other chunks are loaded on first access.
+		void SetLazyLoad(bool Lazy);
+		// loads everything that was skipped by lazy loading, and runs import deferred by build cache hit.
+		EError LoadLazyParts();
+		// prints which parts were loaded on demand and how many bytes were not read.
+		void PrintLazyLoadInfo();
+
+		// adds heap memory held by model, its skins, chunks, skeletons, replace model and imported M2I to Report.
+		// element data shared with clones is split evenly between them.
+		void GetMemoryUsage(MemoryReport& Report) const;
+		// logs memory breakdown of model, largest parts first.
+		void PrintMemoryUsage() const;
+
+		// returns skin, loads it if it was not loaded yet. returns NULL if skin is not present.
+		M2Skin* GetSkin(uint32_t Index);
+		M2Lib::Skeleton* GetSkeleton();
+		M2Lib::Skeleton* GetParentSkeleton();
+		// returns external animation file with keys of sequence, file is found through AFID chunk of model or skeleton and mapped on first access.
+		// returns NULL for sequences stored in model or skeleton file and if file can't be loaded.
+		// files modified through AnimFile::GetMutableData() are saved with SAVE_OTHER.
+		AnimFile* GetAnimFile(uint32_t AnimationIndex);
+
 		EError SetReplaceM2(const wchar_t* FileName);
 
+		// creates deep copy of loaded model including skins, chunks and skeletons.
+		// element data is shared with copy until either of models modifies it, so one loaded model can be used as base for many imports.
+		M2* Clone() const;
+
 		// saves this M2 to a file.
 		EError Save(const wchar_t* FileName, uint8_t saveMask);
 
 		// exports the loaded M2 as an M2I file.
 		EError ExportM2Intermediate(wchar_t const* FileName);
 		// imports an M2I file and merges it with already loaded M2.
+		// if build cache has result for same inputs, import is deferred and Save() restores cached files.
+		// import is run if model is accessed through GetSkin(), GetSkeleton(), LoadLazyParts() or any operation before save,
+		// code that reads Elements directly must call LoadLazyParts() first.
 		EError ImportM2Intermediate(wchar_t const* FileName);
 		
 		// prints diagnostic information.
@@ -314,18 +361,60 @@ namespace M2Lib
 		void RemoveTXIDChunk();
 		EError SetNeedRemoveTXIDChunk();
 		EError SetNeedRemapReferences(const wchar_t* remapPath);
+		// remapped files are hard linked instead of copied where file system allows it
+		void SetRemapHardLinks(bool HardLinks);
+		// removes animation keys that interpolation of neighbouring keys reproduces within tolerances, logs kept and removed keys per track type.
+		// key arrays keep their place in file, bytes of removed keys are zeroed, so file size is not changed.
+		// PositionTolerance is in model units, AngleTolerance is in radians.
+		EError ReduceKeyframes(float PositionTolerance, float AngleTolerance);
+		// recalculates bounding volumes of sequences from vertices skinned every SampleInterval milliseconds.
+		// sequences stored in .anim files are sampled if their files can be loaded.
+		EError CalculateAnimationBounds(uint32_t SampleInterval);
 		EError AddNormalizationRule(int sourceType, uint32_t* sourceData, uint32_t sourceLen, int targetType, uint32_t* targetData, uint32_t targetLen, bool preferSource);
 		EError SetSaveMappingsCallback(SaveMappingsCallback callback);
 
 		DataElement* GetAnimations();
+		// same as GetAnimations(), but parent skeleton shared with skeleton cache is not copied
+		DataElement const* GetAnimationsForRead();
 		DataElement* GetAnimationsLookup();
 		DataElement* GetBones();
 		DataElement* GetBoneLookups();
 		DataElement* GetAttachments();
 
-		SkeletonChunk::AFIDChunk* GetSkeletonAFIDChunk();
+		SkeletonChunk::AFIDChunk const* GetSkeletonAFIDChunk();
 
 	private:
+		struct LazyLoadState
+		{
+			bool Enabled = false;
+			bool SkinPending[SKIN_COUNT] = {};
+			bool LodSkinsPending = false;
+			bool SkeletonPending = false;
+
+			uint64_t BytesRead = 0;				// bytes of files loaded on demand
+			std::vector<std::wstring> Touched;	// parts loaded on demand in order of access
+		} lazy;
+
+		struct BuildCacheState
+		{
+			bool Active = false;		// result of current import may be stored in build cache, cleared when model is changed after import
+			bool Hit = false;			// cache has entry for current import, Save() restores it instead of writing model
+			uint64_t Key = 0;
+			std::wstring PendingImport;	// M2I file whose import was deferred by cache hit
+		} buildCache;
+
+		bool CalcBuildCacheKey(wchar_t const* M2IFileName, uint64_t& Key);
+		bool IsBuildCacheable(uint8_t saveMask) const;
+		// model was changed after import, result of import no longer matches cached one. pending import must be run before.
+		void InvalidateBuildCache() { m2lib_assert(buildCache.PendingImport.empty()); buildCache = BuildCacheState(); }
+		EError m_ImportM2Intermediate(wchar_t const* FileName);
+		// runs import deferred by cache hit, model is accessed before or after cached files are restored
+		EError LoadPendingImport();
+
+		EError LoadLazySkin(uint32_t Index);
+		EError LoadLazySkeleton();
+		void CountLazyRead(std::wstring const& Part, std::wstring const& FileName);
+
 		// utilities and tests
 
 		// averages normals of duplicate vertices within submeshes.
@@ -350,16 +439,26 @@ namespace M2Lib
 		uint32_t CloneTexture(uint16_t TextureId);
 		uint32_t AddTextureFlags(M2Element::CElement_TextureFlag::EFlags Flags, M2Element::CElement_TextureFlag::EBlend Blend);
 
-		EError LoadSkins();
-		EError SaveSkins(wchar_t const* M2FileName);
+		EError LoadSkins(std::wstring const* SkinFileNames, FilePrefetch& Prefetch);
+		EError LoadLodSkins(std::wstring const* SkinFileNames, FilePrefetch& Prefetch);
+		EError SaveSkins(wchar_t const* M2FileName, SaveBatch& Batch);
 
 		bool GetFileSkin(std::wstring& SkinFileNameResultBuffer, std::wstring const& M2FileName, uint32_t SkinIndex, bool Save);
 		bool GetFileSkeleton(std::wstring& SkeletonFileNameResultBuffer, std::wstring const& M2FileName, bool Save);
 		bool GetFileParentSkeleton(std::wstring& SkeletonFileNameResultBuffer, std::wstring const& M2FileName, bool Save) const;
 		std::wstring BuildFsPath(std::wstring const& path);
 
-		EError LoadSkeleton();
-		EError SaveSkeleton(std::wstring const& M2FileName);
+		EError LoadSkeleton(std::wstring const& FileNameSkeleton, FilePrefetch& Prefetch);
+		// parent skeleton is resolved through file data id stored in skeleton, returns false if skeleton has no parent or it is not listed
+		bool GetParentSkeletonSource(uint32_t& FileDataId, std::wstring& FileName);
+		EError LoadParentSkeleton(FilePrefetch& Prefetch);
+		EError SaveSkeleton(std::wstring const& M2FileName, SaveBatch& Batch);
+
+		// FileDataId is 0 if animation file is not listed in AFID chunk and has legacy name
+		bool GetFileAnim(std::wstring& AnimFileNameResultBuffer, std::wstring const& M2FileName, uint16_t AnimationID, uint16_t AnimationSubID, uint32_t& FileDataId, bool Save);
+		uint32_t GetAnimFileDataId(uint16_t AnimationID, uint16_t AnimationSubID);
+		EError SaveAnimFiles(std::wstring const& M2FileName, SaveBatch& Batch);
+		bool IsAnimFileModified(uint32_t FileDataId) const;
 
 		EError SaveCustomMappings(wchar_t const* fileName);
 
@@ -397,9 +496,18 @@ namespace M2Lib
 	M2LIB_API EError __cdecl M2_Load(M2LIB_HANDLE handle, const wchar_t* FileName);
 	M2LIB_API EError __cdecl M2_Save(M2LIB_HANDLE handle, const wchar_t* FileName, uint8_t saveMask);
 	M2LIB_API EError __cdecl M2_SetReplaceM2(M2LIB_HANDLE handle, const wchar_t* FileName);
+	M2LIB_API M2LIB_HANDLE __cdecl M2_Clone(M2LIB_HANDLE handle);
+	M2LIB_API void __cdecl M2_SetLazyLoad(M2LIB_HANDLE handle, bool Lazy);
+	M2LIB_API EError __cdecl M2_LoadLazyParts(M2LIB_HANDLE handle);
+	M2LIB_API void __cdecl M2_PrintLazyLoadInfo(M2LIB_HANDLE handle);
+	M2LIB_API uint64_t __cdecl M2_GetMemoryUsage(M2LIB_HANDLE handle);
+	M2LIB_API void __cdecl M2_PrintMemoryUsage(M2LIB_HANDLE handle);
 	M2LIB_API EError __cdecl M2_ExportM2Intermediate(M2LIB_HANDLE handle, const wchar_t* FileName);
 	M2LIB_API EError __cdecl M2_ImportM2Intermediate(M2LIB_HANDLE handle, const wchar_t* FileName);
 	M2LIB_API EError __cdecl M2_SetNeedRemapReferences(M2LIB_HANDLE handle, const wchar_t* remapPath);
+	M2LIB_API void __cdecl M2_SetRemapHardLinks(M2LIB_HANDLE handle, bool HardLinks);
+	M2LIB_API EError __cdecl M2_ReduceKeyframes(M2LIB_HANDLE handle, float PositionTolerance, float AngleTolerance);
+	M2LIB_API EError __cdecl M2_CalculateAnimationBounds(M2LIB_HANDLE handle, uint32_t SampleInterval);
 	M2LIB_API EError __cdecl M2_SetNeedRemoveTXIDChunk(M2LIB_HANDLE handle);
 	M2LIB_API EError __cdecl M2_AddNormalizationRule(M2LIB_HANDLE handle, int sourceType, uint32_t* sourceData, uint32_t sourceLen, int targetType, uint32_t* targetData, uint32_t targetLen, bool preferSource);
 	M2LIB_API EError __cdecl M2_SetSaveMappingsCallback(M2LIB_HANDLE handle, SaveMappingsCallback callback);
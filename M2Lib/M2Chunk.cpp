@@ -4,19 +4,37 @@
 #include <assert.h>
 #include <algorithm>
 
-void M2Lib::M2Chunk::PFIDChunk::Load(std::fstream& FileStream, uint32_t Size)
+M2Lib::ChunkTable const& M2Lib::M2Chunk::GetChunkTable()
+{
+	static ChunkTable const Table =
+	{
+		ChunkTable::Register<MD21Chunk>(EM2Chunk::Model),
+		ChunkTable::Register<PFIDChunk>(EM2Chunk::Physic),
+		ChunkTable::Register<AFIDChunk>(EM2Chunk::Animation),
+		ChunkTable::Register<SFIDChunk>(EM2Chunk::Skin),
+		ChunkTable::Register<BFIDChunk>(EM2Chunk::Bone),
+		ChunkTable::Register<SKIDChunk>(EM2Chunk::Skeleton),
+		ChunkTable::Register<TXIDChunk>(EM2Chunk::Texture),
+		ChunkTable::Register<GPIDChunk>(EM2Chunk::ParticleGeometryModels),
+		ChunkTable::Register<RPIDChunk>(EM2Chunk::ParticleRecursiveModel),
+	};
+
+	return Table;
+}
+
+void M2Lib::M2Chunk::PFIDChunk::Load(std::istream& FileStream, uint32_t Size)
 {
 	m2lib_assert(Size == 4 && "Bad PFID chunk size");
 
 	FileStream.read((char*)&PhysFileId, 4);
 }
 
-void M2Lib::M2Chunk::PFIDChunk::Save(std::fstream& FileStream)
+void M2Lib::M2Chunk::PFIDChunk::Save(std::ostream& FileStream)
 {
 	FileStream.write((char*)&PhysFileId, 4);
 }
 
-void M2Lib::M2Chunk::SFIDChunk::Load(std::fstream& FileStream, uint32_t Size)
+void M2Lib::M2Chunk::SFIDChunk::Load(std::istream& FileStream, uint32_t Size)
 {
 	m2lib_assert((Size % 4) == 0 && "Bad SFID chunk size");
 
@@ -25,13 +43,13 @@ void M2Lib::M2Chunk::SFIDChunk::Load(std::fstream& FileStream, uint32_t Size)
 		FileStream.read((char*)&SkinsFileDataIds[i], 4);
 }
 
-void M2Lib::M2Chunk::SFIDChunk::Save(std::fstream& FileStream)
+void M2Lib::M2Chunk::SFIDChunk::Save(std::ostream& FileStream)
 {
 	for (uint32_t i = 0; i < SkinsFileDataIds.size(); ++i)
 		FileStream.write((char*)&SkinsFileDataIds[i], 4);
 }
 
-void M2Lib::M2Chunk::AFIDChunk::Load(std::fstream& FileStream, uint32_t Size)
+void M2Lib::M2Chunk::AFIDChunk::Load(std::istream& FileStream, uint32_t Size)
 {
 	uint32_t offs = 0;
 	while (offs < Size)
@@ -47,7 +65,7 @@ void M2Lib::M2Chunk::AFIDChunk::Load(std::fstream& FileStream, uint32_t Size)
 	}
 }
 
-void M2Lib::M2Chunk::AFIDChunk::Save(std::fstream& FileStream)
+void M2Lib::M2Chunk::AFIDChunk::Save(std::ostream& FileStream)
 {
 	for (auto& info : AnimInfos)
 	{
@@ -57,7 +75,7 @@ void M2Lib::M2Chunk::AFIDChunk::Save(std::fstream& FileStream)
 	}
 }
 
-void M2Lib::M2Chunk::BFIDChunk::Load(std::fstream& FileStream, uint32_t Size)
+void M2Lib::M2Chunk::BFIDChunk::Load(std::istream& FileStream, uint32_t Size)
 {
 	uint32_t offs = 0;
 	while (offs < Size)
@@ -70,28 +88,28 @@ void M2Lib::M2Chunk::BFIDChunk::Load(std::fstream& FileStream, uint32_t Size)
 	}
 }
 
-void M2Lib::M2Chunk::BFIDChunk::Save(std::fstream& FileStream)
+void M2Lib::M2Chunk::BFIDChunk::Save(std::ostream& FileStream)
 {
 	for (auto& boneFileDataId : BoneFileDataIds)
 		FileStream.write((char*)&boneFileDataId, 4);
 }
 
-void M2Lib::M2Chunk::SKIDChunk::Load(std::fstream& FileStream, uint32_t Size)
+void M2Lib::M2Chunk::SKIDChunk::Load(std::istream& FileStream, uint32_t Size)
 {
 	FileStream.read((char*)&SkeletonFileDataId, 4);
 }
 
-void M2Lib::M2Chunk::SKIDChunk::Save(std::fstream& FileStream)
+void M2Lib::M2Chunk::SKIDChunk::Save(std::ostream& FileStream)
 {
 	FileStream.write((char*)&SkeletonFileDataId, 4);
 }
 
-void M2Lib::M2Chunk::MD21Chunk::Save(std::fstream& FileStream)
+void M2Lib::M2Chunk::MD21Chunk::Save(std::ostream& FileStream)
 {
 	m2lib_assert(false && "Not implemented");
 }
 
-void M2Lib::M2Chunk::TXIDChunk::Load(std::fstream & FileStream, uint32_t Size)
+void M2Lib::M2Chunk::TXIDChunk::Load(std::istream& FileStream, uint32_t Size)
 {
 	m2lib_assert((Size % 4) == 0 && "Bad SFID chunk size");
 
@@ -100,7 +118,7 @@ void M2Lib::M2Chunk::TXIDChunk::Load(std::fstream & FileStream, uint32_t Size)
 		FileStream.read((char*)&TextureFileDataIds[i], 4);
 }
 
-void M2Lib::M2Chunk::TXIDChunk::Save(std::fstream & FileStream)
+void M2Lib::M2Chunk::TXIDChunk::Save(std::ostream & FileStream)
 {
 	for (uint32_t i = 0; i < TextureFileDataIds.size(); ++i)
 		FileStream.write((char*)&TextureFileDataIds[i], 4);
@@ -112,7 +130,7 @@ M2Lib::M2Chunk::TXACChunk::TXACChunk(uint32_t TextureFlagsCount, uint32_t Partic
 	ParticleEmitterAC.resize(ParticleEmitterCount);
 }
 
-void M2Lib::M2Chunk::TXACChunk::Load(std::fstream & FileStream, uint32_t Size)
+void M2Lib::M2Chunk::TXACChunk::Load(std::istream& FileStream, uint32_t Size)
 {
 	m2lib_assert(Size == (TextureFlagsAC.size() + ParticleEmitterAC.size()) * sizeof(texture_ac) && "Bad TXAC chunk size");
 
@@ -122,7 +140,7 @@ void M2Lib::M2Chunk::TXACChunk::Load(std::fstream & FileStream, uint32_t Size)
 		FileStream.read((char*)&ParticleEmitterAC[i], sizeof(texture_ac));
 }
 
-void M2Lib::M2Chunk::TXACChunk::Save(std::fstream & FileStream)
+void M2Lib::M2Chunk::TXACChunk::Save(std::ostream & FileStream)
 {
 	for (uint32_t i = 0; i < TextureFlagsAC.size(); ++i)
 		FileStream.write((char*)&TextureFlagsAC[i], sizeof(texture_ac));
@@ -130,7 +148,7 @@ void M2Lib::M2Chunk::TXACChunk::Save(std::fstream & FileStream)
 		FileStream.write((char*)&ParticleEmitterAC[i], sizeof(texture_ac));
 }
 
-void M2Lib::M2Chunk::GPIDChunk::Load(std::fstream& FileStream, uint32_t Size)
+void M2Lib::M2Chunk::GPIDChunk::Load(std::istream& FileStream, uint32_t Size)
 {
 	m2lib_assert((Size % 4) == 0 && "Bad GPID chunk size");
 
@@ -139,13 +157,13 @@ void M2Lib::M2Chunk::GPIDChunk::Load(std::fstream& FileStream, uint32_t Size)
 		FileStream.read((char*)& FileDataIds[i], 4);
 }
 
-void M2Lib::M2Chunk::GPIDChunk::Save(std::fstream& FileStream)
+void M2Lib::M2Chunk::GPIDChunk::Save(std::ostream& FileStream)
 {
 	for (uint32_t i = 0; i < FileDataIds.size(); ++i)
 		FileStream.write((char*)& FileDataIds[i], 4);
 }
 
-void M2Lib::M2Chunk::RPIDChunk::Load(std::fstream& FileStream, uint32_t Size)
+void M2Lib::M2Chunk::RPIDChunk::Load(std::istream& FileStream, uint32_t Size)
 {
 	m2lib_assert((Size % 4) == 0 && "Bad RPID chunk size");
 
@@ -154,7 +172,7 @@ void M2Lib::M2Chunk::RPIDChunk::Load(std::fstream& FileStream, uint32_t Size)
 		FileStream.read((char*)& FileDataIds[i], 4);
 }
 
-void M2Lib::M2Chunk::RPIDChunk::Save(std::fstream& FileStream)
+void M2Lib::M2Chunk::RPIDChunk::Save(std::ostream& FileStream)
 {
 	for (uint32_t i = 0; i < FileDataIds.size(); ++i)
 		FileStream.write((char*)& FileDataIds[i], 4);
@@ -24,8 +24,9 @@ namespace M2Lib
 		class PFIDChunk : public ChunkBase
 		{
 		public:
-			void Load(std::fstream& FileStream, uint32_t Size) override;
-			void Save(std::fstream& FileStream) override;
+			void Load(std::istream& FileStream, uint32_t Size) override;
+			void Save(std::ostream& FileStream) override;
+			ChunkBase* Clone() const override { return new PFIDChunk(*this); }
 
 			uint32_t PhysFileId;
 		};
@@ -33,8 +34,10 @@ namespace M2Lib
 		class SFIDChunk : public ChunkBase
 		{
 		public:
-			void Load(std::fstream& FileStream, uint32_t Size) override;
-			void Save(std::fstream& FileStream) override;
+			void Load(std::istream& FileStream, uint32_t Size) override;
+			void Save(std::ostream& FileStream) override;
+			ChunkBase* Clone() const override { return new SFIDChunk(*this); }
+			uint64_t GetMemoryUsage() const override { return SkinsFileDataIds.capacity() * sizeof(uint32_t); }
 
 			std::vector<uint32_t> SkinsFileDataIds;
 		};
@@ -42,8 +45,10 @@ namespace M2Lib
 		class AFIDChunk : public ChunkBase
 		{
 		public:
-			void Load(std::fstream& FileStream, uint32_t Size) override;
-			void Save(std::fstream& FileStream) override;
+			void Load(std::istream& FileStream, uint32_t Size) override;
+			void Save(std::ostream& FileStream) override;
+			ChunkBase* Clone() const override { return new AFIDChunk(*this); }
+			uint64_t GetMemoryUsage() const override { return AnimInfos.capacity() * sizeof(AnimFileInfo); }
 
 			struct AnimFileInfo
 			{
@@ -58,8 +63,10 @@ namespace M2Lib
 		class BFIDChunk : public ChunkBase
 		{
 		public:
-			void Load(std::fstream& FileStream, uint32_t Size) override;
-			void Save(std::fstream& FileStream) override;
+			void Load(std::istream& FileStream, uint32_t Size) override;
+			void Save(std::ostream& FileStream) override;
+			ChunkBase* Clone() const override { return new BFIDChunk(*this); }
+			uint64_t GetMemoryUsage() const override { return BoneFileDataIds.capacity() * sizeof(uint32_t); }
 
 			std::vector<uint32_t> BoneFileDataIds;
 		};
@@ -67,8 +74,9 @@ namespace M2Lib
 		class SKIDChunk : public ChunkBase
 		{
 		public:
-			void Load(std::fstream& FileStream, uint32_t Size) override;
-			void Save(std::fstream& FileStream) override;
+			void Load(std::istream& FileStream, uint32_t Size) override;
+			void Save(std::ostream& FileStream) override;
+			ChunkBase* Clone() const override { return new SKIDChunk(*this); }
 
 			uint32_t SkeletonFileDataId;
 		};
@@ -76,8 +84,10 @@ namespace M2Lib
 		class TXIDChunk : public ChunkBase
 		{
 		public:
-			void Load(std::fstream& FileStream, uint32_t Size) override;
-			void Save(std::fstream& FileStream) override;
+			void Load(std::istream& FileStream, uint32_t Size) override;
+			void Save(std::ostream& FileStream) override;
+			ChunkBase* Clone() const override { return new TXIDChunk(*this); }
+			uint64_t GetMemoryUsage() const override { return TextureFileDataIds.capacity() * sizeof(uint32_t); }
 
 			std::vector<uint32_t> TextureFileDataIds;
 		};
@@ -92,8 +102,10 @@ namespace M2Lib
 
 			TXACChunk(uint32_t TextureFlagsCount, uint32_t ParticleEmitterCount);
 
-			void Load(std::fstream& FileStream, uint32_t Size) override;
-			void Save(std::fstream& FileStream) override;
+			void Load(std::istream& FileStream, uint32_t Size) override;
+			void Save(std::ostream& FileStream) override;
+			ChunkBase* Clone() const override { return new TXACChunk(*this); }
+			uint64_t GetMemoryUsage() const override { return (TextureFlagsAC.capacity() + ParticleEmitterAC.capacity()) * sizeof(texture_ac); }
 
 			std::vector<texture_ac> TextureFlagsAC;
 			std::vector<texture_ac> ParticleEmitterAC;
@@ -102,8 +114,10 @@ namespace M2Lib
 		class GPIDChunk : public ChunkBase
 		{
 		public:
-			void Load(std::fstream& FileStream, uint32_t Size) override;
-			void Save(std::fstream& FileStream) override;
+			void Load(std::istream& FileStream, uint32_t Size) override;
+			void Save(std::ostream& FileStream) override;
+			ChunkBase* Clone() const override { return new GPIDChunk(*this); }
+			uint64_t GetMemoryUsage() const override { return FileDataIds.capacity() * sizeof(uint32_t); }
 
 			std::vector<uint32_t> FileDataIds;
 		};
@@ -111,8 +125,10 @@ namespace M2Lib
 		class RPIDChunk : public ChunkBase
 		{
 		public:
-			void Load(std::fstream& FileStream, uint32_t Size) override;
-			void Save(std::fstream& FileStream) override;
+			void Load(std::istream& FileStream, uint32_t Size) override;
+			void Save(std::ostream& FileStream) override;
+			ChunkBase* Clone() const override { return new RPIDChunk(*this); }
+			uint64_t GetMemoryUsage() const override { return FileDataIds.capacity() * sizeof(uint32_t); }
 
 			std::vector<uint32_t> FileDataIds;
 		};
@@ -120,7 +136,11 @@ namespace M2Lib
 		class MD21Chunk : public RawChunk
 		{
 		public:
-			void Save(std::fstream& FileStream) override;
+			void Save(std::ostream& FileStream) override;
+			ChunkBase* Clone() const override { return new MD21Chunk(*this); }
 		};
+
+		// classes of model chunks. TXAC is not listed, its size depends on header and it is created by model.
+		ChunkTable const& GetChunkTable();
 	}
 }
\ No newline at end of file
@@ -111,6 +111,8 @@ namespace M2Lib
 			uint16_t NextIndex;			// this animation's index in the list of animations.
 
 			bool IsInplace() const { return (Flags & 0x20) != 0; }
+			// keys of alias are taken from sequence at NextAnimation
+			bool IsAlias() const { return (Flags & 0x40) != 0; }
 		};
 
 		ASSERT_SIZE(CElement_Animation, 64);
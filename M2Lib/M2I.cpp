@@ -4,6 +4,7 @@
 #include "DataBinary.h"
 #include "M2.h"
 #include "Logger.h"
+#include "Profiler.h"
 #include <functional>
 #include "StringHelpers.h"
 #include "FileStorage.h"
@@ -11,6 +12,8 @@
 
 M2Lib::EError M2Lib::M2I::Load(wchar_t const* FileName, M2Lib::M2* pM2, bool IgnoreBones, bool IgnoreAttachments, bool IgnoreCameras, bool IgnoreOriginalMeshIndexes)
 {
+	M2LIB_PROFILE_SCOPE("M2I::Load");
+
 	// open file stream
 	std::fstream FileStream;
 	FileStream.open(FileName, std::ios::in | std::ios::binary);
@@ -450,3 +453,12 @@ M2Lib::EError M2Lib::M2I::Load(wchar_t const* FileName, M2Lib::M2* pM2, bool Ign
 
 	return EError_OK;
 }
+
+uint64_t M2Lib::M2I::GetMemoryUsage() const
+{
+	uint64_t Size = sizeof(*this) + VertexList.capacity() * sizeof(CVertex) + SubMeshList.capacity() * sizeof(CSubMesh*);
+	for (auto SubMesh : SubMeshList)
+		Size += sizeof(*SubMesh) + SubMesh->Indices.capacity() * sizeof(uint16_t) + SubMesh->Triangles.capacity() * sizeof(CTriangle);
+
+	return Size;
+}
@@ -39,6 +39,9 @@ namespace M2Lib
 
 		EError Load(wchar_t const* FileName, M2* pM2, bool IgnoreBones, bool IgnoreAttachments, bool IgnoreCameras, bool IgnoreOriginalMeshIndexes);
 
+		// heap memory held by vertex list and sub meshes
+		uint64_t GetMemoryUsage() const;
+
 		~M2I()
 		{
 			for (uint32_t i = 0; i < SubMeshList.size(); i++)
@@ -1,5 +1,6 @@
 #include "M2.h"
 #include "Logger.h"
+#include "Profiler.h"
 #include <set>
 #include <iomanip>
 #include <sstream>
@@ -172,6 +173,8 @@ void M2Lib::M2::FixNormals(float AngularTolerance)
 
 void M2Lib::M2::FixNormals(NormalizationRule const& rule, float AngularTolerance)
 {
+	M2LIB_PROFILE_SCOPE("M2::FixNormals");
+
 	auto pSkin = Skins[0];
 
 	auto allMeshes = pSkin->Elements[EElement_SubMesh].as<CElement_SubMesh>();
@@ -373,6 +376,8 @@ void M2Lib::M2::MirrorCamera()
 
 void M2Lib::M2::FixSeamsSubMesh(float PositionalTolerance, float AngularTolerance)
 {
+	M2LIB_PROFILE_SCOPE("M2::FixSeamsSubMesh");
+
 	// gather up sub meshes
 	std::vector< std::vector< M2SkinElement::CElement_SubMesh* > > SubMeshes;
 
@@ -491,6 +496,8 @@ void M2Lib::M2::FixSeamsSubMesh(float PositionalTolerance, float AngularToleranc
 
 void M2Lib::M2::FixSeamsBody(float PositionalTolerance, float AngularTolerance)
 {
+	M2LIB_PROFILE_SCOPE("M2::FixSeamsBody");
+
 	// sub meshes that are divided up accross multiple bone partitions will have multiple sub mesh entries with the same ID in the M2.
 	// we need to gather each body submesh up into a list and average normals of vertices that are similar between other sub meshes.
 	// this function is designed to be used on character models, so it may not work on other models.
@@ -638,6 +645,8 @@ void M2Lib::M2::FixSeamsBody(float PositionalTolerance, float AngularTolerance)
 
 void M2Lib::M2::FixSeamsClothing(float PositionalTolerance, float AngularTolerance)
 {
+	M2LIB_PROFILE_SCOPE("M2::FixSeamsClothing");
+
 	CVertex* VertexList = Elements[EElement_Vertex].as<CVertex>();
 
 	uint32_t SubMeshListLength = Skins[0]->Elements[M2SkinElement::EElement_SubMesh].Count;
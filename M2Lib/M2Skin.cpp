@@ -2,11 +2,14 @@
 #include "M2.h"
 #include "M2Element.h"
 #include "Logger.h"
+#include "Profiler.h"
 #include "Shaders.h"
+#include "MemoryStream.h"
+#include "GatherWriter.h"
 #include <math.h>
 #include <iostream>
 #include <fstream>
-#include <list>
+#include <tuple>
 #include <assert.h>
 #include <unordered_map>
 #include "StringHelpers.h"
@@ -15,13 +18,23 @@
 
 using namespace M2Lib::M2SkinElement;
 
-M2Lib::EError M2Lib::M2Skin::Load(wchar_t const* FileName)
+M2Lib::EError M2Lib::M2Skin::Load(wchar_t const* FileName, std::vector<uint8_t> const* FileData)
 {
+	M2LIB_PROFILE_SCOPE("M2Skin::Load");
+
 	if (!FileName)
 		return EError_FailedToLoadSKIN_NoFileSpecified;
 
 	_FileName = FileName;
 
+	if (FileData)
+	{
+		sLogger.LogInfo(L"Loading skin at %s", FileName);
+
+		MemoryStream FileStream(FileData->data(), FileData->size());
+		return m_Load(FileStream);
+	}
+
 	// open file stream
 	std::fstream FileStream;
 	FileStream.open(FileName, std::ios::binary | std::ios::in);
@@ -30,6 +43,13 @@ M2Lib::EError M2Lib::M2Skin::Load(wchar_t const* FileName)
 
 	sLogger.LogInfo(L"Loading skin at %s", FileName);
 
+	return m_Load(FileStream);
+}
+
+M2Lib::EError M2Lib::M2Skin::m_Load(std::istream& FileStream)
+{
+	Index.Invalidate();
+
 	// find file size
 	FileStream.seekg(0, std::ios::end);
 	uint32_t FileSize = (uint32_t)FileStream.tellg();
@@ -62,6 +82,15 @@ M2Lib::EError M2Lib::M2Skin::Load(wchar_t const* FileName)
 }
 
 M2Lib::EError M2Lib::M2Skin::Save(const wchar_t* FileName)
+{
+	SaveBatch Batch;
+	if (EError Error = Save(FileName, Batch))
+		return Error;
+
+	return Batch.Commit();
+}
+
+M2Lib::EError M2Lib::M2Skin::Save(const wchar_t* FileName, SaveBatch& Batch)
 {
 	auto directory = std::filesystem::path(FileName).parent_path();
 	if (!std::filesystem::is_directory(directory) && !std::filesystem::create_directories(directory))
@@ -73,31 +102,35 @@ M2Lib::EError M2Lib::M2Skin::Save(const wchar_t* FileName)
 
 	sLogger.LogInfo(L"Saving skin to %s", FileName);
 
-	// open file stream
-	std::fstream FileStream;
-	FileStream.open(FileName, std::ios::binary | std::ios::out | std::ios::trunc);
-
 	// fill elements header data
 	m_SaveElements_FindOffsets();
 	m_SaveElements_CopyElementsToHeader();
 
+	auto& Writer = Batch.Add(FileName, EError_FailedToSaveSKIN);
+
 	// save header
 	uint32_t HeaderSize = pM2->GetExpansion() >= Expansion::Cataclysm ? sizeof(Header) : 48;
-	FileStream.write((char*)&Header, HeaderSize);
+	Writer.Append(&Header, HeaderSize);
 
 	// save elements
 	for (uint32_t i = 0; i != EElement__CountM2Skin__; i++)
 	{
-		if (!Elements[i].Save(FileStream, 0))
-			return EError_FailedToSaveSKIN;
+		auto const& Data = Elements[i].Data;
+		if (!Data.empty())
+			Writer.AppendAt(Elements[i].Offset, Data.data(), Data.size());
 	}
 
-	// close file stream
-	FileStream.close();
-
 	return EError_OK;
 }
 
+M2Lib::M2Skin* M2Lib::M2Skin::Clone(M2* pM2Out) const
+{
+	auto Result = new M2Skin(*this);
+	Result->pM2 = pM2Out;
+
+	return Result;
+}
+
 void M2Lib::M2Skin::BuildVertexBoneIndices()
 {
 	CVertex* VertexList = pM2->Elements[M2Element::EElement_Vertex].as<CVertex>();
@@ -181,6 +214,9 @@ void M2Lib::M2Skin::BuildBoundingData()
 			SubMesh.SortRadius = boundary.SortRadius;
 		}
 	}
+
+	// IDs are unchanged, only order by center is rebuilt
+	Index.Invalidate(M2SkinIndex::ETable_Centers);
 }
 
 void M2Lib::M2Skin::BuildMaxBones()
@@ -231,6 +267,8 @@ void M2Lib::M2Skin::BuildMaxBones()
 
 void M2Lib::M2Skin::CopyMaterials(M2Skin* pOther)
 {
+	M2LIB_PROFILE_SCOPE("M2Skin::CopyMaterials");
+
 	std::vector< CElement_Material > NewMaterialList;
 	std::vector< CElement_Flags > NewFlagsList;
 
@@ -277,7 +315,7 @@ void M2Lib::M2Skin::CopyMaterials(M2Skin* pOther)
 		}
 	}
 
-	// copy new material list to element
+	// copy new material list to element, resize makes index rebuild its table
 	Elements[EElement_Material].SetDataSize(NewMaterialList.size(), sizeof(CElement_Material) * NewMaterialList.size(), false);
 	memcpy(Elements[EElement_Material].Data.data(), &NewMaterialList[0], sizeof(CElement_Material) * NewMaterialList.size());
 
@@ -286,61 +324,169 @@ void M2Lib::M2Skin::CopyMaterials(M2Skin* pOther)
 	memcpy(Elements[EElement_Flags].Data.data(), &NewFlagsList[0], sizeof(CElement_Flags) * NewFlagsList.size());
 }
 
-bool SortSubMeshesComparisonFunction(M2Lib::M2SkinElement::CElement_SubMesh* A, M2Lib::M2SkinElement::CElement_SubMesh* B)
+namespace
 {
-	float ScoreA = A->ID + (0.999f - (A->VertexCount / (float)0xFFFF));
-	float ScoreB = B->ID + (0.999f - (B->VertexCount / (float)0xFFFF));
-	return (ScoreA < ScoreB);
+	// render state of material in order of cost to change, priority plane comes first because client draws planes in order
+	typedef std::tuple<int8_t, uint16_t, uint16_t, int16_t, int16_t, int16_t> MaterialStateKey;
+
+	uint16_t GetMaterialBlend(M2Lib::DataElement const& TextureFlagsElement, CElement_Material const& Material)
+	{
+		if (Material.iRenderFlags < 0 || (uint32_t)Material.iRenderFlags >= TextureFlagsElement.Count)
+			return M2Lib::M2Element::CElement_TextureFlag::EBlend_Opaque;
+
+		return TextureFlagsElement.as<M2Lib::M2Element::CElement_TextureFlag>()[Material.iRenderFlags].Blend;
+	}
+
+	MaterialStateKey GetMaterialStateKey(M2Lib::DataElement const& TextureFlagsElement, CElement_Material const& Material)
+	{
+		// high byte of flags is priority plane
+		return MaterialStateKey((int8_t)(Material.Flags >> 8), GetMaterialBlend(TextureFlagsElement, Material), Material.shader_id,
+			Material.textureComboIndex, Material.op_count, Material.iRenderFlags);
+	}
+}
+
+M2Lib::M2Skin::RenderStateChanges M2Lib::M2Skin::CountRenderStateChanges() const
+{
+	RenderStateChanges Result;
+
+	auto const& TextureFlagsElement = pM2->Elements[M2Element::EElement_TextureFlags];
+	auto Materials = Elements[EElement_Material].as<CElement_Material>();
+	for (uint32_t i = 1; i < Elements[EElement_Material].Count; ++i)
+	{
+		auto& Previous = Materials[i - 1];
+		auto& Current = Materials[i];
+
+		if (Previous.shader_id != Current.shader_id)
+			++Result.Shader;
+		if (GetMaterialBlend(TextureFlagsElement, Previous) != GetMaterialBlend(TextureFlagsElement, Current))
+			++Result.Blend;
+		if (Previous.iRenderFlags != Current.iRenderFlags)
+			++Result.RenderFlags;
+		if (Previous.textureComboIndex != Current.textureComboIndex || Previous.op_count != Current.op_count)
+			++Result.Textures;
+	}
+
+	return Result;
 }
 
 void M2Lib::M2Skin::SortSubMeshes()
 {
-	uint32_t SubMeshListLength = Elements[EElement_SubMesh].Count;
-	CElement_SubMesh* SubMeshList = Elements[EElement_SubMesh].as<CElement_SubMesh>();
+	M2LIB_PROFILE_SCOPE("M2Skin::SortSubMeshes");
 
-	// sort the list
-	std::list< CElement_SubMesh* > SubMeshListSorted;
-	for (uint32_t iSubMesh = 0; iSubMesh < SubMeshListLength; iSubMesh++)
+	auto Before = CountRenderStateChanges();
+
+	auto const& TextureFlagsElement = pM2->Elements[M2Element::EElement_TextureFlags];
+	auto SubMeshes = Elements[EElement_SubMesh].asVector<CElement_SubMesh>();
+	auto Materials = Elements[EElement_Material].asVector<CElement_Material>();
+	auto Flags = Elements[EElement_Flags].asVector<CElement_Flags>();
+	uint32_t SubMeshCount = SubMeshes.size();
+
+	// material layers are drawn over layer 0 of same sub mesh, so each run of layers is moved as a whole
+	std::vector<uint32_t> GroupStarts;
+	for (uint32_t i = 0; i < Materials.size(); ++i)
 	{
-		SubMeshListSorted.push_back(&SubMeshList[iSubMesh]);
+		if (i == 0 || Materials[i].layer == 0 || Materials[i].iSubMesh != Materials[i - 1].iSubMesh)
+			GroupStarts.push_back(i);
 	}
-	SubMeshListSorted.sort(SortSubMeshesComparisonFunction);
+	GroupStarts.push_back(Materials.size());
 
-	// build index remap list
-	uint32_t* SubMeshReMapList = new uint32_t[SubMeshListLength];
-	for (uint32_t i = 0; i < SubMeshListLength; i++)
+	// sub meshes with same ID are ordered by cheapest state of their materials, sub meshes without materials go last
+	std::vector<MaterialStateKey> SubMeshKeys(SubMeshCount);
+	std::vector<bool> SubMeshHasMaterial(SubMeshCount, false);
+	for (auto& Material : Materials)
 	{
-		std::list< CElement_SubMesh* >::iterator it = SubMeshListSorted.begin();
-		for (uint32_t j = 0; j < SubMeshListLength; j++)
-		{
-			if (&SubMeshList[i] == *it)
-			{
-				SubMeshReMapList[i] = j;
-			}
-			it++;
-		}
+		if (Material.iSubMesh >= SubMeshCount)
+			continue;
+
+		auto Key = GetMaterialStateKey(TextureFlagsElement, Material);
+		if (!SubMeshHasMaterial[Material.iSubMesh] || Key < SubMeshKeys[Material.iSubMesh])
+			SubMeshKeys[Material.iSubMesh] = Key;
+		SubMeshHasMaterial[Material.iSubMesh] = true;
 	}
 
-	// remap material sub mesh indices
-	uint32_t MaterialListLength = Elements[EElement_Material].Count;
-	CElement_Material* MaterialList = Elements[EElement_Material].as<CElement_Material>();
-	for (uint32_t i = 0; i < MaterialListLength; i++)
+	std::vector<uint32_t> SubMeshOrder(SubMeshCount);
+	for (uint32_t i = 0; i < SubMeshCount; ++i)
+		SubMeshOrder[i] = i;
+	std::stable_sort(SubMeshOrder.begin(), SubMeshOrder.end(), [&](uint32_t A, uint32_t B)
+	{
+		if (SubMeshes[A].ID != SubMeshes[B].ID)
+			return SubMeshes[A].ID < SubMeshes[B].ID;
+		if (SubMeshHasMaterial[A] != SubMeshHasMaterial[B])
+			return (bool)SubMeshHasMaterial[A];
+		return SubMeshHasMaterial[A] && SubMeshKeys[A] < SubMeshKeys[B];
+	});
+
+	std::vector<uint32_t> SubMeshRemap(SubMeshCount);
+	for (uint32_t i = 0; i < SubMeshCount; ++i)
+		SubMeshRemap[SubMeshOrder[i]] = i;
+	auto RemapSubMesh = [&](uint16_t& SubMeshIndex)
+	{
+		if (SubMeshIndex < SubMeshCount)
+			SubMeshIndex = SubMeshRemap[SubMeshIndex];
+	};
+
+	// material groups by state, then by new sub mesh order
+	std::vector<uint32_t> GroupOrder(GroupStarts.size() - 1);
+	std::vector<MaterialStateKey> GroupKeys(GroupOrder.size());
+	std::vector<uint32_t> GroupSubMeshes(GroupOrder.size());
+	for (uint32_t i = 0; i < GroupOrder.size(); ++i)
+	{
+		auto& First = Materials[GroupStarts[i]];
+		GroupOrder[i] = i;
+		GroupKeys[i] = GetMaterialStateKey(TextureFlagsElement, First);
+		GroupSubMeshes[i] = First.iSubMesh < SubMeshCount ? SubMeshRemap[First.iSubMesh] : First.iSubMesh;
+	}
+	std::stable_sort(GroupOrder.begin(), GroupOrder.end(), [&](uint32_t A, uint32_t B)
+	{
+		if (GroupKeys[A] != GroupKeys[B])
+			return GroupKeys[A] < GroupKeys[B];
+		return GroupSubMeshes[A] < GroupSubMeshes[B];
+	});
+
+	std::vector<CElement_Material> NewMaterials;
+	NewMaterials.reserve(Materials.size());
+	for (auto Group : GroupOrder)
 	{
-		MaterialList[i].iSubMesh = SubMeshReMapList[MaterialList[i].iSubMesh];
-		MaterialList[i].iSubMesh2 = SubMeshReMapList[MaterialList[i].iSubMesh2];
+		for (uint32_t i = GroupStarts[Group]; i < GroupStarts[Group + 1]; ++i)
+		{
+			NewMaterials.push_back(Materials[i]);
+			RemapSubMesh(NewMaterials.back().iSubMesh);
+			RemapSubMesh(NewMaterials.back().iSubMesh2);
+		}
 	}
-	delete[] SubMeshReMapList;
 
-	// copy sorted result
-	CElement_SubMesh* NewSubMeshList = new CElement_SubMesh[SubMeshListLength];
-	std::list< CElement_SubMesh* >::iterator SubMeshListSortedIterator = SubMeshListSorted.begin();
-	for (uint32_t iSubMesh = 0; iSubMesh < SubMeshListLength; iSubMesh++)
+	// flags follow sub mesh order
+	for (auto& Flag : Flags)
+		RemapSubMesh(Flag.iSubMesh);
+	std::stable_sort(Flags.begin(), Flags.end(), [](CElement_Flags const& A, CElement_Flags const& B) { return A.iSubMesh < B.iSubMesh; });
+
+	std::vector<CElement_SubMesh> NewSubMeshes(SubMeshCount);
+	for (uint32_t i = 0; i < SubMeshCount; ++i)
+		NewSubMeshes[i] = SubMeshes[SubMeshOrder[i]];
+
+	if (ExtraDataBySubmeshIndex.size() == SubMeshCount)
 	{
-		NewSubMeshList[iSubMesh] = *(*SubMeshListSortedIterator);
-		SubMeshListSortedIterator++;
+		auto ExtraData = ExtraDataBySubmeshIndex;
+		for (uint32_t i = 0; i < SubMeshCount; ++i)
+			ExtraDataBySubmeshIndex[i] = ExtraData[SubMeshOrder[i]];
 	}
-	memcpy(Elements[EElement_SubMesh].Data.data(), NewSubMeshList, Elements[EElement_SubMesh].Data.size());
-	delete[] NewSubMeshList;
+
+	// counts are unchanged, copy over existing data
+	if (SubMeshCount)
+		memcpy(Elements[EElement_SubMesh].Data.data(), NewSubMeshes.data(), sizeof(CElement_SubMesh) * SubMeshCount);
+	if (!NewMaterials.empty())
+		memcpy(Elements[EElement_Material].Data.data(), NewMaterials.data(), sizeof(CElement_Material) * NewMaterials.size());
+	if (!Flags.empty())
+		memcpy(Elements[EElement_Flags].Data.data(), Flags.data(), sizeof(CElement_Flags) * Flags.size());
+
+	// materials and flags are reordered as a whole, sub mesh groups by ID only move
+	Index.RemapSubMeshes(Elements, SubMeshRemap);
+	Index.Invalidate(M2SkinIndex::ETable_Materials | M2SkinIndex::ETable_Flags);
+
+	auto After = CountRenderStateChanges();
+	sLogger.LogInfo(L"Sorted %u sub meshes and %u materials of skin, estimated render state changes %u -> %u (shader %u -> %u, blend %u -> %u, render flags %u -> %u, textures %u -> %u)",
+		SubMeshCount, (uint32_t)Materials.size(), Before.Total(), After.Total(), Before.Shader, After.Shader, Before.Blend, After.Blend,
+		Before.RenderFlags, After.RenderFlags, Before.Textures, After.Textures);
 }
 
 
@@ -357,35 +503,9 @@ M2Lib::M2SkinElement::CElement_SubMesh* M2Lib::M2Skin::GetSubMesh(SubmeshExtraDa
 		return &SubMeshList[SubMeshIndexOut];
 	}
 
-	float DeltaMin = 0.0f;
-	int32_t ClosestMatch = -1;
-	SubMeshIndexOut = -1;
-
-	uint16_t ID = TargetSubMeshData.ID;
-	C3Vector const& SortCenter = TargetSubMeshData.Boundary.SortCenter;
-	C3Vector const& CenterMass = TargetSubMeshData.Boundary.CenterMass;
-
-	for (uint32_t i = 0; i < SubMeshListLength; ++i)
-	{
-		if (SubMeshList[i].ID == ID)
-		{
-			C3Vector SortDelta = SubMeshList[i].SortCenter - SortCenter;
-			C3Vector BoundingDelta = SubMeshList[i].CenterMass - CenterMass;
-			float Delta = SortDelta.Length() + BoundingDelta.Length();
-
-			if (ClosestMatch == -1 || Delta < DeltaMin)
-			{
-				DeltaMin = Delta;
-				ClosestMatch = i;
-			}
-		}
-	}
-
-	if (ClosestMatch >= 0)
-	{
-		SubMeshIndexOut = ClosestMatch;
-		return &SubMeshList[ClosestMatch];
-	}
+	SubMeshIndexOut = Index.FindClosestSubMesh(Elements, TargetSubMeshData.ID, TargetSubMeshData.Boundary.SortCenter, TargetSubMeshData.Boundary.CenterMass);
+	if (SubMeshIndexOut >= 0)
+		return &SubMeshList[SubMeshIndexOut];
 
 	return 0;
 }
@@ -394,26 +514,16 @@ M2Lib::M2SkinElement::CElement_SubMesh* M2Lib::M2Skin::GetSubMesh(SubmeshExtraDa
 void M2Lib::M2Skin::GetSubMeshMaterials(uint32_t SubMeshIndex, std::vector< CElement_Material* >& Result)
 {
 	CElement_Material* MaterialList = Elements[EElement_Material].as<CElement_Material>();
-	for (uint32_t iMaterial = 0; iMaterial < Header.nMaterial; iMaterial++)
-	{
-		if (MaterialList[iMaterial].iSubMesh == SubMeshIndex)
-		{
-			Result.push_back(&MaterialList[iMaterial]);
-		}
-	}
+	for (auto iMaterial : Index.GetSubMeshMaterials(Elements, SubMeshIndex))
+		Result.push_back(&MaterialList[iMaterial]);
 }
 
 
 void M2Lib::M2Skin::GetSubMeshFlags(uint32_t SubMeshIndex, std::vector< CElement_Flags* >& Result)
 {
 	CElement_Flags* FlagsList = Elements[EElement_Flags].as<CElement_Flags>();
-	for (uint32_t iFlags = 0; iFlags < Header.nFlags; iFlags++)
-	{
-		if (FlagsList[iFlags].iSubMesh == SubMeshIndex)
-		{
-			Result.push_back(&FlagsList[iFlags]);
-		}
-	}
+	for (auto iFlags : Index.GetSubMeshFlags(Elements, SubMeshIndex))
+		Result.push_back(&FlagsList[iFlags]);
 }
 
 
@@ -646,23 +756,19 @@ bool M2Lib::M2Skin::AddShader(uint16_t ShaderId, uint32_t const* MeshTextureIds,
 {
 	uint32_t OpCountForShader = ShaderId == TRANSPARENT_SHADER_ID ? 1 : GetOpCountForShader(ShaderId);
 
-	auto Submeshes = Elements[EElement_SubMesh].as<CElement_SubMesh>();
 	auto Materials = Elements[EElement_Material].as<CElement_Material>();
-	auto TextureLookup = pM2->Elements[M2Element::EElement_TextureLookup].as<M2Element::CElement_TextureLookup>();
+	// model elements are only read here, lookups are added below and reallocate lookup element, so it is not cached
+	auto const& ModelElements = pM2->Elements;
 
 	for (auto submeshId : MeshIndexes)
 	{
-		auto& SubMesh = Submeshes[submeshId];
-		
-		// loop through all materials to find ones assigned to our submesh
-		for (uint32_t i = 0; i < Elements[EElement_Material].Count; ++i)
+		// loop through materials assigned to our submesh
+		for (auto i : Index.GetSubMeshMaterials(Elements, submeshId))
 		{
 			auto& Material = Materials[i];
-			if (Material.iSubMesh != submeshId)
-				continue;
 
-			auto textureId = MeshTextureIds[0] != -1 ? MeshTextureIds[0] : TextureLookup[Material.textureComboIndex].TextureIndex;
-			auto& texture = pM2->Elements[M2Element::EElement_Texture].as<M2Element::CElement_Texture>()[textureId];
+			auto textureId = MeshTextureIds[0] != -1 ? MeshTextureIds[0] : ModelElements[M2Element::EElement_TextureLookup].at<M2Element::CElement_TextureLookup>(Material.textureComboIndex)->TextureIndex;
+			auto& texture = *ModelElements[M2Element::EElement_Texture].at<M2Element::CElement_Texture>(textureId);
 			if (texture.Type == M2Element::CElement_Texture::ETextureType::Skin)
 				pM2->Header.Description.Flags.flag_unk_0x80 = 0;	// fixes gloss but breaks dh tattoos
 
@@ -726,10 +832,14 @@ std::vector<M2Lib::M2Skin::MeshInfo> M2Lib::M2Skin::GetMeshInfo()
 {
 	std::vector<MeshInfo> Infos(Elements[EElement_SubMesh].Count);
 
-	auto Submeshes = Elements[EElement_SubMesh].as<CElement_SubMesh>();
-	auto Materials = Elements[EElement_Material].as<CElement_Material>();
-	auto& TextureElement = pM2->Elements[M2Element::EElement_Texture];
-	auto TextureLookup = pM2->Elements[M2Element::EElement_TextureLookup].as<M2Element::CElement_TextureLookup>();
+	// read-only, const access keeps data shared with clones
+	auto const* SkinElements = Elements;
+	auto const& ModelElements = pM2->Elements;
+
+	auto Submeshes = SkinElements[EElement_SubMesh].as<CElement_SubMesh>();
+	auto Materials = SkinElements[EElement_Material].as<CElement_Material>();
+	auto& TextureElement = ModelElements[M2Element::EElement_Texture];
+	auto TextureLookup = ModelElements[M2Element::EElement_TextureLookup].as<M2Element::CElement_TextureLookup>();
 
 	for (uint32_t i = 0; i < Infos.size(); ++i)
 	{
@@ -742,13 +852,8 @@ std::vector<M2Lib::M2Skin::MeshInfo> M2Lib::M2Skin::GetMeshInfo()
 
 		Info.Description = comparisonData->Description;
 
-		for (uint32_t j = 0; j < Header.nMaterial; ++j)
-		{
-			if (Materials[j].iSubMesh != i)
-				continue;
-
+		for (auto j : Index.GetSubMeshMaterials(Elements, i))
 			Info.Materials.push_back(&Materials[j]);
-		}
 
 		for (auto Material : Info.Materials)
 		{
@@ -775,23 +880,15 @@ void M2Lib::M2Skin::CopyMaterial(uint32_t SrcMeshIndex, uint32_t DstMeshIndex)
 	auto Meshes = Elements[EElement_SubMesh].as<CElement_SubMesh>();
 	auto Materials = Elements[EElement_Material].as<CElement_Material>();
 	
-	CElement_Material* SrcMaterial = NULL;
-	for (uint32_t i = 0; i < Header.nMaterial; ++i)
-	{
-		if (Materials[i].iSubMesh != SrcMeshIndex)
-			continue;
-
-		SrcMaterial = &Materials[i];
-	}
-
-	if (!SrcMaterial)
+	// last material of source sub mesh is copied
+	auto SrcMaterials = Index.GetSubMeshMaterials(Elements, SrcMeshIndex);
+	if (SrcMaterials.empty())
 		return;
 
-	for (uint32_t i = 0; i < Header.nMaterial; ++i)
-	{
-		if (Materials[i].iSubMesh != DstMeshIndex)
-			continue;
+	CElement_Material* SrcMaterial = &Materials[*(SrcMaterials.end() - 1)];
 
+	for (auto i : Index.GetSubMeshMaterials(Elements, DstMeshIndex))
+	{
 		auto& DstMaterial = Materials[i];
 		DstMaterial.Flags = SrcMaterial->Flags;
 		DstMaterial.shader_id = SrcMaterial->shader_id;
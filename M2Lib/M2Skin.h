@@ -2,6 +2,7 @@
 
 #include "DataElement.h"
 #include "M2SkinElement.h"
+#include "M2SkinIndex.h"
 #include "M2Types.h"
 #include <vector>
 #include <map>
@@ -10,6 +11,7 @@
 namespace M2Lib
 {
 	class M2;
+	class SaveBatch;
 
 	namespace M2Element
 	{
@@ -74,14 +76,25 @@ namespace M2Lib
 
 		std::vector<SubmeshExtraData const*> ExtraDataBySubmeshIndex;
 
+		// lookup tables over Elements, code that edits sub meshes, materials or flags in place must invalidate them.
+		M2SkinIndex Index;
+
 		// pointer to M2 that this skin belongs to.
 		M2* pM2;
 
 	public:
-		// loads an M2 skin from a file.
-		EError Load(const wchar_t* FileName);
+		// loads an M2 skin from a file. if FileData is set, file contents are parsed from it instead of reading file.
+		EError Load(const wchar_t* FileName, std::vector<uint8_t> const* FileData = nullptr);
 		// saves this M2 skin to a file.
 		EError Save(const wchar_t* FileName);
+		// assembles skin file and adds it to batch, file is written by Batch.Commit().
+		EError Save(const wchar_t* FileName, SaveBatch& Batch);
+
+		// creates copy of this skin that belongs to pM2Out. element data is shared until modified.
+		M2Skin* Clone(M2* pM2Out) const;
+
+		// heap memory held by skin elements
+		uint64_t GetMemoryUsage() const { return sizeof(*this) + GetElementsMemoryUsage(Elements, M2SkinElement::EElement__CountM2Skin__) + ExtraDataBySubmeshIndex.capacity() * sizeof(SubmeshExtraData const*) + Index.GetMemoryUsage(); }
 
 		void BuildVertexBoneIndices();
 		void BuildBoundingData();
@@ -90,7 +103,20 @@ namespace M2Lib
 		// copies materials from sub meshes in another skin to equivalent sub meshes in this skin.
 		void CopyMaterials(M2Skin* pOther);
 
-		//
+		// estimated number of render state changes when materials are drawn in order of material list
+		struct RenderStateChanges
+		{
+			uint32_t Shader = 0;
+			uint32_t Blend = 0;
+			uint32_t RenderFlags = 0;
+			uint32_t Textures = 0;
+
+			uint32_t Total() const { return Shader + Blend + RenderFlags + Textures; }
+		};
+		RenderStateChanges CountRenderStateChanges() const;
+
+		// orders sub meshes by ID and materials by priority plane and render state, so that client changes state less often.
+		// layers of material stay together and in order. sub mesh indices of materials, flags and extra data are remapped.
 		void SortSubMeshes();
 
 		bool PrintInfo();
@@ -118,20 +144,21 @@ namespace M2Lib
 
 			struct TextureInfo
 			{
-				M2Element::CElement_Texture* pTexture;
+				M2Element::CElement_Texture const* pTexture;
 				std::wstring Name;
 			};
 
 			uint32_t ID;
 			std::string Description;
 
-			std::vector<M2SkinElement::CElement_Material*> Materials;
+			std::vector<M2SkinElement::CElement_Material const*> Materials;
 			std::vector<TextureInfo> Textures;
-			M2SkinElement::CElement_SubMesh* pSubMesh;
+			M2SkinElement::CElement_SubMesh const* pSubMesh;
 		};
 		std::vector<MeshInfo> GetMeshInfo();
 
 	private:
+		EError m_Load(std::istream& FileStream);
 		void m_LoadElements_CopyHeaderToElements();
 		void m_LoadElements_FindSizes(uint32_t FileSize);
 		void m_SaveElements_FindOffsets();
@@ -3,6 +3,7 @@
 #include "M2.h"
 #include "M2Skin.h"
 #include "Logger.h"
+#include "Profiler.h"
 #include <cstring>
 #include <iostream>
 
@@ -138,6 +139,7 @@ bool M2Lib::M2SkinBuilder::CSubMesh::CSubsetPartition::AddTriangle(CTriangle* pT
 
 void M2Lib::M2SkinBuilder::CSubMesh::AddSubsetPartition(CBonePartition* pBonePartition)
 {
+	M2LIB_PROFILE_COUNT("Subset partitions created", 1);
 	SubsetPartitions.push_back(new CSubsetPartition(pBonePartition));
 }
 
@@ -167,6 +169,8 @@ void M2Lib::M2SkinBuilder::Clear()
 
 bool M2Lib::M2SkinBuilder::Build(M2Skin* pResult, uint32_t BoneLoD, M2I* pM2I, CVertex* pGlobalVertexList, uint32_t BoneStart)
 {
+	M2LIB_PROFILE_SCOPE("M2SkinBuilder::Build");
+
 	Clear();
 
 	// list of bone partitions used within this skin.
@@ -190,6 +194,7 @@ bool M2Lib::M2SkinBuilder::Build(M2Skin* pResult, uint32_t BoneLoD, M2I* pM2I, C
 
 			if (!Added)
 			{
+				M2LIB_PROFILE_COUNT("Bone partitions created", 1);
 				auto partition = new CBonePartition(BoneLoD);
 				m2lib_assert(partition->AddTriangle(pGlobalVertexList, &SubMesh->Triangles[j]));
 				m_BonePartitions.push_back(partition);
@@ -0,0 +1,275 @@
+#include "M2SkinIndex.h"
+#include "M2SkinElement.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace M2Lib::M2SkinElement;
+
+namespace
+{
+	// sub mesh groups up to this size are scanned in order, larger ones are searched along x of sort center
+	uint32_t const LinearSearchMaxCount = 16;
+}
+
+bool M2Lib::M2SkinIndex::GroupTable::IsCurrent(DataElement const& Element) const
+{
+	return Valid && Generation == Element.GetGeneration() && Count == Element.Count;
+}
+
+void M2Lib::M2SkinIndex::GroupTable::Build(DataElement const& Element, std::vector<uint32_t> const& Groups, uint32_t GroupCount)
+{
+	// counting sort keeps items of each group in element order
+	Offsets.assign(GroupCount + 1, 0);
+	for (auto Group : Groups)
+		++Offsets[Group + 1];
+	for (uint32_t i = 0; i < GroupCount; ++i)
+		Offsets[i + 1] += Offsets[i];
+
+	Items.resize(Groups.size());
+	std::vector<uint32_t> Next(Offsets.begin(), Offsets.end() - 1);
+	for (uint32_t i = 0; i < Groups.size(); ++i)
+		Items[Next[Groups[i]]++] = i;
+
+	Generation = Element.GetGeneration();
+	Count = Element.Count;
+	Valid = true;
+}
+
+M2Lib::M2SkinIndex::Range M2Lib::M2SkinIndex::GroupTable::Get(uint32_t Group) const
+{
+	Range Result;
+	if (Group + 1 >= Offsets.size())
+		return Result;
+
+	Result.First = Items.data() + Offsets[Group];
+	Result.Last = Items.data() + Offsets[Group + 1];
+	return Result;
+}
+
+void M2Lib::M2SkinIndex::Invalidate(uint32_t Tables)
+{
+	if (Tables & ETable_Materials)
+		materials.Valid = false;
+	if (Tables & ETable_Flags)
+		flags.Valid = false;
+	if (Tables & ETable_SubMeshes)
+		subMeshes.Valid = false;
+	if (Tables & (ETable_SubMeshes | ETable_Centers))
+		centersValid = false;
+}
+
+void M2Lib::M2SkinIndex::RemapSubMeshes(DataElement const* Elements, std::vector<uint32_t> const& Remap)
+{
+	auto& Element = Elements[EElement_SubMesh];
+	if (!subMeshes.IsCurrent(Element) || Remap.size() != Element.Count)
+	{
+		Invalidate(ETable_SubMeshes);
+		return;
+	}
+
+	// items of each group stay in element order, as if table was built again
+	for (auto& Item : subMeshes.Items)
+		Item = Remap[Item];
+	for (uint32_t i = 0; i + 1 < subMeshes.Offsets.size(); ++i)
+		std::sort(subMeshes.Items.begin() + subMeshes.Offsets[i], subMeshes.Items.begin() + subMeshes.Offsets[i + 1]);
+
+	if (!centersValid)
+		return;
+
+	std::vector<float> OldCenterX;
+	OldCenterX.swap(centerX);
+	centerX.resize(OldCenterX.size());
+	for (uint32_t i = 0; i < Remap.size(); ++i)
+		centerX[Remap[i]] = OldCenterX[i];
+
+	// ties are ordered by index, same as stable sort of fresh table
+	for (auto& Item : byCenter)
+		Item = Remap[Item];
+	for (uint32_t i = 0; i + 1 < subMeshes.Offsets.size(); ++i)
+	{
+		std::sort(byCenter.begin() + subMeshes.Offsets[i], byCenter.begin() + subMeshes.Offsets[i + 1],
+			[this](uint32_t A, uint32_t B) { return centerX[A] < centerX[B] || (centerX[A] == centerX[B] && A < B); });
+	}
+}
+
+void M2Lib::M2SkinIndex::UpdateMaterials(DataElement const* Elements)
+{
+	auto& Element = Elements[EElement_Material];
+	if (materials.IsCurrent(Element))
+		return;
+
+	auto Materials = Element.as<CElement_Material>();
+	std::vector<uint32_t> Groups(Element.Count);
+	uint32_t GroupCount = 0;
+	for (uint32_t i = 0; i < Element.Count; ++i)
+	{
+		Groups[i] = Materials[i].iSubMesh;
+		GroupCount = std::max<uint32_t>(GroupCount, Groups[i] + 1);
+	}
+
+	materials.Build(Element, Groups, GroupCount);
+}
+
+void M2Lib::M2SkinIndex::UpdateFlags(DataElement const* Elements)
+{
+	auto& Element = Elements[EElement_Flags];
+	if (flags.IsCurrent(Element))
+		return;
+
+	auto Flags = Element.as<CElement_Flags>();
+	std::vector<uint32_t> Groups(Element.Count);
+	uint32_t GroupCount = 0;
+	for (uint32_t i = 0; i < Element.Count; ++i)
+	{
+		Groups[i] = Flags[i].iSubMesh;
+		GroupCount = std::max<uint32_t>(GroupCount, Groups[i] + 1);
+	}
+
+	flags.Build(Element, Groups, GroupCount);
+}
+
+void M2Lib::M2SkinIndex::UpdateSubMeshes(DataElement const* Elements)
+{
+	auto& Element = Elements[EElement_SubMesh];
+	if (subMeshes.IsCurrent(Element))
+	{
+		if (!centersValid)
+			UpdateCenters(Element);
+		return;
+	}
+
+	auto SubMeshes = Element.as<CElement_SubMesh>();
+
+	groupById.clear();
+	std::vector<uint32_t> Groups(Element.Count);
+	for (uint32_t i = 0; i < Element.Count; ++i)
+		Groups[i] = groupById.emplace(SubMeshes[i].ID, (uint32_t)groupById.size()).first->second;
+
+	subMeshes.Build(Element, Groups, groupById.size());
+	UpdateCenters(Element);
+}
+
+void M2Lib::M2SkinIndex::UpdateCenters(DataElement const& Element)
+{
+	auto SubMeshes = Element.as<CElement_SubMesh>();
+
+	// nan centers are moved to the end of group, so that order is defined
+	centerX.resize(Element.Count);
+	for (uint32_t i = 0; i < Element.Count; ++i)
+		centerX[i] = std::isnan(SubMeshes[i].SortCenter.X) ? std::numeric_limits<float>::infinity() : SubMeshes[i].SortCenter.X;
+
+	byCenter = subMeshes.Items;
+	for (uint32_t i = 0; i + 1 < subMeshes.Offsets.size(); ++i)
+	{
+		std::stable_sort(byCenter.begin() + subMeshes.Offsets[i], byCenter.begin() + subMeshes.Offsets[i + 1],
+			[this](uint32_t A, uint32_t B) { return centerX[A] < centerX[B]; });
+	}
+
+	centersValid = true;
+}
+
+M2Lib::M2SkinIndex::Range M2Lib::M2SkinIndex::GetSubMeshMaterials(DataElement const* Elements, uint32_t SubMeshIndex)
+{
+	UpdateMaterials(Elements);
+
+	return materials.Get(SubMeshIndex);
+}
+
+M2Lib::M2SkinIndex::Range M2Lib::M2SkinIndex::GetSubMeshFlags(DataElement const* Elements, uint32_t SubMeshIndex)
+{
+	UpdateFlags(Elements);
+
+	return flags.Get(SubMeshIndex);
+}
+
+M2Lib::M2SkinIndex::Range M2Lib::M2SkinIndex::GetSubMeshesById(DataElement const* Elements, uint16_t ID)
+{
+	UpdateSubMeshes(Elements);
+
+	auto itr = groupById.find(ID);
+	if (itr == groupById.end())
+		return Range();
+
+	return subMeshes.Get(itr->second);
+}
+
+int32_t M2Lib::M2SkinIndex::FindClosestSubMesh(DataElement const* Elements, uint16_t ID, C3Vector const& SortCenter, C3Vector const& CenterMass)
+{
+	auto Candidates = GetSubMeshesById(Elements, ID);
+	if (Candidates.empty())
+		return -1;
+
+	auto SubMeshes = Elements[EElement_SubMesh].as<CElement_SubMesh>();
+
+	int32_t ClosestMatch = -1;
+	float DeltaMin = 0.0f;
+	auto Compare = [&](uint32_t i)
+	{
+		C3Vector SortDelta = SubMeshes[i].SortCenter - SortCenter;
+		C3Vector BoundingDelta = SubMeshes[i].CenterMass - CenterMass;
+		float Delta = SortDelta.Length() + BoundingDelta.Length();
+
+		if (ClosestMatch == -1 || Delta < DeltaMin || (Delta == DeltaMin && (int32_t)i < ClosestMatch))
+		{
+			DeltaMin = Delta;
+			ClosestMatch = i;
+		}
+	};
+
+	if (Candidates.size() <= LinearSearchMaxCount)
+	{
+		for (auto i : Candidates)
+			Compare(i);
+
+		return ClosestMatch;
+	}
+
+	// distance along x never exceeds delta, so sweep outwards from target x until it is further than closest match.
+	// small margin covers rounding of length.
+	auto First = byCenter.data() + (Candidates.First - subMeshes.Items.data());
+	auto Last = First + Candidates.size();
+	auto Center = std::lower_bound(First, Last, SortCenter.X, [this](uint32_t i, float X) { return centerX[i] < X; });
+
+	auto IsTooFar = [&](uint32_t i)
+	{
+		return ClosestMatch != -1 && std::fabs(centerX[i] - SortCenter.X) > DeltaMin * 1.0001f + 1e-6f;
+	};
+
+	auto Below = Center;
+	auto Above = Center;
+	bool SearchBelow = Below != First;
+	bool SearchAbove = Above != Last;
+	while (SearchBelow || SearchAbove)
+	{
+		if (SearchBelow)
+		{
+			if (IsTooFar(*(Below - 1)))
+				SearchBelow = false;
+			else
+			{
+				Compare(*--Below);
+				SearchBelow = Below != First;
+			}
+		}
+
+		if (SearchAbove)
+		{
+			if (IsTooFar(*Above))
+				SearchAbove = false;
+			else
+			{
+				Compare(*Above++);
+				SearchAbove = Above != Last;
+			}
+		}
+	}
+
+	return ClosestMatch;
+}
+
+uint64_t M2Lib::M2SkinIndex::GetMemoryUsage() const
+{
+	return materials.GetMemoryUsage() + flags.GetMemoryUsage() + subMeshes.GetMemoryUsage() +
+		groupById.size() * (sizeof(uint16_t) + sizeof(uint32_t)) + byCenter.capacity() * sizeof(uint32_t) + centerX.capacity() * sizeof(float);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "BaseTypes.h"
+#include "DataElement.h"
+#include "M2Types.h"
+#include <vector>
+#include <unordered_map>
+
+namespace M2Lib
+{
+	// lookup tables over elements of one skin: materials and flags of each sub mesh, sub meshes by ID and their centers.
+	// they replace scans of whole element lists, which made per sub mesh operations quadratic on skins with many sub meshes.
+	// table is rebuilt on first query after it was invalidated or after generation of its element changed, see DataElement::GetGeneration().
+	// in-place changes of sub mesh IDs or centers, or of iSubMesh of materials and flags, must be followed by Invalidate() or by update of affected table.
+	class M2SkinIndex
+	{
+	public:
+		enum ETable
+		{
+			ETable_Materials = 0x1,
+			ETable_Flags = 0x2,
+			ETable_SubMeshes = 0x4,		// sub meshes by ID and by center
+			ETable_Centers = 0x8,		// only order by center, for changes of centers that keep IDs
+			ETable_All = 0xF,
+		};
+
+		// indices into element list
+		struct Range
+		{
+			uint32_t const* First = nullptr;
+			uint32_t const* Last = nullptr;
+
+			uint32_t const* begin() const { return First; }
+			uint32_t const* end() const { return Last; }
+			uint32_t size() const { return (uint32_t)(Last - First); }
+			bool empty() const { return First == Last; }
+		};
+
+		void Invalidate(uint32_t Tables = ETable_All);
+		// updates sub mesh table after sub meshes were reordered in place, sub mesh i moved to Remap[i].
+		// groups by ID are kept, so only their items and center order are remapped.
+		void RemapSubMeshes(DataElement const* Elements, std::vector<uint32_t> const& Remap);
+
+		// materials assigned to sub mesh, in order of material list
+		Range GetSubMeshMaterials(DataElement const* Elements, uint32_t SubMeshIndex);
+		// flags assigned to sub mesh, in order of flags list
+		Range GetSubMeshFlags(DataElement const* Elements, uint32_t SubMeshIndex);
+		// sub meshes with ID, in order of sub mesh list
+		Range GetSubMeshesById(DataElement const* Elements, uint16_t ID);
+
+		// returns sub mesh with ID that is closest to given centers by sum of both distances, or -1 if there is no sub mesh with ID.
+		// of equally close sub meshes the one with lowest index is returned.
+		int32_t FindClosestSubMesh(DataElement const* Elements, uint16_t ID, C3Vector const& SortCenter, C3Vector const& CenterMass);
+
+		uint64_t GetMemoryUsage() const;
+
+	private:
+		// items of group i are Items[Offsets[i]] .. Items[Offsets[i + 1] - 1]
+		struct GroupTable
+		{
+			uint64_t Generation = 0;		// generation of element table was built from
+			uint32_t Count = 0;
+			bool Valid = false;
+
+			std::vector<uint32_t> Offsets;
+			std::vector<uint32_t> Items;
+
+			bool IsCurrent(DataElement const& Element) const;
+			void Build(DataElement const& Element, std::vector<uint32_t> const& Groups, uint32_t GroupCount);
+			Range Get(uint32_t Group) const;
+			uint64_t GetMemoryUsage() const { return (Offsets.capacity() + Items.capacity()) * sizeof(uint32_t); }
+		};
+
+		GroupTable materials;
+		GroupTable flags;
+
+		// sub meshes grouped by ID. byCenter holds same groups ordered by x of sort center, it bounds nearest center search.
+		GroupTable subMeshes;
+		std::unordered_map<uint16_t, uint32_t> groupById;
+		std::vector<uint32_t> byCenter;
+		std::vector<float> centerX;
+		bool centersValid = false;
+
+		void UpdateMaterials(DataElement const* Elements);
+		void UpdateFlags(DataElement const* Elements);
+		void UpdateSubMeshes(DataElement const* Elements);
+		void UpdateCenters(DataElement const& Element);
+	};
+}
@@ -1,4 +1,5 @@
 #include "M2Types.h"
+#include "Profiler.h"
 #define _USE_MATH_DEFINES
 #include <cmath>
 #include <algorithm>
@@ -60,8 +61,10 @@ M2Lib::CVertex& M2Lib::CVertex::operator = (const CVertex& Other)
 }
 
 // compares 2 vertices to see if they have the same position, bones, and texture coordinates. vertices between subsets that pass this test are most likely duplicates.
-bool M2Lib::CVertex::CompareSimilar(CVertex& A, CVertex& B, bool CompareTextures, bool CompareBones, bool CompareNormals, float PositionalTolerance, float AngularTolerance)
+bool M2Lib::CVertex::CompareSimilar(CVertex const& A, CVertex const& B, bool CompareTextures, bool CompareBones, bool CompareNormals, float PositionalTolerance, float AngularTolerance)
 {
+	M2LIB_PROFILE_COUNT("CVertex::CompareSimilar calls", 1);
+
 	// compare position
 	if (PositionalTolerance > 0.0f)
 	{
@@ -194,6 +197,10 @@ wchar_t const* M2Lib::GetErrorText(EError Error)
 			return L"error faled to save SKELETON, no file was specified.";
 		case EError_FailedToLoadSkeleton_CouldNotOpenFile:
 			return L"error: failed to load SKELETON, could not open file.";
+		case EError_FailedToLoadAnim_CouldNotOpenFile:
+			return L"error: failed to load ANIM, could not open file.";
+		case EError_FailedToLoadAnim_FileCorrupt:
+			return L"error: failed to load ANIM, file is corrupt.";
 		default:
 			break;
 	}
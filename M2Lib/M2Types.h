@@ -117,7 +117,7 @@ namespace M2Lib
 		CVertex();
 		CVertex(const CVertex& Other);
 		CVertex& operator = (const CVertex& Other);
-		static bool CompareSimilar(CVertex& A, CVertex& B, bool CompareTextures, bool CompareBones, bool CompareNormals, float PositionalTolerance, float AngularTolerance);	// compares 2 vertices to see if they have the same position, bones, and texture coordinates. vertices between subsets that pass this test are most likely duplicates.
+		static bool CompareSimilar(CVertex const& A, CVertex const& B, bool CompareTextures, bool CompareBones, bool CompareNormals, float PositionalTolerance, float AngularTolerance);	// compares 2 vertices to see if they have the same position, bones, and texture coordinates. vertices between subsets that pass this test are most likely duplicates.
 	};
 	ASSERT_SIZE(CVertex, 48);
 
@@ -206,6 +206,9 @@ namespace M2Lib
 
 		EError_FailedToLoadSkeleton_NoFileSpecified,
 		EError_FailedToLoadSkeleton_CouldNotOpenFile,
+
+		EError_FailedToLoadAnim_CouldNotOpenFile,
+		EError_FailedToLoadAnim_FileCorrupt,
 	};
 
 	M2LIB_API wchar_t const* __cdecl GetErrorText(EError Error);
@@ -0,0 +1,146 @@
+#include "MappedFile.h"
+#include <filesystem>
+
+#ifdef _WIN32
+# define WIN32_LEAN_AND_MEAN
+# define NOMINMAX
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+#endif
+
+M2Lib::MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+bool M2Lib::MappedFile::Open(std::wstring const& FileName)
+{
+	Close();
+
+	auto File = CreateFileW(FileName.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (File == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER FileSize;
+	if (!GetFileSizeEx(File, &FileSize))
+	{
+		CloseHandle(File);
+		return false;
+	}
+
+	// zero length file can't be mapped
+	if (FileSize.QuadPart == 0)
+	{
+		CloseHandle(File);
+		Opened = true;
+		return true;
+	}
+
+	auto Mapping = CreateFileMappingW(File, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!Mapping)
+	{
+		CloseHandle(File);
+		return false;
+	}
+
+	auto View = MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!View)
+	{
+		CloseHandle(Mapping);
+		CloseHandle(File);
+		return false;
+	}
+
+	FileHandle = File;
+	MappingHandle = Mapping;
+	Data = (uint8_t const*)View;
+	Size = (size_t)FileSize.QuadPart;
+	Opened = true;
+
+	return true;
+}
+
+void M2Lib::MappedFile::Close()
+{
+	if (Data && Buffer.empty())
+		UnmapViewOfFile(Data);
+	if (MappingHandle)
+		CloseHandle(MappingHandle);
+	if (FileHandle)
+		CloseHandle(FileHandle);
+
+	Data = nullptr;
+	Size = 0;
+	Opened = false;
+	FileHandle = nullptr;
+	MappingHandle = nullptr;
+	Buffer = std::vector<uint8_t>();
+}
+#else
+bool M2Lib::MappedFile::Open(std::wstring const& FileName)
+{
+	Close();
+
+	int File = open(std::filesystem::path(FileName).c_str(), O_RDONLY | O_CLOEXEC);
+	if (File < 0)
+		return false;
+
+	struct stat Stat;
+	if (fstat(File, &Stat) != 0)
+	{
+		close(File);
+		return false;
+	}
+
+	// mapping stays valid after descriptor is closed
+	void* View = nullptr;
+	if (Stat.st_size > 0)
+	{
+		View = mmap(nullptr, Stat.st_size, PROT_READ, MAP_PRIVATE, File, 0);
+		if (View == MAP_FAILED)
+		{
+			close(File);
+			return false;
+		}
+	}
+	close(File);
+
+	Data = (uint8_t const*)View;
+	Size = Stat.st_size;
+	Opened = true;
+
+	return true;
+}
+
+void M2Lib::MappedFile::Close()
+{
+	if (Data && Buffer.empty())
+		munmap((void*)Data, Size);
+
+	Data = nullptr;
+	Size = 0;
+	Opened = false;
+	Buffer = std::vector<uint8_t>();
+}
+#endif
+
+void M2Lib::MappedFile::CopyToMemory()
+{
+	if (!IsMapped())
+		return;
+
+	std::vector<uint8_t> Contents(Data, Data + Size);
+	auto ContentsSize = Size;
+
+	Close();
+
+	Buffer = std::move(Contents);
+	Data = Buffer.data();
+	Size = ContentsSize;
+	Opened = true;
+}
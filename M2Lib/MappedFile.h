@@ -0,0 +1,42 @@
+#pragma once
+
+#include "BaseTypes.h"
+#include <string>
+#include <vector>
+
+namespace M2Lib
+{
+	// read-only memory mapping of whole file. pages are read by system on first access, so only touched parts of file are loaded.
+	// mapped file must not be replaced or truncated while mapping is open, CopyToMemory() releases it.
+	class MappedFile
+	{
+		uint8_t const* Data = nullptr;
+		size_t Size = 0;
+		bool Opened = false;
+		std::vector<uint8_t> Buffer;	// contents of file after CopyToMemory()
+#ifdef _WIN32
+		void* FileHandle = nullptr;
+		void* MappingHandle = nullptr;
+#endif
+
+	public:
+		MappedFile() = default;
+		MappedFile(MappedFile const&) = delete;
+		MappedFile& operator=(MappedFile const&) = delete;
+		~MappedFile();
+
+		// maps file, empty file is opened without mapping
+		bool Open(std::wstring const& FileName);
+		void Close();
+		// copies contents to memory and closes mapping, so file can be replaced while it is still in use.
+		// pointers returned by GetData() before the call become invalid.
+		void CopyToMemory();
+
+		bool IsOpen() const { return Opened; }
+		uint8_t const* GetData() const { return Data; }
+		size_t GetSize() const { return Size; }
+		bool IsMapped() const { return Opened && Buffer.empty() && Size; }
+		// heap memory held after CopyToMemory(), mapped pages are not counted
+		size_t GetMemoryUsage() const { return Buffer.capacity(); }
+	};
+}
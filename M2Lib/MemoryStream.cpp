@@ -0,0 +1,40 @@
+#include "MemoryStream.h"
+
+M2Lib::MemoryStream::Buffer::Buffer(uint8_t const* Data, size_t Size)
+{
+	auto Begin = (char*)Data;
+	setg(Begin, Begin, Begin + Size);
+}
+
+std::streambuf::pos_type M2Lib::MemoryStream::Buffer::seekoff(off_type Offset, std::ios_base::seekdir Direction, std::ios_base::openmode Mode)
+{
+	if (!(Mode & std::ios_base::in))
+		return pos_type(off_type(-1));
+
+	char* Target;
+	switch (Direction)
+	{
+		case std::ios_base::beg: Target = eback() + Offset; break;
+		case std::ios_base::cur: Target = gptr() + Offset; break;
+		case std::ios_base::end: Target = egptr() + Offset; break;
+		default: return pos_type(off_type(-1));
+	}
+
+	if (Target < eback() || Target > egptr())
+		return pos_type(off_type(-1));
+
+	setg(eback(), Target, egptr());
+	return pos_type(off_type(Target - eback()));
+}
+
+std::streambuf::pos_type M2Lib::MemoryStream::Buffer::seekpos(pos_type Position, std::ios_base::openmode Mode)
+{
+	return seekoff(off_type(Position), std::ios_base::beg, Mode);
+}
+
+M2Lib::MemoryStream::MemoryStream(uint8_t const* Data, size_t Size)
+	: std::istream(nullptr)
+	, StreamBuffer(Data, Size)
+{
+	rdbuf(&StreamBuffer);
+}
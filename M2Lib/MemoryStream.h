@@ -0,0 +1,28 @@
+#pragma once
+
+#include "BaseTypes.h"
+#include <istream>
+#include <streambuf>
+
+namespace M2Lib
+{
+	// read-only stream over memory block, used to parse files that are already read to memory.
+	// memory is not copied and must outlive the stream.
+	class MemoryStream : public std::istream
+	{
+		class Buffer : public std::streambuf
+		{
+		public:
+			Buffer(uint8_t const* Data, size_t Size);
+
+		protected:
+			pos_type seekoff(off_type Offset, std::ios_base::seekdir Direction, std::ios_base::openmode Mode) override;
+			pos_type seekpos(pos_type Position, std::ios_base::openmode Mode) override;
+		};
+
+		Buffer StreamBuffer;
+
+	public:
+		MemoryStream(uint8_t const* Data, size_t Size);
+	};
+}
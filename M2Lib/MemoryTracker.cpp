@@ -0,0 +1,245 @@
+#include "MemoryTracker.h"
+#include "Logger.h"
+#include "StringHelpers.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <malloc.h>
+
+#ifdef _WIN32
+# define M2LIB_BLOCK_SIZE(pointer) _msize(pointer)
+#else
+# define M2LIB_BLOCK_SIZE(pointer) malloc_usable_size(pointer)
+#endif
+
+std::atomic<bool> M2Lib::MemoryTracker::Enabled(false);
+std::atomic<uint64_t> M2Lib::MemoryTracker::AllocationCount(0);
+std::atomic<uint64_t> M2Lib::MemoryTracker::AllocatedBytes(0);
+std::atomic<int64_t> M2Lib::MemoryTracker::CurrentBytes(0);
+std::atomic<int64_t> M2Lib::MemoryTracker::PeakBytes(0);
+std::atomic<uint64_t> M2Lib::MemoryTracker::ActivePeakSlots(0);
+std::atomic<int64_t> M2Lib::MemoryTracker::PeakSlots[PeakSlotCount];
+
+// block sizes are taken from allocator, so releases don't need a header in front of every block
+void* operator new(std::size_t Size)
+{
+	auto Pointer = std::malloc(Size ? Size : 1);
+	if (!Pointer)
+		throw std::bad_alloc();
+
+	if (M2Lib::MemoryTracker::IsEnabled())
+		M2Lib::MemoryTracker::OnAllocate(M2LIB_BLOCK_SIZE(Pointer));
+
+	return Pointer;
+}
+
+void operator delete(void* Pointer) noexcept
+{
+	if (!Pointer)
+		return;
+
+	if (M2Lib::MemoryTracker::IsEnabled())
+		M2Lib::MemoryTracker::OnRelease(M2LIB_BLOCK_SIZE(Pointer));
+
+	std::free(Pointer);
+}
+
+M2Lib::MemoryTracker::MemoryTracker()
+{
+}
+
+void M2Lib::MemoryTracker::UpdatePeak(std::atomic<int64_t>& Peak, int64_t Current)
+{
+	int64_t Value = Peak.load(std::memory_order_relaxed);
+	while (Current > Value && !Peak.compare_exchange_weak(Value, Current, std::memory_order_relaxed))
+		;
+}
+
+void M2Lib::MemoryTracker::OnAllocate(uint64_t Size)
+{
+	AllocationCount.fetch_add(1, std::memory_order_relaxed);
+	AllocatedBytes.fetch_add(Size, std::memory_order_relaxed);
+
+	int64_t Current = CurrentBytes.fetch_add(Size, std::memory_order_relaxed) + Size;
+	UpdatePeak(PeakBytes, Current);
+
+	for (uint64_t Active = ActivePeakSlots.load(std::memory_order_relaxed), i = 0; Active; Active >>= 1, ++i)
+		if (Active & 1)
+			UpdatePeak(PeakSlots[i], Current);
+}
+
+void M2Lib::MemoryTracker::OnRelease(uint64_t Size)
+{
+	CurrentBytes.fetch_sub(Size, std::memory_order_relaxed);
+}
+
+void M2Lib::MemoryTracker::Reset()
+{
+	// blocks allocated before reset are still released later, so current usage is kept and peaks start from it
+	AllocationCount = 0;
+	AllocatedBytes = 0;
+
+	int64_t Current = CurrentBytes.load(std::memory_order_relaxed);
+	PeakBytes = Current;
+	for (uint32_t i = 0; i < PeakSlotCount; ++i)
+		PeakSlots[i] = Current;
+
+	std::lock_guard<std::mutex> lock(StagesLock);
+	Stages.clear();
+}
+
+int32_t M2Lib::MemoryTracker::BeginPeak()
+{
+	uint64_t Active = ActivePeakSlots.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		if (Active == ~0ull)
+			return -1;
+
+		int32_t Slot = 0;
+		while (Active & (1ull << Slot))
+			++Slot;
+
+		if (!ActivePeakSlots.compare_exchange_weak(Active, Active | (1ull << Slot), std::memory_order_acq_rel))
+			continue;
+
+		// value left by previous owner is replaced, allocations racing with it differ from current usage only by their own size
+		PeakSlots[Slot].store(CurrentBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		return Slot;
+	}
+}
+
+int64_t M2Lib::MemoryTracker::EndPeak(int32_t Slot)
+{
+	int64_t Current = CurrentBytes.load(std::memory_order_relaxed);
+	if (Slot < 0)
+		return Current;
+
+	ActivePeakSlots.fetch_and(~(1ull << Slot), std::memory_order_acq_rel);
+
+	return std::max(PeakSlots[Slot].load(std::memory_order_relaxed), Current);
+}
+
+void M2Lib::MemoryTracker::AddStage(char const* Name, int64_t Peak, uint64_t Allocations, uint64_t AllocatedBytes)
+{
+	std::lock_guard<std::mutex> lock(StagesLock);
+
+	auto& stage = Stages[Name];
+	if (!stage.Calls)
+		stage.Order = Stages.size();
+	++stage.Calls;
+	stage.Peak = std::max(stage.Peak, Peak);
+	stage.Allocations += Allocations;
+	stage.AllocatedBytes += AllocatedBytes;
+}
+
+void M2Lib::MemoryTracker::PrintReport()
+{
+	sLogger.LogInfo(L"Memory: current %.1f KB, peak %.1f KB, %llu allocations, %.1f KB allocated", GetCurrentBytes() / 1024.0, GetPeakBytes() / 1024.0,
+		(unsigned long long)GetAllocationCount(), GetAllocatedBytes() / 1024.0);
+
+	std::vector<std::pair<std::string, StageInfo>> SortedStages;
+	{
+		std::lock_guard<std::mutex> lock(StagesLock);
+		SortedStages.assign(Stages.begin(), Stages.end());
+	}
+
+	std::sort(SortedStages.begin(), SortedStages.end(), [](std::pair<std::string, StageInfo> const& a, std::pair<std::string, StageInfo> const& b)
+	{
+		return a.second.Peak != b.second.Peak ? a.second.Peak > b.second.Peak : a.second.Order < b.second.Order;
+	});
+
+	sLogger.LogInfo(L"%-40s %8s %14s %14s %14s", L"Stage", L"Calls", L"Peak KB", L"Allocations", L"Allocated KB");
+	for (auto& itr : SortedStages)
+	{
+		auto& stage = itr.second;
+		sLogger.LogInfo(L"%-40s %8u %14.1f %14llu %14.1f", StringHelpers::StringToWString(itr.first).c_str(), stage.Calls,
+			stage.Peak / 1024.0, (unsigned long long)stage.Allocations, stage.AllocatedBytes / 1024.0);
+	}
+}
+
+void M2Lib::MemoryReport::Add(std::string const& Name, uint64_t Bytes)
+{
+	Entries.push_back({ Name, Bytes });
+}
+
+void M2Lib::MemoryReport::Add(std::string const& Prefix, MemoryReport const& Other)
+{
+	for (auto& entry : Other.Entries)
+		Entries.push_back({ Prefix + entry.first, entry.second });
+}
+
+uint64_t M2Lib::MemoryReport::GetTotal() const
+{
+	uint64_t Total = 0;
+	for (auto& entry : Entries)
+		Total += entry.second;
+
+	return Total;
+}
+
+void M2Lib::MemoryReport::Print(wchar_t const* Title, uint64_t MinBytes) const
+{
+	auto Total = GetTotal();
+	sLogger.LogInfo(L"%s: %.1f KB", Title, Total / 1024.0);
+
+	auto SortedEntries = Entries;
+	std::stable_sort(SortedEntries.begin(), SortedEntries.end(), [](std::pair<std::string, uint64_t> const& a, std::pair<std::string, uint64_t> const& b)
+	{
+		return a.second > b.second;
+	});
+
+	uint32_t OtherCount = 0;
+	uint64_t OtherBytes = 0;
+	for (auto& entry : SortedEntries)
+	{
+		if (entry.second < MinBytes)
+		{
+			++OtherCount;
+			OtherBytes += entry.second;
+			continue;
+		}
+
+		sLogger.LogInfo(L"    %-40s %12.1f KB %6.1f%%", StringHelpers::StringToWString(entry.first).c_str(), entry.second / 1024.0, Total ? entry.second * 100.0 / Total : 0.0);
+	}
+
+	if (OtherCount)
+		sLogger.LogInfo(L"    %-40s %12.1f KB %6.1f%%", (L"(" + std::to_wstring(OtherCount) + L" smaller parts)").c_str(), OtherBytes / 1024.0, Total ? OtherBytes * 100.0 / Total : 0.0);
+}
+
+void M2Lib::MemoryTracker_SetEnabled(bool Enabled)
+{
+	MemoryTracker::GetInstance()->SetEnabled(Enabled);
+}
+
+void M2Lib::MemoryTracker_Reset()
+{
+	MemoryTracker::GetInstance()->Reset();
+}
+
+int64_t M2Lib::MemoryTracker_GetCurrentBytes()
+{
+	return MemoryTracker::GetInstance()->GetCurrentBytes();
+}
+
+int64_t M2Lib::MemoryTracker_GetPeakBytes()
+{
+	return MemoryTracker::GetInstance()->GetPeakBytes();
+}
+
+uint64_t M2Lib::MemoryTracker_GetAllocationCount()
+{
+	return MemoryTracker::GetInstance()->GetAllocationCount();
+}
+
+void M2Lib::MemoryTracker_PrintReport()
+{
+	try
+	{
+		MemoryTracker::GetInstance()->PrintReport();
+	}
+	catch (std::exception& e)
+	{
+		sLogger.LogError(L"Exception: %s", StringHelpers::StringToWString(e.what()).c_str());
+	}
+}
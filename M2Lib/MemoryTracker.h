@@ -0,0 +1,137 @@
+#pragma once
+
+#include "BaseTypes.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+
+namespace M2Lib
+{
+	// tracks heap usage of library through replaced global operator new and delete.
+	// disabled by default, disabled tracker costs single relaxed atomic load per allocation.
+	// current bytes are net bytes allocated since tracking was enabled, peaks are measured from the same point or from last reset.
+	// every measured peak has its own slot, so nested and concurrent stages don't reset peaks of each other.
+	class MemoryTracker
+	{
+		MemoryTracker();
+
+		struct StageInfo
+		{
+			uint32_t Order = 0;			// stages are reported in order they were first entered
+			uint32_t Calls = 0;
+			int64_t Peak = 0;			// highest growth above usage at stage start
+			uint64_t Allocations = 0;
+			uint64_t AllocatedBytes = 0;
+		};
+
+		// counters are static, so operator new can use them before tracker instance is constructed
+		static std::atomic<bool> Enabled;
+
+		static std::atomic<uint64_t> AllocationCount;
+		static std::atomic<uint64_t> AllocatedBytes;
+		static std::atomic<int64_t> CurrentBytes;
+		static std::atomic<int64_t> PeakBytes;
+
+		static uint32_t const PeakSlotCount = 64;
+		static std::atomic<uint64_t> ActivePeakSlots;		// bit per slot that is being measured
+		static std::atomic<int64_t> PeakSlots[PeakSlotCount];
+
+		std::mutex StagesLock;
+		std::map<std::string, StageInfo> Stages;
+
+		static void UpdatePeak(std::atomic<int64_t>& Peak, int64_t Current);
+
+	public:
+		static MemoryTracker* GetInstance()
+		{
+			static MemoryTracker instance;
+
+			return &instance;
+		}
+
+		static bool IsEnabled() { return Enabled.load(std::memory_order_relaxed); }
+		void SetEnabled(bool Enabled) { MemoryTracker::Enabled = Enabled; }
+
+		// clears allocation counters and stages, overall and running peaks start again from current usage
+		void Reset();
+
+		static void OnAllocate(uint64_t Size);
+		static void OnRelease(uint64_t Size);
+
+		uint64_t GetAllocationCount() const { return AllocationCount.load(std::memory_order_relaxed); }
+		uint64_t GetAllocatedBytes() const { return AllocatedBytes.load(std::memory_order_relaxed); }
+		int64_t GetCurrentBytes() const { return CurrentBytes.load(std::memory_order_relaxed); }
+		int64_t GetPeakBytes() const { return PeakBytes.load(std::memory_order_relaxed); }
+
+		// starts measuring peak from current usage, returns slot that has to be passed to EndPeak.
+		// returns -1 if all slots are taken, EndPeak then gives usage at its call.
+		int32_t BeginPeak();
+		// returns highest usage since BeginPeak and frees slot
+		int64_t EndPeak(int32_t Slot);
+
+		void AddStage(char const* Name, int64_t Peak, uint64_t Allocations, uint64_t AllocatedBytes);
+		// logs peak, allocation count and allocated bytes of every stage, largest peak first
+		void PrintReport();
+	};
+
+	// records peak and allocations between construction and destruction as stage.
+	// usage is process-wide, so peak of stage includes allocations of stages running concurrently on other threads.
+	class MemoryStageScope
+	{
+		char const* Name;
+		int64_t StartBytes;
+		int32_t PeakSlot;
+		uint64_t StartAllocations;
+		uint64_t StartAllocatedBytes;
+
+	public:
+		MemoryStageScope(char const* Name)
+		{
+			auto tracker = MemoryTracker::GetInstance();
+			this->Name = tracker->IsEnabled() ? Name : nullptr;
+			if (!this->Name)
+				return;
+
+			StartBytes = tracker->GetCurrentBytes();
+			StartAllocations = tracker->GetAllocationCount();
+			StartAllocatedBytes = tracker->GetAllocatedBytes();
+			PeakSlot = tracker->BeginPeak();
+		}
+
+		~MemoryStageScope()
+		{
+			if (!Name)
+				return;
+
+			auto tracker = MemoryTracker::GetInstance();
+			auto Peak = tracker->EndPeak(PeakSlot);
+			tracker->AddStage(Name, Peak - StartBytes, tracker->GetAllocationCount() - StartAllocations, tracker->GetAllocatedBytes() - StartAllocatedBytes);
+		}
+	};
+
+	// list of named sizes, used to show which parts of object take most memory
+	class MemoryReport
+	{
+		std::vector<std::pair<std::string, uint64_t>> Entries;
+
+	public:
+		void Add(std::string const& Name, uint64_t Bytes);
+		// adds all entries of other report, names are prefixed with Prefix
+		void Add(std::string const& Prefix, MemoryReport const& Other);
+
+		uint64_t GetTotal() const;
+		std::vector<std::pair<std::string, uint64_t>> const& GetEntries() const { return Entries; }
+
+		// logs entries sorted by size, entries smaller than MinBytes are summed into single line
+		void Print(wchar_t const* Title, uint64_t MinBytes = 1024) const;
+	};
+
+	M2LIB_API void __cdecl MemoryTracker_SetEnabled(bool Enabled);
+	M2LIB_API void __cdecl MemoryTracker_Reset();
+	M2LIB_API int64_t __cdecl MemoryTracker_GetCurrentBytes();
+	M2LIB_API int64_t __cdecl MemoryTracker_GetPeakBytes();
+	M2LIB_API uint64_t __cdecl MemoryTracker_GetAllocationCount();
+	M2LIB_API void __cdecl MemoryTracker_PrintReport();
+}
@@ -0,0 +1,171 @@
+#include "Profiler.h"
+#include "Logger.h"
+#include "StringHelpers.h"
+#include <fstream>
+#include <map>
+#include <algorithm>
+
+namespace
+{
+	std::atomic<uint32_t> NextThreadId(1);
+}
+
+M2Lib::Profiler::Profiler() : Enabled(false)
+{
+	Epoch = std::chrono::steady_clock::now();
+}
+
+void M2Lib::Profiler::Reset()
+{
+	{
+		std::lock_guard<std::mutex> lock(EventsLock);
+		Events.clear();
+	}
+
+	std::lock_guard<std::mutex> lock(CountersLock);
+	for (auto counter : Counters)
+		counter->Reset();
+}
+
+int64_t M2Lib::Profiler::GetTime() const
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - Epoch).count();
+}
+
+uint32_t M2Lib::Profiler::GetThreadId()
+{
+	thread_local uint32_t ThreadId = NextThreadId++;
+
+	return ThreadId;
+}
+
+void M2Lib::Profiler::AddEvent(char const* Name, int64_t Start, int64_t Duration)
+{
+	uint32_t ThreadId = GetThreadId();
+
+	std::lock_guard<std::mutex> lock(EventsLock);
+	Events.push_back({ Name, ThreadId, Start, Duration });
+}
+
+void M2Lib::Profiler::RegisterCounter(ProfileCounter* Counter)
+{
+	std::lock_guard<std::mutex> lock(CountersLock);
+	Counters.push_back(Counter);
+}
+
+bool M2Lib::Profiler::ExportChromeTrace(std::wstring const& FileName)
+{
+	std::fstream FileStream;
+	FileStream.open(FileName, std::ios::out | std::ios::trunc);
+	if (FileStream.fail())
+	{
+		sLogger.LogError(L"Failed to open '%s' for profiler trace", FileName.c_str());
+		return false;
+	}
+
+	int64_t EndTime = GetTime();
+
+	FileStream << "{\"traceEvents\":[";
+
+	bool First = true;
+	{
+		std::lock_guard<std::mutex> lock(EventsLock);
+		for (auto& event : Events)
+		{
+			FileStream << (First ? "\n" : ",\n");
+			FileStream << "{\"name\":\"" << event.Name << "\",\"cat\":\"m2lib\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.ThreadId
+				<< ",\"ts\":" << event.Start << ",\"dur\":" << event.Duration << "}";
+			First = false;
+		}
+	}
+
+	{
+		// counters are totals, they are shown as single sample at the end of trace
+		std::lock_guard<std::mutex> lock(CountersLock);
+		for (auto counter : Counters)
+		{
+			FileStream << (First ? "\n" : ",\n");
+			FileStream << "{\"name\":\"" << counter->GetName() << "\",\"cat\":\"m2lib\",\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":" << EndTime
+				<< ",\"args\":{\"value\":" << counter->GetValue() << "}}";
+			First = false;
+		}
+	}
+
+	FileStream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	FileStream.close();
+
+	return !FileStream.fail();
+}
+
+void M2Lib::Profiler::PrintSummary()
+{
+	struct StageInfo
+	{
+		uint32_t Calls = 0;
+		int64_t Total = 0;
+		int64_t Max = 0;
+		int64_t FirstStart = 0;
+	};
+
+	std::map<std::string, StageInfo> Stages;
+	{
+		std::lock_guard<std::mutex> lock(EventsLock);
+		for (auto& event : Events)
+		{
+			auto& stage = Stages[event.Name];
+			if (!stage.Calls)
+				stage.FirstStart = event.Start;
+			++stage.Calls;
+			stage.Total += event.Duration;
+			stage.Max = std::max(stage.Max, event.Duration);
+		}
+	}
+
+	// stages are listed in order they were first entered
+	std::vector<std::pair<std::string, StageInfo>> SortedStages(Stages.begin(), Stages.end());
+	std::sort(SortedStages.begin(), SortedStages.end(), [](std::pair<std::string, StageInfo> const& a, std::pair<std::string, StageInfo> const& b)
+	{
+		return a.second.FirstStart < b.second.FirstStart;
+	});
+
+	sLogger.LogInfo(L"%-40s %8s %12s %12s %12s", L"Stage", L"Calls", L"Total ms", L"Avg ms", L"Max ms");
+	for (auto& itr : SortedStages)
+	{
+		auto& stage = itr.second;
+		sLogger.LogInfo(L"%-40s %8u %12.3f %12.3f %12.3f", StringHelpers::StringToWString(itr.first).c_str(), stage.Calls,
+			stage.Total / 1000.0, stage.Total / 1000.0 / stage.Calls, stage.Max / 1000.0);
+	}
+
+	std::lock_guard<std::mutex> lock(CountersLock);
+	for (auto counter : Counters)
+		sLogger.LogInfo(L"%-40s %8llu", StringHelpers::StringToWString(counter->GetName()).c_str(), (unsigned long long)counter->GetValue());
+}
+
+void M2Lib::Profiler_SetEnabled(bool Enabled)
+{
+	Profiler::GetInstance()->SetEnabled(Enabled);
+}
+
+void M2Lib::Profiler_Reset()
+{
+	Profiler::GetInstance()->Reset();
+}
+
+bool M2Lib::Profiler_ExportChromeTrace(const wchar_t* FileName)
+{
+	try
+	{
+		return Profiler::GetInstance()->ExportChromeTrace(FileName);
+	}
+	catch (std::exception& e)
+	{
+		sLogger.LogError(L"Exception: %s", StringHelpers::StringToWString(e.what()).c_str());
+
+		return false;
+	}
+}
+
+void M2Lib::Profiler_PrintSummary()
+{
+	Profiler::GetInstance()->PrintSummary();
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "BaseTypes.h"
+#include "MemoryTracker.h"
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+// set to 0 to compile out all profiling scopes and counters
+#ifndef M2LIB_PROFILER
+# define M2LIB_PROFILER 1
+#endif
+
+namespace M2Lib
+{
+	class ProfileCounter;
+
+	// collects timings of scoped stages and values of counters from all threads.
+	// disabled by default, disabled scope or counter costs single relaxed atomic load.
+	class Profiler
+	{
+		Profiler();
+
+		struct Event
+		{
+			char const* Name;
+			uint32_t ThreadId;
+			int64_t Start;		// microseconds since profiler epoch
+			int64_t Duration;
+		};
+
+		std::atomic<bool> Enabled;
+		std::chrono::steady_clock::time_point Epoch;
+
+		std::mutex EventsLock;
+		std::vector<Event> Events;
+
+		std::mutex CountersLock;
+		std::vector<ProfileCounter*> Counters;
+
+	public:
+		static Profiler* GetInstance()
+		{
+			static Profiler instance;
+
+			return &instance;
+		}
+
+		bool IsEnabled() const { return Enabled.load(std::memory_order_relaxed); }
+		void SetEnabled(bool Enabled) { this->Enabled = Enabled; }
+
+		// clears recorded events and counters
+		void Reset();
+
+		int64_t GetTime() const;
+		static uint32_t GetThreadId();
+
+		void AddEvent(char const* Name, int64_t Start, int64_t Duration);
+		void RegisterCounter(ProfileCounter* Counter);
+
+		// writes events and counters in chrome://tracing JSON format
+		bool ExportChromeTrace(std::wstring const& FileName);
+		// logs table with call count and total, average and max time of every stage, followed by counters
+		void PrintSummary();
+	};
+
+	// counter defined once per call site, usually through M2LIB_PROFILE_COUNT
+	class ProfileCounter
+	{
+		char const* Name;
+		std::atomic<uint64_t> Value;
+
+	public:
+		ProfileCounter(char const* Name) : Name(Name), Value(0) { Profiler::GetInstance()->RegisterCounter(this); }
+
+		void Add(uint64_t Count)
+		{
+			if (Profiler::GetInstance()->IsEnabled())
+				Value.fetch_add(Count, std::memory_order_relaxed);
+		}
+
+		char const* GetName() const { return Name; }
+		uint64_t GetValue() const { return Value.load(std::memory_order_relaxed); }
+		void Reset() { Value = 0; }
+	};
+
+	// records time between construction and destruction as event.
+	// when memory tracker is enabled, same scope is recorded as memory stage.
+	class ProfileScope
+	{
+		char const* Name;
+		int64_t Start;
+		MemoryStageScope MemoryStage;
+
+	public:
+		ProfileScope(char const* Name) : MemoryStage(Name)
+		{
+			auto profiler = Profiler::GetInstance();
+			this->Name = profiler->IsEnabled() ? Name : nullptr;
+			Start = this->Name ? profiler->GetTime() : 0;
+		}
+
+		~ProfileScope()
+		{
+			if (!Name)
+				return;
+
+			auto profiler = Profiler::GetInstance();
+			profiler->AddEvent(Name, Start, profiler->GetTime() - Start);
+		}
+	};
+
+	M2LIB_API void __cdecl Profiler_SetEnabled(bool Enabled);
+	M2LIB_API void __cdecl Profiler_Reset();
+	M2LIB_API bool __cdecl Profiler_ExportChromeTrace(const wchar_t* FileName);
+	M2LIB_API void __cdecl Profiler_PrintSummary();
+}
+
+#define M2LIB_PROFILE_CONCAT_(a, b) a##b
+#define M2LIB_PROFILE_CONCAT(a, b) M2LIB_PROFILE_CONCAT_(a, b)
+
+#if M2LIB_PROFILER
+# define M2LIB_PROFILE_SCOPE(name) M2Lib::ProfileScope M2LIB_PROFILE_CONCAT(profileScope, __LINE__)(name)
+# define M2LIB_PROFILE_COUNT(name, count) \
+	{ static M2Lib::ProfileCounter profileCounter(name); profileCounter.Add(count); }
+#else
+# define M2LIB_PROFILE_SCOPE(name)
+# define M2LIB_PROFILE_COUNT(name, count)
+#endif
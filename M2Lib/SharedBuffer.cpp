@@ -0,0 +1,72 @@
+#include "SharedBuffer.h"
+#include <algorithm>
+#include <atomic>
+
+M2Lib::SharedBuffer::SharedBuffer(std::vector<uint8_t>&& Data)
+	: Storage(std::make_shared<std::vector<uint8_t>>(std::move(Data))), Generation(NextGeneration())
+{
+}
+
+M2Lib::SharedBuffer& M2Lib::SharedBuffer::operator=(std::vector<uint8_t>&& Data)
+{
+	Storage = std::make_shared<std::vector<uint8_t>>(std::move(Data));
+	Generation = NextGeneration();
+	return *this;
+}
+
+uint64_t M2Lib::SharedBuffer::NextGeneration()
+{
+	static std::atomic<uint64_t> Counter(0);
+
+	return ++Counter;
+}
+
+std::vector<uint8_t>& M2Lib::SharedBuffer::Mutable()
+{
+	if (!Storage)
+		Storage = std::make_shared<std::vector<uint8_t>>();
+	else if (Storage.use_count() > 1)
+		Storage = std::make_shared<std::vector<uint8_t>>(*Storage);
+	else
+	{
+		// other owners may have just released storage on other threads, their reads must be complete before it is written
+		std::atomic_thread_fence(std::memory_order_acquire);
+	}
+
+	return *Storage;
+}
+
+M2Lib::SharedBuffer::iterator M2Lib::SharedBuffer::insert(const_iterator Position, size_t Count, uint8_t Value)
+{
+	// Position must come from begin()/end() of this buffer, those have already detached storage
+	Generation = NextGeneration();
+	return Mutable().insert(Position, Count, Value);
+}
+
+void M2Lib::SharedBuffer::resize(size_t NewSize)
+{
+	Generation = NextGeneration();
+
+	if (IsShared())
+	{
+		// copy only the part that survives resize
+		auto Size = std::min(NewSize, Storage->size());
+		std::vector<uint8_t> NewData(Storage->begin(), Storage->begin() + Size);
+		NewData.resize(NewSize);
+		Storage = std::make_shared<std::vector<uint8_t>>(std::move(NewData));
+		return;
+	}
+
+	Mutable().resize(NewSize);
+}
+
+void M2Lib::SharedBuffer::clear()
+{
+	Generation = NextGeneration();
+
+	// drop reference instead of copying data that is discarded anyway
+	if (IsShared())
+		Storage.reset();
+	else if (Storage)
+		Storage->clear();
+}
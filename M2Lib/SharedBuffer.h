@@ -0,0 +1,58 @@
+#pragma once
+
+#include "BaseTypes.h"
+#include <vector>
+#include <memory>
+
+namespace M2Lib
+{
+	// byte buffer with copy-on-write storage.
+	// copies of buffer share same data until one of them is accessed through non-const method.
+	// non-const access may move data to new storage, pointers taken from buffer before it must not be used after it.
+	// read-only code should use const access, otherwise it copies data that is shared with clones.
+	// buffers that share storage can be used from different threads, single buffer must not be copied while it is modified.
+	class SharedBuffer
+	{
+		std::shared_ptr<std::vector<uint8_t>> Storage;
+		uint64_t Generation = 0;
+
+		// detaches storage from other owners and returns it for modification.
+		std::vector<uint8_t>& Mutable();
+		static uint64_t NextGeneration();
+
+	public:
+		typedef std::vector<uint8_t>::iterator iterator;
+		typedef std::vector<uint8_t>::const_iterator const_iterator;
+
+		SharedBuffer() = default;
+		SharedBuffer(std::vector<uint8_t>&& Data);
+		SharedBuffer& operator=(std::vector<uint8_t>&& Data);
+
+		size_t size() const { return Storage ? Storage->size() : 0; }
+		bool empty() const { return size() == 0; }
+
+		uint8_t const* data() const { return Storage ? Storage->data() : nullptr; }
+		uint8_t* data() { return Mutable().data(); }
+
+		uint8_t const& operator[](size_t Index) const { return (*Storage)[Index]; }
+		uint8_t& operator[](size_t Index) { return Mutable()[Index]; }
+
+		iterator begin() { return Mutable().begin(); }
+		iterator end() { return Mutable().end(); }
+
+		iterator insert(const_iterator Position, size_t Count, uint8_t Value);
+		void resize(size_t NewSize);
+		void clear();
+
+		// process-wide unique value that changes whenever buffer is resized, reassigned or marked replaced, copies keep generation of their source.
+		// in-place writes keep it, so it tells whether contents were replaced as a whole, not whether they were modified.
+		uint64_t GetGeneration() const { return Generation; }
+		// gives buffer new generation, for code that overwrites whole contents in place
+		void MarkReplaced() { Generation = NextGeneration(); }
+
+		// true if data is shared with another buffer
+		bool IsShared() const { return Storage && Storage.use_count() > 1; }
+		// bytes of storage, split evenly between buffers that share it
+		size_t GetMemoryUsage() const { return Storage ? Storage->capacity() / Storage.use_count() : 0; }
+	};
+}
@@ -1,12 +1,15 @@
 #include "Skeleton.h"
 #include "DataBinary.h"
 #include "Logger.h"
+#include <fstream>
+#include <cstring>
+#include "GatherWriter.h"
 #include <filesystem>
 
 using namespace M2Lib;
 using namespace M2Lib::SkeletonChunk;
 
-EError Skeleton::Load(const wchar_t* FileName)
+EError Skeleton::Load(const wchar_t* FileName, std::shared_ptr<std::vector<uint8_t> const> FileData)
 {
 	// check path
 	if (!FileName)
@@ -14,56 +17,81 @@ EError Skeleton::Load(const wchar_t* FileName)
 	
 	sLogger.LogInfo(L"Loading skeleton at %s", FileName);
 
+	if (FileData)
+		return m_Load(FileData);
+
 	// open file stream
 	std::fstream FileStream;
 	FileStream.open(FileName, std::ios::in | std::ios::binary);
 	if (FileStream.fail())
 		return EError_FailedToLoadSkeleton_CouldNotOpenFile;
 
-	// find file size
 	FileStream.seekg(0, std::ios::end);
-	uint32_t FileSize = (uint32_t)FileStream.tellg();
+	auto FileSize = (size_t)FileStream.tellg();
 	FileStream.seekg(0, std::ios::beg);
 
+	auto Data = std::make_shared<std::vector<uint8_t>>(FileSize);
+	FileStream.read((char*)Data->data(), FileSize);
+	if (FileStream.fail())
+		return EError_FailedToLoadSkeleton_CouldNotOpenFile;
+
+	return m_Load(Data);
+}
+
+EError Skeleton::m_Load(std::shared_ptr<std::vector<uint8_t> const> FileData)
+{
+	auto Data = FileData->data();
+	uint32_t FileSize = (uint32_t)FileData->size();
+
+	shared.reset();
+
 	sLogger.LogInfo(L"Loading skeleton chunks...");
-	while (FileStream.tellg() < FileSize)
+	for (uint32_t Offset = 0; FileSize - Offset >= 8;)
 	{
 		uint32_t ChunkId;
 		uint32_t ChunkSize;
 
-		FileStream.read((char*)&ChunkId, sizeof(ChunkId));
-		FileStream.read((char*)&ChunkSize, sizeof(ChunkSize));
+		memcpy(&ChunkId, Data + Offset, sizeof(ChunkId));
+		memcpy(&ChunkSize, Data + Offset + 4, sizeof(ChunkSize));
+		Offset += 8;
 
-		ChunkBase* Chunk = NULL;
-		auto eChunk = (SkeletonChunk::ESkeletonChunk)REVERSE_CC(ChunkId);
-		switch (eChunk)
+		if (ChunkSize > FileSize - Offset)
 		{
-			case ESkeletonChunk::SKL1: Chunk = new SKL1Chunk(); break;
-			case ESkeletonChunk::SKA1: Chunk = new SKA1Chunk(); break;
-			case ESkeletonChunk::SKB1: Chunk = new SKB1Chunk(); break;
-			case ESkeletonChunk::SKS1: Chunk = new SKS1Chunk(); break;
-			case ESkeletonChunk::SKPD: Chunk = new SKPDChunk(); break;
-			case ESkeletonChunk::AFID: Chunk = new AFIDChunk(); break;
-			case ESkeletonChunk::BFID: Chunk = new BFIDChunk(); break;
-			default:
-				Chunk = new RawChunk();
-				break;
+			sLogger.LogWarning(L"Warning: %s skeleton chunk size %u exceeds file size, chunk is truncated", ChunkIdToStr(ChunkId, false).c_str(), ChunkSize);
+			ChunkSize = FileSize - Offset;
 		}
 
-		sLogger.LogInfo(L"Loaded %s skeleton chunk, size %u", ChunkIdToStr(ChunkId, false).c_str(), ChunkSize);
+		sLogger.LogInfo(L"Found %s skeleton chunk, size %u", ChunkIdToStr(ChunkId, false).c_str(), ChunkSize);
 
-		uint32_t savePos = (uint32_t)FileStream.tellg();
-		Chunk->Load(FileStream, ChunkSize);
-		FileStream.seekg(savePos + ChunkSize, std::ios::beg);
-
-		Chunks[eChunk] = Chunk;
+		Chunks.AddView(REVERSE_CC(ChunkId), FileData, Data + Offset, ChunkSize);
+		Offset += ChunkSize;
 	}
 	sLogger.LogInfo(L"Finished loading skeleton chunks");
 
 	return EError_OK;
 }
 
+Skeleton* Skeleton::Clone() const
+{
+	if (shared)
+		return new Skeleton(shared);
+
+	auto Result = new Skeleton();
+	Result->Chunks = Chunks;
+
+	return Result;
+}
+
 EError Skeleton::Save(const wchar_t* FileName)
+{
+	SaveBatch Batch;
+	if (EError Error = Save(FileName, Batch))
+		return Error;
+
+	return Batch.Commit();
+}
+
+EError Skeleton::Save(const wchar_t* FileName, SaveBatch& Batch)
 {
 	// check path
 	if (!FileName)
@@ -77,40 +105,33 @@ EError Skeleton::Save(const wchar_t* FileName)
 		return EError_FailedToSaveM2;
 	}
 
-	// open file stream
-	std::fstream FileStream;
-	FileStream.open(FileName, std::ios::out | std::ios::trunc | std::ios::binary);
-	if (FileStream.fail())
-		return EError_FailedToSaveM2;
-
 	sLogger.LogInfo(L"Saving skeleton to %s", FileName);
 
 	// SKS1 chunk must be loaded before other animation-dependent chunks (checked client)
-	std::list<ESkeletonChunk> ExplicitOrder = { ESkeletonChunk::SKL1, ESkeletonChunk::SKS1 };
-	for (auto chunk : Chunks)
+	std::list<uint32_t> ExplicitOrder = { (uint32_t)ESkeletonChunk::SKL1, (uint32_t)ESkeletonChunk::SKS1 };
+	auto& SourceChunks = GetChunks();
+	for (auto chunkId : SourceChunks.GetIds())
 	{
-		if (std::find(ExplicitOrder.begin(), ExplicitOrder.end(), chunk.first) != ExplicitOrder.end())
+		if (std::find(ExplicitOrder.begin(), ExplicitOrder.end(), chunkId) != ExplicitOrder.end())
 			continue;
 
-		ExplicitOrder.push_back(chunk.first);
+		ExplicitOrder.push_back(chunkId);
 	}
 
+	// chunks that were not accessed are written as loaded
+	auto& Writer = Batch.Add(FileName, EError_FailedToSaveM2);
 	for (auto chunkId : ExplicitOrder)
 	{
-		auto chunk = GetChunk(chunkId);
-		if (!chunk)
+		auto sharedChunk = shared ? SourceChunks.GetParsed(chunkId) : NULL;
+		if (!sharedChunk)
+		{
+			SourceChunks.Write(chunkId, Writer);
 			continue;
+		}
 
-		uint32_t ChunkId = REVERSE_CC((uint32_t)chunkId);
-
-		FileStream.write((char*)&ChunkId, 4);
-		FileStream.seekp(4, std::ios::cur);		// reserve space for chunk size
-		uint32_t savePos = (uint32_t)FileStream.tellp();
-		chunk->Save(FileStream);
-		uint32_t ChunkSize = (uint32_t)FileStream.tellp() - savePos;
-		FileStream.seekp(savePos - 4, std::ios::beg);
-		FileStream.write((char*)&ChunkSize, 4);
-		FileStream.seekp(0, std::ios::end);
+		// saving updates offsets in chunk header, shared chunk is saved through temporary copy
+		std::unique_ptr<ChunkBase> Copy(sharedChunk->Clone());
+		Writer.AppendChunk(REVERSE_CC(chunkId), Copy.get());
 	}
 
 	return EError::EError_OK;
@@ -118,9 +139,26 @@ EError Skeleton::Save(const wchar_t* FileName)
 
 ChunkBase* Skeleton::GetChunk(ESkeletonChunk ChunkId)
 {
-	auto chunkItr = Chunks.find(ChunkId);
-	if (chunkItr == Chunks.end())
-		return NULL;
+	// shared chunks are copied before caller can modify them
+	if (shared)
+	{
+		Chunks = shared->Chunks;
+		shared.reset();
+	}
+
+	return Chunks.Get((uint32_t)ChunkId);
+}
+
+ChunkBase const* Skeleton::FindChunk(ESkeletonChunk ChunkId) const
+{
+	return GetChunks().GetParsed((uint32_t)ChunkId);
+}
+
+uint64_t Skeleton::GetMemoryUsage() const
+{
+	uint64_t Size = sizeof(*this);
+	for (auto chunkId : Chunks.GetIds())
+		Size += Chunks.GetMemoryUsage(chunkId);
 
-	return chunkItr->second;
+	return Size;
 }
@@ -6,9 +6,12 @@
 #include "SkeletonChunk.h"
 #include <vector>
 #include <map>
+#include <memory>
 
 namespace M2Lib
 {
+	class SaveBatch;
+
 	//using namespace M2SkinElement;
 
 	class Skeleton
@@ -24,18 +27,39 @@ namespace M2Lib
 		{
 		}
 
-		~Skeleton()
+		// creates skeleton that reads chunks of fully parsed Source until first modifying access copies them.
+		// Source must not be modified while it is shared.
+		explicit Skeleton(std::shared_ptr<Skeleton const> Source) : shared(std::move(Source))
 		{
-			for (auto chunk : Chunks)
-				delete chunk.second;
 		}
 
-		EError Load(const wchar_t* FileName);
+		// loads skeleton from file. if FileData is set, file contents are taken from it instead of reading file.
+		// chunks reference file contents and are parsed on first access.
+		EError Load(const wchar_t* FileName, std::shared_ptr<std::vector<uint8_t> const> FileData = nullptr);
 		EError Save(const wchar_t* FileName);
+		// assembles skeleton file and adds it to batch, file is written by Batch.Commit().
+		EError Save(const wchar_t* FileName, SaveBatch& Batch);
+
+		// creates deep copy of skeleton, chunk data is shared until modified. copy of shared skeleton shares same source.
+		Skeleton* Clone() const;
 
+		// returns chunk for modification, chunks of shared skeleton are copied first
 		ChunkBase* GetChunk(SkeletonChunk::ESkeletonChunk ChunkId);
+		// returns chunk for reading without copying shared chunks. returns NULL for chunks that were not parsed yet.
+		ChunkBase const* FindChunk(SkeletonChunk::ESkeletonChunk ChunkId) const;
+		bool IsShared() const { return shared != nullptr; }
+		// parses all chunks, so that skeleton can be shared and cloned without being modified
+		void ParseChunks() { Chunks.ParseAll(); }
+
+		// heap memory held by skeleton chunks, chunks of shared source are not counted
+		uint64_t GetMemoryUsage() const;
 
 	private:
-		std::map<SkeletonChunk::ESkeletonChunk, ChunkBase*> Chunks;
+		ChunkList Chunks { SkeletonChunk::GetChunkTable() };
+		std::shared_ptr<Skeleton const> shared;		// source whose chunks are read until skeleton is modified
+
+		ChunkList const& GetChunks() const { return shared ? shared->Chunks : Chunks; }
+
+		EError m_Load(std::shared_ptr<std::vector<uint8_t> const> FileData);
 	};
 }
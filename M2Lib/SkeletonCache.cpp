@@ -0,0 +1,162 @@
+#include "SkeletonCache.h"
+#include "Skeleton.h"
+#include "Logger.h"
+#include "StringHelpers.h"
+
+void M2Lib::SkeletonCache::SetEnabled(bool Enabled)
+{
+	std::lock_guard<std::mutex> guard(Lock);
+
+	this->Enabled = Enabled;
+	if (!Enabled)
+		Entries.clear();
+}
+
+bool M2Lib::SkeletonCache::IsEnabled() const
+{
+	std::lock_guard<std::mutex> guard(Lock);
+
+	return Enabled;
+}
+
+std::shared_ptr<M2Lib::Skeleton const> M2Lib::SkeletonCache::Load(uint32_t FileDataId, std::wstring const& FileName, EError& Error, std::shared_ptr<std::vector<uint8_t> const> FileData, bool* Hit)
+{
+	auto Key = std::make_pair(FileDataId, std::filesystem::path(FileName).lexically_normal().wstring());
+
+	std::error_code ec;
+	auto WriteTime = std::filesystem::last_write_time(FileName, ec);
+
+	if (Hit)
+		*Hit = false;
+
+	bool CacheEnabled;
+	{
+		std::lock_guard<std::mutex> guard(Lock);
+
+		CacheEnabled = Enabled;
+		if (CacheEnabled && !ec)
+		{
+			auto itr = Entries.find(Key);
+			if (itr != Entries.end())
+			{
+				if (itr->second.WriteTime == WriteTime)
+				{
+					++Stats.Hits;
+					Error = EError_OK;
+					if (Hit)
+						*Hit = true;
+					return itr->second.Skeleton;
+				}
+
+				++Stats.Invalidations;
+				Entries.erase(itr);
+			}
+		}
+
+		if (CacheEnabled)
+			++Stats.Misses;
+	}
+
+	// file is loaded without holding lock, concurrent misses of same file may load it twice
+	auto Result = std::make_shared<Skeleton>();
+	Error = Result->Load(FileName.c_str(), FileData);
+	if (Error != EError_OK)
+		return nullptr;
+
+	// cached skeleton is shared between threads, so nothing may be parsed on access later
+	Result->ParseChunks();
+
+	if (CacheEnabled && !ec)
+	{
+		std::lock_guard<std::mutex> guard(Lock);
+
+		if (Enabled)
+		{
+			auto& Entry = Entries[Key];
+			Entry.Skeleton = Result;
+			Entry.WriteTime = WriteTime;
+		}
+	}
+
+	return Result;
+}
+
+bool M2Lib::SkeletonCache::IsCached(uint32_t FileDataId, std::wstring const& FileName) const
+{
+	std::error_code ec;
+	auto WriteTime = std::filesystem::last_write_time(FileName, ec);
+	if (ec)
+		return false;
+
+	std::lock_guard<std::mutex> guard(Lock);
+
+	if (!Enabled)
+		return false;
+
+	auto itr = Entries.find(std::make_pair(FileDataId, std::filesystem::path(FileName).lexically_normal().wstring()));
+
+	return itr != Entries.end() && itr->second.WriteTime == WriteTime;
+}
+
+void M2Lib::SkeletonCache::Clear()
+{
+	std::lock_guard<std::mutex> guard(Lock);
+
+	Entries.clear();
+}
+
+M2Lib::SkeletonCache::Statistics M2Lib::SkeletonCache::GetStatistics() const
+{
+	std::lock_guard<std::mutex> guard(Lock);
+
+	return Stats;
+}
+
+uint64_t M2Lib::SkeletonCache::GetMemoryUsage() const
+{
+	std::lock_guard<std::mutex> guard(Lock);
+
+	uint64_t Size = 0;
+	for (auto& itr : Entries)
+		Size += itr.second.Skeleton->GetMemoryUsage();
+
+	return Size;
+}
+
+void M2Lib::SkeletonCache::PrintStatistics() const
+{
+	auto Stats = GetStatistics();
+	auto Lookups = Stats.Hits + Stats.Misses;
+
+	size_t EntryCount;
+	{
+		std::lock_guard<std::mutex> guard(Lock);
+		EntryCount = Entries.size();
+	}
+
+	sLogger.LogInfo(L"Skeleton cache: %u hits, %u misses (%.1f%% hit rate), %u invalidations", Stats.Hits, Stats.Misses,
+		Lookups ? Stats.Hits * 100.0 / Lookups : 0.0, Stats.Invalidations);
+	sLogger.LogInfo(L"Skeleton cache: %u entries, %llu bytes held", (uint32_t)EntryCount, (unsigned long long)GetMemoryUsage());
+}
+
+void M2Lib::SkeletonCache_SetEnabled(bool Enabled)
+{
+	SkeletonCache::GetInstance()->SetEnabled(Enabled);
+}
+
+void M2Lib::SkeletonCache_Clear()
+{
+	SkeletonCache::GetInstance()->Clear();
+}
+
+void M2Lib::SkeletonCache_PrintStatistics()
+{
+	try
+	{
+		SkeletonCache::GetInstance()->PrintStatistics();
+	}
+	catch (std::exception& e)
+	{
+		sLogger.LogError(L"Exception: %s", StringHelpers::StringToWString(e.what()).c_str());
+	}
+}
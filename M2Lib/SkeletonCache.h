@@ -0,0 +1,75 @@
+#pragma once
+
+#include "BaseTypes.h"
+#include "M2Types.h"
+#include <string>
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <filesystem>
+
+namespace M2Lib
+{
+	class Skeleton;
+
+	// process-wide cache of loaded parent skeletons, many models reference same parent skeleton file.
+	// cached skeletons are fully parsed and never modified, models share them until they modify them.
+	// entry is reloaded when modification time of its file changes.
+	class SkeletonCache
+	{
+	public:
+		struct Statistics
+		{
+			uint32_t Hits = 0;
+			uint32_t Misses = 0;
+			uint32_t Invalidations = 0;		// entries reloaded because file was changed
+		};
+
+	private:
+		SkeletonCache() = default;
+
+		struct Entry
+		{
+			std::shared_ptr<Skeleton const> Skeleton;
+			std::filesystem::file_time_type WriteTime;
+		};
+
+		mutable std::mutex Lock;
+		bool Enabled = true;
+		std::map<std::pair<uint32_t, std::wstring>, Entry> Entries;
+
+		Statistics Stats;
+
+	public:
+		static SkeletonCache* GetInstance()
+		{
+			static SkeletonCache instance;
+
+			return &instance;
+		}
+
+		// disabling cache also removes all entries
+		void SetEnabled(bool Enabled);
+		bool IsEnabled() const;
+
+		// returns skeleton of file, it is loaded and stored on miss. can be called from several threads at once.
+		// FileData is contents of file if caller has already read it, file is read from disk on miss otherwise.
+		// Hit is set if stored skeleton was returned. returned skeleton must not be modified, caller should share it through Skeleton(Source).
+		std::shared_ptr<Skeleton const> Load(uint32_t FileDataId, std::wstring const& FileName, EError& Error, std::shared_ptr<std::vector<uint8_t> const> FileData = nullptr, bool* Hit = nullptr);
+		// returns true if Load would return stored skeleton without reading file
+		bool IsCached(uint32_t FileDataId, std::wstring const& FileName) const;
+
+		// removes all entries, skeletons still referenced by callers stay alive until released
+		void Clear();
+
+		Statistics GetStatistics() const;
+		// heap memory held by cached skeletons
+		uint64_t GetMemoryUsage() const;
+		void PrintStatistics() const;
+	};
+
+	M2LIB_API void __cdecl SkeletonCache_SetEnabled(bool Enabled);
+	M2LIB_API void __cdecl SkeletonCache_Clear();
+	M2LIB_API void __cdecl SkeletonCache_PrintStatistics();
+}
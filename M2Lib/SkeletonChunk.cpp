@@ -3,7 +3,23 @@
 #include <assert.h>
 #include <algorithm>
 
-void M2Lib::SkeletonChunk::SKL1Chunk::Load(std::fstream& FileStream, uint32_t Size)
+M2Lib::ChunkTable const& M2Lib::SkeletonChunk::GetChunkTable()
+{
+	static ChunkTable const Table =
+	{
+		ChunkTable::Register<SKL1Chunk>(ESkeletonChunk::SKL1),
+		ChunkTable::Register<SKA1Chunk>(ESkeletonChunk::SKA1),
+		ChunkTable::Register<SKB1Chunk>(ESkeletonChunk::SKB1),
+		ChunkTable::Register<SKS1Chunk>(ESkeletonChunk::SKS1),
+		ChunkTable::Register<SKPDChunk>(ESkeletonChunk::SKPD),
+		ChunkTable::Register<AFIDChunk>(ESkeletonChunk::AFID),
+		ChunkTable::Register<BFIDChunk>(ESkeletonChunk::BFID),
+	};
+
+	return Table;
+}
+
+void M2Lib::SkeletonChunk::SKL1Chunk::Load(std::istream& FileStream, uint32_t Size)
 {
 	uint32_t pos = (uint32_t)FileStream.tellg();
 	FileStream.read((char*)&Header, sizeof(SKL1Chunk::Header));
@@ -15,7 +31,7 @@ void M2Lib::SkeletonChunk::SKL1Chunk::Load(std::fstream& FileStream, uint32_t Si
 	IntializeElements(Size);
 }
 
-void M2Lib::SkeletonChunk::SKL1Chunk::Save(std::fstream& FileStream)
+void M2Lib::SkeletonChunk::SKL1Chunk::Save(std::ostream& FileStream)
 {
 	FileStream.write(RawData.data(), RawData.size());
 }
@@ -65,7 +81,7 @@ bool M2Lib::SkeletonChunk::SKL1Chunk::IntializeElements(uint32_t DataSize)
 	return true;
 }
 
-void M2Lib::SkeletonChunk::SKA1Chunk::Load(std::fstream& FileStream, uint32_t Size)
+void M2Lib::SkeletonChunk::SKA1Chunk::Load(std::istream& FileStream, uint32_t Size)
 {
 	uint32_t pos = (uint32_t)FileStream.tellg();
 	FileStream.read((char*)&Header, sizeof(SKA1Chunk::Header));
@@ -77,7 +93,7 @@ void M2Lib::SkeletonChunk::SKA1Chunk::Load(std::fstream& FileStream, uint32_t Si
 	IntializeElements(Size);
 }
 
-void M2Lib::SkeletonChunk::SKA1Chunk::Save(std::fstream& FileStream)
+void M2Lib::SkeletonChunk::SKA1Chunk::Save(std::ostream& FileStream)
 {
 	uint32_t CurrentOffset = sizeof(Header);
 	for (uint32_t i = 0; i < EElement_Count; ++i)
@@ -153,7 +169,7 @@ bool M2Lib::SkeletonChunk::SKA1Chunk::IntializeElements(uint32_t DataSize)
 	return true;
 }
 
-void M2Lib::SkeletonChunk::SKB1Chunk::Load(std::fstream& FileStream, uint32_t Size)
+void M2Lib::SkeletonChunk::SKB1Chunk::Load(std::istream& FileStream, uint32_t Size)
 {
 	uint32_t pos = (uint32_t)FileStream.tellg();
 	FileStream.read((char*)&Header, sizeof(SKB1Chunk::Header));
@@ -165,7 +181,7 @@ void M2Lib::SkeletonChunk::SKB1Chunk::Load(std::fstream& FileStream, uint32_t Si
 	IntializeElements(Size);
 }
 
-void M2Lib::SkeletonChunk::SKB1Chunk::Save(std::fstream& FileStream)
+void M2Lib::SkeletonChunk::SKB1Chunk::Save(std::ostream& FileStream)
 {
 	uint32_t CurrentOffset = sizeof(Header);
 	for (uint32_t i = 0; i < EElement_Count; ++i)
@@ -241,7 +257,7 @@ bool M2Lib::SkeletonChunk::SKB1Chunk::IntializeElements(uint32_t DataSize)
 	return true;
 }
 
-void M2Lib::SkeletonChunk::SKS1Chunk::Load(std::fstream& FileStream, uint32_t Size)
+void M2Lib::SkeletonChunk::SKS1Chunk::Load(std::istream& FileStream, uint32_t Size)
 {
 	uint32_t pos = (uint32_t)FileStream.tellg();
 	FileStream.read((char*)&Header, sizeof(SKS1Chunk::Header));
@@ -253,7 +269,7 @@ void M2Lib::SkeletonChunk::SKS1Chunk::Load(std::fstream& FileStream, uint32_t Si
 	IntializeElements(Size);
 }
 
-void M2Lib::SkeletonChunk::SKS1Chunk::Save(std::fstream& FileStream)
+void M2Lib::SkeletonChunk::SKS1Chunk::Save(std::ostream& FileStream)
 {
 	FileStream.write(RawData.data(), RawData.size());
 }
@@ -309,17 +325,17 @@ bool M2Lib::SkeletonChunk::SKS1Chunk::IntializeElements(uint32_t DataSize)
 	return true;
 }
 
-void M2Lib::SkeletonChunk::SKPDChunk::Load(std::fstream & FileStream, uint32_t Size)
+void M2Lib::SkeletonChunk::SKPDChunk::Load(std::istream& FileStream, uint32_t Size)
 {
 	FileStream.read((char*)&Data, sizeof(Data));
 }
 
-void M2Lib::SkeletonChunk::SKPDChunk::Save(std::fstream & FileStream)
+void M2Lib::SkeletonChunk::SKPDChunk::Save(std::ostream & FileStream)
 {
 	FileStream.write((char*)&Data, sizeof(Data));
 }
 
-void M2Lib::SkeletonChunk::AFIDChunk::Load(std::fstream& FileStream, uint32_t Size)
+void M2Lib::SkeletonChunk::AFIDChunk::Load(std::istream& FileStream, uint32_t Size)
 {
 	uint32_t offs = 0;
 	while (offs < Size)
@@ -335,7 +351,7 @@ void M2Lib::SkeletonChunk::AFIDChunk::Load(std::fstream& FileStream, uint32_t Si
 	}
 }
 
-void M2Lib::SkeletonChunk::AFIDChunk::Save(std::fstream& FileStream)
+void M2Lib::SkeletonChunk::AFIDChunk::Save(std::ostream& FileStream)
 {
 	for (auto& info : AnimInfos)
 	{
@@ -345,7 +361,7 @@ void M2Lib::SkeletonChunk::AFIDChunk::Save(std::fstream& FileStream)
 	}
 }
 
-void M2Lib::SkeletonChunk::BFIDChunk::Load(std::fstream& FileStream, uint32_t Size)
+void M2Lib::SkeletonChunk::BFIDChunk::Load(std::istream& FileStream, uint32_t Size)
 {
 	uint32_t offs = 0;
 	while (offs < Size)
@@ -358,7 +374,7 @@ void M2Lib::SkeletonChunk::BFIDChunk::Load(std::fstream& FileStream, uint32_t Si
 	}
 }
 
-void M2Lib::SkeletonChunk::BFIDChunk::Save(std::fstream& FileStream)
+void M2Lib::SkeletonChunk::BFIDChunk::Save(std::ostream& FileStream)
 {
 	for (auto& boneFileDataId : BoneFileDataIds)
 		FileStream.write((char*)&boneFileDataId, 4);
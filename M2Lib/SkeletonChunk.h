@@ -40,8 +40,10 @@ namespace M2Lib
 				EElement_Count
 			};
 
-			void Load(std::fstream& FileStream, uint32_t Size) override;
-			void Save(std::fstream& FileStream) override;
+			void Load(std::istream& FileStream, uint32_t Size) override;
+			void Save(std::ostream& FileStream) override;
+			ChunkBase* Clone() const override { return new SKL1Chunk(*this); }
+			uint64_t GetMemoryUsage() const override { return RawData.capacity() + GetElementsMemoryUsage(Elements, EElement_Count); }
 
 			DataElement Elements[EElement_Count];
 		};
@@ -68,8 +70,10 @@ namespace M2Lib
 				EElement_Count
 			};
 
-			void Load(std::fstream& FileStream, uint32_t Size) override;
-			void Save(std::fstream& FileStream) override;
+			void Load(std::istream& FileStream, uint32_t Size) override;
+			void Save(std::ostream& FileStream) override;
+			ChunkBase* Clone() const override { return new SKA1Chunk(*this); }
+			uint64_t GetMemoryUsage() const override { return RawData.capacity() + GetElementsMemoryUsage(Elements, EElement_Count); }
 
 			DataElement Elements[EElement_Count];
 		};
@@ -96,8 +100,10 @@ namespace M2Lib
 				EElement_Count
 			};
 
-			void Load(std::fstream& FileStream, uint32_t Size) override;
-			void Save(std::fstream& FileStream) override;
+			void Load(std::istream& FileStream, uint32_t Size) override;
+			void Save(std::ostream& FileStream) override;
+			ChunkBase* Clone() const override { return new SKB1Chunk(*this); }
+			uint64_t GetMemoryUsage() const override { return RawData.capacity() + GetElementsMemoryUsage(Elements, EElement_Count); }
 
 			DataElement Elements[EElement_Count];
 		};
@@ -129,8 +135,10 @@ namespace M2Lib
 				EElement_Count
 			};
 
-			void Load(std::fstream& FileStream, uint32_t Size) override;
-			void Save(std::fstream& FileStream) override;
+			void Load(std::istream& FileStream, uint32_t Size) override;
+			void Save(std::ostream& FileStream) override;
+			ChunkBase* Clone() const override { return new SKS1Chunk(*this); }
+			uint64_t GetMemoryUsage() const override { return RawData.capacity() + GetElementsMemoryUsage(Elements, EElement_Count); }
 
 			DataElement Elements[EElement_Count];
 		};
@@ -147,15 +155,18 @@ namespace M2Lib
 
 			ASSERT_SIZE(TData, 16);
 
-			void Load(std::fstream& FileStream, uint32_t Size) override;
-			void Save(std::fstream& FileStream) override;
+			void Load(std::istream& FileStream, uint32_t Size) override;
+			void Save(std::ostream& FileStream) override;
+			ChunkBase* Clone() const override { return new SKPDChunk(*this); }
 		};
 
 		class AFIDChunk : public ChunkBase
 		{
 		public:
-			void Load(std::fstream& FileStream, uint32_t Size) override;
-			void Save(std::fstream& FileStream) override;
+			void Load(std::istream& FileStream, uint32_t Size) override;
+			void Save(std::ostream& FileStream) override;
+			ChunkBase* Clone() const override { return new AFIDChunk(*this); }
+			uint64_t GetMemoryUsage() const override { return AnimInfos.capacity() * sizeof(AnimFileInfo); }
 
 			struct AnimFileInfo
 			{
@@ -170,11 +181,16 @@ namespace M2Lib
 		class BFIDChunk : public ChunkBase
 		{
 		public:
-			void Load(std::fstream& FileStream, uint32_t Size) override;
-			void Save(std::fstream& FileStream) override;
+			void Load(std::istream& FileStream, uint32_t Size) override;
+			void Save(std::ostream& FileStream) override;
+			ChunkBase* Clone() const override { return new BFIDChunk(*this); }
+			uint64_t GetMemoryUsage() const override { return BoneFileDataIds.capacity() * sizeof(uint32_t); }
 
 			std::vector<uint32_t> BoneFileDataIds;
 		};
 #pragma pack(pop)
+
+		// classes of skeleton chunks
+		ChunkTable const& GetChunkTable();
 	}
 }
\ No newline at end of file
@@ -1,6 +1,14 @@
 #include "StringHash.h"
 #include "lookup.h"
 #include <algorithm>
+#include <type_traits>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+# include <emmintrin.h>
+# define M2LIB_STRINGHASH_SSE2 1
+#else
+# define M2LIB_STRINGHASH_SSE2 0
+#endif
 
 uint64_t CalcJenkinsHash(const void* data, size_t nLength)
 {
@@ -12,7 +20,7 @@ uint64_t CalcJenkinsHash(const void* data, size_t nLength)
 }
 
 template <class T>
-uint64_t M2Lib::CalcStringHash(std::basic_string<T> path)
+uint64_t M2Lib::CalcStringHashReference(std::basic_string<T> path)
 {
 	auto pathCopy = NormalizePath(path);
 	std::transform(pathCopy.begin(), pathCopy.end(), pathCopy.begin(), [](auto c) {return ::toupper(c); });
@@ -21,10 +29,102 @@ uint64_t M2Lib::CalcStringHash(std::basic_string<T> path)
 }
 
 template
-uint64_t M2Lib::CalcStringHash(std::basic_string<char> szFileName);
+uint64_t M2Lib::CalcStringHashReference(std::basic_string<char> szFileName);
+
+template
+uint64_t M2Lib::CalcStringHashReference(std::basic_string<wchar_t> szFileName);
+
+namespace
+{
+	// converts ascii characters to upper case and backslashes to slashes.
+	// returns false if there are non-ascii characters, their case folding depends on locale, so they are left to reference implementation.
+	template <class T>
+	bool FoldPathScalar(T const* Source, T* Destination, size_t Length)
+	{
+		for (size_t i = 0; i < Length; ++i)
+		{
+			T c = Source[i];
+			if ((std::make_unsigned_t<T>)c >= 0x80)
+				return false;
+
+			if (c >= 'a' && c <= 'z')
+				c -= 'a' - 'A';
+			else if (c == '\\')
+				c = '/';
+
+			Destination[i] = c;
+		}
+
+		return true;
+	}
+
+#if M2LIB_STRINGHASH_SSE2
+	// same as FoldPathScalar for 16 characters of 8 bits or 8 characters of 16 bits at once
+	template <class T>
+	bool FoldPathSSE2(T const* Source, T* Destination, size_t Length)
+	{
+		size_t const Step = 16 / sizeof(T);
+
+		size_t i = 0;
+		for (; i + Step <= Length; i += Step)
+		{
+			__m128i Value = _mm_loadu_si128((__m128i const*)(Source + i));
+			__m128i IsLower, IsBackslash;
+
+			if constexpr (sizeof(T) == 1)
+			{
+				if (_mm_movemask_epi8(Value))
+					return false;
+
+				IsLower = _mm_and_si128(_mm_cmpgt_epi8(Value, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(Value, _mm_set1_epi8('z' + 1)));
+				IsBackslash = _mm_cmpeq_epi8(Value, _mm_set1_epi8('\\'));
+				Value = _mm_sub_epi8(Value, _mm_and_si128(IsLower, _mm_set1_epi8('a' - 'A')));
+				Value = _mm_add_epi8(Value, _mm_and_si128(IsBackslash, _mm_set1_epi8('/' - '\\')));
+			}
+			else
+			{
+				if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(Value, _mm_set1_epi16((short)0xFF80)), _mm_setzero_si128())) != 0xFFFF)
+					return false;
+
+				IsLower = _mm_and_si128(_mm_cmpgt_epi16(Value, _mm_set1_epi16('a' - 1)), _mm_cmplt_epi16(Value, _mm_set1_epi16('z' + 1)));
+				IsBackslash = _mm_cmpeq_epi16(Value, _mm_set1_epi16('\\'));
+				Value = _mm_sub_epi16(Value, _mm_and_si128(IsLower, _mm_set1_epi16('a' - 'A')));
+				Value = _mm_add_epi16(Value, _mm_and_si128(IsBackslash, _mm_set1_epi16('/' - '\\')));
+			}
+
+			_mm_storeu_si128((__m128i*)(Destination + i), Value);
+		}
+
+		return FoldPathScalar(Source + i, Destination + i, Length - i);
+	}
+#endif
+
+	template <class T>
+	bool FoldPath(T const* Source, T* Destination, size_t Length)
+	{
+#if M2LIB_STRINGHASH_SSE2
+		if constexpr (sizeof(T) <= 2)
+			return FoldPathSSE2(Source, Destination, Length);
+#endif
+		return FoldPathScalar(Source, Destination, Length);
+	}
+}
+
+template <class T>
+uint64_t M2Lib::CalcStringHash(T const* Path, size_t Length)
+{
+	T Buffer[MaxStackPathLength];
+	if (Length > MaxStackPathLength || !FoldPath(Path, Buffer, Length))
+		return CalcStringHashReference(std::basic_string<T>(Path, Length));
+
+	return CalcJenkinsHash(Buffer, Length * sizeof(T));
+}
+
+template
+uint64_t M2Lib::CalcStringHash(char const* Path, size_t Length);
 
 template
-uint64_t M2Lib::CalcStringHash(std::basic_string<wchar_t> szFileName);
+uint64_t M2Lib::CalcStringHash(wchar_t const* Path, size_t Length);
 
 template <class T>
 T normalize_char(T value) { return value; }
@@ -4,8 +4,20 @@
 
 namespace M2Lib
 {
+	static const size_t MaxStackPathLength = 1024;
+
+	// hash of path that does not depend on case and kind of separators.
+	// path is normalized on the fly into stack buffer, nothing is allocated for ascii paths up to MaxStackPathLength characters.
+	template <class T>
+	uint64_t CalcStringHash(T const* Path, size_t Length);
+	template <class T>
+	uint64_t CalcStringHash(T const* Path) { return CalcStringHash(Path, std::char_traits<T>::length(Path)); }
+	template <class T>
+	uint64_t CalcStringHash(std::basic_string<T> const& Path) { return CalcStringHash(Path.c_str(), Path.length()); }
+
+	// original implementation that normalizes copies of path, CalcStringHash falls back to it for non-ascii and long paths
 	template <class T>
-	uint64_t CalcStringHash(std::basic_string<T> szFileName);
+	uint64_t CalcStringHashReference(std::basic_string<T> Path);
 
 	template <class T>
 	std::basic_string<T> NormalizePath(std::basic_string<T> const& path);
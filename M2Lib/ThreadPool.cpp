@@ -0,0 +1,95 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace
+{
+	thread_local bool IsPoolWorker = false;
+}
+
+M2Lib::ThreadPool::ThreadPool(uint32_t ThreadCount)
+{
+	ThreadCount = std::max(ThreadCount, 1u);
+
+	for (uint32_t i = 0; i < ThreadCount; ++i)
+		Workers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+M2Lib::ThreadPool::~ThreadPool()
+{
+	// joining here would deadlock under loader lock, workers are expected to be stopped by Shutdown().
+	// at process exit they are already terminated, so only their handles are released.
+	for (auto& worker : Workers)
+		if (worker.joinable())
+			worker.detach();
+}
+
+void M2Lib::ThreadPool::Shutdown()
+{
+	m2lib_assert("Thread pool can't be stopped from its own worker" && !IsPoolWorker);
+
+	{
+		std::unique_lock<std::mutex> lock(TasksLock);
+		Stopping = true;
+	}
+	TasksCondition.notify_all();
+
+	for (auto& worker : Workers)
+		if (worker.joinable())
+			worker.join();
+}
+
+bool M2Lib::ThreadPool::IsWorkerThread()
+{
+	return IsPoolWorker;
+}
+
+void M2Lib::ThreadPool::WorkerLoop()
+{
+	IsPoolWorker = true;
+
+	for (;;)
+	{
+		std::function<void()> Task;
+		{
+			std::unique_lock<std::mutex> lock(TasksLock);
+			TasksCondition.wait(lock, [this] { return Stopping || !Tasks.empty(); });
+			if (Stopping && Tasks.empty())
+				return;
+
+			Task = std::move(Tasks.front());
+			Tasks.pop();
+		}
+
+		Task();
+	}
+}
+
+void M2Lib::ThreadPool::ParallelFor(uint32_t Count, std::function<void(uint32_t)> const& Body)
+{
+	if (Count == 0)
+		return;
+
+	// nested call from worker would wait on tasks queued behind itself, run inline instead
+	if (Count == 1 || IsPoolWorker)
+	{
+		for (uint32_t i = 0; i < Count; ++i)
+			Body(i);
+		return;
+	}
+
+	std::vector<std::future<void>> Futures;
+	Futures.reserve(Count);
+	for (uint32_t i = 0; i < Count; ++i)
+		Futures.push_back(Enqueue([&Body, i]() { Body(i); }));
+
+	// wait for all tasks before rethrowing so that Body is not referenced after return
+	for (auto& future : Futures)
+		future.wait();
+	for (auto& future : Futures)
+		future.get();
+}
+
+void M2Lib::ShutdownThreadPool()
+{
+	ThreadPool::GetInstance()->Shutdown();
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "BaseTypes.h"
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+namespace M2Lib
+{
+	// fixed size pool of worker threads shared by all models in process.
+	// tasks may log: synchronous logger callbacks are then called from worker threads one at a time, batch callbacks are always called from logger thread.
+	// workers must be stopped with Shutdown() before library is unloaded, they can't be joined from static destructor under loader lock.
+	class ThreadPool
+	{
+		ThreadPool(uint32_t ThreadCount);
+
+		std::vector<std::thread> Workers;
+		std::queue<std::function<void()>> Tasks;
+		std::mutex TasksLock;
+		std::condition_variable TasksCondition;
+		bool Stopping = false;
+
+		void WorkerLoop();
+
+	public:
+		static ThreadPool* GetInstance()
+		{
+			static ThreadPool instance(std::thread::hardware_concurrency());
+
+			return &instance;
+		}
+
+		~ThreadPool();
+
+		// finishes queued tasks and joins workers. tasks enqueued afterwards run inline on calling thread.
+		void Shutdown();
+
+		uint32_t GetThreadCount() const { return Workers.size(); }
+
+		// true if called from one of pool workers. such callers must not wait for other pool tasks.
+		static bool IsWorkerThread();
+
+		// queues task for execution, exceptions thrown by task are rethrown from future::get()
+		template <class F>
+		auto Enqueue(F&& Task) -> std::future<decltype(Task())>
+		{
+			typedef decltype(Task()) Result;
+
+			auto PackagedTask = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(Task));
+			auto Future = PackagedTask->get_future();
+			{
+				std::unique_lock<std::mutex> lock(TasksLock);
+				if (Stopping)
+				{
+					lock.unlock();
+					(*PackagedTask)();
+					return Future;
+				}
+
+				Tasks.emplace([PackagedTask]() { (*PackagedTask)(); });
+			}
+			TasksCondition.notify_one();
+
+			return Future;
+		}
+
+		// runs Body(i) for each i in [0, Count) and waits for all of them. first exception is rethrown.
+		void ParallelFor(uint32_t Count, std::function<void(uint32_t)> const& Body);
+	};
+
+	M2LIB_API void __cdecl ShutdownThreadPool();
+}
@@ -1,5 +1,6 @@
 #include "VectorMath.h"
 #include <cmath>
+#include <algorithm>
 
 M2Lib::Geometry::Plane::Plane(C3Vector const& A, C3Vector const& B, C3Vector const& C)
 {
@@ -25,3 +26,115 @@ float M2Lib::Geometry::CalculateAngle(Plane const& A, Plane const& B)
 {
 	return CalculateAngle(A.Normal, B.Normal);
 }
+
+M2Lib::Geometry::Quaternion M2Lib::Geometry::Quaternion::FromPacked(uint16_t const* Values)
+{
+	float Components[4];
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		auto Signed = (int16_t)Values[i];
+		Components[i] = (Signed < 0 ? Signed + 32768 : Signed - 32767) / 32767.0f;
+	}
+
+	return Quaternion(Components[0], Components[1], Components[2], Components[3]).Normalized();
+}
+
+M2Lib::Geometry::Quaternion M2Lib::Geometry::Quaternion::Normalized() const
+{
+	float Length = std::sqrt(Dot(*this));
+	if (Length <= 0.0f)
+		return *this;
+
+	return Quaternion(X / Length, Y / Length, Z / Length, W / Length);
+}
+
+M2Lib::Geometry::Quaternion M2Lib::Geometry::Quaternion::Blend(Quaternion const& A, float WeightA, Quaternion const& B, float WeightB)
+{
+	return Quaternion(A.X * WeightA + B.X * WeightB, A.Y * WeightA + B.Y * WeightB, A.Z * WeightA + B.Z * WeightB, A.W * WeightA + B.W * WeightB);
+}
+
+M2Lib::Geometry::Quaternion M2Lib::Geometry::Quaternion::Nlerp(Quaternion const& A, Quaternion const& B, float Factor)
+{
+	return Blend(A, 1.0f - Factor, B, Factor).Normalized();
+}
+
+M2Lib::Geometry::Quaternion M2Lib::Geometry::Quaternion::Slerp(Quaternion const& A, Quaternion const& B, float Factor)
+{
+	float Cos = A.Dot(B);
+	float Sign = Cos < 0.0f ? -1.0f : 1.0f;
+	Cos *= Sign;
+
+	// sin of small angle is too imprecise to divide by
+	if (Cos > 0.9999f)
+		return Blend(A, 1.0f - Factor, B, Factor * Sign).Normalized();
+
+	float Theta = std::acos(std::min(1.0f, Cos));
+	float Sin = std::sin(Theta);
+
+	return Blend(A, std::sin((1.0f - Factor) * Theta) / Sin, B, Sign * std::sin(Factor * Theta) / Sin).Normalized();
+}
+
+float M2Lib::Geometry::Quaternion::GetAngle(Quaternion const& A, Quaternion const& B)
+{
+	// acos of dot product loses precision for small angles, half-angle form does not
+	float Sign = A.Dot(B) < 0.0f ? -1.0f : 1.0f;
+	auto Difference = Blend(A, 1.0f, B, -Sign);
+	auto Sum = Blend(A, 1.0f, B, Sign);
+
+	return 4.0f * std::atan2(std::sqrt(Difference.Dot(Difference)), std::sqrt(Sum.Dot(Sum)));
+}
+
+M2Lib::Geometry::Matrix M2Lib::Geometry::Matrix::Identity()
+{
+	return Translation(C3Vector(0.0f, 0.0f, 0.0f));
+}
+
+M2Lib::Geometry::Matrix M2Lib::Geometry::Matrix::Translation(C3Vector const& Offset)
+{
+	return Transform(Offset, Quaternion(), C3Vector(1.0f, 1.0f, 1.0f));
+}
+
+M2Lib::Geometry::Matrix M2Lib::Geometry::Matrix::Transform(C3Vector const& Offset, Quaternion const& Rotation, C3Vector const& Scale)
+{
+	auto& q = Rotation;
+	float Rows[3][3] =
+	{
+		{ 1.0f - 2.0f * (q.Y * q.Y + q.Z * q.Z), 2.0f * (q.X * q.Y - q.Z * q.W), 2.0f * (q.X * q.Z + q.Y * q.W) },
+		{ 2.0f * (q.X * q.Y + q.Z * q.W), 1.0f - 2.0f * (q.X * q.X + q.Z * q.Z), 2.0f * (q.Y * q.Z - q.X * q.W) },
+		{ 2.0f * (q.X * q.Z - q.Y * q.W), 2.0f * (q.Y * q.Z + q.X * q.W), 1.0f - 2.0f * (q.X * q.X + q.Y * q.Y) },
+	};
+
+	float Scales[3] = { Scale.X, Scale.Y, Scale.Z };
+	float Offsets[3] = { Offset.X, Offset.Y, Offset.Z };
+
+	Matrix Result;
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		for (uint32_t j = 0; j < 3; ++j)
+			Result.M[i][j] = Rows[i][j] * Scales[j];
+		Result.M[i][3] = Offsets[i];
+	}
+
+	return Result;
+}
+
+M2Lib::Geometry::Matrix M2Lib::Geometry::Matrix::operator * (Matrix const& Other) const
+{
+	Matrix Result;
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		for (uint32_t j = 0; j < 4; ++j)
+			Result.M[i][j] = M[i][0] * Other.M[0][j] + M[i][1] * Other.M[1][j] + M[i][2] * Other.M[2][j];
+		Result.M[i][3] += M[i][3];
+	}
+
+	return Result;
+}
+
+M2Lib::C3Vector M2Lib::Geometry::Matrix::TransformPoint(C3Vector const& Point) const
+{
+	return C3Vector(
+		M[0][0] * Point.X + M[0][1] * Point.Y + M[0][2] * Point.Z + M[0][3],
+		M[1][0] * Point.X + M[1][1] * Point.Y + M[1][2] * Point.Z + M[1][3],
+		M[2][0] * Point.X + M[2][1] * Point.Y + M[2][2] * Point.Z + M[2][3]);
+}
@@ -34,6 +34,49 @@ namespace M2Lib::Geometry
 		Plane(C3Vector const& A, C3Vector const& B, C3Vector const& C);
 	};
 
+	// rotation, bone rotation keys decode to unit quaternions
+	class Quaternion
+	{
+	public:
+		float X = 0.0f;
+		float Y = 0.0f;
+		float Z = 0.0f;
+		float W = 1.0f;
+
+		Quaternion() = default;
+		Quaternion(float X, float Y, float Z, float W) : X(X), Y(Y), Z(Z), W(W) {}
+
+		// decodes SKey_SInt16x4 key, each component is signed value shifted to positive range
+		static Quaternion FromPacked(uint16_t const* Values);
+
+		float Dot(Quaternion const& Other) const { return X * Other.X + Y * Other.Y + Z * Other.Z + W * Other.W; }
+		Quaternion Normalized() const;
+
+		static Quaternion Blend(Quaternion const& A, float WeightA, Quaternion const& B, float WeightB);
+		// normalized linear interpolation, no hemisphere correction
+		static Quaternion Nlerp(Quaternion const& A, Quaternion const& B, float Factor);
+		// spherical interpolation along shortest arc
+		static Quaternion Slerp(Quaternion const& A, Quaternion const& B, float Factor);
+
+		// rotation angle between two unit quaternions
+		static float GetAngle(Quaternion const& A, Quaternion const& B);
+	};
+
+	// affine transform, 3 rows of 4 columns with translation in last column
+	class Matrix
+	{
+	public:
+		float M[3][4];
+
+		static Matrix Identity();
+		static Matrix Translation(C3Vector const& Offset);
+		// translation * rotation * scale
+		static Matrix Transform(C3Vector const& Offset, Quaternion const& Rotation, C3Vector const& Scale);
+
+		Matrix operator * (Matrix const& Other) const;
+		C3Vector TransformPoint(C3Vector const& Point) const;
+	};
+
 	float CalculateAngle(C3Vector const& A, C3Vector const& B);
 
 	float CalculateAngle(Plane const& A, Plane const& B);
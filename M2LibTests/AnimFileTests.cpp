@@ -0,0 +1,106 @@
+#include "Tests.h"
+#include "AnimFile.h"
+#include "GatherWriter.h"
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+using namespace M2Lib;
+
+namespace
+{
+	typedef AnimFile::EAnimChunk EAnimChunk;
+
+	void WriteChunk(std::ofstream& out, EAnimChunk ChunkId, std::vector<uint8_t> const& Data)
+	{
+		uint32_t Header[2] = { REVERSE_CC((uint32_t)ChunkId), (uint32_t)Data.size() };
+		out.write((char const*)Header, sizeof(Header));
+		out.write((char const*)Data.data(), Data.size());
+	}
+
+	bool HasData(AnimFile const& File, EAnimChunk ChunkId, std::vector<uint8_t> const& Expected)
+	{
+		auto Data = File.GetData(ChunkId, 0, Expected.size());
+		return Data && !memcmp(Data, Expected.data(), Expected.size()) && !File.GetData(ChunkId, 0, Expected.size() + 1);
+	}
+}
+
+TEST_CASE(AnimFile_SaveOverMappedSource)
+{
+	auto Directory = Tests::GetTestDirectory();
+	auto FileName = Directory / L"model0060-00.anim";
+
+	std::vector<uint8_t> ModelKeys(16);
+	for (uint32_t i = 0; i < ModelKeys.size(); ++i)
+		ModelKeys[i] = i;
+	std::vector<uint8_t> BoneKeys(8, 0x5A);
+	{
+		std::ofstream out(FileName, std::ios::binary);
+		WriteChunk(out, EAnimChunk::AFM2, ModelKeys);
+		WriteChunk(out, EAnimChunk::AFSB, BoneKeys);
+	}
+
+	AnimFile File;
+	CHECK(File.Load(FileName.wstring().c_str()) == EError_OK);
+	CHECK(File.IsChunked());
+	CHECK(HasData(File, EAnimChunk::AFM2, ModelKeys));
+	CHECK(HasData(File, EAnimChunk::AFSB, BoneKeys));
+	CHECK(!File.GetData(EAnimChunk::AFSA, 0, 0));
+
+	std::unique_ptr<AnimFile> Clone(File.Clone());
+	auto MappedUsage = Clone->GetMemoryUsage();
+
+	auto Keys = File.GetMutableData(EAnimChunk::AFM2, 4, 4);
+	CHECK(Keys && File.IsModified() && !Clone->IsModified());
+	memset(Keys, 0xFF, 4);
+
+	// saving elsewhere keeps mapping
+	{
+		SaveBatch Batch;
+		CHECK(File.Save((Directory / L"copy.anim").wstring().c_str(), Batch) == EError_OK);
+		CHECK(Batch.Commit() == EError_OK);
+	}
+	CHECK(Clone->GetMemoryUsage() == MappedUsage);
+
+	// saving over source copies mapping shared with clone to memory, clone still sees contents it was loaded with
+	{
+		SaveBatch Batch;
+		CHECK(File.Save(FileName.wstring().c_str(), Batch) == EError_OK);
+		CHECK(Batch.Commit() == EError_OK);
+	}
+	CHECK(Clone->GetMemoryUsage() > MappedUsage);
+	CHECK(HasData(*Clone, EAnimChunk::AFM2, ModelKeys));
+	CHECK(HasData(*Clone, EAnimChunk::AFSB, BoneKeys));
+
+	auto SavedKeys = ModelKeys;
+	memset(&SavedKeys[4], 0xFF, 4);
+	for (auto& Saved : { FileName, Directory / L"copy.anim" })
+	{
+		AnimFile Reloaded;
+		CHECK(Reloaded.Load(Saved.wstring().c_str()) == EError_OK);
+		CHECK(Reloaded.IsChunked());
+		CHECK(HasData(Reloaded, EAnimChunk::AFM2, SavedKeys));
+		CHECK(HasData(Reloaded, EAnimChunk::AFSB, BoneKeys));
+	}
+}
+
+TEST_CASE(AnimFile_LoadsFileWithoutChunks)
+{
+	auto FileName = Tests::GetTestDirectory() / L"model0060-00.anim";
+
+	// files before legion are only model keys
+	std::vector<uint8_t> ModelKeys(12, 0x33);
+	{
+		std::ofstream out(FileName, std::ios::binary);
+		out.write((char const*)ModelKeys.data(), ModelKeys.size());
+	}
+
+	AnimFile File;
+	CHECK(File.Load(FileName.wstring().c_str()) == EError_OK);
+	CHECK(!File.IsChunked());
+	CHECK(HasData(File, EAnimChunk::AFM2, ModelKeys));
+	CHECK(!File.GetData(EAnimChunk::AFSB, 0, 0));
+	CHECK(File.GetData(EAnimChunk::AFM2, 8, 4) == File.GetData(EAnimChunk::AFM2, 0, 4) + 8);
+	CHECK(!File.GetData(EAnimChunk::AFM2, 8, 5));
+}
@@ -0,0 +1,363 @@
+#include "Tests.h"
+#include "AnimationSampler.h"
+#include "M2.h"
+#include "Logger.h"
+#include <cmath>
+#include <cstring>
+#include <cwchar>
+#include <vector>
+
+using namespace M2Lib;
+using namespace M2Lib::M2Element;
+using M2Lib::Geometry::Matrix;
+
+namespace
+{
+	uint32_t const BoneElementOffset = 0x100;
+
+	// bones of model with their keys stored after them in bone element, all sequences are in-place
+	struct ModelBuilder
+	{
+		M2 Model;
+		std::vector<CElement_Bone> Bones;
+		std::vector<uint8_t> KeyData;
+
+		ModelBuilder(std::vector<uint32_t> const& AnimationLengths, std::vector<uint32_t> const& GlobalSequences = {})
+		{
+			auto& Animations = Model.Elements[EElement_Animation];
+			Animations.SetDataSize(AnimationLengths.size(), AnimationLengths.size() * sizeof(CElement_Animation), false);
+			for (uint32_t i = 0; i < AnimationLengths.size(); ++i)
+			{
+				auto& Animation = Animations.as<CElement_Animation>()[i];
+				Animation.Length = AnimationLengths[i];
+				Animation.Flags = 0x20;
+			}
+
+			auto& GlobalSequenceElement = Model.Elements[EElement_GlobalSequence];
+			GlobalSequenceElement.SetDataSize(GlobalSequences.size(), GlobalSequences.size() * sizeof(uint32_t), false);
+			if (!GlobalSequences.empty())
+				memcpy(GlobalSequenceElement.as<uint8_t>(), GlobalSequences.data(), GlobalSequences.size() * sizeof(uint32_t));
+		}
+
+		uint32_t AddBone(int16_t ParentBone, C3Vector const& Pivot = C3Vector(0.0f, 0.0f, 0.0f))
+		{
+			CElement_Bone Bone;
+			memset(&Bone, 0, sizeof(Bone));
+			Bone.ParentBone = ParentBone;
+			Bone.Position = Pivot;
+			Bone.AnimationBlock_Position.GlobalSequenceID = -1;
+			Bone.AnimationBlock_Rotation.GlobalSequenceID = -1;
+			Bone.AnimationBlock_Scale.GlobalSequenceID = -1;
+			Bones.push_back(Bone);
+
+			return Bones.size() - 1;
+		}
+
+		// keys are stored relative to key data, they are moved behind bones by Finish()
+		uint32_t Put(void const* Data, uint32_t Size)
+		{
+			uint32_t Offset = KeyData.size();
+			KeyData.resize(Offset + ((Size + 3) & ~3u));
+			memcpy(&KeyData[Offset], Data, Size);
+			return Offset;
+		}
+
+		// one key array per animation, Values holds ValueSize bytes per key
+		void SetTrack(M2Track& Track, EInterpolationType Interpolation, std::vector<std::vector<uint32_t>> const& Times, std::vector<uint8_t const*> const& Values, uint32_t ValueSize, int16_t GlobalSequenceID = -1)
+		{
+			std::vector<M2Array> SubTimes(Times.size());
+			std::vector<M2Array> SubValues(Times.size());
+			for (uint32_t i = 0; i < Times.size(); ++i)
+			{
+				SubTimes[i].Count = SubValues[i].Count = Times[i].size();
+				SubTimes[i].Offset = Put(Times[i].data(), Times[i].size() * sizeof(uint32_t));
+				SubValues[i].Offset = Put(Values[i], Times[i].size() * ValueSize);
+			}
+
+			Track.InterpolationType = Interpolation;
+			Track.GlobalSequenceID = GlobalSequenceID;
+			Track.TimeStamps.Count = Track.Values.Count = Times.size();
+			Track.TimeStamps.Offset = Put(SubTimes.data(), SubTimes.size() * sizeof(M2Array));
+			Track.Values.Offset = Put(SubValues.data(), SubValues.size() * sizeof(M2Array));
+		}
+
+		void Finish()
+		{
+			// offsets into key data become global offsets behind bones
+			uint32_t KeyOffset = BoneElementOffset + Bones.size() * sizeof(CElement_Bone);
+			auto Relocate = [&](M2Track& Track)
+			{
+				if (!Track.TimeStamps.Count)
+					return;
+
+				Track.TimeStamps.Offset += KeyOffset;
+				Track.Values.Offset += KeyOffset;
+				for (uint32_t i = 0; i < Track.TimeStamps.Count; ++i)
+				{
+					auto SubTimes = (M2Array*)&KeyData[Track.TimeStamps.Offset - KeyOffset] + i;
+					auto SubValues = (M2Array*)&KeyData[Track.Values.Offset - KeyOffset] + i;
+					SubTimes->Offset += KeyOffset;
+					SubValues->Offset += KeyOffset;
+				}
+			};
+			for (auto& Bone : Bones)
+			{
+				Relocate(Bone.AnimationBlock_Position);
+				Relocate(Bone.AnimationBlock_Rotation);
+				Relocate(Bone.AnimationBlock_Scale);
+			}
+
+			auto& Element = Model.Elements[EElement_Bone];
+			Element.Offset = BoneElementOffset;
+			Element.SetDataSize(Bones.size(), Bones.size() * sizeof(CElement_Bone) + KeyData.size(), false);
+			memcpy(Element.as<uint8_t>(), Bones.data(), Bones.size() * sizeof(CElement_Bone));
+			if (!KeyData.empty())
+				memcpy(Element.as<uint8_t>() + Bones.size() * sizeof(CElement_Bone), KeyData.data(), KeyData.size());
+		}
+
+		void SetVertices(std::vector<C3Vector> const& Positions, uint8_t Bone)
+		{
+			auto& Element = Model.Elements[EElement_Vertex];
+			Element.SetDataSize(Positions.size(), Positions.size() * sizeof(CVertex), false);
+			for (uint32_t i = 0; i < Positions.size(); ++i)
+			{
+				auto& Vertex = Element.as<CVertex>()[i];
+				memset(&Vertex, 0, sizeof(Vertex));
+				Vertex.Position = Positions[i];
+				Vertex.BoneIndices[0] = Bone;
+				Vertex.BoneWeights[0] = 255;
+			}
+		}
+	};
+
+	// inverse of Quaternion::FromPacked
+	M2Track::SKey_SInt16x4 Pack(float X, float Y, float Z, float W)
+	{
+		M2Track::SKey_SInt16x4 Key;
+		float Components[4] = { X, Y, Z, W };
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			int32_t Scaled = (int32_t)std::lround(Components[i] * 32767.0f);
+			Key.Values[i] = (uint16_t)(int16_t)(Components[i] >= 0.0f ? Scaled - 32768 : Scaled + 32767);
+		}
+
+		return Key;
+	}
+
+	bool IsNear(float A, float B, float Tolerance = 1e-3f)
+	{
+		return std::fabs(A - B) <= Tolerance;
+	}
+
+	bool IsNear(C3Vector const& A, C3Vector const& B, float Tolerance = 1e-3f)
+	{
+		return IsNear(A.X, B.X, Tolerance) && IsNear(A.Y, B.Y, Tolerance) && IsNear(A.Z, B.Z, Tolerance);
+	}
+
+	C3Vector GetTranslation(Matrix const& M)
+	{
+		return C3Vector(M.M[0][3], M.M[1][3], M.M[2][3]);
+	}
+
+	C3Vector Sample(AnimationSampler const& Sampler, uint32_t Bone, uint32_t Animation, uint32_t Time)
+	{
+		std::vector<Matrix> Matrices;
+		Sampler.GetBoneMatrices(Animation, Time, Matrices);
+		return GetTranslation(Matrices[Bone]);
+	}
+
+	uint32_t SplineRotationWarnings = 0;
+
+	void __stdcall CountSplineRotationWarnings(uint8_t LogLevel, wchar_t const* Message)
+	{
+		if (wcsstr(Message, L"rotation tracks use spline interpolation"))
+			++SplineRotationWarnings;
+	}
+}
+
+TEST_CASE(AnimationSampler_InterpolatesLinearAndStepKeys)
+{
+	ModelBuilder Builder({ 100 });
+	C3Vector const Values[2] = { C3Vector(0.0f, 0.0f, 0.0f), C3Vector(10.0f, 20.0f, 30.0f) };
+	auto Linear = Builder.AddBone(-1);
+	Builder.SetTrack(Builder.Bones[Linear].AnimationBlock_Position, EInterpolationType_Linear, { { 20, 60 } }, { (uint8_t const*)Values }, sizeof(C3Vector));
+	auto Step = Builder.AddBone(-1);
+	Builder.SetTrack(Builder.Bones[Step].AnimationBlock_Position, EInterpolationType_None, { { 20, 60 } }, { (uint8_t const*)Values }, sizeof(C3Vector));
+	Builder.Finish();
+
+	AnimationSampler Sampler(Builder.Model);
+	CHECK(Sampler.GetBoneCount() == 2);
+	CHECK(Sampler.IsSampleable(0));
+	CHECK(!Sampler.IsSampleable(1));
+
+	CHECK(IsNear(Sample(Sampler, Linear, 0, 30), C3Vector(2.5f, 5.0f, 7.5f)));
+	CHECK(IsNear(Sample(Sampler, Linear, 0, 50), C3Vector(7.5f, 15.0f, 22.5f)));
+	// values are held before first and after last key
+	CHECK(IsNear(Sample(Sampler, Linear, 0, 0), Values[0]));
+	CHECK(IsNear(Sample(Sampler, Linear, 0, 100), Values[1]));
+
+	CHECK(IsNear(Sample(Sampler, Step, 0, 59), Values[0]));
+	CHECK(IsNear(Sample(Sampler, Step, 0, 60), Values[1]));
+
+	// extra identity matrix for vertices without bones
+	std::vector<Matrix> Matrices;
+	Sampler.GetBoneMatrices(0, 0, Matrices);
+	CHECK(Matrices.size() == 3);
+	CHECK(IsNear(GetTranslation(Matrices[2]), C3Vector(0.0f, 0.0f, 0.0f)));
+}
+
+TEST_CASE(AnimationSampler_InterpolatesSplineKeys)
+{
+	// spline keys are value, in tangent and out tangent
+	C3Vector const Keys[6] =
+	{
+		C3Vector(0.0f, 0.0f, 0.0f), C3Vector(0.0f, 0.0f, 0.0f), C3Vector(4.0f, 2.0f, 0.0f),
+		C3Vector(1.0f, 1.0f, 1.0f), C3Vector(-2.0f, 3.0f, 1.0f), C3Vector(0.0f, 0.0f, 0.0f),
+	};
+
+	ModelBuilder Builder({ 100 });
+	auto Hermite = Builder.AddBone(-1);
+	Builder.SetTrack(Builder.Bones[Hermite].AnimationBlock_Position, EInterpolationType_Hermite, { { 0, 100 } }, { (uint8_t const*)Keys }, 3 * sizeof(C3Vector));
+	auto Bezier = Builder.AddBone(-1);
+	Builder.SetTrack(Builder.Bones[Bezier].AnimationBlock_Position, EInterpolationType_Bezier, { { 0, 100 } }, { (uint8_t const*)Keys }, 3 * sizeof(C3Vector));
+	Builder.Finish();
+
+	AnimationSampler Sampler(Builder.Model);
+
+	auto& A = Keys[0];
+	auto& OutTangent = Keys[2];
+	auto& InTangent = Keys[4];
+	auto& B = Keys[3];
+	for (uint32_t Time : { 25u, 50u, 80u })
+	{
+		float t = Time / 100.0f;
+		float s = 1.0f - t;
+
+		auto ExpectedHermite = A * (2 * t * t * t - 3 * t * t + 1) + B * (-2 * t * t * t + 3 * t * t) + OutTangent * (t * t * t - 2 * t * t + t) + InTangent * (t * t * t - t * t);
+		CHECK(IsNear(Sample(Sampler, Hermite, 0, Time), ExpectedHermite));
+
+		auto ExpectedBezier = A * (s * s * s) + OutTangent * (3 * s * s * t) + InTangent * (3 * s * t * t) + B * (t * t * t);
+		CHECK(IsNear(Sample(Sampler, Bezier, 0, Time), ExpectedBezier));
+	}
+
+	// keys themselves are hit exactly
+	CHECK(IsNear(Sample(Sampler, Hermite, 0, 100), B));
+	CHECK(IsNear(Sample(Sampler, Bezier, 0, 0), A));
+}
+
+TEST_CASE(AnimationSampler_SlerpsRotationKeys)
+{
+	float const HalfAngle = std::sqrt(0.5f);
+	M2Track::SKey_SInt16x4 const Keys[2] = { Pack(0.0f, 0.0f, 0.0f, 1.0f), Pack(0.0f, 0.0f, HalfAngle, HalfAngle) };
+	// spline rotation keys are followed by tangents, they are ignored
+	M2Track::SKey_SInt16x4 const SplineKeys[6] = { Keys[0], Keys[0], Keys[0], Keys[1], Keys[1], Keys[1] };
+
+	ModelBuilder Builder({ 100 });
+	auto Linear = Builder.AddBone(-1);
+	Builder.SetTrack(Builder.Bones[Linear].AnimationBlock_Rotation, EInterpolationType_Linear, { { 0, 100 } }, { (uint8_t const*)Keys }, sizeof(Keys[0]));
+	auto Spline = Builder.AddBone(-1);
+	Builder.SetTrack(Builder.Bones[Spline].AnimationBlock_Rotation, EInterpolationType_Bezier, { { 0, 100 } }, { (uint8_t const*)SplineKeys }, 3 * sizeof(Keys[0]));
+	Builder.Finish();
+
+	SplineRotationWarnings = 0;
+	sLogger.AttachCallback(LOG_WARNING, CountSplineRotationWarnings);
+	AnimationSampler Sampler(Builder.Model);
+	sLogger.DetachCallback(LOG_WARNING, CountSplineRotationWarnings);
+	CHECK(SplineRotationWarnings == 1);
+
+	// rotation by 90 degrees around Z is slerped, point on X axis moves along arc
+	std::vector<Matrix> Matrices;
+	for (uint32_t Time : { 0u, 25u, 50u, 100u })
+	{
+		float Angle = 3.14159265f / 2.0f * Time / 100.0f;
+		auto Expected = C3Vector(std::cos(Angle), std::sin(Angle), 0.0f);
+
+		Sampler.GetBoneMatrices(0, Time, Matrices);
+		CHECK(IsNear(Matrices[Linear].TransformPoint(C3Vector(1.0f, 0.0f, 0.0f)), Expected));
+		CHECK(IsNear(Matrices[Spline].TransformPoint(C3Vector(1.0f, 0.0f, 0.0f)), Expected));
+	}
+}
+
+TEST_CASE(AnimationSampler_WrapsGlobalSequences)
+{
+	C3Vector const Values[2] = { C3Vector(0.0f, 0.0f, 0.0f), C3Vector(10.0f, 0.0f, 0.0f) };
+
+	ModelBuilder Builder({ 1000, 1000 }, { 100 });
+	auto Bone = Builder.AddBone(-1);
+	Builder.SetTrack(Builder.Bones[Bone].AnimationBlock_Position, EInterpolationType_Linear, { { 0, 100 } }, { (uint8_t const*)Values }, sizeof(C3Vector), 0);
+	Builder.Finish();
+
+	AnimationSampler Sampler(Builder.Model);
+
+	// global sequence has single key array shared by all animations
+	CHECK(IsNear(Sample(Sampler, Bone, 0, 25), C3Vector(2.5f, 0.0f, 0.0f)));
+	CHECK(IsNear(Sample(Sampler, Bone, 0, 125), C3Vector(2.5f, 0.0f, 0.0f)));
+	CHECK(IsNear(Sample(Sampler, Bone, 1, 975), C3Vector(7.5f, 0.0f, 0.0f)));
+}
+
+TEST_CASE(AnimationSampler_EvaluatesParentsFirst)
+{
+	C3Vector const ParentValues[1] = { C3Vector(10.0f, 0.0f, 0.0f) };
+	C3Vector const ChildValues[1] = { C3Vector(0.0f, 5.0f, 0.0f) };
+
+	// child is stored before its parent, cycle between last two bones is broken
+	ModelBuilder Builder({ 100 });
+	auto Child = Builder.AddBone(1);
+	auto Parent = Builder.AddBone(-1);
+	auto CycleA = Builder.AddBone(3);
+	auto CycleB = Builder.AddBone(2);
+	Builder.SetTrack(Builder.Bones[Child].AnimationBlock_Position, EInterpolationType_Linear, { { 0 } }, { (uint8_t const*)ChildValues }, sizeof(C3Vector));
+	Builder.SetTrack(Builder.Bones[Parent].AnimationBlock_Position, EInterpolationType_Linear, { { 0 } }, { (uint8_t const*)ParentValues }, sizeof(C3Vector));
+	Builder.SetTrack(Builder.Bones[CycleA].AnimationBlock_Position, EInterpolationType_Linear, { { 0 } }, { (uint8_t const*)ParentValues }, sizeof(C3Vector));
+	Builder.SetTrack(Builder.Bones[CycleB].AnimationBlock_Position, EInterpolationType_Linear, { { 0 } }, { (uint8_t const*)ChildValues }, sizeof(C3Vector));
+	Builder.Finish();
+
+	AnimationSampler Sampler(Builder.Model);
+
+	std::vector<Matrix> Matrices;
+	Sampler.GetBoneMatrices(0, 50, Matrices);
+	CHECK(IsNear(GetTranslation(Matrices[Parent]), C3Vector(10.0f, 0.0f, 0.0f)));
+	CHECK(IsNear(GetTranslation(Matrices[Child]), C3Vector(10.0f, 5.0f, 0.0f)));
+
+	// one of cycle bones becomes root, other one is its child
+	auto A = GetTranslation(Matrices[CycleA]);
+	auto B = GetTranslation(Matrices[CycleB]);
+	CHECK(IsNear(A, C3Vector(10.0f, 5.0f, 0.0f)) != IsNear(B, C3Vector(10.0f, 5.0f, 0.0f)));
+}
+
+TEST_CASE(AnimationSampler_CalculatesBoundingVolumes)
+{
+	C3Vector const Moving[2] = { C3Vector(0.0f, 0.0f, 0.0f), C3Vector(0.0f, 0.0f, 10.0f) };
+	C3Vector const Scales[2] = { C3Vector(1.0f, 1.0f, 1.0f), C3Vector(2.0f, 2.0f, 2.0f) };
+
+	// first sequence lifts unit box, second one scales it around pivot in its corner
+	ModelBuilder Builder({ 100, 50 });
+	auto Bone = Builder.AddBone(-1, C3Vector(-1.0f, -1.0f, -1.0f));
+	C3Vector const Identity[1] = { C3Vector(0.0f, 0.0f, 0.0f) };
+	C3Vector const Unit[1] = { C3Vector(1.0f, 1.0f, 1.0f) };
+	Builder.SetTrack(Builder.Bones[Bone].AnimationBlock_Position, EInterpolationType_Linear, { { 0, 100 }, { 0 } }, { (uint8_t const*)Moving, (uint8_t const*)Identity }, sizeof(C3Vector));
+	Builder.SetTrack(Builder.Bones[Bone].AnimationBlock_Scale, EInterpolationType_Linear, { { 0 }, { 0, 50 } }, { (uint8_t const*)Unit, (uint8_t const*)Scales }, sizeof(C3Vector));
+	Builder.Finish();
+
+	std::vector<C3Vector> Positions;
+	for (uint32_t i = 0; i < 8; ++i)
+		Positions.emplace_back(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f);
+	Builder.SetVertices(Positions, Bone);
+
+	AnimationSampler Sampler(Builder.Model);
+	std::vector<SVolume> Volumes;
+	std::vector<bool> Valid;
+	Sampler.CalculateBoundingVolumes(30, Volumes, Valid);
+
+	CHECK(Volumes.size() == 2 && Valid.size() == 2);
+	CHECK(Valid[0] && Valid[1]);
+
+	// last sample is taken at end of sequence although it is not multiple of interval
+	CHECK(IsNear(Volumes[0].Min, C3Vector(-1.0f, -1.0f, -1.0f)));
+	CHECK(IsNear(Volumes[0].Max, C3Vector(1.0f, 1.0f, 11.0f)));
+	CHECK(IsNear(Volumes[0].Radius, std::sqrt(1.0f + 1.0f + 36.0f)));
+
+	CHECK(IsNear(Volumes[1].Min, C3Vector(-1.0f, -1.0f, -1.0f)));
+	CHECK(IsNear(Volumes[1].Max, C3Vector(3.0f, 3.0f, 3.0f)));
+	CHECK(IsNear(Volumes[1].Radius, std::sqrt(12.0f)));
+}
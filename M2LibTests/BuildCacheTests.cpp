@@ -0,0 +1,172 @@
+#include "Tests.h"
+#include "BuildCache.h"
+#include "ContentHash.h"
+#include "Logger.h"
+#include "M2.h"
+#include "SyntheticCorpus.h"
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+using namespace M2Lib;
+
+namespace
+{
+	void WriteFile(std::filesystem::path const& FileName, std::string const& Text)
+	{
+		std::ofstream out(FileName, std::ios::binary | std::ios::trunc);
+		out << Text;
+	}
+
+	std::string ReadFile(std::filesystem::path const& FileName)
+	{
+		std::ifstream in(FileName, std::ios::binary);
+		return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+
+	uint32_t DeferredImports = 0;
+
+	void __stdcall CountDeferredImports(uint8_t LogLevel, wchar_t const* Message)
+	{
+		if (wcsstr(Message, L"Running import deferred"))
+			++DeferredImports;
+	}
+
+	EError ImportAndSave(std::filesystem::path const& Directory, std::filesystem::path const& OutFileName, bool AccessModel)
+	{
+		M2 Model;
+		if (EError Error = Model.Load((Directory / L"model.m2").wstring().c_str()))
+			return Error;
+		if (EError Error = Model.ImportM2Intermediate((Directory / L"model.m2i").wstring().c_str()))
+			return Error;
+		if (AccessModel && !Model.GetSkin(0))
+			return EError_FAIL;
+
+		return Model.Save(OutFileName.wstring().c_str(), SAVE_ALL);
+	}
+}
+
+TEST_CASE(BuildCache_RestoresStoredFiles)
+{
+	auto Directory = Tests::GetTestDirectory();
+	auto Cache = BuildCache::GetInstance();
+	Cache->SetDirectory((Directory / L"cache").wstring(), 0);
+	auto StatsBefore = Cache->GetStatistics();
+
+	auto Model = (Directory / L"out" / L"model.m2").wstring();
+	auto Skin = (Directory / L"out" / L"model00.skin").wstring();
+	std::filesystem::create_directories(Directory / L"out");
+	WriteFile(Model, "model contents");
+	WriteFile(Skin, "skin contents");
+
+	CHECK(!Cache->Contains(1));
+	Cache->Store(1, Model, { Model, Skin });
+	CHECK(Cache->Contains(1));
+	CHECK(Cache->GetStatistics().BytesStored - StatsBefore.BytesStored == 14 + 13);
+
+	// changed output is replaced, removed one is created again
+	WriteFile(Model, "changed");
+	std::filesystem::remove(Skin);
+	CHECK(Cache->Restore(1, Model));
+	CHECK(ReadFile(Model) == "model contents");
+	CHECK(ReadFile(Skin) == "skin contents");
+	CHECK(!std::filesystem::exists(Model + L".tmp"));
+	CHECK(Cache->GetStatistics().Hits - StatsBefore.Hits == 1);
+	CHECK(Cache->GetStatistics().BytesRestored - StatsBefore.BytesRestored == 14 + 13);
+
+	// entry is bound to output model it was produced for
+	auto OtherModel = (Directory / L"other.m2").wstring();
+	CHECK(!Cache->Restore(1, OtherModel));
+	CHECK(!std::filesystem::exists(OtherModel));
+
+	Cache->Clear();
+	CHECK(!Cache->Contains(1));
+	Cache->SetDirectory(L"", 0);
+}
+
+TEST_CASE(BuildCache_EvictsLeastRecentlyUsed)
+{
+	auto Directory = Tests::GetTestDirectory();
+	auto Cache = BuildCache::GetInstance();
+	Cache->SetDirectory((Directory / L"cache").wstring(), 0);
+
+	auto EvictionsBefore = Cache->GetStatistics().Evictions;
+	auto Model = (Directory / L"model.m2").wstring();
+	WriteFile(Model, std::string(100, 'x'));
+
+	// manifest time orders entries, it is set explicitly as file times may be coarse
+	auto SetAccessTime = [&](uint64_t Key, int Hours)
+	{
+		for (auto& itr : std::filesystem::directory_iterator(Directory / L"cache"))
+		{
+			auto Manifest = itr.path() / L"entry.bin";
+			if (itr.path().filename() == ContentHash::ToString(Key))
+				std::filesystem::last_write_time(Manifest, std::filesystem::file_time_type::clock::now() - std::chrono::hours(Hours));
+		}
+	};
+
+	Cache->Store(1, Model, { Model });
+	SetAccessTime(1, 3);
+
+	// limit fits two entries of same size
+	uint64_t EntrySize = 0;
+	for (auto& itr : std::filesystem::recursive_directory_iterator(Directory / L"cache"))
+		if (itr.is_regular_file())
+			EntrySize += itr.file_size();
+	Cache->SetDirectory((Directory / L"cache").wstring(), EntrySize * 5 / 2);
+
+	Cache->Store(2, Model, { Model });
+	SetAccessTime(2, 2);
+	CHECK(Cache->Restore(1, Model));
+	Cache->Store(3, Model, { Model });
+
+	CHECK(Cache->Contains(1));
+	CHECK(!Cache->Contains(2));
+	CHECK(Cache->Contains(3));
+	CHECK(Cache->GetStatistics().Evictions - EvictionsBefore == 1);
+
+	Cache->SetDirectory(L"", 0);
+}
+
+TEST_CASE(BuildCache_SkipsImportOnHit)
+{
+	auto Directory = Tests::GetTestDirectory();
+	auto Cache = BuildCache::GetInstance();
+	Cache->SetDirectory((Directory / L"cache").wstring(), 0);
+	auto StatsBefore = Cache->GetStatistics();
+
+	SyntheticModelParams Params;
+	Params.SubMeshCount = 4;
+	Params.VerticesPerSubMesh = 256;
+	CHECK(SyntheticCorpus::Generate(Directory.wstring(), L"model", Params) == EError_OK);
+
+	DeferredImports = 0;
+	sLogger.AttachCallback(LOG_INFO, CountDeferredImports);
+
+	// first build imports and stores
+	auto Out = Directory / L"out";
+	CHECK(ImportAndSave(Directory, Out / L"model.m2", false) == EError_OK);
+	CHECK(Cache->GetStatistics().Stores - StatsBefore.Stores == 1);
+	auto BuiltModel = ReadFile(Out / L"model.m2");
+	auto BuiltSkin = ReadFile(Out / L"model00.skin");
+	CHECK(!BuiltModel.empty() && !BuiltSkin.empty());
+
+	// second one is restored without import
+	std::filesystem::remove_all(Out);
+	CHECK(ImportAndSave(Directory, Out / L"model.m2", false) == EError_OK);
+	CHECK(Cache->GetStatistics().Hits - StatsBefore.Hits == 1);
+	CHECK(DeferredImports == 0);
+	CHECK(ReadFile(Out / L"model.m2") == BuiltModel);
+	CHECK(ReadFile(Out / L"model00.skin") == BuiltSkin);
+
+	// accessing model runs deferred import, entry is still restored as model matches it
+	std::filesystem::remove_all(Out);
+	CHECK(ImportAndSave(Directory, Out / L"model.m2", true) == EError_OK);
+	CHECK(DeferredImports == 1);
+	CHECK(ReadFile(Out / L"model.m2") == BuiltModel);
+	CHECK(ReadFile(Out / L"model00.skin") == BuiltSkin);
+
+	sLogger.DetachCallback(LOG_INFO, CountDeferredImports);
+	Cache->SetDirectory(L"", 0);
+}
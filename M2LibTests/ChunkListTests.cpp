@@ -0,0 +1,187 @@
+#include "Tests.h"
+#include "ChunkBase.h"
+#include "GatherWriter.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+using namespace M2Lib;
+
+namespace
+{
+	uint32_t const TestChunkId1 = 'TST1';
+	uint32_t const TestChunkId2 = 'TST2';
+	uint32_t const BrokenChunkId = 'BAD1';
+	uint32_t const UnknownChunkId = 'UNKN';
+
+	class TestChunk : public RawChunk
+	{
+	public:
+		static uint32_t LoadCount;
+
+		void Load(std::istream& FileStream, uint32_t Size) override
+		{
+			++LoadCount;
+			RawChunk::Load(FileStream, Size);
+		}
+
+		ChunkBase* Clone() const override { return new TestChunk(*this); }
+	};
+
+	uint32_t TestChunk::LoadCount = 0;
+
+	class BrokenChunk : public RawChunk
+	{
+	public:
+		void Load(std::istream& FileStream, uint32_t Size) override { throw std::runtime_error("broken chunk"); }
+		ChunkBase* Clone() const override { return new BrokenChunk(*this); }
+	};
+
+	ChunkTable const& GetTestChunkTable()
+	{
+		static ChunkTable const Table =
+		{
+			ChunkTable::Register<TestChunk>(TestChunkId1),
+			ChunkTable::Register<TestChunk>(TestChunkId2),
+			ChunkTable::Register<BrokenChunk>(BrokenChunkId),
+		};
+
+		return Table;
+	}
+
+	std::shared_ptr<std::vector<uint8_t>> MakeSource()
+	{
+		return std::make_shared<std::vector<uint8_t>>(std::vector<uint8_t>({ 1, 2, 3, 4, 5, 6, 7, 8 }));
+	}
+
+	std::vector<uint8_t> GetBytes(ChunkBase const* Chunk)
+	{
+		auto& Data = static_cast<RawChunk const*>(Chunk)->RawData;
+		return std::vector<uint8_t>(Data.data(), Data.data() + Data.size());
+	}
+}
+
+TEST_CASE(ChunkList_ParsesOnFirstAccess)
+{
+	TestChunk::LoadCount = 0;
+
+	auto Source = MakeSource();
+	std::weak_ptr<std::vector<uint8_t>> WeakSource = Source;
+
+	ChunkList List(GetTestChunkTable());
+	List.AddView(TestChunkId1, Source, Source->data(), 4);
+	List.AddView(TestChunkId2, Source, Source->data() + 4, 4);
+	List.AddView(UnknownChunkId, Source, Source->data(), 2);
+	Source.reset();
+
+	CHECK(List.Contains(TestChunkId1) && !List.Contains(BrokenChunkId));
+	CHECK(!List.IsParsed(TestChunkId1));
+	CHECK(!List.GetParsed(TestChunkId1));
+	CHECK(TestChunk::LoadCount == 0);
+
+	auto Chunk = List.Get(TestChunkId1);
+	CHECK(Chunk && List.IsParsed(TestChunkId1));
+	CHECK(TestChunk::LoadCount == 1);
+	CHECK(GetBytes(Chunk) == std::vector<uint8_t>({ 1, 2, 3, 4 }));
+	CHECK(List.Get(TestChunkId1) == Chunk);
+	CHECK(TestChunk::LoadCount == 1);
+
+	// other chunks are still views of file
+	uint8_t const* Data;
+	uint32_t Size;
+	CHECK(!List.GetView(TestChunkId1, Data, Size));
+	CHECK(List.GetView(TestChunkId2, Data, Size) && Size == 4 && Data[0] == 5);
+	CHECK(!List.Get(BrokenChunkId));
+
+	// unknown chunks are kept as raw data, source is released once nothing views it
+	CHECK(GetBytes(List.Get(UnknownChunkId)) == std::vector<uint8_t>({ 1, 2 }));
+	CHECK(!WeakSource.expired());
+	List.ParseAll();
+	CHECK(TestChunk::LoadCount == 2);
+	CHECK(WeakSource.expired());
+}
+
+TEST_CASE(ChunkList_WritesUnparsedChunksAsOriginalBytes)
+{
+	auto Source = MakeSource();
+	ChunkList List(GetTestChunkTable());
+	List.AddView(TestChunkId1, Source, Source->data(), 4);
+	List.AddView(TestChunkId2, Source, Source->data() + 4, 4);
+
+	static_cast<TestChunk*>(List.Get(TestChunkId1))->RawData[0] = 9;
+
+	auto FileName = Tests::GetTestDirectory() / L"chunks.bin";
+	GatherWriter Writer;
+	List.Write(TestChunkId1, Writer);
+	List.Write(TestChunkId2, Writer);
+	List.Write(BrokenChunkId, Writer);
+	CHECK(Writer.Commit(FileName.wstring()));
+
+	// writing doesn't parse chunk, its original bytes are written
+	uint8_t const* Data;
+	uint32_t Size;
+	CHECK(List.GetView(TestChunkId2, Data, Size));
+
+	std::vector<uint8_t> Expected;
+	auto AppendChunk = [&Expected](uint32_t Id, std::vector<uint8_t> const& Bytes)
+	{
+		uint32_t Header[2] = { REVERSE_CC(Id), (uint32_t)Bytes.size() };
+		Expected.insert(Expected.end(), (uint8_t const*)Header, (uint8_t const*)(Header + 2));
+		Expected.insert(Expected.end(), Bytes.begin(), Bytes.end());
+	};
+	AppendChunk(TestChunkId1, { 9, 2, 3, 4 });
+	AppendChunk(TestChunkId2, { 5, 6, 7, 8 });
+
+	std::ifstream in(FileName, std::ios::binary);
+	CHECK(std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()) == Expected);
+}
+
+TEST_CASE(ChunkList_CopySharesViewsAndClonesParsedChunks)
+{
+	auto Source = MakeSource();
+	ChunkList List(GetTestChunkTable());
+	List.AddView(TestChunkId1, Source, Source->data(), 4);
+	List.AddView(TestChunkId2, Source, Source->data() + 4, 4);
+	auto Chunk = static_cast<TestChunk*>(List.Get(TestChunkId1));
+
+	ChunkList Copy(List);
+	CHECK(Copy.IsParsed(TestChunkId1) && !Copy.IsParsed(TestChunkId2));
+
+	auto CopiedChunk = static_cast<TestChunk*>(Copy.Get(TestChunkId1));
+	CHECK(CopiedChunk != Chunk);
+	CopiedChunk->RawData[0] = 9;
+	CHECK(GetBytes(Chunk) == std::vector<uint8_t>({ 1, 2, 3, 4 }));
+
+	uint8_t const* Data;
+	uint8_t const* CopiedData;
+	uint32_t Size;
+	CHECK(List.GetView(TestChunkId2, Data, Size));
+	CHECK(Copy.GetView(TestChunkId2, CopiedData, Size));
+	CHECK(Data == CopiedData);
+}
+
+TEST_CASE(ChunkList_FailedParseKeepsView)
+{
+	auto Source = MakeSource();
+	ChunkList List(GetTestChunkTable());
+	List.AddView(BrokenChunkId, Source, Source->data(), 8);
+
+	bool Thrown = false;
+	try
+	{
+		List.Get(BrokenChunkId);
+	}
+	catch (std::exception&)
+	{
+		Thrown = true;
+	}
+
+	uint8_t const* Data;
+	uint32_t Size;
+	CHECK(Thrown);
+	CHECK(!List.IsParsed(BrokenChunkId));
+	CHECK(List.GetView(BrokenChunkId, Data, Size) && Data == Source->data() && Size == 8);
+}
@@ -0,0 +1,155 @@
+#include "Tests.h"
+#include "FileStorage.h"
+#include <fstream>
+#include <string>
+
+using namespace M2Lib;
+
+namespace
+{
+	void WriteMapping(std::filesystem::path const& FileName, char const* Text, bool Append = false)
+	{
+		std::ofstream out(FileName, std::ios::binary | (Append ? std::ios::app : std::ios::trunc));
+		out << Text;
+	}
+
+	std::filesystem::path MakeDirectory(wchar_t const* Name)
+	{
+		auto Directory = Tests::GetTestDirectory() / Name;
+		std::filesystem::create_directories(Directory);
+		return Directory;
+	}
+}
+
+TEST_CASE(FileStorage_ReloadParsesAppendedLines)
+{
+	auto Directory = MakeDirectory(L"mappings");
+	auto FileName = Directory / L"listfile.csv";
+	WriteMapping(FileName, "1;World\\A.m2\n2;world/b.m2\n");
+
+	FileStorage Storage(Directory.wstring());
+	CHECK(Storage.LoadStorage());
+	CHECK(Storage.GetStorageSize() == 2);
+	CHECK(Storage.GetPathView(1) == "world/a.m2");
+
+	// unterminated line is parsed, but kept for reparse until it is complete
+	WriteMapping(FileName, "3;world/c.m2\n4;world/d", true);
+	CHECK(Storage.ReloadStorage());
+	CHECK(Storage.GetStorageSize() == 4);
+	CHECK(Storage.GetFileDataIdByPath(L"WORLD\\C.M2") == 3);
+	CHECK(Storage.GetPathView(4) == "world/d");
+
+	// completed line replaces entry parsed from its start
+	WriteMapping(FileName, ".m2\n5;world/e.m2\n", true);
+	CHECK(Storage.ReloadStorage());
+	CHECK(Storage.GetStorageSize() == 5);
+	CHECK(Storage.GetPathView(4) == "world/d.m2");
+	CHECK(Storage.GetFileDataIdByPath(L"world/d") == 0);
+
+	// line that was complete without terminator is not parsed twice
+	WriteMapping(FileName, "6;world/f.m2", true);
+	CHECK(Storage.ReloadStorage());
+	WriteMapping(FileName, "\r\n7;world/g.m2\n", true);
+	CHECK(Storage.ReloadStorage());
+	CHECK(Storage.GetStorageSize() == 7);
+	CHECK(Storage.GetPathView(6) == "world/f.m2");
+	CHECK(Storage.GetFileDataIdByPath(L"world/e.m2") == 5);
+
+	// file infos returned before reload stay valid
+	auto Info = Storage.GetFileInfoByFileDataId(2);
+	CHECK(Info && Info->Path == L"world/b.m2");
+	WriteMapping(FileName, "8;world/h.m2\n", true);
+	CHECK(Storage.ReloadStorage());
+	CHECK(Storage.GetFileInfoByFileDataId(2) == Info);
+	CHECK(Storage.GetFileDataIdByPath(L"world/h.m2") == 8);
+}
+
+TEST_CASE(FileStorage_ReloadRewrittenFile)
+{
+	auto Directory = MakeDirectory(L"mappings");
+	auto FileName = Directory / L"listfile.csv";
+	WriteMapping(FileName, "1;world/a.m2\n2;world/b.m2\n");
+
+	FileStorage Storage(Directory.wstring());
+	CHECK(Storage.LoadStorage());
+
+	// same prefix length with other contents makes full reload, old entries must not survive
+	WriteMapping(FileName, "1;world/x.m2\n3;world/c.m2\n7;world/g.m2\n");
+	CHECK(Storage.ReloadStorage());
+	CHECK(Storage.GetStorageSize() == 3);
+	CHECK(Storage.GetPathView(1) == "world/x.m2");
+	CHECK(Storage.GetPathView(2).empty());
+	CHECK(Storage.GetFileDataIdByPath(L"world/a.m2") == 0);
+
+	// truncated file
+	WriteMapping(FileName, "1;world/x.m2\n");
+	CHECK(Storage.ReloadStorage());
+	CHECK(Storage.GetStorageSize() == 1);
+	CHECK(Storage.GetPathView(7).empty());
+
+	// removed file
+	WriteMapping(Directory / L"other.txt", "8;world/h.m2\n");
+	CHECK(Storage.ReloadStorage());
+	CHECK(Storage.GetStorageSize() == 2);
+	std::filesystem::remove(FileName);
+	CHECK(Storage.ReloadStorage());
+	CHECK(Storage.GetStorageSize() == 1);
+	CHECK(Storage.GetPathView(1).empty());
+	CHECK(Storage.GetPathView(8) == "world/h.m2");
+}
+
+TEST_CASE(FileStorage_SkipsInvalidLines)
+{
+	auto Directory = MakeDirectory(L"mappings");
+	WriteMapping(Directory / L"listfile.csv", "abc;world/a.m2\n99999999999;world/b.m2\n12x;world/c.m2\nno separator\n\n  4;world/d.m2 \r\n");
+
+	FileStorage Storage(Directory.wstring());
+	CHECK(Storage.LoadStorage());
+	CHECK(Storage.GetStorageSize() == 1);
+	CHECK(Storage.GetPathView(4) == "world/d.m2");
+}
+
+TEST_CASE(FileStorage_OverlayFallsThroughToBase)
+{
+	auto BaseDirectory = MakeDirectory(L"base");
+	auto OverlayDirectory = MakeDirectory(L"overlay");
+	char const* BaseText = "1;world/a.m2\n2;world/b.m2\n4;world/d.m2\n";
+	WriteMapping(BaseDirectory / L"listfile.csv", BaseText);
+	// copy of base listfile is not parsed again by overlay
+	WriteMapping(OverlayDirectory / L"listfile.csv", BaseText);
+	// overlay gives other path to 2 and path of 1 to new file data id
+	WriteMapping(OverlayDirectory / L"custom.csv", "2;world/c.m2\n3;world/a.m2\n");
+
+	FileStorage Base(BaseDirectory.wstring());
+	FileStorage Overlay(OverlayDirectory.wstring());
+	Overlay.SetBase(&Base);
+	CHECK(Overlay.LoadStorage());
+	CHECK(Base.GetLayerSize() == 3);
+	CHECK(Overlay.GetLayerSize() == 2);
+	CHECK(Overlay.GetMaxFileDataId() == 4);
+
+	CHECK(Overlay.GetPathView(4) == "world/d.m2");
+	CHECK(Overlay.GetFileDataIdByPath(L"world/d.m2") == 4);
+	CHECK(Overlay.GetFileInfoByFileDataId(4) == Base.GetFileInfoByFileDataId(4));
+
+	CHECK(Overlay.GetPathView(2) == "world/c.m2");
+	CHECK(Overlay.GetFileDataIdByPath(L"world/b.m2") == 0);
+	CHECK(Overlay.GetFileInfoByPath(L"world/b.m2") == nullptr);
+
+	CHECK(Overlay.GetFileDataIdByPath(L"world/a.m2") == 3);
+	CHECK(Overlay.GetPathView(1).empty());
+	CHECK(Overlay.GetFileInfoByFileDataId(1) == nullptr);
+
+	// base itself is not affected by overlay
+	CHECK(Base.GetPathView(1) == "world/a.m2");
+	CHECK(Base.GetFileDataIdByPath(L"world/b.m2") == 2);
+
+	// lines appended to shared copy are parsed into overlay only
+	WriteMapping(OverlayDirectory / L"listfile.csv", "5;world/e.m2\n", true);
+	auto StateHash = Overlay.GetStateHash();
+	CHECK(Overlay.ReloadStorage());
+	CHECK(Overlay.GetStateHash() != StateHash);
+	CHECK(Overlay.GetPathView(5) == "world/e.m2");
+	CHECK(Base.GetPathView(5).empty());
+	CHECK(Overlay.GetLayerSize() == 3);
+}
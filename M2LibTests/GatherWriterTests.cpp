@@ -0,0 +1,123 @@
+#include "Tests.h"
+#include "GatherWriter.h"
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace M2Lib;
+
+namespace
+{
+	std::vector<uint8_t> ReadFile(std::filesystem::path const& FileName)
+	{
+		std::ifstream in(FileName, std::ios::binary);
+		return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+
+	// small values, gap and segment large enough to bypass staging buffer
+	std::vector<uint8_t> AppendTestData(GatherWriter& Writer, std::vector<uint8_t> const& Large, uint32_t Value)
+	{
+		Writer.AppendValue(Value);
+		Writer.AppendAt(16, Large.data(), Large.size());
+		Writer.AppendCopy("tail", 4);
+
+		std::vector<uint8_t> Expected((uint8_t const*)&Value, (uint8_t const*)&Value + sizeof(Value));
+		Expected.resize(16, 0);
+		Expected.insert(Expected.end(), Large.begin(), Large.end());
+		Expected.insert(Expected.end(), { 't', 'a', 'i', 'l' });
+		return Expected;
+	}
+}
+
+TEST_CASE(GatherWriter_WritesSegmentsInOrder)
+{
+	auto FileName = (Tests::GetTestDirectory() / L"file.bin").wstring();
+	std::vector<uint8_t> Large(1024 * 1024);
+	for (size_t i = 0; i < Large.size(); ++i)
+		Large[i] = (uint8_t)(i * 7);
+
+	GatherWriter Writer;
+	auto Expected = AppendTestData(Writer, Large, 0x12345678);
+	CHECK(Writer.GetSize() == Expected.size());
+	CHECK(Writer.Commit(FileName));
+	CHECK(!Writer.GetStatistics().Skipped);
+	CHECK(Writer.GetStatistics().Bytes == Expected.size());
+	CHECK(ReadFile(FileName) == Expected);
+	CHECK(!std::filesystem::exists(FileName + L".tmp"));
+}
+
+TEST_CASE(GatherWriter_SkipsUnchangedFile)
+{
+	auto FileName = (Tests::GetTestDirectory() / L"file.bin").wstring();
+	std::vector<uint8_t> Large(256 * 1024, 0xAB);
+
+	GatherWriter First;
+	AppendTestData(First, Large, 1);
+	CHECK(First.Commit(FileName));
+	CHECK(!First.GetStatistics().Skipped);
+
+	// backdated timestamp shows whether file was rewritten
+	auto OldTime = std::filesystem::last_write_time(FileName) - std::chrono::hours(1);
+	std::filesystem::last_write_time(FileName, OldTime);
+
+	GatherWriter Same;
+	auto Expected = AppendTestData(Same, Large, 1);
+	CHECK(Same.Commit(FileName));
+	CHECK(Same.GetStatistics().Skipped);
+	CHECK(Same.GetStatistics().WriteCalls == 0);
+	CHECK(std::filesystem::last_write_time(FileName) == OldTime);
+	CHECK(ReadFile(FileName) == Expected);
+
+	// same size with other contents is written
+	GatherWriter Changed;
+	Expected = AppendTestData(Changed, Large, 2);
+	CHECK(Changed.Commit(FileName));
+	CHECK(!Changed.GetStatistics().Skipped);
+	CHECK(std::filesystem::last_write_time(FileName) != OldTime);
+	CHECK(ReadFile(FileName) == Expected);
+
+	// other size is written
+	GatherWriter Longer;
+	Expected = AppendTestData(Longer, Large, 2);
+	Longer.AppendValue((uint8_t)0);
+	Expected.push_back(0);
+	CHECK(Longer.Commit(FileName));
+	CHECK(!Longer.GetStatistics().Skipped);
+	CHECK(ReadFile(FileName) == Expected);
+}
+
+TEST_CASE(GatherWriter_BatchCommitsAllFiles)
+{
+	auto Directory = Tests::GetTestDirectory();
+	std::vector<uint8_t> Large(128 * 1024, 0x5A);
+	std::vector<std::vector<uint8_t>> Expected;
+
+	{
+		SaveBatch Batch;
+		for (uint32_t i = 0; i < 8; ++i)
+			Expected.push_back(AppendTestData(Batch.Add((Directory / std::to_wstring(i)).wstring(), EError_FailedToSaveM2), Large, i));
+		CHECK(Batch.GetFileCount() == 8);
+		CHECK(Batch.Commit() == EError_OK);
+	}
+
+	for (uint32_t i = 0; i < 8; ++i)
+		CHECK(ReadFile(Directory / std::to_wstring(i)) == Expected[i]);
+
+	// unchanged files are skipped, changed ones are written
+	SaveBatch Batch;
+	std::vector<GatherWriter*> Writers;
+	for (uint32_t i = 0; i < 8; ++i)
+	{
+		auto& Writer = Batch.Add((Directory / std::to_wstring(i)).wstring(), EError_FailedToSaveM2);
+		Expected[i] = AppendTestData(Writer, Large, i % 2 ? i + 100 : i);
+		Writers.push_back(&Writer);
+	}
+	CHECK(Batch.Commit() == EError_OK);
+
+	for (uint32_t i = 0; i < 8; ++i)
+	{
+		CHECK(Writers[i]->GetStatistics().Skipped == (i % 2 == 0));
+		CHECK(ReadFile(Directory / std::to_wstring(i)) == Expected[i]);
+	}
+}
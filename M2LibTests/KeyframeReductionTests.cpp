@@ -0,0 +1,150 @@
+#include "Tests.h"
+#include "KeyframeReduction.h"
+#include "DataElement.h"
+#include <cstring>
+#include <vector>
+
+using namespace M2Lib;
+using namespace M2Lib::M2Element;
+
+namespace
+{
+	// element with sub arrays and keys of tracks, all tracks have one sequence
+	struct TrackBuilder
+	{
+		DataElement Element;
+		std::vector<uint8_t> Bytes = std::vector<uint8_t>(4096);
+		uint32_t Used = 0;
+
+		uint32_t Put(void const* Data, uint32_t Size)
+		{
+			uint32_t Offset = Used;
+			memcpy(&Bytes[Offset], Data, Size);
+			Used += (Size + 3) & ~3u;
+			return Offset;
+		}
+
+		M2Track AddTrack(uint32_t TimeOffset, uint32_t ValueOffset, uint32_t Count, EInterpolationType Interpolation = EInterpolationType_Linear)
+		{
+			M2Array Times;
+			Times.Count = Count;
+			Times.Offset = TimeOffset;
+			M2Array Values;
+			Values.Count = Count;
+			Values.Offset = ValueOffset;
+
+			M2Track Track;
+			memset(&Track, 0, sizeof(Track));
+			Track.InterpolationType = Interpolation;
+			Track.TimeStamps.Count = 1;
+			Track.TimeStamps.Offset = Put(&Times, sizeof(Times));
+			Track.Values.Count = 1;
+			Track.Values.Offset = Put(&Values, sizeof(Values));
+			return Track;
+		}
+
+		void Finish()
+		{
+			Element.Offset = 0;
+			Element.SetDataSize(1, Used, false);
+			memcpy(Element.as<uint8_t>(), Bytes.data(), Used);
+		}
+
+		M2Array const& GetTimes(M2Track const& Track) { return *(M2Array const*)Element.GetLocalPointer(Track.TimeStamps.Offset); }
+		M2Array const& GetValues(M2Track const& Track) { return *(M2Array const*)Element.GetLocalPointer(Track.Values.Offset); }
+
+		template <class T>
+		T const* GetKeys(M2Array const& Array) { return (T const*)Element.GetLocalPointer(Array.Offset); }
+	};
+
+	uint32_t const Times[8] = { 0, 10, 20, 30, 40, 50, 60, 70 };
+	float const LinearValues[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+}
+
+TEST_CASE(KeyframeReduction_KeepsKeysOutOfTolerance)
+{
+	float Values[8] = { 0, 1, 2, 3.5f, 4, 5, 6, 7 };
+
+	TrackBuilder Builder;
+	auto TimeOffset = Builder.Put(Times, sizeof(Times));
+	auto ValueOffset = Builder.Put(Values, sizeof(Values));
+	auto Track = Builder.AddTrack(TimeOffset, ValueOffset, 8);
+	Builder.Finish();
+
+	KeyframeReduction Reduction(0.01f, 0.01f);
+	Reduction.AddTrack(Track, KeyframeReduction::ETrackType_BonePosition, KeyframeReduction::EValueType_Float, 1, 4, &Builder.Element, 1, nullptr);
+	auto Total = Reduction.Reduce().GetTotal();
+
+	uint32_t const ExpectedTimes[5] = { 0, 20, 30, 40, 70 };
+	float const ExpectedValues[5] = { 0, 2, 3.5f, 4, 7 };
+	auto& ReducedTimes = Builder.GetTimes(Track);
+	CHECK(ReducedTimes.Count == 5);
+	CHECK(Builder.GetValues(Track).Count == 5);
+	CHECK(memcmp(Builder.GetKeys<uint32_t>(ReducedTimes), ExpectedTimes, sizeof(ExpectedTimes)) == 0);
+	CHECK(memcmp(Builder.GetKeys<float>(Builder.GetValues(Track)), ExpectedValues, sizeof(ExpectedValues)) == 0);
+
+	// removed keys are zeroed
+	auto TimeData = Builder.GetKeys<uint32_t>(ReducedTimes);
+	for (uint32_t i = 5; i < 8; ++i)
+		CHECK(TimeData[i] == 0);
+
+	CHECK(Total.Tracks == 1);
+	CHECK(Total.KeysBefore == 8);
+	CHECK(Total.KeysAfter == 5);
+	CHECK(Total.UnusedKeyBytes == 3 * 8);
+}
+
+TEST_CASE(KeyframeReduction_NonLinearKeepsChangingKeys)
+{
+	uint8_t Flags[8] = { 1, 1, 1, 0, 0, 0, 0, 1 };
+
+	TrackBuilder Builder;
+	auto TimeOffset = Builder.Put(Times, sizeof(Times));
+	auto FlagOffset = Builder.Put(Flags, sizeof(Flags));
+	auto ValueOffset = Builder.Put(LinearValues, sizeof(LinearValues));
+	auto FlagTrack = Builder.AddTrack(TimeOffset, FlagOffset, 8);
+	auto HermiteTrack = Builder.AddTrack(TimeOffset, ValueOffset, 8, EInterpolationType_Hermite);
+	Builder.Finish();
+
+	// hermite tracks are skipped, their keys carry tangents
+	KeyframeReduction Reduction(0.01f, 0.01f);
+	Reduction.AddTrack(FlagTrack, KeyframeReduction::ETrackType_Attachment, KeyframeReduction::EValueType_Flag, 1, 1, &Builder.Element, 1, nullptr);
+	Reduction.AddTrack(HermiteTrack, KeyframeReduction::ETrackType_BonePosition, KeyframeReduction::EValueType_Float, 1, 4, &Builder.Element, 1, nullptr);
+	Reduction.Reduce();
+
+	uint8_t const ExpectedFlags[5] = { 1, 1, 0, 0, 1 };
+	CHECK(Builder.GetTimes(FlagTrack).Count == 5);
+	CHECK(memcmp(Builder.GetKeys<uint8_t>(Builder.GetValues(FlagTrack)), ExpectedFlags, sizeof(ExpectedFlags)) == 0);
+	CHECK(Builder.GetTimes(HermiteTrack).Count == 8);
+}
+
+TEST_CASE(KeyframeReduction_SkipsOverlappingKeyArrays)
+{
+	TrackBuilder Builder;
+	auto SharedTimes = Builder.Put(Times, sizeof(Times));
+	auto SharedValues = Builder.Put(LinearValues, sizeof(LinearValues));
+	auto OverlapTimes = Builder.Put(Times, sizeof(Times));
+	auto OverlapValues = Builder.Put(LinearValues, sizeof(LinearValues));
+
+	// alias has same layout of same keys and gets same result,
+	// partial track starts inside keys of another one, neither of them can be compacted
+	auto Owner = Builder.AddTrack(SharedTimes, SharedValues, 8);
+	auto Alias = Builder.AddTrack(SharedTimes, SharedValues, 8);
+	auto Overlap = Builder.AddTrack(OverlapTimes, OverlapValues, 8);
+	auto Partial = Builder.AddTrack(OverlapTimes + 8, OverlapValues + 8, 4);
+	Builder.Finish();
+
+	KeyframeReduction Reduction(0.001f, 0.001f);
+	for (auto Track : { &Owner, &Alias, &Overlap, &Partial })
+		Reduction.AddTrack(*Track, KeyframeReduction::ETrackType_BonePosition, KeyframeReduction::EValueType_Float, 1, 4, &Builder.Element, 1, nullptr);
+	auto Total = Reduction.Reduce().GetTotal();
+
+	CHECK(Builder.GetTimes(Owner).Count == 2);
+	CHECK(Builder.GetTimes(Alias).Count == 2);
+	CHECK(Builder.GetTimes(Overlap).Count == 8);
+	CHECK(Builder.GetTimes(Partial).Count == 4);
+	CHECK(memcmp(Builder.GetKeys<uint32_t>(Builder.GetTimes(Overlap)), Times, sizeof(Times)) == 0);
+	CHECK(Total.KeysBefore == 28);
+	CHECK(Total.KeysAfter == 16);
+	CHECK(Total.UnusedKeyBytes == 6 * 8);
+}
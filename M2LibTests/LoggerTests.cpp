@@ -0,0 +1,73 @@
+#include "Tests.h"
+#include "Logger.h"
+#include <atomic>
+#include <chrono>
+#include <cwchar>
+#include <thread>
+
+using namespace M2Lib;
+
+namespace
+{
+	std::atomic<bool> CallbackEntered;
+	std::atomic<bool> CallbackReleased;
+	std::atomic<uint32_t> OldMessages;
+	std::atomic<uint32_t> NewMessages;
+
+	// holds logging thread after it took sink snapshot and before it enqueued message
+	void __stdcall BlockingCallback(uint8_t LogLevel, wchar_t const* Message)
+	{
+		if (wcscmp(Message, L"old"))
+			return;
+
+		CallbackEntered = true;
+		while (!CallbackReleased)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	void __stdcall IgnoreBatch(uint32_t Count, uint8_t const* LogLevels, wchar_t const* const* Messages)
+	{
+	}
+
+	void __stdcall CountBatch(uint32_t Count, uint8_t const* LogLevels, wchar_t const* const* Messages)
+	{
+		for (uint32_t i = 0; i < Count; ++i)
+		{
+			if (!wcscmp(Messages[i], L"new"))
+				++NewMessages;
+			else
+				++OldMessages;
+		}
+	}
+}
+
+TEST_CASE(Logger_DetachDoesNotStrandMessages)
+{
+	CallbackEntered = false;
+	CallbackReleased = false;
+	OldMessages = 0;
+	NewMessages = 0;
+
+	sLogger.AttachCallback(LOG_CUSTOM, BlockingCallback);
+	sLogger.AttachBatchCallback(LOG_CUSTOM, IgnoreBatch);
+
+	std::thread Thread([]() { sLogger.LogCustom(L"old"); });
+	while (!CallbackEntered)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+	// last batch sink is detached while message logged through it is not queued yet
+	sLogger.DetachBatchCallback(IgnoreBatch);
+	CallbackReleased = true;
+	Thread.join();
+	sLogger.DetachCallback(LOG_CUSTOM, BlockingCallback);
+
+	// message queued after worker drained queue would be delivered to next sink
+	sLogger.AttachBatchCallback(LOG_CUSTOM, CountBatch);
+	for (uint32_t i = 0; i < 100; ++i)
+		sLogger.LogCustom(L"new");
+	sLogger.Flush();
+	sLogger.DetachBatchCallback(CountBatch);
+
+	CHECK(NewMessages == 100);
+	CHECK(OldMessages == 0);
+}
@@ -0,0 +1,62 @@
+#include "Tests.h"
+#include "M2.h"
+#include "SyntheticCorpus.h"
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+
+using namespace M2Lib;
+using namespace M2Lib::M2Element;
+
+namespace
+{
+	std::string ReadFile(std::filesystem::path const& FileName)
+	{
+		std::ifstream in(FileName, std::ios::binary);
+		return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+}
+
+TEST_CASE(M2Clone_ImportMatchesReload)
+{
+	auto Directory = Tests::GetTestDirectory();
+
+	SyntheticModelParams Params;
+	Params.SubMeshCount = 4;
+	Params.VerticesPerSubMesh = 64;
+	CHECK(SyntheticCorpus::Generate(Directory.wstring(), L"model", Params) == EError_OK);
+	auto Input = (Directory / L"model.m2").wstring();
+	auto InputM2I = (Directory / L"model.m2i").wstring();
+
+	// import into freshly loaded model is reference
+	{
+		M2 Model;
+		CHECK(Model.Load(Input.c_str()) == EError_OK);
+		CHECK(Model.ImportM2Intermediate(InputM2I.c_str()) == EError_OK);
+		CHECK(Model.Save((Directory / L"reload" / L"model.m2").wstring().c_str(), SAVE_ALL) == EError_OK);
+	}
+
+	M2 Base;
+	CHECK(Base.Load(Input.c_str()) == EError_OK);
+	auto& Vertices = static_cast<DataElement const&>(Base.Elements[EElement_Vertex]);
+	std::string BaseVertices((char const*)Vertices.Data.data(), Vertices.Data.size());
+
+	// every clone of same base model gives same result as reload, base is not modified by imports
+	for (auto Name : { L"clone1", L"clone2" })
+	{
+		std::unique_ptr<M2> Clone(Base.Clone());
+		CHECK(Clone->Elements[EElement_Vertex].Data.IsShared());
+		CHECK(Clone->ImportM2Intermediate(InputM2I.c_str()) == EError_OK);
+		CHECK(Clone->Save((Directory / Name / L"model.m2").wstring().c_str(), SAVE_ALL) == EError_OK);
+
+		for (auto File : { L"model.m2", L"model00.skin" })
+		{
+			auto Expected = ReadFile(Directory / L"reload" / File);
+			CHECK(!Expected.empty());
+			CHECK(ReadFile(Directory / Name / File) == Expected);
+		}
+	}
+
+	CHECK(std::string((char const*)Vertices.Data.data(), Vertices.Data.size()) == BaseVertices);
+}
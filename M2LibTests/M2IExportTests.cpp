@@ -0,0 +1,45 @@
+#include "Tests.h"
+#include "M2.h"
+#include "SyntheticCorpus.h"
+#include "ThreadPool.h"
+#include <fstream>
+#include <iterator>
+#include <string>
+
+using namespace M2Lib;
+
+namespace
+{
+	std::string ReadFile(std::filesystem::path const& FileName)
+	{
+		std::ifstream in(FileName, std::ios::binary);
+		return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+}
+
+TEST_CASE(M2IExport_ParallelMatchesSerial)
+{
+	auto Directory = Tests::GetTestDirectory();
+
+	SyntheticModelParams Params;
+	Params.SubMeshCount = 12;
+	Params.VerticesPerSubMesh = 256;
+	Params.Skinning = SkinningPattern::Scattered;
+	CHECK(SyntheticCorpus::Generate(Directory.wstring(), L"model", Params) == EError_OK);
+
+	M2 Model;
+	CHECK(Model.Load((Directory / L"model.m2").wstring().c_str()) == EError_OK);
+
+	// export from main thread splits sub meshes between workers
+	auto Parallel = Directory / L"parallel.m2i";
+	CHECK(Model.ExportM2Intermediate(Parallel.wstring().c_str()) == EError_OK);
+
+	// from pool worker nested ParallelFor runs inline, so sub meshes are written one after another
+	auto Serial = Directory / L"serial.m2i";
+	auto Error = ThreadPool::GetInstance()->Enqueue([&]() { return Model.ExportM2Intermediate(Serial.wstring().c_str()); }).get();
+	CHECK(Error == EError_OK);
+
+	auto ParallelData = ReadFile(Parallel);
+	CHECK(!ParallelData.empty());
+	CHECK(ParallelData == ReadFile(Serial));
+}
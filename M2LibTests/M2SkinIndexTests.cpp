@@ -0,0 +1,161 @@
+#include "Tests.h"
+#include "M2SkinIndex.h"
+#include "M2SkinElement.h"
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace M2Lib;
+using namespace M2Lib::M2SkinElement;
+
+namespace
+{
+	// sub meshes on coarse grid, so that equal centers and equal distances are common
+	void FillSubMeshes(DataElement* Elements, uint32_t Count, std::mt19937& Random)
+	{
+		auto& Element = Elements[EElement_SubMesh];
+		Element.SetDataSize(Count, Count * sizeof(CElement_SubMesh), false);
+
+		auto SubMeshes = Element.as<CElement_SubMesh>();
+		for (uint32_t i = 0; i < Count; ++i)
+		{
+			memset(&SubMeshes[i], 0, sizeof(CElement_SubMesh));
+			// last ID has few sub meshes, it is scanned linearly
+			SubMeshes[i].ID = i % 50 == 0 ? 7 : Random() % 3;
+			SubMeshes[i].SortCenter = C3Vector((float)(Random() % 16), (float)(Random() % 4), 0.0f);
+			SubMeshes[i].CenterMass = C3Vector(0.0f, (float)(Random() % 4), (float)(Random() % 4));
+		}
+	}
+
+	// linear scan that index replaced
+	int32_t FindClosestSubMeshLinear(DataElement const* Elements, uint16_t ID, C3Vector const& SortCenter, C3Vector const& CenterMass)
+	{
+		auto& Element = Elements[EElement_SubMesh];
+		auto SubMeshes = Element.as<CElement_SubMesh>();
+
+		int32_t ClosestMatch = -1;
+		float DeltaMin = 0.0f;
+		for (uint32_t i = 0; i < Element.Count; ++i)
+		{
+			if (SubMeshes[i].ID != ID)
+				continue;
+
+			float Delta = (SubMeshes[i].SortCenter - SortCenter).Length() + (SubMeshes[i].CenterMass - CenterMass).Length();
+			if (ClosestMatch == -1 || Delta < DeltaMin)
+			{
+				DeltaMin = Delta;
+				ClosestMatch = i;
+			}
+		}
+
+		return ClosestMatch;
+	}
+
+	bool MatchesLinearSearch(M2SkinIndex& Index, DataElement const* Elements, std::mt19937& Random)
+	{
+		auto SubMeshes = Elements[EElement_SubMesh].as<CElement_SubMesh>();
+		for (uint32_t i = 0; i < 2000; ++i)
+		{
+			uint16_t ID = i % 4 == 3 ? 7 : Random() % 4;
+			C3Vector SortCenter((float)(Random() % 20) - 2.0f, (float)(Random() % 4), 0.0f);
+			C3Vector CenterMass(0.0f, (float)(Random() % 4), (float)(Random() % 4));
+
+			// centers of existing sub mesh are exact matches
+			if (i % 5 == 0)
+			{
+				auto& SubMesh = SubMeshes[Random() % Elements[EElement_SubMesh].Count];
+				SortCenter = SubMesh.SortCenter;
+				CenterMass = SubMesh.CenterMass;
+			}
+
+			if (Index.FindClosestSubMesh(Elements, ID, SortCenter, CenterMass) != FindClosestSubMeshLinear(Elements, ID, SortCenter, CenterMass))
+				return false;
+		}
+
+		return true;
+	}
+}
+
+TEST_CASE(M2SkinIndex_ClosestSubMeshMatchesLinearSearch)
+{
+	std::mt19937 Random(1);
+	DataElement Elements[EElement__CountM2Skin__];
+	FillSubMeshes(Elements, 600, Random);
+
+	M2SkinIndex Index;
+	CHECK(MatchesLinearSearch(Index, Elements, Random));
+	// ID 3 has no sub meshes
+	CHECK(Index.FindClosestSubMesh(Elements, 3, C3Vector(), C3Vector()) == -1);
+
+	// replaced element is detected by its generation
+	FillSubMeshes(Elements, 400, Random);
+	CHECK(MatchesLinearSearch(Index, Elements, Random));
+}
+
+TEST_CASE(M2SkinIndex_RemapMatchesRebuild)
+{
+	std::mt19937 Random(2);
+	DataElement Elements[EElement__CountM2Skin__];
+	FillSubMeshes(Elements, 300, Random);
+
+	M2SkinIndex Index;
+	CHECK(MatchesLinearSearch(Index, Elements, Random));
+
+	// sub meshes are shuffled in place, index is remapped instead of rebuilt
+	auto& Element = Elements[EElement_SubMesh];
+	std::vector<uint32_t> Remap(Element.Count);
+	for (uint32_t i = 0; i < Remap.size(); ++i)
+		Remap[i] = i;
+	std::shuffle(Remap.begin(), Remap.end(), Random);
+
+	std::vector<CElement_SubMesh> Old(Element.as<CElement_SubMesh>(), Element.as<CElement_SubMesh>() + Element.Count);
+	for (uint32_t i = 0; i < Remap.size(); ++i)
+		Element.as<CElement_SubMesh>()[Remap[i]] = Old[i];
+	Index.RemapSubMeshes(Elements, Remap);
+
+	CHECK(MatchesLinearSearch(Index, Elements, Random));
+
+	M2SkinIndex Fresh;
+	for (uint16_t ID : { 0, 1, 2, 7 })
+	{
+		auto Remapped = Index.GetSubMeshesById(Elements, ID);
+		auto Rebuilt = Fresh.GetSubMeshesById(Elements, ID);
+		CHECK(std::vector<uint32_t>(Remapped.begin(), Remapped.end()) == std::vector<uint32_t>(Rebuilt.begin(), Rebuilt.end()));
+	}
+}
+
+TEST_CASE(M2SkinIndex_GroupsMaterialsAndFlags)
+{
+	DataElement Elements[EElement__CountM2Skin__];
+	uint16_t const SubMeshOfMaterial[] = { 2, 0, 2, 5, 0 };
+
+	auto& Materials = Elements[EElement_Material];
+	Materials.SetDataSize(5, 5 * sizeof(CElement_Material), false);
+	auto& Flags = Elements[EElement_Flags];
+	Flags.SetDataSize(5, 5 * sizeof(CElement_Flags), false);
+	for (uint32_t i = 0; i < 5; ++i)
+	{
+		Materials.as<CElement_Material>()[i].iSubMesh = SubMeshOfMaterial[i];
+		Flags.as<CElement_Flags>()[i].iSubMesh = SubMeshOfMaterial[4 - i];
+	}
+
+	M2SkinIndex Index;
+	auto Items = [](M2SkinIndex::Range Range) { return std::vector<uint32_t>(Range.begin(), Range.end()); };
+	CHECK(Items(Index.GetSubMeshMaterials(Elements, 0)) == std::vector<uint32_t>({ 1, 4 }));
+	CHECK(Items(Index.GetSubMeshMaterials(Elements, 2)) == std::vector<uint32_t>({ 0, 2 }));
+	CHECK(Items(Index.GetSubMeshMaterials(Elements, 5)) == std::vector<uint32_t>({ 3 }));
+	CHECK(Index.GetSubMeshMaterials(Elements, 1).empty());
+	CHECK(Index.GetSubMeshMaterials(Elements, 9).empty());
+	CHECK(Items(Index.GetSubMeshFlags(Elements, 0)) == std::vector<uint32_t>({ 0, 3 }));
+	CHECK(Items(Index.GetSubMeshFlags(Elements, 5)) == std::vector<uint32_t>({ 1 }));
+
+	// in-place change needs explicit invalidation, resize is detected
+	Materials.as<CElement_Material>()[3].iSubMesh = 1;
+	Index.Invalidate(M2SkinIndex::ETable_Materials);
+	CHECK(Items(Index.GetSubMeshMaterials(Elements, 1)) == std::vector<uint32_t>({ 3 }));
+
+	Materials.SetDataSize(6, 6 * sizeof(CElement_Material), true);
+	Materials.as<CElement_Material>()[5].iSubMesh = 1;
+	CHECK(Items(Index.GetSubMeshMaterials(Elements, 1)) == std::vector<uint32_t>({ 3, 5 }));
+}
@@ -0,0 +1,40 @@
+#include "Tests.h"
+#include "MemoryTracker.h"
+#include <memory>
+
+using namespace M2Lib;
+
+TEST_CASE(MemoryTracker_ResetKeepsCurrentUsage)
+{
+	uint32_t const BlockSize = 1 << 20;
+
+	auto Tracker = MemoryTracker::GetInstance();
+	Tracker->SetEnabled(true);
+
+	auto Kept = std::make_unique<char[]>(BlockSize);
+	int32_t Slot = Tracker->BeginPeak();
+	{
+		auto Released = std::make_unique<char[]>(BlockSize);
+	}
+	int64_t Current = Tracker->GetCurrentBytes();
+	CHECK(Tracker->GetPeakBytes() >= Current + BlockSize);
+
+	// counters are cleared, usage of blocks allocated before reset stays
+	Tracker->Reset();
+	CHECK(Tracker->GetAllocationCount() == 0);
+	CHECK(Tracker->GetAllocatedBytes() == 0);
+	CHECK(Tracker->GetCurrentBytes() == Current);
+	CHECK(Tracker->GetPeakBytes() == Current);
+
+	// running peak doesn't remember block released before reset
+	CHECK(Tracker->EndPeak(Slot) == Current);
+
+	// releasing block allocated before reset doesn't drive usage below zero
+	Kept.reset();
+	CHECK(Tracker->GetCurrentBytes() <= Current - BlockSize);
+	CHECK(Tracker->GetCurrentBytes() >= 0);
+	CHECK(Tracker->GetPeakBytes() == Current);
+
+	Tracker->SetEnabled(false);
+	Tracker->Reset();
+}
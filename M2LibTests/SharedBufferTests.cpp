@@ -0,0 +1,36 @@
+#include "Tests.h"
+#include "SharedBuffer.h"
+#include <vector>
+
+using namespace M2Lib;
+
+TEST_CASE(SharedBuffer_CopiesOnWrite)
+{
+	SharedBuffer Buffer(std::vector<uint8_t>({ 1, 2, 3, 4 }));
+	CHECK(!Buffer.IsShared());
+
+	// copies share storage and generation until non-const access
+	SharedBuffer Copy = Buffer;
+	CHECK(Buffer.IsShared() && Copy.IsShared());
+	CHECK(Copy.GetGeneration() == Buffer.GetGeneration());
+	CHECK(static_cast<SharedBuffer const&>(Copy).data() == static_cast<SharedBuffer const&>(Buffer).data());
+	CHECK(Copy.GetMemoryUsage() == Buffer.GetMemoryUsage());
+
+	Copy[0] = 9;
+	CHECK(!Buffer.IsShared() && !Copy.IsShared());
+	CHECK(Buffer[0] == 1 && Copy[0] == 9);
+	CHECK(Copy.GetGeneration() == Buffer.GetGeneration());
+
+	// resize of shared buffer keeps prefix and gives new generation
+	SharedBuffer Resized = Buffer;
+	Resized.resize(2);
+	CHECK(Resized.size() == 2 && Buffer.size() == 4);
+	CHECK(Resized[1] == 2);
+	CHECK(Resized.GetGeneration() != Buffer.GetGeneration());
+
+	Buffer.MarkReplaced();
+	CHECK(Buffer.GetGeneration() != Copy.GetGeneration());
+
+	SharedBuffer Empty;
+	CHECK(Empty.empty() && !Empty.data() && !Empty.IsShared());
+}
@@ -0,0 +1,89 @@
+#include "Tests.h"
+#include "SkeletonCache.h"
+#include "Skeleton.h"
+#include <chrono>
+#include <fstream>
+
+using namespace M2Lib;
+
+namespace
+{
+	// skeleton with single chunk unknown to library, it is kept as raw data
+	void WriteSkeleton(std::filesystem::path const& FileName, uint32_t Value)
+	{
+		uint32_t const Chunk[3] = { REVERSE_CC('TEST'), sizeof(Value), Value };
+
+		std::ofstream out(FileName, std::ios::binary | std::ios::trunc);
+		out.write((char const*)Chunk, sizeof(Chunk));
+	}
+}
+
+TEST_CASE(SkeletonCache_ReloadsChangedFile)
+{
+	auto Directory = Tests::GetTestDirectory();
+	auto FileName = Directory / L"parent.skel";
+	WriteSkeleton(FileName, 1);
+
+	auto Cache = SkeletonCache::GetInstance();
+	Cache->SetEnabled(true);
+	Cache->Clear();
+	auto Stats = Cache->GetStatistics();
+
+	EError Error;
+	bool Hit = true;
+	auto First = Cache->Load(1, FileName.wstring(), Error, nullptr, &Hit);
+	CHECK(Error == EError_OK && First);
+	CHECK(!Hit);
+	CHECK(Cache->IsCached(1, FileName.wstring()));
+
+	// same file under unnormalized path is stored skeleton, other file data id is different entry
+	auto Second = Cache->Load(1, (Directory / L"." / L"parent.skel").wstring(), Error, nullptr, &Hit);
+	CHECK(Error == EError_OK && Hit);
+	CHECK(Second == First);
+	CHECK(!Cache->IsCached(2, FileName.wstring()));
+
+	// rewritten file is reloaded, skeleton held by caller stays valid
+	WriteSkeleton(FileName, 2);
+	std::filesystem::last_write_time(FileName, std::filesystem::last_write_time(FileName) + std::chrono::hours(1));
+	CHECK(!Cache->IsCached(1, FileName.wstring()));
+
+	auto Third = Cache->Load(1, FileName.wstring(), Error, nullptr, &Hit);
+	CHECK(Error == EError_OK && Third);
+	CHECK(!Hit);
+	CHECK(Third != First);
+	CHECK(First->FindChunk((SkeletonChunk::ESkeletonChunk)'TEST'));
+
+	auto NewStats = Cache->GetStatistics();
+	CHECK(NewStats.Misses - Stats.Misses == 2);
+	CHECK(NewStats.Hits - Stats.Hits == 1);
+	CHECK(NewStats.Invalidations - Stats.Invalidations == 1);
+
+	Cache->Clear();
+	CHECK(!Cache->IsCached(1, FileName.wstring()));
+}
+
+TEST_CASE(SkeletonCache_DisabledCacheStoresNothing)
+{
+	auto FileName = Tests::GetTestDirectory() / L"parent.skel";
+	WriteSkeleton(FileName, 1);
+
+	auto Cache = SkeletonCache::GetInstance();
+	Cache->SetEnabled(true);
+	EError Error;
+	Cache->Load(1, FileName.wstring(), Error);
+	CHECK(Cache->IsCached(1, FileName.wstring()));
+
+	// disabling drops entries, loads return fresh skeletons
+	Cache->SetEnabled(false);
+	CHECK(!Cache->IsCached(1, FileName.wstring()));
+
+	bool Hit = true;
+	auto First = Cache->Load(1, FileName.wstring(), Error, nullptr, &Hit);
+	auto Second = Cache->Load(1, FileName.wstring(), Error, nullptr, &Hit);
+	CHECK(Error == EError_OK && First && Second);
+	CHECK(!Hit);
+	CHECK(First != Second);
+	CHECK(!Cache->IsCached(1, FileName.wstring()));
+
+	Cache->SetEnabled(true);
+}
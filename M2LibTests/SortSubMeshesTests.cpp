@@ -0,0 +1,231 @@
+#include "Tests.h"
+#include "M2.h"
+#include "M2Skin.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <vector>
+
+using namespace M2Lib;
+using namespace M2Lib::M2SkinElement;
+
+namespace
+{
+	// material as seen by its sub mesh, sub meshes are identified by VertexStart that is unique in test skin
+	typedef std::tuple<uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t> MaterialKey;
+
+	std::map<uint16_t, std::vector<MaterialKey>> GetMaterialsBySubMesh(M2Skin& Skin)
+	{
+		auto SubMeshes = Skin.Elements[EElement_SubMesh].as<CElement_SubMesh>();
+		auto Materials = Skin.Elements[EElement_Material].as<CElement_Material>();
+
+		std::map<uint16_t, std::vector<MaterialKey>> Result;
+		for (uint32_t i = 0; i < Skin.Elements[EElement_Material].Count; ++i)
+		{
+			auto& Material = Materials[i];
+			Result[SubMeshes[Material.iSubMesh].VertexStart].emplace_back(SubMeshes[Material.iSubMesh2].VertexStart, Material.shader_id,
+				Material.iRenderFlags, Material.textureComboIndex, Material.layer, Material.Flags);
+		}
+		for (auto& itr : Result)
+			std::sort(itr.second.begin(), itr.second.end());
+
+		return Result;
+	}
+
+	std::map<uint16_t, uint32_t> GetFlagsBySubMesh(M2Skin& Skin)
+	{
+		auto SubMeshes = Skin.Elements[EElement_SubMesh].as<CElement_SubMesh>();
+		auto Flags = Skin.Elements[EElement_Flags].as<CElement_Flags>();
+
+		std::map<uint16_t, uint32_t> Result;
+		for (uint32_t i = 0; i < Skin.Elements[EElement_Flags].Count; ++i)
+			Result[SubMeshes[Flags[i].iSubMesh].VertexStart] = Flags[i].TextureId;
+
+		return Result;
+	}
+}
+
+TEST_CASE(SortSubMeshes_RemapsReferences)
+{
+	M2 Model;
+	auto& TextureFlagsElement = Model.Elements[M2Element::EElement_TextureFlags];
+	TextureFlagsElement.SetDataSize(3, 3 * sizeof(M2Element::CElement_TextureFlag), false);
+	auto TextureFlags = TextureFlagsElement.as<M2Element::CElement_TextureFlag>();
+	TextureFlags[0].Flags = (M2Element::CElement_TextureFlag::EFlags)0;
+	TextureFlags[0].Blend = M2Element::CElement_TextureFlag::EBlend_Opaque;
+	TextureFlags[1].Flags = (M2Element::CElement_TextureFlag::EFlags)0;
+	TextureFlags[1].Blend = M2Element::CElement_TextureFlag::EBlend_Add;
+	TextureFlags[2].Flags = (M2Element::CElement_TextureFlag::EFlags)4;
+	TextureFlags[2].Blend = M2Element::CElement_TextureFlag::EBlend_Opaque;
+
+	M2Skin Skin(&Model);
+
+	uint16_t const SubMeshIds[] = { 5, 0, 5, 1, 0, 3 };
+	uint32_t const SubMeshCount = sizeof(SubMeshIds) / sizeof(SubMeshIds[0]);
+	Skin.Elements[EElement_SubMesh].SetDataSize(SubMeshCount, SubMeshCount * sizeof(CElement_SubMesh), false);
+	auto SubMeshes = Skin.Elements[EElement_SubMesh].as<CElement_SubMesh>();
+	for (uint32_t i = 0; i < SubMeshCount; ++i)
+	{
+		memset(&SubMeshes[i], 0, sizeof(SubMeshes[i]));
+		SubMeshes[i].ID = SubMeshIds[i];
+		SubMeshes[i].VertexStart = i * 10;
+		SubMeshes[i].SortCenter = C3Vector((float)i, 0.0f, 0.0f);
+	}
+
+	// sub mesh, shader, render flags, texture combo, layer, priority plane
+	uint16_t const MaterialData[][6] = {
+		{ 0, 1, 1, 4, 0, 0 },
+		{ 1, 0, 0, 2, 0, 0 },
+		{ 2, 1, 1, 4, 0, 0 },
+		{ 2, 1, 0, 6, 1, 0 },
+		{ 3, 0, 0, 2, 0, 0 },
+		{ 4, 1, 1, 4, 0, 0 },
+		{ 5, 0, 0, 2, 0, 1 },
+		{ 0, 0, 0, 2, 0, 0 },
+	};
+	uint32_t const MaterialCount = sizeof(MaterialData) / sizeof(MaterialData[0]);
+	Skin.Elements[EElement_Material].SetDataSize(MaterialCount, MaterialCount * sizeof(CElement_Material), false);
+	auto Materials = Skin.Elements[EElement_Material].as<CElement_Material>();
+	for (uint32_t i = 0; i < MaterialCount; ++i)
+	{
+		memset(&Materials[i], 0, sizeof(Materials[i]));
+		Materials[i].iSubMesh = Materials[i].iSubMesh2 = MaterialData[i][0];
+		Materials[i].shader_id = MaterialData[i][1];
+		Materials[i].iRenderFlags = MaterialData[i][2];
+		Materials[i].textureComboIndex = MaterialData[i][3];
+		Materials[i].layer = MaterialData[i][4];
+		Materials[i].Flags = MaterialData[i][5] << 8;
+		Materials[i].op_count = 1;
+	}
+
+	Skin.Elements[EElement_Flags].SetDataSize(SubMeshCount, SubMeshCount * sizeof(CElement_Flags), false);
+	auto Flags = Skin.Elements[EElement_Flags].as<CElement_Flags>();
+	for (uint32_t i = 0; i < SubMeshCount; ++i)
+	{
+		memset(&Flags[i], 0, sizeof(Flags[i]));
+		Flags[i].iSubMesh = SubMeshCount - 1 - i;
+		Flags[i].TextureId = (SubMeshCount - 1 - i) * 10;
+	}
+
+	std::vector<SubmeshExtraData> ExtraData(SubMeshCount);
+	for (uint32_t i = 0; i < SubMeshCount; ++i)
+	{
+		ExtraData[i].ID = SubMeshIds[i];
+		ExtraData[i].Boundary.SortCenter = SubMeshes[i].SortCenter;
+		Skin.ExtraDataBySubmeshIndex.push_back(&ExtraData[i]);
+	}
+
+	// lookups before sort build index, so it has to be remapped rather than built from sorted data
+	int32_t SubMeshIndex;
+	for (auto& Data : ExtraData)
+		CHECK(Skin.GetSubMesh(Data, SubMeshIndex));
+	std::vector<CElement_Material*> SubMeshMaterials;
+	std::vector<CElement_Flags*> SubMeshFlags;
+	for (uint32_t i = 0; i < SubMeshCount; ++i)
+	{
+		Skin.GetSubMeshMaterials(i, SubMeshMaterials);
+		Skin.GetSubMeshFlags(i, SubMeshFlags);
+	}
+
+	auto MaterialsBefore = GetMaterialsBySubMesh(Skin);
+	auto FlagsBefore = GetFlagsBySubMesh(Skin);
+	auto ChangesBefore = Skin.CountRenderStateChanges();
+
+	Skin.SortSubMeshes();
+
+	CHECK(Skin.CountRenderStateChanges().Total() < ChangesBefore.Total());
+	CHECK(GetMaterialsBySubMesh(Skin) == MaterialsBefore);
+	CHECK(GetFlagsBySubMesh(Skin) == FlagsBefore);
+
+	SubMeshes = Skin.Elements[EElement_SubMesh].as<CElement_SubMesh>();
+	Materials = Skin.Elements[EElement_Material].as<CElement_Material>();
+	Flags = Skin.Elements[EElement_Flags].as<CElement_Flags>();
+	for (uint32_t i = 0; i < SubMeshCount; ++i)
+	{
+		CHECK(i == 0 || SubMeshes[i - 1].ID <= SubMeshes[i].ID);
+		CHECK(i == 0 || Flags[i - 1].iSubMesh <= Flags[i].iSubMesh);
+		CHECK(Skin.ExtraDataBySubmeshIndex[i]->ID == SubMeshes[i].ID);
+		CHECK(Skin.GetSubMesh(ExtraData[i], SubMeshIndex) && SubMeshes[SubMeshIndex].VertexStart == i * 10);
+	}
+
+	// layer stays right after material it is drawn over
+	for (uint32_t i = 0; i < MaterialCount; ++i)
+		CHECK(Materials[i].layer == 0 || (i > 0 && Materials[i - 1].iSubMesh == Materials[i].iSubMesh && Materials[i - 1].layer < Materials[i].layer));
+
+	// indexed lookups match scan of sorted elements
+	for (uint32_t i = 0; i < SubMeshCount; ++i)
+	{
+		std::vector<CElement_Material*> ExpectedMaterials;
+		for (uint32_t j = 0; j < MaterialCount; ++j)
+			if (Materials[j].iSubMesh == i)
+				ExpectedMaterials.push_back(&Materials[j]);
+		std::vector<CElement_Flags*> ExpectedFlags;
+		for (uint32_t j = 0; j < SubMeshCount; ++j)
+			if (Flags[j].iSubMesh == i)
+				ExpectedFlags.push_back(&Flags[j]);
+
+		SubMeshMaterials.clear();
+		Skin.GetSubMeshMaterials(i, SubMeshMaterials);
+		CHECK(SubMeshMaterials == ExpectedMaterials);
+		SubMeshFlags.clear();
+		Skin.GetSubMeshFlags(i, SubMeshFlags);
+		CHECK(SubMeshFlags == ExpectedFlags);
+	}
+}
+
+TEST_CASE(SortSubMeshes_RemapsCenterSearch)
+{
+	M2 Model;
+	auto& TextureFlagsElement = Model.Elements[M2Element::EElement_TextureFlags];
+	TextureFlagsElement.SetDataSize(2, 2 * sizeof(M2Element::CElement_TextureFlag), false);
+	auto TextureFlags = TextureFlagsElement.as<M2Element::CElement_TextureFlag>();
+	TextureFlags[0].Flags = (M2Element::CElement_TextureFlag::EFlags)0;
+	TextureFlags[0].Blend = M2Element::CElement_TextureFlag::EBlend_Opaque;
+	TextureFlags[1].Flags = (M2Element::CElement_TextureFlag::EFlags)0;
+	TextureFlags[1].Blend = M2Element::CElement_TextureFlag::EBlend_Add;
+
+	// groups by ID are large enough to be searched by center instead of linearly
+	M2Skin Skin(&Model);
+	uint32_t const SubMeshCount = 96;
+	Skin.Elements[EElement_SubMesh].SetDataSize(SubMeshCount, SubMeshCount * sizeof(CElement_SubMesh), false);
+	Skin.Elements[EElement_Material].SetDataSize(SubMeshCount, SubMeshCount * sizeof(CElement_Material), false);
+	auto SubMeshes = Skin.Elements[EElement_SubMesh].as<CElement_SubMesh>();
+	auto Materials = Skin.Elements[EElement_Material].as<CElement_Material>();
+	std::vector<SubmeshExtraData> ExtraData(SubMeshCount);
+	for (uint32_t i = 0; i < SubMeshCount; ++i)
+	{
+		memset(&SubMeshes[i], 0, sizeof(SubMeshes[i]));
+		SubMeshes[i].ID = (uint16_t)(i % 3);
+		SubMeshes[i].VertexStart = (uint16_t)i;
+		SubMeshes[i].SortCenter = C3Vector((float)((i * 37) % SubMeshCount), (float)(i % 5), 0.0f);
+		SubMeshes[i].CenterMass = C3Vector(0.0f, 0.0f, (float)(i % 7));
+
+		memset(&Materials[i], 0, sizeof(Materials[i]));
+		Materials[i].iSubMesh = Materials[i].iSubMesh2 = (uint16_t)i;
+		Materials[i].shader_id = (uint16_t)(i % 4);
+		Materials[i].iRenderFlags = (uint16_t)(i % 2);
+		Materials[i].textureComboIndex = (uint16_t)(i % 6);
+		Materials[i].op_count = 1;
+
+		ExtraData[i].ID = SubMeshes[i].ID;
+		ExtraData[i].Boundary.SortCenter = SubMeshes[i].SortCenter;
+		ExtraData[i].Boundary.CenterMass = SubMeshes[i].CenterMass;
+		Skin.ExtraDataBySubmeshIndex.push_back(&ExtraData[i]);
+	}
+
+	int32_t SubMeshIndex;
+	for (uint32_t i = 0; i < SubMeshCount; ++i)
+		CHECK(Skin.GetSubMesh(ExtraData[i], SubMeshIndex) && SubMeshIndex == (int32_t)i);
+
+	Skin.SortSubMeshes();
+
+	SubMeshes = Skin.Elements[EElement_SubMesh].as<CElement_SubMesh>();
+	bool Moved = false;
+	for (uint32_t i = 0; i < SubMeshCount; ++i)
+	{
+		CHECK(Skin.GetSubMesh(ExtraData[i], SubMeshIndex) && SubMeshes[SubMeshIndex].VertexStart == i);
+		Moved |= SubMeshes[i].VertexStart != i;
+	}
+	CHECK(Moved);
+}
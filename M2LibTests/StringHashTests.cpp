@@ -0,0 +1,92 @@
+#include "Tests.h"
+#include "StringHash.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace M2Lib;
+
+namespace
+{
+	template <class T>
+	std::basic_string<T> Widen(char const* Path)
+	{
+		return std::basic_string<T>(Path, Path + strlen(Path));
+	}
+
+	template <class T>
+	bool MatchesReference(std::basic_string<T> const& Path)
+	{
+		return CalcStringHash(Path) == CalcStringHashReference(Path);
+	}
+
+	// mixed case and both kinds of separators, with lengths around vector widths to cover tails of folding loop
+	std::vector<std::string> GetAsciiPaths()
+	{
+		std::vector<std::string> Paths = {
+			"",
+			"a",
+			"Creature\\Murloc\\Murloc.m2",
+			"creature/murloc/MURLOC.M2",
+			"WORLD/Expansion02\\Doodads//Generic\\AZ_x.skin",
+			"[]^_`{|}~@ZAza09/\\",
+		};
+
+		std::string Pattern = "Ab/cD\\eF";
+		for (size_t Length = 1; Length <= 70; ++Length)
+		{
+			std::string Path;
+			for (size_t i = 0; i < Length; ++i)
+				Path += Pattern[i % Pattern.length()];
+			Paths.push_back(Path);
+		}
+
+		return Paths;
+	}
+}
+
+TEST_CASE(StringHash_AsciiMatchesReference)
+{
+	for (auto& Path : GetAsciiPaths())
+	{
+		CHECK(MatchesReference(Path));
+		CHECK(MatchesReference(Widen<wchar_t>(Path.c_str())));
+	}
+}
+
+TEST_CASE(StringHash_IgnoresCaseAndSeparators)
+{
+	CHECK(CalcStringHash("Creature\\Murloc\\Murloc.m2") == CalcStringHash("creature/murloc/MURLOC.M2"));
+	CHECK(CalcStringHash(L"Creature\\Murloc\\Murloc.m2") == CalcStringHash(L"creature/murloc/MURLOC.M2"));
+	CHECK(CalcStringHash("Creature\\Murloc\\Murloc.m2") != CalcStringHash("Creature\\Murloc\\Murloc2.m2"));
+}
+
+TEST_CASE(StringHash_NonAsciiMatchesReference)
+{
+	std::string Path = "Creature\\\xC4pfel\\Model.m2";
+	CHECK(MatchesReference(Path));
+
+	// non-ascii character at every position relative to vector width
+	for (size_t Position = 0; Position < 40; ++Position)
+	{
+		std::wstring WidePath(40, L'A');
+		WidePath[Position] = L'\x00C4';
+		CHECK(MatchesReference(WidePath));
+		WidePath[Position] = L'\x0416';
+		CHECK(MatchesReference(WidePath));
+	}
+}
+
+TEST_CASE(StringHash_LongPathMatchesReference)
+{
+	for (size_t Length : { MaxStackPathLength - 1, MaxStackPathLength, MaxStackPathLength + 1, MaxStackPathLength * 3 })
+	{
+		std::string Path;
+		while (Path.length() < Length)
+			Path += "Dir\\sub/";
+		Path.resize(Length);
+
+		CHECK(MatchesReference(Path));
+		CHECK(MatchesReference(Widen<wchar_t>(Path.c_str())));
+	}
+}
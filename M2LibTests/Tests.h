@@ -0,0 +1,28 @@
+#pragma once
+
+#include <filesystem>
+
+// minimal test framework, test cases register themselves when their translation unit is linked in.
+// failed check throws, so rest of test case is skipped.
+namespace Tests
+{
+	typedef void (*TestFunction)();
+
+	struct Registrar
+	{
+		Registrar(char const* Name, TestFunction Function);
+	};
+
+	[[noreturn]] void Fail(char const* File, int Line, char const* Expression);
+
+	// empty directory for files of running test case
+	std::filesystem::path GetTestDirectory();
+}
+
+#define TEST_CASE(Name) \
+	static void Name(); \
+	static Tests::Registrar Name##_Registrar(#Name, Name); \
+	static void Name()
+
+#define CHECK(Expression) \
+	do { if (!(Expression)) Tests::Fail(__FILE__, __LINE__, #Expression); } while (false)
@@ -0,0 +1,87 @@
+#include "Tests.h"
+#include "Logger.h"
+#include "ThreadPool.h"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace M2Lib;
+
+// runs all test cases, or only those whose names contain first argument. returns number of failed test cases.
+namespace
+{
+	struct TestCase
+	{
+		char const* Name;
+		Tests::TestFunction Function;
+	};
+
+	std::vector<TestCase>& GetTestCases()
+	{
+		static std::vector<TestCase> TestCases;
+		return TestCases;
+	}
+
+	std::filesystem::path TestDirectory;
+
+	void __stdcall PrintLog(uint8_t LogLevel, wchar_t const* Message)
+	{
+		fwprintf(stderr, L"%s\n", Message);
+	}
+}
+
+Tests::Registrar::Registrar(char const* Name, TestFunction Function)
+{
+	GetTestCases().push_back({ Name, Function });
+}
+
+void Tests::Fail(char const* File, int Line, char const* Expression)
+{
+	throw std::runtime_error(std::string(File) + "(" + std::to_string(Line) + "): CHECK(" + Expression + ") failed");
+}
+
+std::filesystem::path Tests::GetTestDirectory()
+{
+	return TestDirectory;
+}
+
+int main(int argc, char* argv[])
+{
+	// only errors are printed, library logs a lot of info while loading and saving
+	sLogger.AttachCallback(LOG_ERROR, PrintLog);
+
+	int Failed = 0;
+	int Run = 0;
+	for (auto& Test : GetTestCases())
+	{
+		if (argc > 1 && !strstr(Test.Name, argv[1]))
+			continue;
+
+		TestDirectory = std::filesystem::temp_directory_path() / L"M2LibTests" / Test.Name;
+		std::error_code ec;
+		std::filesystem::remove_all(TestDirectory, ec);
+		std::filesystem::create_directories(TestDirectory, ec);
+
+		++Run;
+		try
+		{
+			Test.Function();
+			printf("[  OK  ] %s\n", Test.Name);
+		}
+		catch (std::exception const& e)
+		{
+			printf("[ FAIL ] %s\n    %s\n", Test.Name, e.what());
+			++Failed;
+		}
+
+		std::filesystem::remove_all(TestDirectory, ec);
+	}
+
+	printf("%d of %d tests passed\n", Run - Failed, Run);
+
+	// workers can't be joined by static destructor
+	ThreadPool::GetInstance()->Shutdown();
+	return Failed;
+}
@@ -0,0 +1,719 @@
+#include "Benchmark.h"
+#include "M2.h"
+#include "M2SkinBuilder.h"
+#include "BoneComparator.h"
+#include "FileStorage.h"
+#include "StringHash.h"
+#include "SyntheticCorpus.h"
+#include "MemoryTracker.h"
+#include "Logger.h"
+#include "StringHelpers.h"
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <map>
+
+using namespace M2Lib;
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double ElapsedMs(Clock::time_point Start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - Start).count();
+	}
+
+	uint64_t FileSize(std::wstring const& FileName)
+	{
+		std::error_code ec;
+		auto Size = std::filesystem::file_size(FileName, ec);
+
+		return ec ? 0 : Size;
+	}
+
+	// heap that stays allocated after Build returns
+	int64_t MeasureResidentBytes(std::function<void()> const& Build)
+	{
+		auto Tracker = MemoryTracker::GetInstance();
+		bool WasTracking = Tracker->IsEnabled();
+		Tracker->SetEnabled(true);
+
+		int64_t StartBytes = Tracker->GetCurrentBytes();
+		Build();
+		int64_t Bytes = Tracker->GetCurrentBytes() - StartBytes;
+
+		Tracker->SetEnabled(WasTracking);
+
+		return Bytes;
+	}
+
+	// layout of FileStorage before entries were packed into flat arrays, kept to compare memory and lookup times
+	struct LegacyFileStorage
+	{
+		std::map<uint32_t, FileInfo const*> FileInfosByFileDataId;
+		std::map<uint64_t, FileInfo const*> FileInfosByNameHash;
+
+		void Add(uint32_t FileDataId, std::wstring const& Path)
+		{
+			auto info = new FileInfo(FileDataId, Path.c_str());
+			FileInfosByFileDataId[FileDataId] = info;
+			FileInfosByNameHash[CalcStringHash(info->Path)] = info;
+		}
+
+		FileInfo const* GetFileInfoByFileDataId(uint32_t FileDataId) const
+		{
+			auto itr = FileInfosByFileDataId.find(FileDataId);
+			return itr != FileInfosByFileDataId.end() ? itr->second : nullptr;
+		}
+
+		FileInfo const* GetFileInfoByPath(std::wstring const& Path) const
+		{
+			auto itr = FileInfosByNameHash.find(CalcStringHash(Path));
+			return itr != FileInfosByNameHash.end() ? itr->second : nullptr;
+		}
+
+		~LegacyFileStorage()
+		{
+			for (auto& itr : FileInfosByFileDataId)
+				delete itr.second;
+		}
+	};
+}
+
+double BenchmarkSuite::Result::GetOpsPerSecond() const
+{
+	return TotalMs > 0.0 ? Iterations * OpsPerIteration * 1000.0 / TotalMs : 0.0;
+}
+
+double BenchmarkSuite::Result::GetMBPerSecond() const
+{
+	return TotalMs > 0.0 ? Iterations * BytesPerIteration / (1024.0 * 1024.0) * 1000.0 / TotalMs : 0.0;
+}
+
+BenchmarkSuite::BenchmarkSuite(std::wstring const& Directory) : Directory(Directory)
+{
+}
+
+void BenchmarkSuite::SetIterationLimits(uint32_t MinIterations, double MinTimeMs)
+{
+	this->MinIterations = std::max<uint32_t>(MinIterations, 1);
+	this->MinTimeMs = MinTimeMs;
+}
+
+EError BenchmarkSuite::Measure(char const* Name, std::string const& Model, uint64_t OpsPerIteration, uint64_t BytesPerIteration, Step const& Setup, Step const& Run)
+{
+	Result Result;
+	Result.Name = Name;
+	Result.Model = Model;
+	Result.OpsPerIteration = OpsPerIteration;
+	Result.BytesPerIteration = BytesPerIteration;
+
+	// keep slow kernels on large models from running forever
+	uint32_t const MaxIterations = 100000;
+
+	// setup allocations are counted too, only difference around kernel is used
+	auto Tracker = MemoryTracker::GetInstance();
+	bool WasTracking = Tracker->IsEnabled();
+	Tracker->SetEnabled(true);
+
+	while (Result.Iterations < MaxIterations && (Result.Iterations < MinIterations || Result.TotalMs < MinTimeMs))
+	{
+		if (Setup)
+		{
+			auto Error = Setup();
+			if (Error != EError_OK)
+			{
+				Tracker->SetEnabled(WasTracking);
+				return Error;
+			}
+		}
+
+		uint64_t Allocations = Tracker->GetAllocationCount();
+		uint64_t Bytes = Tracker->GetAllocatedBytes();
+		int64_t StartBytes = Tracker->GetCurrentBytes();
+		int32_t PeakSlot = Tracker->BeginPeak();
+
+		auto Start = Clock::now();
+		auto Error = Run();
+		Result.TotalMs += ElapsedMs(Start);
+
+		Result.PeakBytes = std::max(Result.PeakBytes, Tracker->EndPeak(PeakSlot) - StartBytes);
+		Result.Allocations += Tracker->GetAllocationCount() - Allocations;
+		Result.AllocatedBytes += Tracker->GetAllocatedBytes() - Bytes;
+
+		if (Error != EError_OK)
+		{
+			Tracker->SetEnabled(WasTracking);
+			sLogger.LogError(L"Benchmark '%s' failed on %s: %s", StringHelpers::StringToWString(Name).c_str(), StringHelpers::StringToWString(Model).c_str(), GetErrorText(Error));
+			return Error;
+		}
+
+		++Result.Iterations;
+	}
+
+	Tracker->SetEnabled(WasTracking);
+	Results.push_back(Result);
+
+	return EError_OK;
+}
+
+EError BenchmarkSuite::RunModelKernels(std::string const& ModelName, SyntheticModelParams const& Params)
+{
+	auto CorpusDirectory = (std::filesystem::path(Directory) / L"corpus").wstring();
+	auto OutputDirectory = (std::filesystem::path(Directory) / L"output").wstring();
+	auto Name = StringHelpers::StringToWString(ModelName);
+
+	auto Error = SyntheticCorpus::Generate(CorpusDirectory, Name, Params);
+	if (Error != EError_OK)
+		return Error;
+
+	std::error_code ec;
+	std::filesystem::create_directories(OutputDirectory, ec);
+
+	auto BasePath = (std::filesystem::path(CorpusDirectory) / Name).wstring();
+	auto M2FileName = BasePath + L".m2";
+	auto M2IFileName = BasePath + L".m2i";
+	auto OutputM2FileName = (std::filesystem::path(OutputDirectory) / Name).wstring() + L".m2";
+	auto OutputM2IFileName = (std::filesystem::path(OutputDirectory) / Name).wstring() + L".m2i";
+
+	uint64_t ModelSize = FileSize(M2FileName) + FileSize(BasePath + L"00.skin");
+	uint64_t M2ISize = FileSize(M2IFileName);
+
+	std::unique_ptr<M2> Base(new M2());
+	Error = Base->Load(M2FileName.c_str());
+	if (Error != EError_OK)
+		return Error;
+
+	uint64_t VertexSize = Base->Elements[M2Element::EElement_Vertex].Data.size();
+	std::unique_ptr<M2> Model;
+
+	// end-to-end stages
+
+	auto ResetModel = [&]()
+	{
+		Model.reset();
+		return EError_OK;
+	};
+
+	Error = Measure("M2::Load", ModelName, 1, ModelSize, ResetModel, [&]()
+	{
+		Model.reset(new M2());
+		return Model->Load(M2FileName.c_str());
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	// output is removed, so unchanged files are not skipped by save
+	Error = Measure("M2::Save", ModelName, 1, ModelSize, [&]()
+	{
+		std::filesystem::remove(OutputM2FileName, ec);
+		std::filesystem::remove((std::filesystem::path(OutputDirectory) / Name).wstring() + L"00.skin", ec);
+		Model.reset(Base->Clone());
+		return EError_OK;
+	}, [&]()
+	{
+		return Model->Save(OutputM2FileName.c_str(), SAVE_ALL);
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	Error = Measure("M2::ExportM2Intermediate", ModelName, 1, M2ISize, nullptr, [&]()
+	{
+		return Base->ExportM2Intermediate(OutputM2IFileName.c_str());
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	Error = Measure("M2::ImportM2Intermediate", ModelName, 1, M2ISize, [&]()
+	{
+		Model.reset(Base->Clone());
+		return EError_OK;
+	}, [&]()
+	{
+		return Model->ImportM2Intermediate(M2IFileName.c_str());
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	// kernels
+
+	std::unique_ptr<M2I> Intermediate;
+	Error = Measure("M2I::Load", ModelName, 1, M2ISize, [&]()
+	{
+		Intermediate.reset();
+		return EError_OK;
+	}, [&]()
+	{
+		Intermediate.reset(new M2I());
+		return Intermediate->Load(M2IFileName.c_str(), Base.get(), false, false, false, false);
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	Error = Measure("M2SkinBuilder::Build", ModelName, 1, VertexSize, nullptr, [&]()
+	{
+		M2SkinBuilder SkinBuilder;
+		std::unique_ptr<M2Skin> Skin(new M2Skin(Base.get()));
+		return SkinBuilder.Build(Skin.get(), 256, Intermediate.get(), &Intermediate->VertexList[0], 0) ? EError_OK : EError_FAIL;
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	// every sub mesh is normalized against every other
+	uint32_t AllMeshes = 0x1F1F1F1F;
+	Error = Measure("M2::FixNormals", ModelName, 1, VertexSize, [&]()
+	{
+		Model.reset(Base->Clone());
+		return Model->AddNormalizationRule(0, &AllMeshes, 1, 0, &AllMeshes, 1, false);
+	}, [&]()
+	{
+		Model->FixNormals(NormalAngularTolerance * DegreesToRadians);
+		return EError_OK;
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	auto CloneBase = [&]()
+	{
+		Model.reset(Base->Clone());
+		return EError_OK;
+	};
+
+	Error = Measure("M2::FixSeamsSubMesh", ModelName, 1, VertexSize, CloneBase, [&]()
+	{
+		Model->FixSeamsSubMesh(SubmeshPositionalTolerance, SubmeshAngularTolerance * DegreesToRadians);
+		return EError_OK;
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	Error = Measure("M2::FixSeamsBody", ModelName, 1, VertexSize, CloneBase, [&]()
+	{
+		Model->FixSeamsBody(BodyPositionalTolerance, BodyAngularTolerance * DegreesToRadians);
+		return EError_OK;
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	Error = Measure("M2::FixSeamsClothing", ModelName, 1, VertexSize, CloneBase, [&]()
+	{
+		Model->FixSeamsClothing(ClothingPositionalTolerance, ClothingAngularTolerance * DegreesToRadians);
+		return EError_OK;
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	// every sequence is skinned at 30 samples per second
+	uint32_t const AnimationSampleInterval = 33;
+	Error = Measure("M2::CalculateAnimationBounds", ModelName, Params.AnimationCount, VertexSize, CloneBase, [&]()
+	{
+		return Model->CalculateAnimationBounds(AnimationSampleInterval);
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	// compare model against its own copy, so every bone is matched
+	Model.reset(Base->Clone());
+	Error = Measure("BoneComparator::Diff", ModelName, 1, VertexSize * 2, nullptr, [&]()
+	{
+		float SourceScale = 1.0f;
+		BoneComparator::Diff(Base.get(), Model.get(), true, false, SourceScale);
+		return EError_OK;
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	return EError_OK;
+}
+
+EError BenchmarkSuite::RunStorageKernels(uint32_t EntryCount)
+{
+	auto MappingsDirectory = (std::filesystem::path(Directory) / L"mappings").wstring();
+
+	std::error_code ec;
+	std::filesystem::create_directories(MappingsDirectory, ec);
+
+	// listfile-like paths with mixed case and separators, so normalization has work to do
+	std::vector<std::string> Paths(EntryCount);
+	for (uint32_t i = 0; i < EntryCount; ++i)
+	{
+		char Path[128];
+		snprintf(Path, sizeof(Path), "World\\Synthetic\\Zone%03u/Doodads\\Synthetic_Doodad_%06u.M2", i % 997, i);
+		Paths[i] = Path;
+	}
+
+	auto MappingsFileName = (std::filesystem::path(MappingsDirectory) / L"synthetic.csv").wstring();
+	{
+		std::ofstream FileStream(std::filesystem::path(MappingsFileName), std::ios::out | std::ios::trunc);
+		for (uint32_t i = 0; i < EntryCount; ++i)
+			FileStream << (i + 1) << ";" << Paths[i] << "\n";
+		if (FileStream.fail())
+		{
+			sLogger.LogError(L"Failed to write benchmark mappings to '%s'", MappingsFileName.c_str());
+			return EError_FAIL;
+		}
+	}
+
+	// left by reload kernels of interrupted run
+	std::filesystem::remove(std::filesystem::path(MappingsDirectory) / L"custom.txt", ec);
+
+	uint64_t MappingsSize = FileSize(MappingsFileName);
+	std::string Model = "mappings_" + std::to_string(EntryCount);
+
+	std::unique_ptr<FileStorage> Storage;
+	auto Error = Measure("FileStorage::ParseCsv", Model, EntryCount, MappingsSize, nullptr, [&]()
+	{
+		Storage.reset(new FileStorage(MappingsDirectory));
+		return Storage->LoadStorage() && Storage->GetStorageSize() == EntryCount ? EError_OK : EError_FAIL;
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	std::vector<std::wstring> WidePaths(Paths.size());
+	uint64_t PathsSize = 0;
+	for (uint32_t i = 0; i < Paths.size(); ++i)
+	{
+		WidePaths[i] = StringHelpers::StringToWString(Paths[i]);
+		PathsSize += Paths[i].length();
+	}
+
+	Error = Measure("FileStorage::GetFileInfoByPath", Model, EntryCount, PathsSize * sizeof(wchar_t), nullptr, [&]()
+	{
+		for (auto const& Path : WidePaths)
+			if (!Storage->GetFileInfoByPath(Path))
+				return EError_FAIL;
+		return EError_OK;
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	Error = Measure("FileStorage::GetFileInfoByFileDataId", Model, EntryCount, 0, nullptr, [&]()
+	{
+		for (uint32_t i = 0; i < EntryCount; ++i)
+			if (!Storage->GetFileInfoByFileDataId(i + 1))
+				return EError_FAIL;
+		return EError_OK;
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	Error = Measure("FileStorage::GetFileDataIdByPath", Model, EntryCount, PathsSize * sizeof(wchar_t), nullptr, [&]()
+	{
+		for (uint32_t i = 0; i < EntryCount; ++i)
+			if (Storage->GetFileDataIdByPath(WidePaths[i]) != i + 1)
+				return EError_FAIL;
+		return EError_OK;
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	Error = Measure("FileStorage::GetPathView", Model, EntryCount, 0, nullptr, [&]()
+	{
+		for (uint32_t i = 0; i < EntryCount; ++i)
+			if (Storage->GetPathView(i + 1).empty())
+				return EError_FAIL;
+		return EError_OK;
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	std::unique_ptr<LegacyFileStorage> Legacy;
+	Error = Measure("LegacyFileStorage::Build", Model, EntryCount, PathsSize * sizeof(wchar_t), nullptr, [&]()
+	{
+		Legacy.reset(new LegacyFileStorage());
+		for (uint32_t i = 0; i < EntryCount; ++i)
+			Legacy->Add(i + 1, WidePaths[i]);
+		return EError_OK;
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	Error = Measure("LegacyFileStorage::GetFileInfoByPath", Model, EntryCount, PathsSize * sizeof(wchar_t), nullptr, [&]()
+	{
+		for (auto const& Path : WidePaths)
+			if (!Legacy->GetFileInfoByPath(Path))
+				return EError_FAIL;
+		return EError_OK;
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	Error = Measure("LegacyFileStorage::GetFileInfoByFileDataId", Model, EntryCount, 0, nullptr, [&]()
+	{
+		for (uint32_t i = 0; i < EntryCount; ++i)
+			if (!Legacy->GetFileInfoByFileDataId(i + 1))
+				return EError_FAIL;
+		return EError_OK;
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	// memory is measured on fresh storages, lookups above created FileInfo objects for every entry
+	Storage.reset();
+	Legacy.reset();
+	auto StorageBytes = MeasureResidentBytes([&]()
+	{
+		Storage.reset(new FileStorage(MappingsDirectory));
+		Storage->LoadStorage();
+	});
+	auto LegacyBytes = MeasureResidentBytes([&]()
+	{
+		Legacy.reset(new LegacyFileStorage());
+		for (uint32_t i = 0; i < EntryCount; ++i)
+			Legacy->Add(i + 1, WidePaths[i]);
+	});
+
+	for (auto& Result : Results)
+	{
+		if (Result.Model != Model)
+			continue;
+		if (Result.Name == "FileStorage::ParseCsv")
+			Result.ResidentBytes = StorageBytes;
+		else if (Result.Name == "LegacyFileStorage::Build")
+			Result.ResidentBytes = LegacyBytes;
+	}
+
+	sLogger.LogInfo(L"FileStorage: %.1f bytes per entry, legacy maps: %.1f bytes per entry", StorageBytes / double(EntryCount), LegacyBytes / double(EntryCount));
+	Legacy.reset();
+
+	// custom mappings are appended between iterations, as M2::SaveCustomMappings does
+	auto CustomFileName = (std::filesystem::path(MappingsDirectory) / L"custom.txt").wstring();
+	uint32_t const AppendedCount = 100;
+	uint32_t NextCustomFileDataId = EntryCount + 1;
+	const auto appendCustomMappings = [&]()
+	{
+		std::ofstream FileStream(std::filesystem::path(CustomFileName), std::ios::out | std::ios::app);
+		for (uint32_t i = 0; i < AppendedCount; ++i, ++NextCustomFileDataId)
+			FileStream << NextCustomFileDataId << ";world/synthetic/custom/custom_" << NextCustomFileDataId << ".m2\n";
+
+		return FileStream.fail() ? EError_FAIL : EError_OK;
+	};
+
+	uint32_t ExpectedSize = EntryCount;
+	Error = Measure("FileStorage::ReloadStorage", Model, AppendedCount, 0, [&]()
+	{
+		ExpectedSize += AppendedCount;
+		return appendCustomMappings();
+	}, [&]()
+	{
+		return Storage->ReloadStorage() && Storage->GetStorageSize() == ExpectedSize ? EError_OK : EError_FAIL;
+	});
+	if (Error == EError_OK)
+	{
+		Error = Measure("FileStorage::FullReload", Model, AppendedCount, 0, [&]()
+		{
+			ExpectedSize += AppendedCount;
+			return appendCustomMappings();
+		}, [&]()
+		{
+			Storage.reset(new FileStorage(MappingsDirectory));
+			return Storage->LoadStorage() && Storage->GetStorageSize() == ExpectedSize ? EError_OK : EError_FAIL;
+		});
+	}
+
+	std::filesystem::remove(CustomFileName, ec);
+	if (Error != EError_OK)
+		return Error;
+
+	// project storages hold copy of base listfile and few own mappings, loaded independently and as overlays of shared base
+	uint32_t const ProjectCount = 4;
+	std::vector<std::wstring> ProjectDirectories;
+	for (uint32_t i = 0; i < ProjectCount; ++i)
+	{
+		auto ProjectDirectory = std::filesystem::path(Directory) / L"projects" / (L"project_" + std::to_wstring(i));
+		std::filesystem::create_directories(ProjectDirectory, ec);
+		std::filesystem::copy_file(MappingsFileName, ProjectDirectory / L"synthetic.csv", std::filesystem::copy_options::overwrite_existing, ec);
+
+		std::ofstream FileStream(ProjectDirectory / L"custom.txt", std::ios::out | std::ios::trunc);
+		for (uint32_t j = 0; j < AppendedCount; ++j)
+			FileStream << (EntryCount + 1 + i * AppendedCount + j) << ";world/synthetic/project_" << i << "/custom_" << j << ".m2\n";
+		if (FileStream.fail())
+			return EError_FAIL;
+
+		ProjectDirectories.push_back(ProjectDirectory.wstring());
+	}
+
+	std::unique_ptr<FileStorage> BaseStorage;
+	std::vector<std::unique_ptr<FileStorage>> Projects;
+	const auto loadProjects = [&](bool Layered)
+	{
+		Projects.clear();
+		BaseStorage.reset();
+		if (Layered)
+		{
+			BaseStorage.reset(new FileStorage(MappingsDirectory));
+			BaseStorage->LoadStorage();
+		}
+
+		for (auto& ProjectDirectory : ProjectDirectories)
+		{
+			Projects.emplace_back(new FileStorage(ProjectDirectory));
+			Projects.back()->SetBase(BaseStorage.get());
+			if (!Projects.back()->LoadStorage() || Projects.back()->GetFileDataIdByPath(WidePaths[0]) != 1)
+				return EError_FAIL;
+		}
+
+		return EError_OK;
+	};
+
+	std::string ProjectsModel = Model + "_x" + std::to_string(ProjectCount);
+	Error = Measure("FileStorage::LoadProjects", ProjectsModel, ProjectCount, 0, nullptr, [&]() { return loadProjects(false); });
+	if (Error != EError_OK)
+		return Error;
+
+	Error = Measure("FileStorage::LoadLayeredProjects", ProjectsModel, ProjectCount, 0, nullptr, [&]() { return loadProjects(true); });
+	if (Error != EError_OK)
+		return Error;
+
+	Error = Measure("FileStorage::GetFileDataIdByPath (overlay)", ProjectsModel, EntryCount, PathsSize * sizeof(wchar_t), nullptr, [&]()
+	{
+		for (uint32_t i = 0; i < EntryCount; ++i)
+			if (Projects[0]->GetFileDataIdByPath(WidePaths[i]) != i + 1)
+				return EError_FAIL;
+		return EError_OK;
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	Projects.clear();
+	BaseStorage.reset();
+	auto IndependentBytes = MeasureResidentBytes([&]() { loadProjects(false); });
+	Projects.clear();
+	auto LayeredBytes = MeasureResidentBytes([&]() { loadProjects(true); });
+
+	for (auto& Result : Results)
+	{
+		if (Result.Model != ProjectsModel)
+			continue;
+		if (Result.Name == "FileStorage::LoadProjects")
+			Result.ResidentBytes = IndependentBytes;
+		else if (Result.Name == "FileStorage::LoadLayeredProjects")
+			Result.ResidentBytes = LayeredBytes;
+	}
+
+	sLogger.LogInfo(L"%u project storages: %.1f MB independent, %.1f MB layered", ProjectCount, IndependentBytes / (1024.0 * 1024.0), LayeredBytes / (1024.0 * 1024.0));
+
+	// result is accumulated so hashing can't be optimized away
+	uint64_t HashSum = 0;
+	Error = Measure("CalcStringHash", Model, EntryCount, PathsSize, nullptr, [&]()
+	{
+		for (auto const& Path : Paths)
+			HashSum += CalcStringHash(Path);
+		return EError_OK;
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	Error = Measure("CalcStringHash<wchar_t>", Model, EntryCount, PathsSize * sizeof(wchar_t), nullptr, [&]()
+	{
+		for (auto const& Path : WidePaths)
+			HashSum += CalcStringHash(Path);
+		return EError_OK;
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	Error = Measure("CalcStringHashReference<wchar_t>", Model, EntryCount, PathsSize * sizeof(wchar_t), nullptr, [&]()
+	{
+		for (auto const& Path : WidePaths)
+			HashSum += CalcStringHashReference(Path);
+		return EError_OK;
+	});
+	if (Error != EError_OK)
+		return Error;
+
+	// stack buffer hashing has to stay bit exact with reference, hashes are stored in mapping caches
+	for (auto const& Path : WidePaths)
+	{
+		if (CalcStringHash(Path) != CalcStringHashReference(Path))
+		{
+			sLogger.LogError(L"Benchmark: hash mismatch for path '%s'", Path.c_str());
+			return EError_FAIL;
+		}
+	}
+
+	sLogger.LogInfo(L"Benchmark hash checksum: %llu", (unsigned long long)HashSum);
+
+	return EError_OK;
+}
+
+EError BenchmarkSuite::Run()
+{
+	Results.clear();
+
+	struct ModelSize
+	{
+		char const* Name;
+		uint32_t SubMeshCount;
+		uint32_t VerticesPerSubMesh;
+		uint32_t BoneCount;
+	};
+
+	// largest model is close to vertex limit of single M2I
+	ModelSize const Sizes[] =
+	{
+		{ "small", 4, 256, 16 },
+		{ "medium", 8, 1024, 32 },
+		{ "large", 16, 3969, 64 },
+	};
+
+	for (auto const& Size : Sizes)
+	{
+		SyntheticModelParams Params;
+		Params.SubMeshCount = Size.SubMeshCount;
+		Params.VerticesPerSubMesh = Size.VerticesPerSubMesh;
+		Params.BoneCount = Size.BoneCount;
+
+		sLogger.LogInfo(L"Running benchmarks on %s model", StringHelpers::StringToWString(Size.Name).c_str());
+
+		auto Error = RunModelKernels(std::string("synthetic_") + Size.Name, Params);
+		if (Error != EError_OK)
+			return Error;
+	}
+
+	return RunStorageKernels(100000);
+}
+
+bool BenchmarkSuite::ExportJson(std::wstring const& FileName) const
+{
+	std::fstream FileStream;
+	FileStream.open(FileName, std::ios::out | std::ios::trunc);
+	if (FileStream.fail())
+	{
+		sLogger.LogError(L"Failed to open '%s' for benchmark results", FileName.c_str());
+		return false;
+	}
+
+	FileStream << "{\"benchmarks\":[";
+
+	for (uint32_t i = 0; i < Results.size(); ++i)
+	{
+		auto const& Result = Results[i];
+
+		FileStream << (i ? ",\n" : "\n");
+		FileStream << "{\"name\":\"" << Result.Name << "\",\"model\":\"" << Result.Model << "\",\"iterations\":" << Result.Iterations
+			<< ",\"total_ms\":" << Result.TotalMs << ",\"ms_per_iteration\":" << Result.TotalMs / Result.Iterations
+			<< ",\"ops_per_sec\":" << Result.GetOpsPerSecond() << ",\"mb_per_sec\":" << Result.GetMBPerSecond()
+			<< ",\"allocations_per_iteration\":" << Result.Allocations / Result.Iterations
+			<< ",\"allocated_bytes_per_iteration\":" << Result.AllocatedBytes / Result.Iterations << ",\"peak_bytes\":" << Result.PeakBytes
+			<< ",\"resident_bytes\":" << Result.ResidentBytes << "}";
+	}
+
+	FileStream << "\n]}\n";
+	FileStream.close();
+
+	return !FileStream.fail();
+}
+
+void BenchmarkSuite::PrintSummary() const
+{
+	sLogger.LogInfo(L"%-36s %-20s %8s %12s %12s %10s %12s", L"Benchmark", L"Model", L"Iters", L"ms/iter", L"ops/s", L"MB/s", L"allocs/iter");
+	for (auto const& Result : Results)
+	{
+		sLogger.LogInfo(L"%-36s %-20s %8u %12.3f %12.1f %10.1f %12llu", StringHelpers::StringToWString(Result.Name).c_str(), StringHelpers::StringToWString(Result.Model).c_str(),
+			Result.Iterations, Result.TotalMs / Result.Iterations, Result.GetOpsPerSecond(), Result.GetMBPerSecond(), (unsigned long long)(Result.Allocations / Result.Iterations));
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "BaseTypes.h"
+#include "M2Types.h"
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace M2Lib
+{
+	struct Settings;
+	struct SyntheticModelParams;
+
+	// runs end-to-end stages and single kernels on synthetic models of several sizes.
+	// every kernel is repeated until both minimal iteration count and minimal time are reached, setup of iteration is not measured.
+	// log levels are left as they are, disable info messages to keep logging out of results.
+	class BenchmarkSuite
+	{
+	public:
+		struct Result
+		{
+			std::string Name;
+			std::string Model;
+			uint32_t Iterations = 0;
+			uint64_t OpsPerIteration = 0;
+			uint64_t BytesPerIteration = 0;	// input or output size processed by one iteration
+			double TotalMs = 0.0;
+			uint64_t Allocations = 0;		// operator new calls during all iterations
+			uint64_t AllocatedBytes = 0;
+			int64_t PeakBytes = 0;			// highest memory growth during single iteration
+			int64_t ResidentBytes = 0;		// memory kept by result of kernel, only set by storage kernels
+
+			double GetOpsPerSecond() const;
+			double GetMBPerSecond() const;
+		};
+
+		BenchmarkSuite(std::wstring const& Directory);
+
+		void SetIterationLimits(uint32_t MinIterations, double MinTimeMs);
+
+		EError Run();
+
+		std::vector<Result> const& GetResults() const { return Results; }
+		bool ExportJson(std::wstring const& FileName) const;
+		void PrintSummary() const;
+
+	private:
+		typedef std::function<EError()> Step;
+
+		std::wstring Directory;		// synthetic models, outputs and mappings are created here
+		uint32_t MinIterations = 3;
+		double MinTimeMs = 250.0;
+		std::vector<Result> Results;
+
+		EError Measure(char const* Name, std::string const& Model, uint64_t OpsPerIteration, uint64_t BytesPerIteration, Step const& Setup, Step const& Run);
+
+		EError RunModelKernels(std::string const& ModelName, SyntheticModelParams const& Params);
+		EError RunStorageKernels(uint32_t EntryCount);
+	};
+}
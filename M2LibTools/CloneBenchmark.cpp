@@ -0,0 +1,50 @@
+#include "CloneBenchmark.h"
+#include "M2.h"
+#include "Logger.h"
+#include <chrono>
+#include <memory>
+
+using namespace M2Lib;
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double ElapsedMs(Clock::time_point Start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - Start).count();
+	}
+}
+
+EError Benchmark::CloneVsReload(wchar_t const* FileName, Settings* settings, uint32_t Iterations, double& ReloadMs, double& CloneMs)
+{
+	ReloadMs = 0.0;
+	CloneMs = 0.0;
+
+	if (!Iterations)
+		Iterations = 1;
+
+	std::unique_ptr<M2> Base(new M2(settings));
+	auto Error = Base->Load(FileName);
+	if (Error != EError_OK)
+		return Error;
+
+	auto Start = Clock::now();
+	for (uint32_t i = 0; i < Iterations; ++i)
+	{
+		std::unique_ptr<M2> Reloaded(new M2(settings));
+		Error = Reloaded->Load(FileName);
+		if (Error != EError_OK)
+			return Error;
+	}
+	ReloadMs = ElapsedMs(Start) / Iterations;
+
+	Start = Clock::now();
+	for (uint32_t i = 0; i < Iterations; ++i)
+		std::unique_ptr<M2> Cloned(Base->Clone());
+	CloneMs = ElapsedMs(Start) / Iterations;
+
+	sLogger.LogInfo(L"Benchmark: %u iterations, reload %.3f ms, clone %.3f ms (x%.1f)", Iterations, ReloadMs, CloneMs, CloneMs > 0.0 ? ReloadMs / CloneMs : 0.0);
+
+	return EError_OK;
+}
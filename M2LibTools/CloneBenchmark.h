@@ -0,0 +1,16 @@
+#pragma once
+
+#include "BaseTypes.h"
+#include "M2Types.h"
+
+namespace M2Lib
+{
+	struct Settings;
+
+	namespace Benchmark
+	{
+		// loads model once, then measures average time of loading it again from disk against cloning already loaded model.
+		// times are in milliseconds per iteration.
+		EError CloneVsReload(wchar_t const* FileName, Settings* settings, uint32_t Iterations, double& ReloadMs, double& CloneMs);
+	}
+}
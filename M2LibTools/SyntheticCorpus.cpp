@@ -0,0 +1,787 @@
+#include "SyntheticCorpus.h"
+#include "M2.h"
+#include "M2I.h"
+#include "DataBinary.h"
+#include "Logger.h"
+#include "StringHelpers.h"
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+using namespace M2Lib;
+using namespace M2Lib::M2Element;
+using namespace M2Lib::M2SkinElement;
+
+namespace
+{
+	float const Pi = 3.14159265f;
+	float const ModelHeight = 2.0f;
+
+	// std distributions are implementation defined, so values are derived from raw engine output
+	class Random
+	{
+		std::mt19937 Engine;
+
+	public:
+		Random(uint32_t Seed) : Engine(Seed) { }
+
+		uint32_t Next(uint32_t Max) { return Engine() % Max; }
+		float NextFloat(float Min, float Max) { return Min + (Max - Min) * ((Engine() >> 8) * (1.0f / 16777216.0f)); }
+	};
+
+	// file image, each element starts at 16 byte boundary like in files written by game exporter
+	class FileLayout
+	{
+		std::vector<uint8_t> Data;
+
+	public:
+		FileLayout(uint32_t HeaderSize) : Data(HeaderSize) { }
+
+		uint32_t BeginElement()
+		{
+			Data.resize((Data.size() + 15) & ~15);
+			return Data.size();
+		}
+
+		uint32_t Append(void const* Source, uint32_t Size)
+		{
+			uint32_t Offset = Data.size();
+			Data.resize(Offset + Size);
+			if (Size)
+				memcpy(&Data[Offset], Source, Size);
+			return Offset;
+		}
+
+		template <class T>
+		uint32_t AppendElement(std::vector<T> const& Elements)
+		{
+			uint32_t Offset = BeginElement();
+			Append(Elements.data(), Elements.size() * sizeof(T));
+			return Offset;
+		}
+
+		template <class T>
+		T* At(uint32_t Offset) { return (T*)&Data[Offset]; }
+
+		std::vector<uint8_t> const& GetData() const { return Data; }
+	};
+
+	// in-place animation keys are stored after all elements, so they are written to tail and relocated at the end
+	class ModelLayout : public FileLayout
+	{
+		FileLayout Tail;
+		std::vector<uint32_t> TailFixups;	// offsets of fields that point into tail
+
+		void AppendKeys(uint32_t ArrayOffset, void const* Keys, uint32_t Count, uint32_t Size)
+		{
+			auto Array = At<M2Array>(ArrayOffset);
+			Array->Count = Count;
+			Array->Offset = Tail.BeginElement();
+			Tail.Append(Keys, Size);
+
+			TailFixups.push_back(ArrayOffset + sizeof(Array->Count));
+		}
+
+	public:
+		ModelLayout(uint32_t HeaderSize) : FileLayout(HeaderSize), Tail(0) { }
+
+		// writes arrays of key arrays behind current element, one key array per animation
+		template <class T>
+		void AppendTrack(M2Track& Track, std::vector<std::vector<uint32_t>> const& Times, std::vector<std::vector<T>> const& Values)
+		{
+			Track.InterpolationType = EInterpolationType_Linear;
+			Track.GlobalSequenceID = -1;
+			Track.TimeStamps = M2Array();
+			Track.Values = M2Array();
+
+			uint32_t AnimationCount = Times.size();
+			if (!AnimationCount)
+				return;
+
+			std::vector<M2Array> Arrays(AnimationCount);
+			Track.TimeStamps.Count = AnimationCount;
+			Track.TimeStamps.Offset = Append(Arrays.data(), AnimationCount * sizeof(M2Array));
+			Track.Values.Count = AnimationCount;
+			Track.Values.Offset = Append(Arrays.data(), AnimationCount * sizeof(M2Array));
+
+			for (uint32_t i = 0; i < AnimationCount; ++i)
+			{
+				AppendKeys(Track.TimeStamps.Offset + i * sizeof(M2Array), Times[i].data(), Times[i].size(), Times[i].size() * sizeof(uint32_t));
+				AppendKeys(Track.Values.Offset + i * sizeof(M2Array), Values[i].data(), Values[i].size(), Values[i].size() * sizeof(T));
+			}
+		}
+
+		void AppendTail()
+		{
+			uint32_t TailOffset = BeginElement();
+			for (auto Fixup : TailFixups)
+				*At<uint32_t>(Fixup) += TailOffset;
+
+			Append(Tail.GetData().data(), Tail.GetData().size());
+		}
+	};
+
+	struct GeneratedSubMesh
+	{
+		uint16_t ID;
+		uint32_t VertexStart;
+		uint32_t VertexCount;
+		std::vector<uint16_t> Triangles;	// indices relative to VertexStart
+		std::vector<uint16_t> Bones;		// bone partition of sub mesh, sorted
+		uint32_t MaxBonesPerVertex;
+		BoundaryData Boundary;
+	};
+
+	struct GeneratedModel
+	{
+		std::vector<CVertex> Vertices;
+		std::vector<GeneratedSubMesh> SubMeshes;
+		std::vector<CElement_Bone> Bones;
+		BoundaryData Boundary;
+	};
+
+	// rotation keys are stored as compressed quaternions
+	M2Track::SKey_SInt16x4 CompressQuaternion(float X, float Y, float Z, float W)
+	{
+		M2Track::SKey_SInt16x4 Key;
+		float Components[] = { X, Y, Z, W };
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			int32_t Value = (int32_t)(Components[i] * 32767.0f);
+			Key.Values[i] = (uint16_t)(Components[i] > 0.0f ? Value - 32768 : Value + 32767);
+		}
+
+		return Key;
+	}
+
+	SVolume ToVolume(BoundaryData const& Boundary)
+	{
+		SVolume Volume;
+		Volume.Min = Boundary.BoundingMin;
+		Volume.Max = Boundary.BoundingMax;
+		Volume.Radius = Boundary.SortRadius;
+
+		return Volume;
+	}
+
+	// sub mesh ids follow geoset numbering, 0 is body and others are variations of geoset groups
+	uint16_t GetSubMeshId(uint32_t SubMeshIndex)
+	{
+		if (!SubMeshIndex)
+			return 0;
+
+		return (uint16_t)(((SubMeshIndex - 1) % 20 + 1) * 100 + (SubMeshIndex - 1) / 20 + 1);
+	}
+
+	// picks bones and 8 bit weights that sum to 255 for vertex at Height in range 0..1
+	void AssignBones(CVertex& Vertex, SyntheticModelParams const& Params, uint32_t SubMeshIndex, float Height, Random& Rng)
+	{
+		uint32_t Influences = std::min(Params.InfluencesPerVertex, Params.BoneCount);
+		uint16_t Bones[BONES_PER_VERTEX] = {};
+		float Weights[BONES_PER_VERTEX] = {};
+
+		switch (Params.Skinning)
+		{
+			case SkinningPattern::Rigid:
+				Influences = 1;
+				Bones[0] = (uint16_t)(SubMeshIndex * Params.BoneCount / Params.SubMeshCount);
+				Weights[0] = 1.0f;
+				break;
+			case SkinningPattern::Chain:
+			{
+				float Position = Height * (Params.BoneCount - 1);
+				uint32_t First = std::min((uint32_t)Position, Params.BoneCount - Influences);
+				for (uint32_t i = 0; i < Influences; ++i)
+				{
+					Bones[i] = (uint16_t)(First + i);
+					Weights[i] = 1.0f / (1.0f + std::fabs(Position - (First + i)) * 4.0f);
+				}
+				break;
+			}
+			case SkinningPattern::Scattered:
+			default:
+				for (uint32_t i = 0; i < Influences; ++i)
+				{
+					uint16_t Bone;
+					do
+						Bone = (uint16_t)Rng.Next(Params.BoneCount);
+					while (std::find(Bones, Bones + i, Bone) != Bones + i);
+
+					Bones[i] = Bone;
+					Weights[i] = Rng.NextFloat(0.1f, 1.0f);
+				}
+				break;
+		}
+
+		// heaviest influence goes first, like in exported models
+		uint32_t Order[BONES_PER_VERTEX] = { 0, 1, 2, 3 };
+		std::stable_sort(Order, Order + Influences, [&](uint32_t a, uint32_t b) { return Weights[a] > Weights[b]; });
+
+		float TotalWeight = 0.0f;
+		for (uint32_t i = 0; i < Influences; ++i)
+			TotalWeight += Weights[i];
+
+		uint32_t Remaining = 255;
+		for (uint32_t i = 0; i < BONES_PER_VERTEX; ++i)
+		{
+			Vertex.BoneIndices[i] = 0;
+			Vertex.BoneWeights[i] = 0;
+			if (i >= Influences)
+				continue;
+
+			uint32_t Weight = i + 1 == Influences ? Remaining : std::min(Remaining, (uint32_t)(Weights[Order[i]] / TotalWeight * 255.0f));
+			Vertex.BoneIndices[i] = (uint8_t)Bones[Order[i]];
+			Vertex.BoneWeights[i] = (uint8_t)Weight;
+			Remaining -= Weight;
+		}
+	}
+
+	// every sub mesh is a band of a cylinder. first and last columns are duplicates, so sub meshes have seams like real ones
+	EError BuildModel(SyntheticModelParams const& Params, GeneratedModel& Model)
+	{
+		Random Rng(Params.Seed);
+
+		uint32_t Columns = std::max<uint32_t>(3, (uint32_t)std::sqrt((float)Params.VerticesPerSubMesh));
+		uint32_t Rows = std::max<uint32_t>(2, Params.VerticesPerSubMesh / Columns);
+
+		if (Params.SubMeshCount * Columns * Rows > 0xFFFF)
+		{
+			sLogger.LogError(L"Synthetic model has too many vertices: %u, maximum is %u", Params.SubMeshCount * Columns * Rows, 0xFFFF);
+			return EError_FailedToImportM2I_TooManyVertices;
+		}
+
+		if ((Columns - 1) * (Rows - 1) * 6 > 0xFFFF)
+		{
+			sLogger.LogError(L"Synthetic sub mesh has too many triangle indices: %u, maximum is %u", (Columns - 1) * (Rows - 1) * 6, 0xFFFF);
+			return EError_FailedToImportM2I_SkinHasTooManyIndices;
+		}
+
+		float BandHeight = ModelHeight / Params.SubMeshCount;
+		std::vector<float> RadiusNoise(Columns - 1);
+
+		Model.SubMeshes.resize(Params.SubMeshCount);
+		for (uint32_t i = 0; i < Params.SubMeshCount; ++i)
+		{
+			auto& SubMesh = Model.SubMeshes[i];
+			SubMesh.ID = GetSubMeshId(i);
+			SubMesh.VertexStart = Model.Vertices.size();
+			SubMesh.VertexCount = Columns * Rows;
+
+			float Radius = Rng.NextFloat(0.3f, 0.5f);
+			for (uint32_t Row = 0; Row < Rows; ++Row)
+			{
+				for (auto& Noise : RadiusNoise)
+					Noise = Rng.NextFloat(-0.01f, 0.01f);
+
+				float Z = BandHeight * (i + (float)Row / (Rows - 1));
+				for (uint32_t Column = 0; Column < Columns; ++Column)
+				{
+					float Angle = 2.0f * Pi * Column / (Columns - 1);
+
+					CVertex Vertex;
+					float VertexRadius = Radius + RadiusNoise[Column % (Columns - 1)];
+					Vertex.Position = C3Vector(std::cos(Angle) * VertexRadius, std::sin(Angle) * VertexRadius, Z);
+					Vertex.Normal = C3Vector(std::cos(Angle), std::sin(Angle), 0.0f);
+					Vertex.Texture[0].X = (float)Column / (Columns - 1);
+					Vertex.Texture[0].Y = (float)Row / (Rows - 1);
+					Vertex.Texture[1] = Vertex.Texture[0];
+					AssignBones(Vertex, Params, i, Z / ModelHeight, Rng);
+
+					Model.Vertices.push_back(Vertex);
+				}
+			}
+
+			for (uint32_t Row = 0; Row + 1 < Rows; ++Row)
+			{
+				for (uint32_t Column = 0; Column + 1 < Columns; ++Column)
+				{
+					uint16_t A = (uint16_t)(Row * Columns + Column);
+					uint16_t B = (uint16_t)(A + 1);
+					uint16_t C = (uint16_t)(A + Columns);
+					uint16_t D = (uint16_t)(C + 1);
+
+					uint16_t Indices[] = { A, B, D, A, D, C };
+					SubMesh.Triangles.insert(SubMesh.Triangles.end(), Indices, Indices + 6);
+				}
+			}
+
+			std::vector<CVertex> SubMeshVertices(Model.Vertices.begin() + SubMesh.VertexStart, Model.Vertices.end());
+			SubMesh.Boundary.Calculate(SubMeshVertices);
+
+			SubMesh.MaxBonesPerVertex = 0;
+			for (auto const& Vertex : SubMeshVertices)
+			{
+				for (uint32_t j = 0; j < BONES_PER_VERTEX; ++j)
+				{
+					if (!Vertex.BoneWeights[j])
+						continue;
+
+					SubMesh.MaxBonesPerVertex = std::max(SubMesh.MaxBonesPerVertex, j + 1);
+					if (std::find(SubMesh.Bones.begin(), SubMesh.Bones.end(), Vertex.BoneIndices[j]) == SubMesh.Bones.end())
+						SubMesh.Bones.push_back(Vertex.BoneIndices[j]);
+				}
+			}
+			std::sort(SubMesh.Bones.begin(), SubMesh.Bones.end());
+		}
+
+		Model.Boundary.Calculate(Model.Vertices);
+
+		// bones form a chain along model height
+		Model.Bones.resize(Params.BoneCount);
+		for (uint32_t i = 0; i < Params.BoneCount; ++i)
+		{
+			auto& Bone = Model.Bones[i];
+			memset(&Bone, 0, sizeof(Bone));
+			Bone.BoneLookupID = -1;
+			Bone.Flags = (CElement_Bone::EFlags)0;
+			Bone.ParentBone = (int16_t)i - 1;
+			Bone.SubmeshId = 0;
+			Bone.Position = C3Vector(0.0f, 0.0f, Params.BoneCount > 1 ? ModelHeight * i / (Params.BoneCount - 1) : 0.0f);
+		}
+
+		return EError_OK;
+	}
+
+	std::vector<uint8_t> BuildM2(SyntheticModelParams const& Params, GeneratedModel const& Model, std::string const& Name)
+	{
+		Random Rng(Params.Seed ^ 0x5EED);
+
+		M2::CM2Header Header;
+		memset(&Header, 0, sizeof(Header));
+		memcpy(Header.Description.ID, "MD20", 4);
+		Header.Description.Version = 274;
+		Header.Elements.nSkin = 1;
+		Header.Elements.CollisionVolume = ToVolume(Model.Boundary);
+		Header.Elements.BoundingVolume = ToVolume(Model.Boundary);
+
+		// short header, model has no texture combiner combos
+		ModelLayout Layout(sizeof(Header) - 8);
+
+		Header.Description.nName = Name.length() + 1;
+		Header.Description.oName = Layout.BeginElement();
+		Layout.Append(Name.c_str(), Name.length() + 1);
+
+		// animations and key times shared by all tracks
+		std::vector<CElement_Animation> Animations(Params.AnimationCount);
+		std::vector<uint16_t> AnimationLookup(Params.AnimationCount);
+		std::vector<std::vector<uint32_t>> Times(Params.AnimationCount);
+		std::vector<std::vector<uint32_t>> StaticTimes(Params.AnimationCount, std::vector<uint32_t>(1, 0));
+		for (uint32_t i = 0; i < Params.AnimationCount; ++i)
+		{
+			auto& Animation = Animations[i];
+			memset(&Animation, 0, sizeof(Animation));
+			Animation.AnimationID = (uint16_t)i;
+			Animation.Length = 1000 + 250 * i;
+			Animation.Flags = 0x20;	// in-place, keys are stored in model file
+			Animation.Rarity = 0x7FFF;
+			Animation.BlendTimeIn = 150;
+			Animation.BlendTimeOut = 150;
+			Animation.BoundingVolume = ToVolume(Model.Boundary);
+			Animation.NextAnimation = -1;
+			Animation.NextIndex = (uint16_t)i;
+
+			AnimationLookup[i] = (uint16_t)i;
+
+			uint32_t KeyCount = std::max<uint32_t>(1, Params.KeysPerTrack);
+			for (uint32_t j = 0; j < KeyCount; ++j)
+				Times[i].push_back(KeyCount > 1 ? Animation.Length * j / (KeyCount - 1) : 0);
+		}
+
+		if (Params.AnimationCount)
+		{
+			Header.Elements.nAnimation = Params.AnimationCount;
+			Header.Elements.oAnimation = Layout.AppendElement(Animations);
+			Header.Elements.nAnimationLookup = Params.AnimationCount;
+			Header.Elements.oAnimationLookup = Layout.AppendElement(AnimationLookup);
+		}
+
+		// bones, key arrays follow bone list inside element
+		std::vector<CElement_Bone> Bones = Model.Bones;
+		Header.Elements.nBone = Bones.size();
+		Header.Elements.oBone = Layout.AppendElement(Bones);
+		for (auto& Bone : Bones)
+		{
+			float Amplitude = Rng.NextFloat(0.0f, 0.05f);
+			float Swing = Rng.NextFloat(0.0f, 0.5f);
+			float Phase = Rng.NextFloat(0.0f, 2.0f * Pi);
+
+			std::vector<std::vector<M2Track::SKey_Float32x3>> Translations(Params.AnimationCount);
+			std::vector<std::vector<M2Track::SKey_SInt16x4>> Rotations(Params.AnimationCount);
+			for (uint32_t i = 0; i < Params.AnimationCount; ++i)
+			{
+				for (uint32_t j = 0; j < Times[i].size(); ++j)
+				{
+					float Time = 2.0f * Pi * Times[i][j] / Animations[i].Length + Phase;
+
+					M2Track::SKey_Float32x3 Translation = { { Amplitude * std::sin(Time), 0.0f, 0.0f } };
+					Translations[i].push_back(Translation);
+
+					float HalfAngle = Swing * std::sin(Time) * 0.5f;
+					Rotations[i].push_back(CompressQuaternion(0.0f, 0.0f, std::sin(HalfAngle), std::cos(HalfAngle)));
+				}
+			}
+
+			Layout.AppendTrack(Bone.AnimationBlock_Position, Times, Translations);
+			Layout.AppendTrack(Bone.AnimationBlock_Rotation, Times, Rotations);
+			Layout.AppendTrack(Bone.AnimationBlock_Scale, std::vector<std::vector<uint32_t>>(), std::vector<std::vector<M2Track::SKey_Float32x3>>());
+		}
+		memcpy(Layout.At<CElement_Bone>(Header.Elements.oBone), Bones.data(), Bones.size() * sizeof(CElement_Bone));
+
+		Header.Elements.nVertex = Model.Vertices.size();
+		Header.Elements.oVertex = Layout.AppendElement(Model.Vertices);
+
+		// textures, paths follow texture list inside element
+		std::vector<CElement_Texture> Textures(Params.TextureCount);
+		Header.Elements.nTexture = Textures.size();
+		Header.Elements.oTexture = Layout.AppendElement(Textures);
+		for (uint32_t i = 0; i < Textures.size(); ++i)
+		{
+			char Path[64];
+			snprintf(Path, sizeof(Path), "synthetic\\%s_%02u.blp", Name.c_str(), i);
+
+			Textures[i].Type = CElement_Texture::ETextureType::Final_Hardcoded;
+			Textures[i].Flags = (CElement_Texture::ETextureFlags)((uint32_t)CElement_Texture::ETextureFlags::WrapX | (uint32_t)CElement_Texture::ETextureFlags::WrapY);
+			Textures[i].TexturePath.Count = strlen(Path) + 1;
+			Textures[i].TexturePath.Offset = Layout.Append(Path, strlen(Path) + 1);
+		}
+		memcpy(Layout.At<CElement_Texture>(Header.Elements.oTexture), Textures.data(), Textures.size() * sizeof(CElement_Texture));
+
+		// single opaque transparency
+		std::vector<CElement_Transparency> Transparencies(1);
+		std::vector<std::vector<M2Track::SKey_UInt16>> Opaque(Params.AnimationCount, std::vector<M2Track::SKey_UInt16>(1, { { 0x7FFF } }));
+		Header.Elements.nTransparency = 1;
+		Header.Elements.oTransparency = Layout.AppendElement(Transparencies);
+		Layout.AppendTrack(Transparencies[0].AnimationBlock_Transparency, StaticTimes, Opaque);
+		memcpy(Layout.At<CElement_Transparency>(Header.Elements.oTransparency), Transparencies.data(), sizeof(CElement_Transparency));
+
+		std::vector<CElement_TextureFlag> RenderFlags(1, { CElement_TextureFlag::EFlags_None, CElement_TextureFlag::EBlend_Opaque });
+		Header.Elements.nTextureFlags = 1;
+		Header.Elements.oTextureFlags = Layout.AppendElement(RenderFlags);
+
+		std::vector<uint16_t> SkinnedBoneLookup;
+		for (auto const& SubMesh : Model.SubMeshes)
+			SkinnedBoneLookup.insert(SkinnedBoneLookup.end(), SubMesh.Bones.begin(), SubMesh.Bones.end());
+		Header.Elements.nSkinnedBoneLookup = SkinnedBoneLookup.size();
+		Header.Elements.oSkinnedBoneLookup = Layout.AppendElement(SkinnedBoneLookup);
+
+		std::vector<uint16_t> TextureLookup(Params.TextureCount);
+		for (uint32_t i = 0; i < TextureLookup.size(); ++i)
+			TextureLookup[i] = (uint16_t)i;
+		Header.Elements.nTextureLookup = TextureLookup.size();
+		Header.Elements.oTextureLookup = Layout.AppendElement(TextureLookup);
+
+		std::vector<uint16_t> ZeroLookup(1, 0);
+		Header.Elements.nTextureUnitLookup = 1;
+		Header.Elements.oTextureUnitLookup = Layout.AppendElement(ZeroLookup);
+		Header.Elements.nTransparencyLookup = 1;
+		Header.Elements.oTransparencyLookup = Layout.AppendElement(ZeroLookup);
+
+		std::vector<int16_t> TextureAnimationLookup(1, -1);
+		Header.Elements.nTextureAnimationLookup = 1;
+		Header.Elements.oTextureAnimationLookup = Layout.AppendElement(TextureAnimationLookup);
+
+		// attachments are spread over bone chain
+		uint32_t AttachmentCount = Params.BoneCount ? Params.AttachmentCount : 0;
+		if (AttachmentCount)
+		{
+			std::vector<CElement_Attachment> Attachments(AttachmentCount);
+			std::vector<int16_t> AttachmentLookup(AttachmentCount);
+			for (uint32_t i = 0; i < AttachmentCount; ++i)
+			{
+				auto& Attachment = Attachments[i];
+				memset(&Attachment, 0, sizeof(Attachment));
+				Attachment.ID = i;
+				Attachment.ParentBone = i * Params.BoneCount / AttachmentCount;
+				Attachment.Position = Model.Bones[Attachment.ParentBone].Position + C3Vector(0.5f, 0.0f, 0.0f);
+				Attachment.AnimationBlock_Visibility.GlobalSequenceID = -1;
+
+				AttachmentLookup[i] = (int16_t)i;
+			}
+
+			Header.Elements.nAttachment = AttachmentCount;
+			Header.Elements.oAttachment = Layout.AppendElement(Attachments);
+			Header.Elements.nAttachmentLookup = AttachmentCount;
+			Header.Elements.oAttachmentLookup = Layout.AppendElement(AttachmentLookup);
+		}
+
+		Layout.AppendTail();
+		memcpy(Layout.At<M2::CM2Header>(0), &Header, sizeof(Header) - 8);
+
+		// wrap model in chunk
+		auto const& ModelData = Layout.GetData();
+		uint32_t ChunkHeader[2] = { REVERSE_CC((uint32_t)M2Chunk::EM2Chunk::Model), (uint32_t)ModelData.size() };
+
+		std::vector<uint8_t> FileData((uint8_t const*)ChunkHeader, (uint8_t const*)(ChunkHeader + 2));
+		FileData.insert(FileData.end(), ModelData.begin(), ModelData.end());
+
+		return FileData;
+	}
+
+	std::vector<uint8_t> BuildSkin(SyntheticModelParams const& Params, GeneratedModel const& Model)
+	{
+		M2Skin::CM2SkinHeader Header;
+		memset(&Header, 0, sizeof(Header));
+		memcpy(Header.ID, "SKIN", 4);
+
+		FileLayout Layout(sizeof(Header));
+
+		// sub meshes are contiguous, skin vertices map 1:1 to model vertices
+		std::vector<uint16_t> VertexLookup(Model.Vertices.size());
+		for (uint32_t i = 0; i < VertexLookup.size(); ++i)
+			VertexLookup[i] = (uint16_t)i;
+
+		std::vector<uint16_t> Triangles;
+		std::vector<CElement_BoneIndices> BoneIndices(Model.Vertices.size());
+		std::vector<CElement_SubMesh> SubMeshes(Model.SubMeshes.size());
+		std::vector<CElement_Material> Materials(Model.SubMeshes.size());
+
+		uint32_t BoneStart = 0;
+		for (uint32_t i = 0; i < Model.SubMeshes.size(); ++i)
+		{
+			auto const& Source = Model.SubMeshes[i];
+
+			auto& SubMesh = SubMeshes[i];
+			memset(&SubMesh, 0, sizeof(SubMesh));
+			SubMesh.ID = Source.ID;
+			SubMesh.Level = (uint16_t)(Triangles.size() >> 16);
+			SubMesh.VertexStart = (uint16_t)Source.VertexStart;
+			SubMesh.VertexCount = (uint16_t)Source.VertexCount;
+			SubMesh.TriangleIndexStart = (uint16_t)Triangles.size();
+			SubMesh.TriangleIndexCount = (uint16_t)Source.Triangles.size();
+			SubMesh.BoneCount = (uint16_t)Source.Bones.size();
+			SubMesh.BoneStart = (uint16_t)BoneStart;
+			SubMesh.MaxBonesPerVertex = (uint16_t)Source.MaxBonesPerVertex;
+			SubMesh.CenterBoneIndex = Source.Bones.empty() ? 0 : Source.Bones[0];
+			SubMesh.CenterMass = Source.Boundary.CenterMass;
+			SubMesh.SortCenter = Source.Boundary.SortCenter;
+			SubMesh.SortRadius = Source.Boundary.SortRadius;
+
+			for (auto Index : Source.Triangles)
+				Triangles.push_back((uint16_t)(Source.VertexStart + Index));
+
+			// skin bone indices point into bone partition of sub mesh
+			for (uint32_t j = Source.VertexStart; j < Source.VertexStart + Source.VertexCount; ++j)
+			{
+				auto const& Vertex = Model.Vertices[j];
+				BoneIndices[j].Clear();
+				for (uint32_t k = 0; k < BONES_PER_VERTEX; ++k)
+				{
+					if (Vertex.BoneWeights[k])
+						BoneIndices[j].BoneIndices[k] = (uint8_t)(std::lower_bound(Source.Bones.begin(), Source.Bones.end(), Vertex.BoneIndices[k]) - Source.Bones.begin());
+				}
+			}
+
+			auto& Material = Materials[i];
+			memset(&Material, 0, sizeof(Material));
+			Material.iSubMesh = (uint16_t)i;
+			Material.iSubMesh2 = (uint16_t)i;
+			Material.iColor = -1;
+			Material.op_count = 1;
+			Material.textureComboIndex = (int16_t)(Params.TextureCount ? i % Params.TextureCount : 0);
+
+			BoneStart += Source.Bones.size();
+		}
+
+		Header.nVertex = VertexLookup.size();
+		Header.oVertex = Layout.AppendElement(VertexLookup);
+		Header.nTriangleIndex = Triangles.size();
+		Header.oTriangleIndex = Layout.AppendElement(Triangles);
+		Header.nBoneIndices = BoneIndices.size();
+		Header.oBoneIndices = Layout.AppendElement(BoneIndices);
+		Header.nSubMesh = SubMeshes.size();
+		Header.oSubMesh = Layout.AppendElement(SubMeshes);
+		Header.nMaterial = Materials.size();
+		Header.oMaterial = Layout.AppendElement(Materials);
+
+		memcpy(Layout.At<M2Skin::CM2SkinHeader>(0), &Header, sizeof(Header));
+
+		return Layout.GetData();
+	}
+
+	// same layout as M2::ExportM2Intermediate writes
+	std::vector<uint8_t> BuildM2I(SyntheticModelParams const& Params, GeneratedModel const& Model)
+	{
+		std::vector<uint8_t> FileData;
+		DataBinary DataBinary(&FileData, EEndianness_Little);
+
+		DataBinary.WriteFourCC(M2I::Signature_M2I0);
+		DataBinary.Write<uint16_t>(8);
+		DataBinary.Write<uint16_t>(1);
+
+		DataBinary.Write<uint32_t>(Model.SubMeshes.size());
+		for (uint32_t i = 0; i < Model.SubMeshes.size(); ++i)
+		{
+			auto const& SubMesh = Model.SubMeshes[i];
+
+			char Description[32];
+			snprintf(Description, sizeof(Description), "synthetic %u", i);
+
+			DataBinary.Write<uint16_t>(SubMesh.ID);
+			DataBinary.WriteASCIIString(Description);
+			DataBinary.Write<int16_t>(-1);				// material override
+			DataBinary.Write<int32_t>(-1);				// shader id
+			DataBinary.Write<int16_t>(-1);				// blend type
+			DataBinary.Write<uint16_t>(0);				// render flags
+
+			for (uint32_t j = 0; j < MAX_SUBMESH_TEXTURES; ++j)
+			{
+				DataBinary.Write<uint16_t>(-1);			// texture type
+				DataBinary.WriteASCIIString("");	// texture
+			}
+
+			DataBinary.Write<uint32_t>(i);				// original subset index
+			DataBinary.Write<uint16_t>(0);				// level
+
+			DataBinary.Write<uint32_t>(SubMesh.VertexCount);
+			for (uint32_t j = SubMesh.VertexStart; j < SubMesh.VertexStart + SubMesh.VertexCount; ++j)
+			{
+				auto const& Vertex = Model.Vertices[j];
+
+				DataBinary.WriteC3Vector(Vertex.Position);
+				for (uint32_t k = 0; k < BONES_PER_VERTEX; ++k)
+					DataBinary.Write<uint8_t>(Vertex.BoneWeights[k]);
+				for (uint32_t k = 0; k < BONES_PER_VERTEX; ++k)
+					DataBinary.Write<uint8_t>(Vertex.BoneIndices[k]);
+				DataBinary.WriteC3Vector(Vertex.Normal);
+				for (uint32_t k = 0; k < MAX_SUBMESH_UV; ++k)
+					DataBinary.WriteC2Vector(Vertex.Texture[k]);
+			}
+
+			DataBinary.Write<uint32_t>(SubMesh.Triangles.size() / 3);
+			for (auto Index : SubMesh.Triangles)
+				DataBinary.Write<uint16_t>(Index);
+		}
+
+		DataBinary.Write<uint32_t>(Model.Bones.size());
+		for (uint32_t i = 0; i < Model.Bones.size(); ++i)
+		{
+			auto const& Bone = Model.Bones[i];
+
+			DataBinary.Write<uint16_t>(i);
+			DataBinary.Write<int16_t>(Bone.ParentBone);
+			DataBinary.WriteC3Vector(Bone.Position);
+			DataBinary.Write<uint8_t>(1);	// has data
+			DataBinary.Write<uint32_t>(Bone.Flags);
+			DataBinary.Write<uint16_t>(Bone.SubmeshId);
+			DataBinary.Write<uint16_t>(Bone.Unknown[0]);
+			DataBinary.Write<uint16_t>(Bone.Unknown[1]);
+		}
+
+		uint32_t AttachmentCount = Params.BoneCount ? Params.AttachmentCount : 0;
+		DataBinary.Write<uint32_t>(AttachmentCount);
+		for (uint32_t i = 0; i < AttachmentCount; ++i)
+		{
+			uint32_t ParentBone = i * Params.BoneCount / AttachmentCount;
+
+			DataBinary.Write<uint32_t>(i);
+			DataBinary.Write<int16_t>((int16_t)ParentBone);
+			DataBinary.WriteC3Vector(Model.Bones[ParentBone].Position + C3Vector(0.5f, 0.0f, 0.0f));
+			DataBinary.Write<float>(1.0f);
+		}
+
+		DataBinary.Write<uint32_t>(0);	// cameras
+
+		return FileData;
+	}
+
+	bool WriteFile(std::filesystem::path const& FileName, std::vector<uint8_t> const& Data)
+	{
+		std::fstream FileStream;
+		FileStream.open(FileName, std::ios::out | std::ios::trunc | std::ios::binary);
+		if (FileStream.fail())
+		{
+			sLogger.LogError(L"Failed to open '%s' for writing", FileName.wstring().c_str());
+			return false;
+		}
+
+		FileStream.write((char const*)Data.data(), Data.size());
+		FileStream.close();
+
+		return !FileStream.fail();
+	}
+}
+
+EError SyntheticCorpus::Generate(std::wstring const& Directory, std::wstring const& Name, SyntheticModelParams const& Params)
+{
+	if (!Params.SubMeshCount || !Params.BoneCount || Params.BoneCount > 256 || !Params.InfluencesPerVertex || Params.InfluencesPerVertex > BONES_PER_VERTEX)
+	{
+		sLogger.LogError(L"Invalid synthetic model parameters: %u sub meshes, %u bones, %u influences per vertex", Params.SubMeshCount, Params.BoneCount, Params.InfluencesPerVertex);
+		return EError_FAIL;
+	}
+
+	GeneratedModel Model;
+	auto Error = BuildModel(Params, Model);
+	if (Error != EError_OK)
+		return Error;
+
+	std::error_code ec;
+	std::filesystem::create_directories(Directory, ec);
+
+	auto BasePath = (std::filesystem::path(Directory) / Name).wstring();
+	if (!WriteFile(BasePath + L".m2", BuildM2(Params, Model, StringHelpers::WStringToString(Name))))
+		return EError_FailedToSaveM2;
+	if (!WriteFile(BasePath + L"00.skin", BuildSkin(Params, Model)))
+		return EError_FailedToSaveSKIN;
+	if (!WriteFile(BasePath + L".m2i", BuildM2I(Params, Model)))
+		return EError_FAIL;
+
+	sLogger.LogInfo(L"Generated synthetic model '%s': seed %u, %u vertices, %u sub meshes, %u bones, %u animations", BasePath.c_str(),
+		Params.Seed, (uint32_t)Model.Vertices.size(), (uint32_t)Model.SubMeshes.size(), (uint32_t)Model.Bones.size(), Params.AnimationCount);
+
+	return EError_OK;
+}
+
+EError SyntheticCorpus::Verify(std::wstring const& Directory, std::wstring const& Name)
+{
+	auto BasePath = (std::filesystem::path(Directory) / Name).wstring();
+
+	std::unique_ptr<M2> Model(new M2());
+	auto Error = Model->Load((BasePath + L".m2").c_str());
+	if (Error != EError_OK)
+		return Error;
+
+	if (!Model->GetSkin(0))
+		return EError_FailedToLoadSKIN_FileMissingOrCorrupt;
+
+	M2I Intermediate;
+	Error = Intermediate.Load((BasePath + L".m2i").c_str(), Model.get(), false, false, false, false);
+	if (Error != EError_OK)
+		return Error;
+
+	if (Intermediate.VertexList.size() != Model->Elements[EElement_Vertex].Count)
+	{
+		sLogger.LogError(L"Synthetic model '%s' has %u vertices, its M2I has %u", BasePath.c_str(), Model->Elements[EElement_Vertex].Count, (uint32_t)Intermediate.VertexList.size());
+		return EError_FailedToImportM2I_FileCorrupt;
+	}
+
+	return EError_OK;
+}
+
+EError SyntheticCorpus::GenerateCorpus(std::wstring const& Directory, SyntheticModelParams const& Params, uint32_t Count, bool Verify)
+{
+	for (uint32_t i = 0; i < Count; ++i)
+	{
+		SyntheticModelParams ModelParams = Params;
+		ModelParams.Seed = Params.Seed + i;
+
+		auto Name = L"synthetic_" + std::to_wstring(ModelParams.Seed);
+		auto Error = Generate(Directory, Name, ModelParams);
+		if (Error != EError_OK)
+			return Error;
+
+		if (Verify)
+		{
+			Error = SyntheticCorpus::Verify(Directory, Name);
+			if (Error != EError_OK)
+			{
+				sLogger.LogError(L"Synthetic model '%s' failed verification: %s", Name.c_str(), GetErrorText(Error));
+				return Error;
+			}
+		}
+	}
+
+	return EError_OK;
+}
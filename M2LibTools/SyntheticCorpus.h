@@ -0,0 +1,41 @@
+#pragma once
+
+#include "BaseTypes.h"
+#include "M2Types.h"
+#include <string>
+
+namespace M2Lib
+{
+	enum class SkinningPattern : uint32_t
+	{
+		Rigid = 0,		// every vertex follows single bone of its sub mesh
+		Chain = 1,		// vertices blend between neighbouring bones of chain that runs along model height
+		Scattered = 2,	// vertices are weighted to random bones, produces many bone partitions
+	};
+
+	struct SyntheticModelParams
+	{
+		uint32_t Seed = 1;
+		uint32_t SubMeshCount = 8;
+		uint32_t VerticesPerSubMesh = 1024;	// rounded down to full grid of rows and columns
+		uint32_t BoneCount = 32;				// up to 256
+		uint32_t InfluencesPerVertex = 2;		// up to 4
+		SkinningPattern Skinning = SkinningPattern::Chain;
+		uint32_t TextureCount = 4;
+		uint32_t AnimationCount = 4;
+		uint32_t KeysPerTrack = 16;
+		uint32_t AttachmentCount = 4;
+	};
+
+	// procedurally generated models for benchmarks and bug reports that can't ship game assets.
+	namespace SyntheticCorpus
+	{
+		// writes Name.m2, Name00.skin and matching Name.m2i to Directory.
+		// output depends only on Params, same seed produces byte identical files.
+		EError Generate(std::wstring const& Directory, std::wstring const& Name, SyntheticModelParams const& Params);
+		// loads generated model through M2::Load and its M2I through M2I::Load.
+		EError Verify(std::wstring const& Directory, std::wstring const& Name);
+		// generates Count models named synthetic_<seed>, seeds start at Params.Seed.
+		EError GenerateCorpus(std::wstring const& Directory, SyntheticModelParams const& Params, uint32_t Count, bool Verify);
+	}
+}
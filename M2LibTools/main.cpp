@@ -0,0 +1,130 @@
+#include "Benchmark.h"
+#include "CloneBenchmark.h"
+#include "Settings.h"
+#include "SyntheticCorpus.h"
+#include "Logger.h"
+#include "ThreadPool.h"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace M2Lib;
+
+// command line front end for benchmarks and other developer tools, they are not part of M2Lib.dll.
+namespace
+{
+	struct Command
+	{
+		wchar_t const* Name;
+		wchar_t const* Usage;
+		int (*Run)(int ArgCount, wchar_t** Args);
+	};
+
+	void __stdcall PrintLog(uint8_t LogLevel, wchar_t const* Message)
+	{
+		fwprintf(LogLevel == LOG_ERROR ? stderr : stdout, L"%s\n", Message);
+	}
+
+	int ReportError(EError Error)
+	{
+		if (Error == EError_OK)
+			return 0;
+
+		fwprintf(stderr, L"Failed: %s\n", GetErrorText(Error));
+		return 1;
+	}
+
+	int RunClone(int ArgCount, wchar_t** Args)
+	{
+		if (ArgCount < 1)
+			return -1;
+
+		uint32_t Iterations = ArgCount > 1 ? wcstoul(Args[1], NULL, 10) : 10;
+
+		Settings settings;
+		double ReloadMs, CloneMs;
+		return ReportError(Benchmark::CloneVsReload(Args[0], &settings, Iterations, ReloadMs, CloneMs));
+	}
+
+	int RunSuite(int ArgCount, wchar_t** Args)
+	{
+		if (ArgCount < 1)
+			return -1;
+
+		BenchmarkSuite Suite(Args[0]);
+		if (ArgCount > 2)
+			Suite.SetIterationLimits(wcstoul(Args[2], NULL, 10), ArgCount > 3 ? wcstod(Args[3], NULL) : 250.0);
+
+		if (int Result = ReportError(Suite.Run()))
+			return Result;
+
+		Suite.PrintSummary();
+
+		if (ArgCount > 1 && !Suite.ExportJson(Args[1]))
+		{
+			fwprintf(stderr, L"Failed to write %s\n", Args[1]);
+			return 1;
+		}
+
+		return 0;
+	}
+
+	int RunCorpus(int ArgCount, wchar_t** Args)
+	{
+		if (ArgCount < 1)
+			return -1;
+
+		SyntheticModelParams Params;
+		uint32_t Count = ArgCount > 1 ? wcstoul(Args[1], NULL, 10) : 1;
+		if (ArgCount > 2)
+			Params.Seed = wcstoul(Args[2], NULL, 10);
+
+		return ReportError(SyntheticCorpus::GenerateCorpus(Args[0], Params, Count, true));
+	}
+
+	Command const Commands[] =
+	{
+		{ L"clone", L"clone <model.m2> [iterations]", RunClone },
+		{ L"bench", L"bench <directory> [results.json] [min iterations] [min ms]", RunSuite },
+		{ L"corpus", L"corpus <directory> [count] [first seed]", RunCorpus },
+	};
+
+	void PrintUsage()
+	{
+		wprintf(L"usage:\n");
+		for (auto& command : Commands)
+			wprintf(L"  M2LibTools %s\n", command.Usage);
+	}
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+	if (argc < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	sLogger.AttachCallback(LOG_ALL, PrintLog);
+
+	std::wstring Name = argv[1];
+	for (auto& command : Commands)
+	{
+		if (Name != command.Name)
+			continue;
+
+		int Result = command.Run(argc - 2, argv + 2);
+		if (Result < 0)
+		{
+			PrintUsage();
+			Result = 1;
+		}
+
+		// workers can't be joined by static destructor
+		ThreadPool::GetInstance()->Shutdown();
+		return Result;
+	}
+
+	PrintUsage();
+	return 1;
+}
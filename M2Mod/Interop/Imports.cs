@@ -1,4 +1,5 @@
 ﻿using System;
+using System.Collections.Generic;
 using System.Runtime.InteropServices;
 using M2Mod.Controls;
 using M2Mod.Interop.Structures;
@@ -27,6 +28,15 @@ namespace M2Mod.Interop
         [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
         public static extern M2LibError M2_SetNeedRemapReferences(IntPtr handle, [MarshalAs(UnmanagedType.LPWStr)]string filePath);
 
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void M2_SetRemapHardLinks(IntPtr handle, [MarshalAs(UnmanagedType.I1)] bool hardLinks);
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern M2LibError M2_ReduceKeyframes(IntPtr handle, float positionTolerance, float angleTolerance);
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern M2LibError M2_CalculateAnimationBounds(IntPtr handle, uint sampleInterval);
+
         [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
         public static extern M2LibError M2_SetNeedRemoveTXIDChunk(IntPtr handle);
 
@@ -39,6 +49,24 @@ namespace M2Mod.Interop
         public static extern M2LibError M2_SetReplaceM2(IntPtr handle,
             [MarshalAs(UnmanagedType.LPWStr)] string filePath);
 
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr M2_Clone(IntPtr handle);
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void M2_SetLazyLoad(IntPtr handle, [MarshalAs(UnmanagedType.I1)] bool lazy);
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern M2LibError M2_LoadLazyParts(IntPtr handle);
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void M2_PrintLazyLoadInfo(IntPtr handle);
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern ulong M2_GetMemoryUsage(IntPtr handle);
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void M2_PrintMemoryUsage(IntPtr handle);
+
         [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
         public static extern void M2_Free(IntPtr handle);
 
@@ -52,9 +80,34 @@ namespace M2Mod.Interop
         [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
         public static extern void FileStorage_Clear();
 
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void FileStorage_SetBaseDirectory([MarshalAs(UnmanagedType.LPWStr)] string baseDirectory);
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void BuildCache_SetDirectory([MarshalAs(UnmanagedType.LPWStr)] string directory, ulong maxSize);
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void BuildCache_Clear();
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void BuildCache_PrintStatistics();
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void SkeletonCache_SetEnabled([MarshalAs(UnmanagedType.I1)] bool enabled);
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void SkeletonCache_Clear();
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void SkeletonCache_PrintStatistics();
+
         [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
         public static extern void FileStorage_SetMappingsDirectory(IntPtr handle, [MarshalAs(UnmanagedType.LPWStr)] string mappingsDirectory);
 
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool FileStorage_Reload(IntPtr handle);
+
         [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
         public static extern IntPtr FileStorage_GetFileInfoByFileDataId(IntPtr handle, uint fileDataId);
 
@@ -76,6 +129,71 @@ namespace M2Mod.Interop
         [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
         public static extern void DetachLoggerCallback(LogLevel logLevel, LoggerDelegate callback);
 
+        public delegate void LoggerBatchDelegate(uint count, IntPtr logLevels, IntPtr messages);
+
+        // batch arrays are valid only during callback, messages have to be copied before they are passed to UI thread
+        public static List<KeyValuePair<LogLevel, string>> ReadLoggerBatch(uint count, IntPtr logLevels, IntPtr messages)
+        {
+            var batch = new List<KeyValuePair<LogLevel, string>>((int)count);
+            for (var i = 0; i < count; ++i)
+            {
+                var logLevel = (LogLevel)Marshal.ReadByte(logLevels, i);
+                var message = Marshal.PtrToStringUni(Marshal.ReadIntPtr(messages, i * IntPtr.Size));
+                batch.Add(new KeyValuePair<LogLevel, string>(logLevel, message));
+            }
+
+            return batch;
+        }
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void AttachLoggerBatchCallback(LogLevel logLevel, LoggerBatchDelegate callback);
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void DetachLoggerBatchCallback(LoggerBatchDelegate callback);
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void SetLoggerEnabledLevels(LogLevel logLevel);
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void FlushLogger();
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void ShutdownLogger();
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void ShutdownThreadPool();
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void Profiler_SetEnabled([MarshalAs(UnmanagedType.I1)] bool enabled);
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void Profiler_Reset();
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool Profiler_ExportChromeTrace([MarshalAs(UnmanagedType.LPWStr)] string fileName);
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void Profiler_PrintSummary();
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void MemoryTracker_SetEnabled([MarshalAs(UnmanagedType.I1)] bool enabled);
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void MemoryTracker_Reset();
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern long MemoryTracker_GetCurrentBytes();
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern long MemoryTracker_GetPeakBytes();
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern ulong MemoryTracker_GetAllocationCount();
+
+        [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void MemoryTracker_PrintReport();
+
         [DllImport("M2Lib.dll", CallingConvention = CallingConvention.Cdecl)]
         public static extern IntPtr Wrapper_Create(IntPtr oldM2, IntPtr newM2, float weightThreshold, bool compareTextures, bool precictScale, ref float sourceScale);
 
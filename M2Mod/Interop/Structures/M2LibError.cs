@@ -37,5 +37,8 @@ namespace M2Mod.Interop.Structures
 
         FailedToLoadSkeleton_NoFileSpecified,
         FailedToLoadSkeleton_CouldNotOpenFile,
+
+        FailedToLoadAnim_CouldNotOpenFile,
+        FailedToLoadAnim_FileCorrupt,
     }
 }
@@ -1,4 +1,6 @@
 ﻿using System;
+using System.Collections.Concurrent;
+using System.Collections.Generic;
 using System.IO;
 using System.Linq;
 using System.Net;
@@ -56,12 +58,42 @@ namespace M2Mod
 
         private static string VersionString => $"v{Version.Major}.{Version.Minor}.{Version.Patch}";
 
-        private Imports.LoggerDelegate logDelegate;
+        private Imports.LoggerBatchDelegate logDelegate;
+        private readonly ConcurrentQueue<KeyValuePair<LogLevel, string>> _pendingLog = new ConcurrentQueue<KeyValuePair<LogLevel, string>>();
+        private bool _showingLog;
 
         private void InitializeLogger()
         {
-            logDelegate = Log;
-            Imports.AttachLoggerCallback(LogLevel.AllDefault, logDelegate);
+            logDelegate = LogBatch;
+            Imports.AttachLoggerBatchCallback(LogLevel.AllDefault, logDelegate);
+        }
+
+        // called from logger thread, messages and error dialogs are shown on UI thread
+        private void LogBatch(uint count, IntPtr logLevels, IntPtr messages)
+        {
+            foreach (var entry in Imports.ReadLoggerBatch(count, logLevels, messages))
+                _pendingLog.Enqueue(entry);
+
+            if (IsHandleCreated)
+                BeginInvoke(new Action(ShowPendingLog));
+        }
+
+        private void ShowPendingLog()
+        {
+            // error dialog pumps messages, nested call would open next dialog on top of it
+            if (_showingLog)
+                return;
+
+            _showingLog = true;
+            try
+            {
+                while (_pendingLog.TryDequeue(out var entry))
+                    Log(entry.Key, entry.Value);
+            }
+            finally
+            {
+                _showingLog = false;
+            }
         }
 
         private void ResetIgnoreWarnings()
@@ -457,6 +489,8 @@ namespace M2Mod
 
         private void M2Mod_FormClosing(object sender, FormClosingEventArgs e)
         {
+            Imports.DetachLoggerBatchCallback(logDelegate);
+
             SaveFormDataToProfile(ProfileManager.CurrentProfile);
 
             ProfileManager.Save();
@@ -649,7 +683,9 @@ namespace M2Mod
 
         private void LoadMappingsButton_Click(object sender, EventArgs e)
         {
-            Imports.FileStorage_Clear();
+            // only new and appended mapping lines are parsed, storage is fully reloaded if some mapping file was rewritten
+            var fileStorage = Imports.FileStorage_Get(ProfileManager.CurrentProfile.Settings.MappingsDirectory);
+            Imports.FileStorage_Reload(fileStorage);
         }
 
         private void CustomMenuItem_Click(object sender, EventArgs e)
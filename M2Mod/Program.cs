@@ -14,6 +14,11 @@ namespace M2Mod
             Application.EnableVisualStyles();
             Application.SetCompatibleTextRenderingDefault(false);
             Application.Run(new M2ModForm());
+
+            // worker threads can't be stopped while library is being unloaded.
+            // pool goes first, its tasks may still log.
+            Interop.Imports.ShutdownThreadPool();
+            Interop.Imports.ShutdownLogger();
         }
     }
 }
@@ -10,7 +10,7 @@ namespace M2Mod.Tools
 {
     public partial class RemapReferencesForm : Form
     {
-        private Imports.LoggerDelegate logDelegate;
+        private Imports.LoggerBatchDelegate logDelegate;
 
         public RemapReferencesForm()
         {
@@ -18,13 +18,22 @@ namespace M2Mod.Tools
 
             this.Icon = Properties.Resources.Icon;
 
-            logDelegate = Log;
-            Imports.AttachLoggerCallback(LogLevel.Custom, logDelegate);
+            logDelegate = LogBatch;
+            Imports.AttachLoggerBatchCallback(LogLevel.Custom, logDelegate);
         }
 
-        private void Log(LogLevel logLevel, string message)
+        // called from logger thread
+        private void LogBatch(uint count, IntPtr logLevels, IntPtr messages)
         {
-            logTextBox.AppendLine(logLevel, message);
+            var batch = Imports.ReadLoggerBatch(count, logLevels, messages);
+            if (!IsHandleCreated)
+                return;
+
+            BeginInvoke(new Action(() =>
+            {
+                foreach (var entry in batch)
+                    logTextBox.AppendLine(entry.Key, entry.Value);
+            }));
         }
 
         private void closeButton_Click(object sender, EventArgs e)
@@ -126,7 +135,7 @@ namespace M2Mod.Tools
 
         private void RemapReferencesForm_FormClosing(object sender, FormClosingEventArgs e)
         {
-            Imports.DetachLoggerCallback(LogLevel.Custom, logDelegate);
+            Imports.DetachLoggerBatchCallback(logDelegate);
         }
     }
 }
@@ -10,7 +10,7 @@ namespace M2Mod.Tools
 {
     public partial class TXIDRemoverForm : Form
     {
-        private Imports.LoggerDelegate logDelegate;
+        private Imports.LoggerBatchDelegate logDelegate;
 
         public TXIDRemoverForm()
         {
@@ -18,8 +18,8 @@ namespace M2Mod.Tools
 
             this.Icon = Properties.Resources.Icon;
 
-            logDelegate = Log;
-            Imports.AttachLoggerCallback(LogLevel.Custom, logDelegate);
+            logDelegate = LogBatch;
+            Imports.AttachLoggerBatchCallback(LogLevel.Custom, logDelegate);
         }
 
         private void m2BrowseButton_Click(object sender, EventArgs e)
@@ -37,9 +37,18 @@ namespace M2Mod.Tools
             }
         }
 
-        private void Log(LogLevel logLevel, string message)
+        // called from logger thread
+        private void LogBatch(uint count, IntPtr logLevels, IntPtr messages)
         {
-            logTextBox.AppendLine(logLevel, message);
+            var batch = Imports.ReadLoggerBatch(count, logLevels, messages);
+            if (!IsHandleCreated)
+                return;
+
+            BeginInvoke(new Action(() =>
+            {
+                foreach (var entry in batch)
+                    logTextBox.AppendLine(entry.Key, entry.Value);
+            }));
         }
 
         private void convertButton_Click(object sender, EventArgs e)
@@ -111,7 +120,7 @@ namespace M2Mod.Tools
 
         private void TXIDRemover_FormClosing(object sender, FormClosingEventArgs e)
         {
-            Imports.DetachLoggerCallback(LogLevel.Custom, logDelegate);
+            Imports.DetachLoggerBatchCallback(logDelegate);
         }
     }
 }